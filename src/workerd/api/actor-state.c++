@@ -9,10 +9,12 @@
 #include <workerd/jsg/ser.h>
 #include <workerd/jsg/util.h>
 #include <v8.h>
+#include <algorithm>
 #include <workerd/io/actor-cache.h>
 #include <workerd/io/actor-id.h>
 #include <workerd/io/actor-storage.h>
 #include <workerd/io/actor-sqlite.h>
+#include <workerd/util/sqlite-kv.h>
 #include "sql.h"
 #include <workerd/api/web-socket.h>
 #include <workerd/io/hibernation-manager.h>
@@ -118,6 +120,27 @@ ActorObserver& currentActorMetrics() {
   return IoContext::current().getActorOrThrow().getMetrics();
 }
 
+void addListReadUnits(size_t cachedReadBytes, size_t uncachedReadBytes, bool completelyCached) {
+  auto& actorMetrics = currentActorMetrics();
+  if (cachedReadBytes || uncachedReadBytes) {
+    size_t totalReadBytes = cachedReadBytes + uncachedReadBytes;
+    uint32_t totalUnits = billingUnits(totalReadBytes);
+
+    // If we went to disk, we want to ensure we bill at least 1 uncached unit.
+    // Otherwise, we disable this behavior, to ensure a fully cached list will have
+    // uncachedUnits == 0.
+    auto billAtLeastOne = completelyCached ? BillAtLeastOne::NO : BillAtLeastOne::YES;
+    uint32_t uncachedUnits = billingUnits(uncachedReadBytes, billAtLeastOne);
+    uint32_t cachedUnits = totalUnits - uncachedUnits;
+
+    actorMetrics.addUncachedStorageReadUnits(uncachedUnits);
+    actorMetrics.addCachedStorageReadUnits(cachedUnits);
+  } else {
+    // We bill 1 uncached read unit if there was no results from the list.
+    actorMetrics.addUncachedStorageReadUnits(1);
+  }
+}
+
 jsg::JsRef<jsg::JsValue> listResultsToMap(jsg::Lock& js,
                                           ActorCacheOps::GetResultList value,
                                           bool completelyCached) {
@@ -131,25 +154,34 @@ jsg::JsRef<jsg::JsValue> listResultsToMap(jsg::Lock& js,
       bytesRef += entry.key.size() + entry.value.size();
       map.set(js, entry.key, deserializeV8Value(js, entry.key, entry.value));
     }
-    auto& actorMetrics = currentActorMetrics();
-    if (cachedReadBytes || uncachedReadBytes) {
-      size_t totalReadBytes = cachedReadBytes + uncachedReadBytes;
-      uint32_t totalUnits = billingUnits(totalReadBytes);
-
-      // If we went to disk, we want to ensure we bill at least 1 uncached unit.
-      // Otherwise, we disable this behavior, to ensure a fully cached list will have
-      // uncachedUnits == 0.
-      auto billAtLeastOne = completelyCached ? BillAtLeastOne::NO : BillAtLeastOne::YES;
-      uint32_t uncachedUnits = billingUnits(uncachedReadBytes, billAtLeastOne);
-      uint32_t cachedUnits = totalUnits - uncachedUnits;
-
-      actorMetrics.addUncachedStorageReadUnits(uncachedUnits);
-      actorMetrics.addCachedStorageReadUnits(cachedUnits);
+    addListReadUnits(cachedReadBytes, uncachedReadBytes, completelyCached);
+
+    return jsg::JsValue(map).addRef(js);
+  });
+}
+
+// Equivalent to listResultsToMap() applied to the result of list() or listReverse() on an
+// ActorSqlite, but deserializes each value straight out of SQLite's row buffer, without first
+// copying every row into a GetResultList.
+jsg::JsRef<jsg::JsValue> listSqliteKvToMap(jsg::Lock& js, SqliteKv& kv,
+                                           kj::StringPtr start, kj::Maybe<kj::StringPtr> end,
+                                           kj::Maybe<uint> limit, bool reverse) {
+  return js.withinHandleScope([&] {
+    auto map = js.map();
+    size_t readBytes = 0;
+    auto callback = [&](kj::StringPtr key, kj::ArrayPtr<const byte> value) {
+      readBytes += key.size() + value.size();
+      map.set(js, key, deserializeV8Value(js, key, value));
+    };
+    if (reverse) {
+      kv.list(start, end, limit, SqliteKv::REVERSE, callback);
     } else {
-      // We bill 1 uncached read unit if there was no results from the list.
-      actorMetrics.addUncachedStorageReadUnits(1);
+      kv.list(start, end, limit, SqliteKv::FORWARD, callback);
     }
 
+    // Like ActorSqlite, count everything as uncached, though read synchronously.
+    addListReadUnits(0, readBytes, true);
+
     return jsg::JsValue(map).addRef(js);
   });
 }
@@ -192,6 +224,33 @@ getMultipleResultsToMap(
   };
 }
 
+// Equivalent to getMultipleResultsToMap() applied to the result of get() on an ActorSqlite, but
+// deserializes each value straight out of SQLite's row buffer.
+jsg::JsRef<jsg::JsValue> getMultipleSqliteKvToMap(jsg::Lock& js, SqliteKv& kv,
+                                                  kj::ArrayPtr<const kj::String> keys) {
+  return js.withinHandleScope([&] {
+    // Sorting the keys makes results come back in key order, as they do from get().
+    auto keyPtrs = KJ_MAP(key, keys) -> kj::StringPtr { return key; };
+    std::sort(keyPtrs.begin(), keyPtrs.end());
+
+    auto map = js.map();
+    uint32_t uncachedUnits = 0;
+    size_t count = kv.get(keyPtrs, [&](kj::StringPtr key, kj::ArrayPtr<const byte> value) {
+      uncachedUnits += billingUnits(key.size() + value.size());
+      map.set(js, key, deserializeV8Value(js, key, value));
+    });
+
+    auto& actorMetrics = currentActorMetrics();
+    actorMetrics.addCachedStorageReadUnits(0);
+
+    // As in getMultipleResultsToMap(), keys which weren't found are billed too.
+    size_t leftoverKeys = keys.size() - kj::min(count, keys.size());
+    actorMetrics.addUncachedStorageReadUnits(leftoverKeys + uncachedUnits);
+
+    return jsg::JsValue(map).addRef(js);
+  });
+}
+
 kj::Promise<void> updateStorageWriteUnit(IoContext& context,
                                          ActorObserver& metrics,
                                          uint32_t units) {
@@ -392,9 +451,15 @@ jsg::Promise<jsg::JsRef<jsg::JsValue>> DurableObjectStorageOperations::list(
   auto options = configureOptions(kj::mv(maybeOptions).orDefault(ListOptions{}));
   ActorCacheOps::ReadOptions readOptions = options;
 
+  auto& cache = getCache(OP_LIST);
+  KJ_IF_SOME(kv, cache.getSqliteKv()) {
+    return js.resolvedPromise(listSqliteKvToMap(js, kv, start,
+        end.map([](kj::String& e) -> kj::StringPtr { return e; }), limit, reverse));
+  }
+
   auto result = reverse
-      ? getCache(OP_LIST).listReverse(kj::mv(start), kj::mv(end), limit, readOptions)
-      : getCache(OP_LIST).list(kj::mv(start), kj::mv(end), limit, readOptions);
+      ? cache.listReverse(kj::mv(start), kj::mv(end), limit, readOptions)
+      : cache.list(kj::mv(start), kj::mv(end), limit, readOptions);
   return transformCacheResultWithCacheStatus(js, kj::mv(result),
                                              options, &listResultsToMap);
 }
@@ -560,9 +625,14 @@ jsg::Promise<jsg::JsRef<jsg::JsValue>> DurableObjectStorageOperations::getMultip
     const GetOptions& options) {
   ActorStorageLimits::checkMaxPairsCount(keys.size());
 
+  auto& cache = getCache(OP_GET);
+  KJ_IF_SOME(kv, cache.getSqliteKv()) {
+    return js.resolvedPromise(getMultipleSqliteKvToMap(js, kv, keys));
+  }
+
   auto numKeys = keys.size();
 
-  return transformCacheResult(js, getCache(OP_GET).get(kj::mv(keys), options),
+  return transformCacheResult(js, cache.get(kj::mv(keys), options),
                               options, getMultipleResultsToMap(numKeys));
 }
 
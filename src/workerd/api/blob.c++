@@ -9,53 +9,153 @@
 
 namespace workerd::api {
 
-// Concatenate an array of segments (parameter to Blob constructor).
-static kj::Array<byte> concat(jsg::Optional<Blob::Bits> maybeBits) {
-  // TODO(perf): Make it so that a Blob can keep references to the input data rather than copy it.
-  //   Note that we can't keep references to ArrayBuffers since they are mutable, but we can
-  //   reference other Blobs in the input.
-
-  auto bits = kj::mv(maybeBits).orDefault(nullptr);
-
-  size_t size = 0;
-  for (auto& part: bits) {
-    KJ_SWITCH_ONEOF(part) {
-      KJ_CASE_ONEOF(bytes, kj::Array<const byte>) {
-        size += bytes.size();
+namespace {
+
+// Assembles the content of a new Blob out of copied bytes and shared pieces of existing Blobs.
+// Everything passed in must stay alive until build() is called.
+class ContentBuilder {
+public:
+  void addCopy(kj::ArrayPtr<const byte> bytes) {
+    if (bytes.size() == 0) return;
+    copySize += bytes.size();
+    pieces.add(bytes);
+  }
+
+  void addBlob(Blob& blob, size_t start, size_t end) {
+    for (auto& segment: blob.shareSegments(start, end)) {
+      if (segment.data.size() < Blob::MIN_SHARED_SEGMENT_SIZE) {
+        addCopy(segment.data);
+      } else {
+        pieces.add(kj::mv(segment));
+      }
+    }
+  }
+
+  // Adds the parts passed to the Blob or File constructor. ArrayBuffers are mutable, so their
+  // content has to be copied, but other Blobs can be shared.
+  void addBits(Blob::Bits& bits) {
+    for (auto& part: bits) {
+      KJ_SWITCH_ONEOF(part) {
+        KJ_CASE_ONEOF(bytes, kj::Array<const byte>) {
+          addCopy(bytes);
+        }
+        KJ_CASE_ONEOF(text, kj::String) {
+          addCopy(text.asBytes());
+        }
+        KJ_CASE_ONEOF(blob, jsg::Ref<Blob>) {
+          addBlob(*blob, 0, blob->getSize());
+        }
       }
-      KJ_CASE_ONEOF(text, kj::String) {
-        size += text.size();
+    }
+  }
+
+  template <typename T, typename... Params>
+  jsg::Ref<T> build(Params&&... params) {
+    auto ownData = kj::heapArray<byte>(copySize);
+    kj::Vector<Blob::Segment> segments(pieces.size());
+
+    // Consecutive copied pieces end up in a single segment.
+    byte* pos = ownData.begin();
+    byte* runStart = pos;
+    auto endRun = [&]() {
+      if (pos != runStart) {
+        segments.add(Blob::Segment { kj::none, kj::arrayPtr(runStart, pos) });
+        runStart = pos;
       }
-      KJ_CASE_ONEOF(blob, jsg::Ref<Blob>) {
-        size += blob->getData().size();
+    };
+
+    for (auto& piece: pieces) {
+      KJ_SWITCH_ONEOF(piece) {
+        KJ_CASE_ONEOF(bytes, kj::ArrayPtr<const byte>) {
+          memcpy(pos, bytes.begin(), bytes.size());
+          pos += bytes.size();
+        }
+        KJ_CASE_ONEOF(segment, Blob::Segment) {
+          endRun();
+          segments.add(kj::mv(segment));
+        }
       }
     }
+    endRun();
+
+    KJ_ASSERT(pos == ownData.end());
+    return jsg::alloc<T>(kj::mv(ownData), segments.releaseAsArray(), kj::fwd<Params>(params)...);
   }
 
-  if (size == 0) return nullptr;
+private:
+  kj::Vector<kj::OneOf<kj::ArrayPtr<const byte>, Blob::Segment>> pieces;
+  size_t copySize = 0;
+};
+
+}  // namespace
+
+Blob::Blob(kj::Array<byte> data, kj::String type)
+    : ownData(kj::mv(data)), size(ownData.size()), type(kj::mv(type)) {
+  if (size > 0) {
+    segments = kj::arr(Segment { kj::none, ownData });
+  }
+}
 
+Blob::Blob(jsg::Ref<Blob> parent, kj::ArrayPtr<const byte> data, kj::String type)
+    : size(data.size()), type(kj::mv(type)) {
+  if (size > 0) {
+    segments = kj::arr(Segment { kj::mv(parent), data });
+  }
+}
+
+Blob::Blob(kj::Array<byte> ownData, kj::Array<Segment> segments, kj::String type)
+    : ownData(kj::mv(ownData)), segments(kj::mv(segments)), size(0), type(kj::mv(type)) {
+  for (auto& segment: this->segments) {
+    size += segment.data.size();
+  }
+}
+
+kj::ArrayPtr<const byte> Blob::getData() const {
+  switch (segments.size()) {
+    case 0:
+      return nullptr;
+    case 1:
+      return segments[0].data;
+  }
+
+  KJ_IF_SOME(f, flattened) {
+    return f;
+  }
   auto result = kj::heapArray<byte>(size);
-  byte* ptr = result.begin();
+  copyTo(result);
+  return flattened.emplace(kj::mv(result));
+}
 
-  for (auto& part: bits) {
-    KJ_SWITCH_ONEOF(part) {
-      KJ_CASE_ONEOF(bytes, kj::Array<const byte>) {
-        memcpy(ptr, bytes.begin(), bytes.size());
-        ptr += bytes.size();
-      }
-      KJ_CASE_ONEOF(text, kj::String) {
-        memcpy(ptr, text.begin(), text.size());
-        ptr += text.size();
-      }
-      KJ_CASE_ONEOF(blob, jsg::Ref<Blob>) {
-        memcpy(ptr, blob->getData().begin(), blob->getData().size());
-        ptr += blob->getData().size();
-      }
-    }
+void Blob::copyTo(kj::ArrayPtr<byte> out) const {
+  KJ_DASSERT(out.size() == size);
+  byte* pos = out.begin();
+  for (auto& segment: segments) {
+    memcpy(pos, segment.data.begin(), segment.data.size());
+    pos += segment.data.size();
   }
+}
 
-  KJ_ASSERT(ptr == result.end());
-  return result;
+kj::Array<Blob::Segment> Blob::shareSegments(size_t start, size_t end) {
+  KJ_DASSERT(start <= end && end <= size);
+  if (start == end) return nullptr;
+
+  kj::Vector<Segment> result;
+  size_t offset = 0;
+  for (auto& segment: segments) {
+    size_t segmentStart = offset;
+    offset += segment.data.size();
+    if (offset <= start) continue;
+    if (segmentStart >= end) break;
+
+    auto data = segment.data.slice(kj::max(start, segmentStart) - segmentStart,
+                                   kj::min(end, offset) - segmentStart);
+    KJ_IF_SOME(owner, segment.owner) {
+      result.add(Segment { owner.addRef(), data });
+    } else {
+      result.add(Segment { JSG_THIS, data });
+    }
+  }
+  return result.releaseAsArray();
 }
 
 static kj::String normalizeType(kj::String type) {
@@ -87,52 +187,63 @@ jsg::Ref<Blob> Blob::constructor(jsg::Optional<Bits> bits, jsg::Optional<Options
     }
   }
 
-  return jsg::alloc<Blob>(concat(kj::mv(bits)), kj::mv(type));
+  ContentBuilder builder;
+  KJ_IF_SOME(b, bits) {
+    builder.addBits(b);
+  }
+  return builder.build<Blob>(kj::mv(type));
 }
 
 jsg::Ref<Blob> Blob::slice(jsg::Optional<int> maybeStart, jsg::Optional<int> maybeEnd,
                             jsg::Optional<kj::String> type) {
   int start = maybeStart.orDefault(0);
-  int end = maybeEnd.orDefault(data.size());
+  int end = maybeEnd.orDefault(size);
 
   if (start < 0) {
     // Negative value interpreted as offset from end.
-    start += data.size();
+    start += size;
   }
   // Clamp start to range.
   if (start < 0) {
     start = 0;
-  } else if (start > data.size()) {
-    start = data.size();
+  } else if (start > size) {
+    start = size;
   }
 
   if (end < 0) {
     // Negative value interpreted as offset from end.
-    end += data.size();
+    end += size;
   }
   // Clamp end to range.
   if (end < start) {
     end = start;
-  } else if (end > data.size()) {
-    end = data.size();
+  } else if (end > size) {
+    end = size;
   }
 
-  return jsg::alloc<Blob>(JSG_THIS, data.slice(start, end),
-      normalizeType(kj::mv(type).orDefault(nullptr)));
+  ContentBuilder builder;
+  builder.addBlob(*this, start, end);
+  return builder.build<Blob>(normalizeType(kj::mv(type).orDefault(nullptr)));
 }
 
 jsg::Promise<kj::Array<kj::byte>> Blob::arrayBuffer(jsg::Lock& js) {
-  // TODO(perf): Find a way to avoid the copy.
-  return js.resolvedPromise(kj::heapArray<byte>(data));
+  // ArrayBuffers are mutable, so we can't avoid copying, but we can at least gather the segments
+  // straight into the result.
+  auto result = kj::heapArray<byte>(size);
+  copyTo(result);
+  return js.resolvedPromise(kj::mv(result));
 }
 jsg::Promise<kj::String> Blob::text(jsg::Lock& js) {
-  return js.resolvedPromise(kj::str(data.asChars()));
+  auto result = kj::heapString(size);
+  copyTo(result.asBytes());
+  return js.resolvedPromise(kj::mv(result));
 }
 
 class Blob::BlobInputStream final: public ReadableStreamSource {
 public:
   BlobInputStream(jsg::Ref<Blob> blob)
-      : unread(blob->data),
+      : unreadSegments(blob->segments),
+        unreadSize(blob->size),
         blob(kj::mv(blob)) {}
 
   // Attempt to read a maximum of maxBytes from the remaining unread content of the blob
@@ -142,11 +253,21 @@ public:
   // The buffer must be kept alive by the caller until the returned promise is fulfilled.
   // The returned promise is fulfilled with the actual number of bytes read.
   kj::Promise<size_t> tryRead(void* buffer, size_t minBytes, size_t maxBytes) override {
-    size_t amount = kj::min(maxBytes, unread.size());
-    if (amount > 0) {
-      memcpy(buffer, unread.begin(), amount);
-      unread = unread.slice(amount, unread.size());
+    byte* pos = static_cast<byte*>(buffer);
+    size_t amount = kj::min(maxBytes, unreadSize);
+    size_t remaining = amount;
+    while (remaining > 0) {
+      if (current.size() == 0) {
+        current = unreadSegments.front().data;
+        unreadSegments = unreadSegments.slice(1, unreadSegments.size());
+      }
+      size_t n = kj::min(remaining, current.size());
+      memcpy(pos, current.begin(), n);
+      current = current.slice(n, current.size());
+      pos += n;
+      remaining -= n;
     }
+    unreadSize -= amount;
     return amount;
   }
 
@@ -154,22 +275,30 @@ public:
   // encoding is supported. This implementation only supports StreamEncoding::IDENTITY.
   kj::Maybe<uint64_t> tryGetLength(StreamEncoding encoding) override {
     if (encoding == StreamEncoding::IDENTITY) {
-      return unread.size();
+      return unreadSize;
     } else {
       return kj::none;
     }
   }
 
-  // Write all of the remaining unread content of the blob to output.
+  // Write all of the remaining unread content of the blob to output, one piece per segment.
   // If end is true, output.end() will be called once the write has been completed.
   // Importantly, the WritableStreamSink must be kept alive by the caller until the
   // returned promise is fulfilled.
   kj::Promise<DeferredProxy<void>> pumpTo(WritableStreamSink& output, bool end) override {
-    if (unread.size() != 0) {
-      auto promise = output.write(unread.begin(), unread.size());
-      unread = nullptr;
+    if (unreadSize != 0) {
+      kj::Vector<kj::ArrayPtr<const byte>> pieces(unreadSegments.size() + 1);
+      if (current.size() != 0) {
+        pieces.add(current);
+      }
+      for (auto& segment: unreadSegments) {
+        pieces.add(segment.data);
+      }
+      current = nullptr;
+      unreadSegments = nullptr;
+      unreadSize = 0;
 
-      co_await promise;
+      co_await output.write(pieces.asPtr());
 
       if (end) co_await output.end();
     }
@@ -180,14 +309,19 @@ public:
   }
 
 private:
-  kj::ArrayPtr<const byte> unread;
+  // The unread part of the segment being read, followed by the segments not yet started.
+  kj::ArrayPtr<const byte> current;
+  kj::ArrayPtr<const Segment> unreadSegments;
+  size_t unreadSize;
   jsg::Ref<Blob> blob;
 };
 
+kj::Own<ReadableStreamSource> Blob::newInputStream() {
+  return kj::heap<BlobInputStream>(JSG_THIS);
+}
+
 jsg::Ref<ReadableStream> Blob::stream() {
-  return jsg::alloc<ReadableStream>(
-      IoContext::current(),
-      kj::heap<BlobInputStream>(JSG_THIS));
+  return jsg::alloc<ReadableStream>(IoContext::current(), newInputStream());
 }
 
 // =======================================================================================
@@ -210,7 +344,11 @@ jsg::Ref<File> File::constructor(jsg::Optional<Bits> bits,
     lastModified = dateNow();
   }
 
-  return jsg::alloc<File>(concat(kj::mv(bits)), kj::mv(name), kj::mv(type), lastModified);
+  ContentBuilder builder;
+  KJ_IF_SOME(b, bits) {
+    builder.addBits(b);
+  }
+  return builder.build<File>(kj::mv(name), kj::mv(type), lastModified);
 }
 
 }  // namespace workerd::api
@@ -10,16 +10,46 @@
 namespace workerd::api {
 
 class ReadableStream;
+class ReadableStreamSource;
 
 // An implementation of the Web Platform Standard Blob API
+//
+// A Blob's content is a sequence of segments, each of which views immutable bytes owned either by
+// the Blob itself or by some other Blob it holds a reference to. This way, slicing Blobs and
+// building new Blobs out of existing ones shares their content rather than copying it.
 class Blob: public jsg::Object {
 public:
-  Blob(kj::Array<byte> data, kj::String type)
-      : ownData(kj::mv(data)), data(ownData.get<kj::Array<byte>>()), type(kj::mv(type)) {}
-  Blob(jsg::Ref<Blob> parent, kj::ArrayPtr<const byte> data, kj::String type)
-      : ownData(kj::mv(parent)), data(data), type(kj::mv(type)) {}
+  struct Segment {
+    // The Blob whose bytes `data` points into, or none if they belong to the Blob holding this
+    // segment. Sharing a Blob's content references the Blobs owning the bytes, not the Blob being
+    // shared, so that chains of slices don't keep each other alive.
+    kj::Maybe<jsg::Ref<Blob>> owner;
+    kj::ArrayPtr<const byte> data;
+  };
+
+  // Pieces of other Blobs (or other shared buffers) smaller than this are copied rather than
+  // shared, as a segment costs about as much as the copy, and would keep the whole of the buffer
+  // owning the bytes alive.
+  static constexpr size_t MIN_SHARED_SEGMENT_SIZE = 1024;
+
+  Blob(kj::Array<byte> data, kj::String type);
+  Blob(jsg::Ref<Blob> parent, kj::ArrayPtr<const byte> data, kj::String type);
+
+  // `segments` may point into `ownData`, which the Blob takes ownership of.
+  Blob(kj::Array<byte> ownData, kj::Array<Segment> segments, kj::String type);
+
+  // Returns the content as one contiguous array. If it is spread over several segments, this
+  // copies it the first time it's called, so prefer getSegments() where possible.
+  kj::ArrayPtr<const byte> getData() const KJ_LIFETIMEBOUND;
+
+  kj::ArrayPtr<const Segment> getSegments() const KJ_LIFETIMEBOUND { return segments; }
 
-  inline kj::ArrayPtr<const byte> getData() const KJ_LIFETIMEBOUND { return data; }
+  // Returns segments with the same content as bytes [start, end) of this Blob, for constructing
+  // another Blob (or File) which shares it.
+  kj::Array<Segment> shareSegments(size_t start, size_t end);
+
+  // Returns a stream of the content, which writes out each segment as it is.
+  kj::Own<ReadableStreamSource> newInputStream();
 
   // ---------------------------------------------------------------------------
   // JS API
@@ -35,7 +65,7 @@ public:
 
   static jsg::Ref<Blob> constructor(jsg::Optional<Bits> bits, jsg::Optional<Options> options);
 
-  int getSize() const { return data.size(); }
+  int getSize() const { return size; }
   kj::StringPtr getType() const { return type; }
 
   jsg::Ref<Blob> slice(jsg::Optional<int> start, jsg::Optional<int> end,
@@ -61,28 +91,32 @@ public:
   }
 
   void visitForMemoryInfo(jsg::MemoryTracker& tracker) const {
-    KJ_SWITCH_ONEOF(ownData) {
-      KJ_CASE_ONEOF(data, kj::Array<byte>) {
-        tracker.trackField("ownData", data);
-      }
-      KJ_CASE_ONEOF(data, jsg::Ref<Blob>) {
-        tracker.trackField("ownData", data);
-      }
+    tracker.trackField("ownData", ownData);
+    for (auto& segment: segments) {
+      tracker.trackField("owner", segment.owner);
     }
+    tracker.trackField("flattened", flattened);
     tracker.trackField("type", type);
   }
 
 private:
-  kj::OneOf<kj::Array<byte>, jsg::Ref<Blob>> ownData;
-  kj::ArrayPtr<const byte> data;
+  kj::Array<byte> ownData;
+  kj::Array<Segment> segments;
+  size_t size;
   kj::String type;
 
+  // The content copied into one array, if getData() had to do so.
+  mutable kj::Maybe<kj::Array<byte>> flattened;
+
   void visitForGc(jsg::GcVisitor& visitor) {
-    KJ_IF_SOME(b, ownData.tryGet<jsg::Ref<Blob>>()) {
-      visitor.visit(b);
+    for (auto& segment: segments) {
+      visitor.visit(segment.owner);
     }
   }
 
+  // Copies the content into `out`, which must be exactly as large.
+  void copyTo(kj::ArrayPtr<byte> out) const;
+
   class BlobInputStream;
 };
 
@@ -92,6 +126,14 @@ public:
   File(kj::Array<byte> data, kj::String name, kj::String type, double lastModified)
       : Blob(kj::mv(data), kj::mv(type)),
         name(kj::mv(name)), lastModified(lastModified) {}
+  File(jsg::Ref<Blob> parent, kj::ArrayPtr<const byte> data, kj::String name, kj::String type,
+       double lastModified)
+      : Blob(kj::mv(parent), data, kj::mv(type)),
+        name(kj::mv(name)), lastModified(lastModified) {}
+  File(kj::Array<byte> ownData, kj::Array<Segment> segments, kj::String name, kj::String type,
+       double lastModified)
+      : Blob(kj::mv(ownData), kj::mv(segments), kj::mv(type)),
+        name(kj::mv(name)), lastModified(lastModified) {}
 
   struct Options {
     jsg::Optional<kj::String> type;
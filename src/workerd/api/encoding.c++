@@ -5,6 +5,7 @@
 #include "encoding.h"
 #include <workerd/jsg/jsg.h>
 #include <workerd/jsg/buffersource.h>
+#include <workerd/util/utf8.h>
 #include <unicode/ucnv.h>
 #include <unicode/utf8.h>
 #include <algorithm>
@@ -294,7 +295,7 @@ kj::Maybe<IcuDecoder> IcuDecoder::create(Encoding encoding, bool fatal, bool ign
     if (U_FAILURE(status)) return kj::none;
   }
 
-  return IcuDecoder(encoding, inner, ignoreBom);
+  return IcuDecoder(encoding, inner, fatal, ignoreBom);
 }
 
 kj::Maybe<jsg::JsString> IcuDecoder::decode(
@@ -317,8 +318,6 @@ kj::Maybe<jsg::JsString> IcuDecoder::decode(
     KJ_UNREACHABLE;
   };
 
-  const auto isUsAscii = [](const auto& b) { return b <= 0x7f; };
-
   KJ_DEFER({ if (flush) reset(); });
 
   // Evaluate fast-path options. These provide shortcuts for common cases with the caveat
@@ -326,16 +325,25 @@ kj::Maybe<jsg::JsString> IcuDecoder::decode(
   // conversions are being handled by v8 directly rather than by the ICU converter).
   if (buffer.size() > 0 && ucnv_toUCountPending(inner.get(), &status) == 0) {
     KJ_ASSERT(U_SUCCESS(status));
-    if (encoding == Encoding::Utf8 && std::all_of(buffer.begin(), buffer.end(), isUsAscii)) {
-      // This is a fast-path option for UTF-8 that can be taken when there
-      // are no buffered inputs and the non-empty input buffer contains only
-      // codepoints <= 0x7f. This path is safe because with ASCII range codepoints
-      // we know we won't accidentally split a multi-byte encoding. We also don't
-      // have to worry about the BOM here since the BOM bytes are > 0x7f.
-      // Note also that in this case we'll interpret as Latin1 since UTF-8 bytes
-      // within this range are identical to Latin1 and v8 allocates these more
-      // efficiently.
-      return js.str(buffer);
+    if (encoding == Encoding::Utf8) {
+      if (utf8::isAscii(buffer)) {
+        // This is a fast-path option for UTF-8 that can be taken when there
+        // are no buffered inputs and the non-empty input buffer contains only
+        // codepoints <= 0x7f. This path is safe because with ASCII range codepoints
+        // we know we won't accidentally split a multi-byte encoding. We also don't
+        // have to worry about the BOM here since the BOM bytes are > 0x7f.
+        // Note also that in this case we'll interpret as Latin1 since UTF-8 bytes
+        // within this range are identical to Latin1 and v8 allocates these more
+        // efficiently.
+        return js.str(buffer);
+      }
+
+      if (flush || utf8::incompleteSuffixLength(buffer) == 0) {
+        // There's nothing the converter would need to carry over to the next call, so we can
+        // decode the whole buffer ourselves. The output is the same as ICU's, including the
+        // replacement of invalid sequences.
+        return decodeUtf8(js, buffer);
+      }
     }
 
     if (encoding == Encoding::Utf16le && buffer.size() % sizeof(char16_t) == 0) {
@@ -393,6 +401,33 @@ kj::Maybe<jsg::JsString> IcuDecoder::decode(
   return js.str(result.slice(omitInitialBom ? 1 : 0, length));
 }
 
+kj::Maybe<jsg::JsString> IcuDecoder::decodeUtf8(
+    jsg::Lock& js,
+    kj::ArrayPtr<const kj::byte> buffer) {
+  static constexpr kj::byte BOM[] = { 0xef, 0xbb, 0xbf };
+
+  if (!ignoreBom && !bomSeen) {
+    if (buffer.size() >= sizeof(BOM) && memcmp(buffer.begin(), BOM, sizeof(BOM)) == 0) {
+      buffer = buffer.slice(sizeof(BOM), buffer.size());
+    }
+    bomSeen = true;
+  }
+
+  auto info = utf8::scan(buffer);
+  if (!info.isValid && fatal) return kj::none;
+
+  if (info.isLatin1) {
+    // V8 stores these more compactly than two-byte strings.
+    KJ_STACK_ARRAY(kj::byte, result, info.utf16Length, 512, 4096);
+    utf8::decodeToLatin1(buffer, result);
+    return js.str(result);
+  }
+
+  KJ_STACK_ARRAY(char16_t, result, info.utf16Length, 512, 4096);
+  utf8::decodeToUtf16(buffer, result);
+  return js.str(result);
+}
+
 kj::Maybe<jsg::JsString> AsciiDecoder::decode(jsg::Lock& js,
                                               kj::ArrayPtr<const kj::byte> buffer,
                                               bool flush) {
@@ -481,25 +516,46 @@ jsg::Ref<TextEncoder> TextEncoder::constructor() {
 }
 
 namespace {
+// Returns the length of the UTF-8 encoding of `input`.
+size_t utf8Length(jsg::Lock& js, jsg::JsString input) {
+  v8::String::ValueView view(js.v8Isolate, input);
+  if (view.is_one_byte()) {
+    return utf8::encodedLength(kj::arrayPtr(view.data8(), view.length()));
+  } else {
+    return utf8::encodedLength(kj::arrayPtr(
+        reinterpret_cast<const char16_t*>(view.data16()), view.length()));
+  }
+}
+
+// Encodes as much of `input` into `buffer` as will fit. Unpaired surrogates are replaced with
+// U+FFFD.
+//
+// We read the string's contents in place rather than going through v8::String::WriteUtf8(), so
+// that we can use our own vectorized encoder. The ValueView forbids GC while it exists, so nothing
+// in here may allocate on the JS heap.
 TextEncoder::EncodeIntoResult encodeIntoImpl(jsg::Lock& js,
                                              jsg::JsString input,
-                                             jsg::BufferSource& buffer) {
-  auto result = input.writeInto(js, buffer.asArrayPtr().asChars(),
-                                static_cast<jsg::JsString::WriteOptions>(
-                                    jsg::JsString::NO_NULL_TERMINATION |
-                                    jsg::JsString::REPLACE_INVALID_UTF8));
+                                             kj::ArrayPtr<kj::byte> buffer) {
+  v8::String::ValueView view(js.v8Isolate, input);
+  utf8::EncodeResult result;
+  if (view.is_one_byte()) {
+    result = utf8::encode(kj::arrayPtr(view.data8(), view.length()), buffer);
+  } else {
+    result = utf8::encode(kj::arrayPtr(
+        reinterpret_cast<const char16_t*>(view.data16()), view.length()), buffer);
+  }
   return TextEncoder::EncodeIntoResult {
-    .read = result.read,
-    .written = result.written,
+    .read = static_cast<int>(result.read),
+    .written = static_cast<int>(result.written),
   };
 }
 }  // namespace
 
 jsg::BufferSource TextEncoder::encode(jsg::Lock& js, jsg::Optional<jsg::JsString> input) {
   auto str = input.orDefault(js.str());
-  auto view = JSG_REQUIRE_NONNULL(jsg::BufferSource::tryAlloc(js, str.utf8Length(js)),
+  auto view = JSG_REQUIRE_NONNULL(jsg::BufferSource::tryAlloc(js, utf8Length(js, str)),
                                   RangeError, "Cannot allocate space for TextEncoder.encode");
-  [[maybe_unused]] auto result = encodeIntoImpl(js, str, view);
+  [[maybe_unused]] auto result = encodeIntoImpl(js, str, view.asArrayPtr());
   KJ_DASSERT(result.written == view.size());
   return kj::mv(view);
 }
@@ -509,7 +565,7 @@ TextEncoder::EncodeIntoResult TextEncoder::encodeInto(jsg::Lock& js,
                                                       jsg::BufferSource buffer) {
   auto handle = buffer.getHandle(js);
   JSG_REQUIRE(handle->IsUint8Array(), TypeError, "buffer must be a Uint8Array");
-  return encodeIntoImpl(js, input, buffer);
+  return encodeIntoImpl(js, input, buffer.asArrayPtr());
 }
 
 }  // namespace workerd::api
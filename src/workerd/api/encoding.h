@@ -96,8 +96,8 @@ public:
 // of encodings required by the Encoding specification.
 class IcuDecoder: public Decoder {
 public:
-  IcuDecoder(Encoding encoding, UConverter* converter, bool ignoreBom)
-      : encoding(encoding), inner(converter), ignoreBom(ignoreBom), bomSeen(false) {}
+  IcuDecoder(Encoding encoding, UConverter* converter, bool fatal, bool ignoreBom)
+      : encoding(encoding), inner(converter), fatal(fatal), ignoreBom(ignoreBom), bomSeen(false) {}
   IcuDecoder(IcuDecoder&&) = default;
   IcuDecoder& operator=(IcuDecoder&&) = default;
 
@@ -120,8 +120,13 @@ private:
   Encoding encoding;
   std::unique_ptr<UConverter, ConverterDeleter> inner;
 
+  bool fatal;
   bool ignoreBom;
   bool bomSeen;
+
+  // Decodes UTF-8 input which does not end partway through a sequence without going through the
+  // ICU converter, which must not have any pending input.
+  kj::Maybe<jsg::JsString> decodeUtf8(jsg::Lock& js, kj::ArrayPtr<const kj::byte> buffer);
 };
 
 // Implements the TextDecoder interface as prescribed by:
@@ -9,8 +9,8 @@
 #include <kj/parse/char.h>
 #include <kj/compat/http.h>
 #include <workerd/util/mimetype.h>
-#include <algorithm>
-#include <regex>
+#include <workerd/util/substring-search.h>
+#include <cstring>
 
 #if !_MSC_VER
 #include <strings.h>
@@ -22,14 +22,24 @@ namespace {
 // Like split() in kj/compat/url.c++, but splits at a substring rather than a character.
 kj::ArrayPtr<const char> splitAtSubString(
     kj::ArrayPtr<const char>& text, kj::StringPtr subString) {
-  // TODO(perf): Use a Boyer-Moore search?
-  auto iter = std::search(text.begin(), text.end(), subString.begin(), subString.end());
-  auto result = kj::arrayPtr(text.begin(), iter - text.begin());
-  text = text.slice(kj::min(text.size(), result.end() - text.begin() + subString.size()),
-                    text.size());
+  auto pos = substring::findFirst(text.asBytes(), subString.asBytes());
+  auto result = text.slice(0, pos);
+  text = text.slice(kj::min(text.size(), pos + subString.size()), text.size());
   return result;
 }
 
+// Returns the length of the headers at the start of `text`, including the empty line which
+// terminates them, or kj::none if there is no empty line. Carriage returns are optional.
+kj::Maybe<size_t> findHeaderEnd(kj::ArrayPtr<const char> text) {
+  auto pos = text.begin();
+  while (auto lf = reinterpret_cast<const char*>(memchr(pos, '\n', text.end() - pos))) {
+    pos = lf + 1;
+    if (pos < text.end() && *pos == '\r') ++pos;
+    if (pos < text.end() && *pos == '\n') return pos + 1 - text.begin();
+  }
+  return kj::none;
+}
+
 bool startsWith(kj::ArrayPtr<const char> bytes, kj::StringPtr prefix) {
   return bytes.size() >= prefix.size() && bytes.slice(0, prefix.size()) == prefix;
 }
@@ -66,8 +76,12 @@ constexpr auto contentDisposition =
     p::sequence(p::discardWhitespace, httpIdentifier,
                 p::discardWhitespace, p::many(contentDispositionParam));
 
+// If `ownedBody` is provided, it must be the buffer which `body` points into. Files of at least
+// Blob::MIN_SHARED_SEGMENT_SIZE bytes are then created as views of it rather than copies, and it is
+// kept alive for as long as any of them is. Smaller files are always copied.
 void parseFormData(kj::Vector<FormData::Entry>& data, kj::StringPtr boundary,
-                   kj::ArrayPtr<const char> body, bool convertFilesToStrings) {
+                   kj::ArrayPtr<const char> body, bool convertFilesToStrings,
+                   kj::Maybe<kj::Array<kj::byte>> ownedBody) {
   // multipart/form-data messages are delimited by <CRLF>--<boundary>. We want to be able to handle
   // omitted carriage returns, though, so our delimiter only matches against a preceding line feed.
   const auto delimiter = kj::str("\n--", boundary);
@@ -96,22 +110,19 @@ void parseFormData(kj::Vector<FormData::Entry>& data, kj::StringPtr boundary,
     return false;
   };
 
-  constexpr auto staticRegexFlags = std::regex_constants::ECMAScript
-                                  | std::regex_constants::optimize;
-
-  static const auto headerTerminationRegex = std::regex("\r?\n\r?\n", staticRegexFlags);
-
-  std::cmatch match;
+  // Created from `ownedBody` when the first file large enough to share it is found, to be shared
+  // by all such files.
+  kj::Maybe<jsg::Ref<Blob>> backing;
 
   auto& formDataHeaderTable = getFormDataHeaderTable();
 
   while (!done(body)) {
-    JSG_REQUIRE(std::regex_search(body.begin(), body.end(), match, headerTerminationRegex),
-                 TypeError, "No multipart message header termination found.");
+    size_t headerEnd = JSG_REQUIRE_NONNULL(findHeaderEnd(body),
+        TypeError, "No multipart message header termination found.");
 
     // TODO(cleanup): Use kj-http to parse multipart headers. Right now that API isn't public, so
-    //   I'm just using a regex. For reference, multipart/form-data supports the following three
-    //   headers (https://tools.ietf.org/html/rfc7578#section-4.8):
+    //   I'm just splitting them off by hand. For reference, multipart/form-data supports the
+    //   following three headers (https://tools.ietf.org/html/rfc7578#section-4.8):
     //
     //   Content-Disposition        (required)
     //   Content-Type               (optional, recommended for files)
@@ -119,8 +130,8 @@ void parseFormData(kj::Vector<FormData::Entry>& data, kj::StringPtr boundary,
     //
     // TODO(soon): Read the Content-Type to support files.
 
-    auto headersText = kj::str(body.slice(0, match[0].second - body.begin()));
-    body = body.slice(match[0].second - body.begin(), body.size());
+    auto headersText = kj::str(body.slice(0, headerEnd));
+    body = body.slice(headerEnd, body.size());
 
     kj::HttpHeaders headers(*formDataHeaderTable.table);
     JSG_REQUIRE(headers.tryParse(headersText), TypeError, "FormData part had invalid headers.");
@@ -165,11 +176,30 @@ void parseFormData(kj::Vector<FormData::Entry>& data, kj::StringPtr boundary,
     if (filename == kj::none || convertFilesToStrings) {
       data.add(FormData::Entry { kj::mv(name), kj::str(message) });
     } else {
-      data.add(FormData::Entry {
-        kj::mv(name),
-        jsg::alloc<File>(kj::heapArray(message.asBytes()), KJ_ASSERT_NONNULL(kj::mv(filename)),
-                          kj::str(type.orDefault(nullptr)), dateNow())
-      });
+      // Small files are copied, so that they don't keep the whole body alive.
+      kj::Maybe<jsg::Ref<Blob>> shared;
+      if (message.size() >= Blob::MIN_SHARED_SEGMENT_SIZE) {
+        KJ_IF_SOME(bytes, ownedBody) {
+          backing = jsg::alloc<Blob>(kj::mv(bytes), kj::String());
+          ownedBody = kj::none;
+        }
+        shared = backing.map([](jsg::Ref<Blob>& b) { return b.addRef(); });
+      }
+      auto filenameStr = KJ_ASSERT_NONNULL(kj::mv(filename));
+      auto typeStr = kj::str(type.orDefault(nullptr));
+      KJ_IF_SOME(b, shared) {
+        data.add(FormData::Entry {
+          kj::mv(name),
+          jsg::alloc<File>(kj::mv(b), message.asBytes(), kj::mv(filenameStr), kj::mv(typeStr),
+                           dateNow())
+        });
+      } else {
+        data.add(FormData::Entry {
+          kj::mv(name),
+          jsg::alloc<File>(kj::heapArray(message.asBytes()), kj::mv(filenameStr),
+                           kj::mv(typeStr), dateNow())
+        });
+      }
     }
   }
 }
@@ -184,8 +214,9 @@ blobToFile(kj::StringPtr name, kj::OneOf<jsg::Ref<File>, jsg::Ref<Blob>, kj::Str
     } else {
       fn = kj::str(name);
     }
-    return jsg::alloc<File>(kj::heapArray(blob->getData()), kj::mv(fn),
-                             kj::str(blob->getType()), dateNow());
+    // The File only needs a different name, so it can share the Blob's data.
+    return jsg::alloc<File>(kj::Array<byte>(), blob->shareSegments(0, blob->getSize()),
+                            kj::mv(fn), kj::str(blob->getType()), dateNow());
   };
 
   KJ_SWITCH_ONEOF(value) {
@@ -209,7 +240,8 @@ blobToFile(kj::StringPtr name, kj::OneOf<jsg::Ref<File>, jsg::Ref<Blob>, kj::Str
 
 // Add the chars from `value` into `builder` escaping the characters '"' and '\n' using %
 // encoding, exactly as Chrome does for Content-Disposition values.
-void addEscapingQuotes(kj::Vector<char>& builder, kj::StringPtr value) {
+template <typename Builder>
+void addEscapingQuotes(Builder& builder, kj::StringPtr value) {
   // Chrome throws "Failed to fetch" if the name ends with a backslash. Otherwise it worries that
   // the backslash may be interpreted as escaping the final quote.
   JSG_REQUIRE(!value.endsWith("\\"), TypeError, "Name or filename can't end with backslash");
@@ -237,20 +269,28 @@ void addEscapingQuotes(kj::Vector<char>& builder, kj::StringPtr value) {
   }
 }
 
-}  // namespace
+// Builders for serializeFormData(), which runs once with each: first to measure the output, then
+// to fill in a buffer of exactly that size.
+struct LengthCounter {
+  size_t size = 0;
 
-// =======================================================================================
-// FormData implementation
+  void add(char c) { ++size; }
+  void addAll(kj::ArrayPtr<const char> text) { size += text.size(); }
+};
 
-kj::Array<kj::byte> FormData::serialize(kj::ArrayPtr<const char> boundary) {
-  // Boundary string requirement per RFC7578
-  JSG_REQUIRE(boundary.size() > 0 && boundary.size() <= 70, TypeError,
-      "Length of multipart/form-data boundary string must be in the range [1, 70].");
+struct ArrayFiller {
+  char* pos;
 
-  // TODO(perf): We should be able to trivially calculate the length of the serialized form data
-  //   beforehand. I tried, but apparently my math REALLY sucks and I hate memory overruns, so ...
-  auto builder = kj::Vector<char>{};
+  void add(char c) { *pos++ = c; }
+  void addAll(kj::ArrayPtr<const char> text) {
+    memcpy(pos, text.begin(), text.size());
+    pos += text.size();
+  }
+};
 
+template <typename Builder>
+void serializeFormData(Builder& builder, kj::ArrayPtr<FormData::Entry> data,
+                       kj::ArrayPtr<const char> boundary) {
   for (auto& kv: data) {
     builder.addAll("--"_kj);
     builder.addAll(boundary);
@@ -268,12 +308,14 @@ kj::Array<kj::byte> FormData::serialize(kj::ArrayPtr<const char> boundary) {
         builder.addAll("\"\r\nContent-Type: "_kj);
         auto type = file->getType();
         if (type == nullptr) {
-          builder.addAll(MimeType::OCTET_STREAM.toString());
+          builder.addAll(MimeType::OCTET_STREAM_STRING);
         } else {
           builder.addAll(type);
         }
         builder.addAll("\r\n\r\n"_kj);
-        builder.addAll(file->getData().asChars());
+        for (auto& segment: file->getSegments()) {
+          builder.addAll(segment.data.asChars());
+        }
       }
     }
     builder.addAll("\r\n"_kj);
@@ -281,24 +323,11 @@ kj::Array<kj::byte> FormData::serialize(kj::ArrayPtr<const char> boundary) {
   builder.addAll("--"_kj);
   builder.addAll(boundary);
   builder.addAll("--"_kj);
-
-  return builder.releaseAsArray().releaseAsBytes();
 }
 
-FormData::EntryType FormData::clone(FormData::EntryType& value) {
-  KJ_SWITCH_ONEOF(value) {
-    KJ_CASE_ONEOF(file, jsg::Ref<File>) {
-      return file.addRef();
-    }
-    KJ_CASE_ONEOF(string, kj::String) {
-      return kj::str(string);
-    }
-  }
-  KJ_UNREACHABLE;
-}
-
-void FormData::parse(kj::ArrayPtr<const char> rawText, kj::StringPtr contentType,
-                     bool convertFilesToStrings) {
+void parseBody(kj::Vector<FormData::Entry>& data, kj::ArrayPtr<const char> rawText,
+               kj::StringPtr contentType, bool convertFilesToStrings,
+               kj::Maybe<kj::Array<kj::byte>> ownedBody) {
   KJ_IF_SOME(parsed, MimeType::tryParse(contentType)) {
     auto& params = parsed.params();
     if (MimeType::FORM_DATA == parsed) {
@@ -306,7 +335,7 @@ void FormData::parse(kj::ArrayPtr<const char> rawText, kj::StringPtr contentType
           "No boundary string in Content-Type header. The multipart/form-data MIME "
           "type requires a boundary parameter, e.g. 'Content-Type: multipart/form-data; "
           "boundary=\"abcd\"'. See RFC 7578, section 4.");
-      parseFormData(data, boundary, rawText, convertFilesToStrings);
+      parseFormData(data, boundary, rawText, convertFilesToStrings, kj::mv(ownedBody));
       return;
     } else if (MimeType::FORM_URLENCODED == parsed) {
       // Let's read the charset so we can barf if the body isn't UTF-8.
@@ -323,7 +352,7 @@ void FormData::parse(kj::ArrayPtr<const char> rawText, kj::StringPtr contentType
       parseQueryString(query, kj::mv(rawText));
       data.reserve(query.size());
       for (auto& param: query) {
-        data.add(Entry { kj::mv(param.name), kj::mv(param.value) });
+        data.add(FormData::Entry { kj::mv(param.name), kj::mv(param.value) });
       }
       return;
     }
@@ -335,6 +364,51 @@ void FormData::parse(kj::ArrayPtr<const char> rawText, kj::StringPtr contentType
       MimeType::FORM_URLENCODED.toString()));
 }
 
+}  // namespace
+
+// =======================================================================================
+// FormData implementation
+
+kj::Array<kj::byte> FormData::serialize(kj::ArrayPtr<const char> boundary) {
+  // Boundary string requirement per RFC7578
+  JSG_REQUIRE(boundary.size() > 0 && boundary.size() <= 70, TypeError,
+      "Length of multipart/form-data boundary string must be in the range [1, 70].");
+
+  LengthCounter counter;
+  serializeFormData(counter, data.asPtr(), boundary);
+
+  auto result = kj::heapArray<kj::byte>(counter.size);
+  ArrayFiller filler { result.asChars().begin() };
+  serializeFormData(filler, data.asPtr(), boundary);
+  KJ_ASSERT(filler.pos == result.asChars().end());
+
+  return result;
+}
+
+FormData::EntryType FormData::clone(FormData::EntryType& value) {
+  KJ_SWITCH_ONEOF(value) {
+    KJ_CASE_ONEOF(file, jsg::Ref<File>) {
+      return file.addRef();
+    }
+    KJ_CASE_ONEOF(string, kj::String) {
+      return kj::str(string);
+    }
+  }
+  KJ_UNREACHABLE;
+}
+
+void FormData::parse(kj::ArrayPtr<const char> rawText, kj::StringPtr contentType,
+                     bool convertFilesToStrings) {
+  parseBody(data, rawText, contentType, convertFilesToStrings, kj::none);
+}
+
+void FormData::parse(kj::Array<kj::byte> rawBytes, kj::StringPtr contentType,
+                     bool convertFilesToStrings) {
+  // Moving the array into parseBody() doesn't move its contents, so `rawText` stays valid.
+  auto rawText = rawBytes.asChars();
+  parseBody(data, rawText, contentType, convertFilesToStrings, kj::mv(rawBytes));
+}
+
 jsg::Ref<FormData> FormData::constructor() {
   return jsg::alloc<FormData>();
 }
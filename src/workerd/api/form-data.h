@@ -52,6 +52,13 @@ public:
   void parse(kj::ArrayPtr<const char> rawText, kj::StringPtr contentType,
              bool convertFilesToStrings);
 
+  // Like above, but takes ownership of the body so that files can be views of it rather than
+  // copies. Files smaller than Blob::MIN_SHARED_SEGMENT_SIZE are still copied. If any file is
+  // larger, the whole body stays in memory for as long as any File sharing it is alive, even if
+  // the other entries are discarded.
+  void parse(kj::Array<kj::byte> rawBytes, kj::StringPtr contentType,
+             bool convertFilesToStrings);
+
   struct Entry {
     kj::String name;
     kj::OneOf<jsg::Ref<File>, kj::String> value;
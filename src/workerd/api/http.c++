@@ -423,9 +423,9 @@ namespace {
 
 class BodyBufferInputStream final: public ReadableStreamSource {
 public:
-  BodyBufferInputStream(Body::Buffer buffer)
-      : unread(buffer.view),
-        ownBytes(kj::mv(buffer.ownBytes)) {}
+  BodyBufferInputStream(kj::ArrayPtr<const byte> view, kj::Own<Body::RefcountedBytes> ownBytes)
+      : unread(view),
+        ownBytes(kj::mv(ownBytes)) {}
 
   kj::Promise<size_t> tryRead(void* buffer, size_t minBytes, size_t maxBytes) override {
     size_t amount = kj::min(maxBytes, unread.size());
@@ -456,9 +456,21 @@ public:
 
 private:
   kj::ArrayPtr<const byte> unread;
-  kj::OneOf<kj::Own<Body::RefcountedBytes>, jsg::Ref<Blob>> ownBytes;
+  kj::Own<Body::RefcountedBytes> ownBytes;
 };
 
+kj::Own<ReadableStreamSource> newBodyBufferInputStream(Body::Buffer buffer) {
+  KJ_SWITCH_ONEOF(buffer.ownBytes) {
+    KJ_CASE_ONEOF(refcounted, kj::Own<Body::RefcountedBytes>) {
+      return kj::heap<BodyBufferInputStream>(buffer.view, kj::mv(refcounted));
+    }
+    KJ_CASE_ONEOF(blob, jsg::Ref<Blob>) {
+      return blob->newInputStream();
+    }
+  }
+  KJ_UNREACHABLE;
+}
+
 }  // namespace
 
 // Make an array of characters containing random hexadecimal digits.
@@ -487,6 +499,13 @@ Body::Buffer Body::Buffer::clone(jsg::Lock& js) {
   return result;
 }
 
+size_t Body::Buffer::size() const {
+  KJ_IF_SOME(blob, ownBytes.tryGet<jsg::Ref<Blob>>()) {
+    return blob->getSize();
+  }
+  return view.size();
+}
+
 Body::ExtractedBody::ExtractedBody(jsg::Ref<ReadableStream> stream,
                                    kj::Maybe<Buffer> buffer,
                                    kj::Maybe<kj::String> contentType)
@@ -543,7 +562,7 @@ Body::ExtractedBody Body::extractBody(jsg::Lock& js, Initializer init) {
     }
   }
 
-  auto bodyStream = kj::heap<BodyBufferInputStream>(buffer.clone(js));
+  auto bodyStream = newBodyBufferInputStream(buffer.clone(js));
 
   return {
     jsg::alloc<ReadableStream>(IoContext::current(), kj::mv(bodyStream)),
@@ -598,7 +617,7 @@ void Body::rewindBody(jsg::Lock& js) {
 
   KJ_IF_SOME(i, impl) {
     auto bufferCopy = KJ_ASSERT_NONNULL(i.buffer).clone(js);
-    auto bodyStream = kj::heap<BodyBufferInputStream>(kj::mv(bufferCopy));
+    auto bodyStream = newBodyBufferInputStream(kj::mv(bufferCopy));
     i.stream = jsg::alloc<ReadableStream>(IoContext::current(), kj::mv(bodyStream));
   }
 }
@@ -673,11 +692,11 @@ jsg::Promise<jsg::Ref<FormData>> Body::formData(jsg::Lock& js) {
     KJ_IF_SOME(i, impl) {
       KJ_ASSERT(!i.stream->isDisturbed());
       auto& context = IoContext::current();
-      return i.stream->getController().readAllText(js,
+      return i.stream->getController().readAllBytes(js,
           context.getLimitEnforcer().getBufferingLimit()).then(js,
           [contentType = kj::mv(contentType), formData = kj::mv(formData)]
-          (auto& js, kj::String rawText) mutable {
-        formData->parse(kj::mv(rawText), contentType,
+          (auto& js, kj::Array<byte> rawBytes) mutable {
+        formData->parse(kj::mv(rawBytes), contentType,
             !FeatureFlags::get(js).getFormDataParserSupportsFiles());
         return kj::mv(formData);
       });
@@ -1129,7 +1148,7 @@ jsg::Ref<Response> Response::constructor(
           "Response with null body status (101, 204, 205, or 304) cannot have a body.");
 
       // Fail if the body is backed by a non-zero-length buffer.
-      JSG_REQUIRE(buffer.view.size() == 0, TypeError,
+      JSG_REQUIRE(buffer.size() == 0, TypeError,
           "Response with null body status (101, 204, 205, or 304) cannot have a body.");
 
       auto& context = IoContext::current();
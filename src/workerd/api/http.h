@@ -280,6 +280,9 @@ public:
     // (e.g. for redirects, authentication). In these cases, we need to keep an ArrayPtr view onto
     // the Array source itself, because the source may be a string, and thus have a trailing nul
     // byte.
+    //
+    // Blobs are left as they are, and streamed segment by segment, rather than flattened into a
+    // single view, so `view` is empty for them.
     kj::ArrayPtr<const kj::byte> view;
 
     Buffer() = default;
@@ -293,11 +296,12 @@ public:
             return bytesIncludingNull.slice(0, bytesIncludingNull.size() - 1);
           }()) {}
     Buffer(jsg::Ref<Blob> blob)
-        : ownBytes(kj::mv(blob)),
-          view(ownBytes.get<jsg::Ref<Blob>>()->getData()) {}
+        : ownBytes(kj::mv(blob)) {}
 
     Buffer clone(jsg::Lock& js);
 
+    size_t size() const;
+
     JSG_MEMORY_INFO(Buffer) {
       KJ_SWITCH_ONEOF(ownBytes) {
         KJ_CASE_ONEOF(bytes, kj::Own<RefcountedBytes>) {
@@ -87,7 +87,7 @@ void SharedMemoryCache::resize(ThreadUnsafeData& data) const {
 
   // First, remove any values that might be too large.
   while (data.cache.size() != 0) {
-    MemoryCacheEntry& largestEntry = *data.cache.ordered<2>().begin();
+    MemoryCacheEntry& largestEntry = *data.cache.ordered<1>().begin();
     if (largestEntry.size() <= data.effectiveLimits.maxValueSize) {
       break;
     }
@@ -102,31 +102,43 @@ void SharedMemoryCache::resize(ThreadUnsafeData& data) const {
   }
 }
 
-kj::Maybe<kj::Own<CacheValue>> SharedMemoryCache::getWhileLocked(
-    ThreadUnsafeData& data, const kj::String& key) const {
+kj::Maybe<kj::Own<const CacheValue>> SharedMemoryCache::getWhileLocked(
+    const ThreadUnsafeData& data, const kj::String& key) const {
   KJ_IF_SOME(existingCacheEntry, data.cache.find(key)) {
     if (hasExpired(existingCacheEntry.expiration)) {
       // The cache entry has an associated expiration time and that time has
-      // passed (according to the calling IoContext's timer).
-      data.totalValueSize -= existingCacheEntry.size();
-      data.cache.erase(existingCacheEntry);
+      // passed (according to the calling IoContext's timer). It will be
+      // evicted before any unexpired entry is.
       return kj::none;
     }
 
-    // Obtain a reference to the cache value before we kj::mv the cache entry.
-    auto cacheValue = kj::atomicAddRef(*existingCacheEntry.value);
-
-    // Update the liveliness.
-    MemoryCacheEntry entry = data.cache.release(existingCacheEntry);
-    entry.liveliness = data.stepLiveliness();
-    data.cache.insert(kj::mv(entry));
+    // Other threads may be setting the same bit concurrently, and the CLOCK
+    // hand only moves under an exclusive lock, so relaxed ordering suffices.
+    // Checking first avoids contending on the cache line for hot entries.
+    if (!existingCacheEntry.referenced.load(std::memory_order_relaxed)) {
+      existingCacheEntry.referenced.store(true, std::memory_order_relaxed);
+    }
 
-    return kj::mv(cacheValue);
+    return kj::atomicAddRef(*existingCacheEntry.value);
   } else {
     return kj::none;
   }
 }
 
+kj::Maybe<kj::Own<const CacheValue>> SharedMemoryCache::getStaleWhileLocked(
+    const ThreadUnsafeData& data, const kj::String& key, double staleWhileRevalidate) const {
+  KJ_IF_SOME(entry, data.cache.find(key)) {
+    KJ_IF_SOME(expiration, entry.expiration) {
+      double now = api::dateNow();
+      if (expiration < now && now <= expiration + staleWhileRevalidate) {
+        entry.referenced.store(true, std::memory_order_relaxed);
+        return kj::atomicAddRef(*entry.value);
+      }
+    }
+  }
+  return kj::none;
+}
+
 void SharedMemoryCache::putWhileLocked(ThreadUnsafeData& data,
     const kj::String& key,
     kj::Own<CacheValue>&& value,
@@ -150,6 +162,7 @@ void SharedMemoryCache::putWhileLocked(ThreadUnsafeData& data,
   KJ_IF_SOME(entry, existingEntry) {
     size_t oldValueSize = entry.size();
     KJ_ASSERT(data.totalValueSize >= oldValueSize);
+    // Re-insert the entry, since its position in the value size index changes.
     MemoryCacheEntry updatedEntry = data.cache.release(entry);
     data.totalValueSize -= oldValueSize;
     while (data.totalValueSize + valueSize > data.effectiveLimits.maxTotalValueSize) {
@@ -157,7 +170,6 @@ void SharedMemoryCache::putWhileLocked(ThreadUnsafeData& data,
       // risk of evicting it.
       evictNextWhileLocked(data);
     }
-    updatedEntry.liveliness = data.stepLiveliness();
     updatedEntry.value = kj::mv(value);
     updatedEntry.expiration = expiration;
     data.cache.insert(kj::mv(updatedEntry));
@@ -171,13 +183,9 @@ void SharedMemoryCache::putWhileLocked(ThreadUnsafeData& data,
     while (data.totalValueSize + valueSize > data.effectiveLimits.maxTotalValueSize) {
       evictNextWhileLocked(data);
     }
-    MemoryCacheEntry newEntry = {
-      kj::str(key),
-      data.stepLiveliness(),
-      kj::mv(value),
-      expiration,
-    };
-    data.cache.insert(kj::mv(newEntry));
+    // New entries start out unreferenced, so that entries which are never read
+    // again are the first to go.
+    data.cache.insert(MemoryCacheEntry(kj::str(key), kj::mv(value), expiration));
     data.totalValueSize += valueSize;
   }
 }
@@ -189,7 +197,7 @@ void SharedMemoryCache::evictNextWhileLocked(
   KJ_REQUIRE(data.cache.size() > 0);
 
   // If there is an entry that has expired already, evict that one.
-  MemoryCacheEntry& maybeExpired = *data.cache.ordered<3>().begin();
+  MemoryCacheEntry& maybeExpired = *data.cache.ordered<2>().begin();
   KJ_ASSERT(data.totalValueSize >= maybeExpired.size());
   if (hasExpired(maybeExpired.expiration, allowOutsideIoContext)) {
     data.totalValueSize -= maybeExpired.size();
@@ -197,11 +205,26 @@ void SharedMemoryCache::evictNextWhileLocked(
     return;
   }
 
-  // Otherwise, if no entry has expired, evict the least recently used entry.
-  MemoryCacheEntry& leastRecentlyUsed = *data.cache.ordered<1>().begin();
-  KJ_ASSERT(data.totalValueSize >= leastRecentlyUsed.size());
-  data.totalValueSize -= leastRecentlyUsed.size();
-  data.cache.erase(leastRecentlyUsed);
+  // Otherwise, if no entry has expired, advance the CLOCK hand to the next
+  // unreferenced entry and evict it. This terminates within two sweeps, since
+  // the first sweep clears every referenced bit.
+  for (;;) {
+    if (data.clockHand >= data.cache.size()) {
+      data.clockHand = 0;
+    }
+    MemoryCacheEntry& entry = data.cache.begin()[data.clockHand];
+    if (entry.referenced.exchange(false, std::memory_order_relaxed)) {
+      ++data.clockHand;
+      continue;
+    }
+
+    // Erasing the entry moves the last row into its place, which is where the
+    // hand will resume from next time.
+    KJ_ASSERT(data.totalValueSize >= entry.size());
+    data.totalValueSize -= entry.size();
+    data.cache.erase(entry);
+    return;
+  }
 }
 
 void SharedMemoryCache::removeIfExistsWhileLocked(
@@ -240,18 +263,42 @@ SharedMemoryCache::Use::~Use() noexcept(false) {
   }
 }
 
-kj::Maybe<kj::Own<CacheValue>> SharedMemoryCache::Use::getWithoutFallback(
+kj::Maybe<kj::Own<const CacheValue>> SharedMemoryCache::Use::getWithoutFallback(
     const kj::String& key) const {
-  auto data = cache->data.lockExclusive();
+  auto data = cache->data.lockShared();
   return cache->getWhileLocked(*data, key);
 }
 
-kj::OneOf<kj::Own<CacheValue>, kj::Promise<SharedMemoryCache::Use::GetWithFallbackOutcome>>
-SharedMemoryCache::Use::getWithFallback(const kj::String& key) const {
+kj::OneOf<kj::Own<const CacheValue>, SharedMemoryCache::Use::StaleValue,
+          kj::Promise<SharedMemoryCache::Use::GetWithFallbackOutcome>>
+SharedMemoryCache::Use::getWithFallback(
+    const kj::String& key, kj::Maybe<double> staleWhileRevalidate) const {
+  // Cache hits only need a shared lock.
+  KJ_IF_SOME(existingValue, cache->getWhileLocked(*cache->data.lockShared(), key)) {
+    return kj::mv(existingValue);
+  }
+
+  // On a miss, we need an exclusive lock to register a fallback. The value may
+  // have been stored since we checked, so check again.
   auto data = cache->data.lockExclusive();
   KJ_IF_SOME(existingValue, cache->getWhileLocked(*data, key)) {
     return kj::mv(existingValue);
-  } else KJ_IF_SOME(existingInProgress, data->inProgress.find(key)) {
+  }
+
+  KJ_IF_SOME(swr, staleWhileRevalidate) {
+    KJ_IF_SOME(staleValue, cache->getStaleWhileLocked(*data, key, swr)) {
+      if (data->inProgress.find(key) != kj::none) {
+        // Somebody is already refreshing the value (or waiting for it).
+        return StaleValue { kj::mv(staleValue), kj::none };
+      }
+      // Register the refresh like any other fallback, so that readers past the
+      // stale-while-revalidate period wait for it rather than starting another.
+      auto& newEntry = data->inProgress.insert(kj::heap<InProgress>(kj::str(key)));
+      return StaleValue { kj::mv(staleValue), prepareFallback(*newEntry) };
+    }
+  }
+
+  KJ_IF_SOME(existingInProgress, data->inProgress.find(key)) {
     // We return a Promise, but we keep the fulfiller. We might fulfill it
     // from a different thread, so we need a cross-thread fulfiller here.
     auto pair = kj::newPromiseAndCrossThreadFulfiller<GetWithFallbackOutcome>();
@@ -297,7 +344,7 @@ SharedMemoryCache::Use::FallbackDoneCallback SharedMemoryCache::Use::prepareFall
       cache->putWhileLocked(
           *data, kj::str(inProgress.key), kj::atomicAddRef(*result.value), result.expiration);
       for (auto& waiter: inProgress.waiting) {
-        waiter.fulfiller->fulfill(kj::atomicAddRef(*result.value));
+        waiter.fulfiller->fulfill(kj::Own<const CacheValue>(kj::atomicAddRef(*result.value)));
       }
       data->inProgress.eraseMatch(inProgress.key);
     } else {
@@ -365,55 +412,96 @@ static kj::Own<CacheValue> hackySerialize(jsg::Lock& js, jsg::JsRef<jsg::JsValue
   });
 }
 
+// Invokes the fallback function and passes its result (or failure) to `callback`.
+static jsg::Promise<jsg::JsRef<jsg::JsValue>> runFallback(jsg::Lock& js,
+    MemoryCache::FallbackFunction& fallback, kj::String key,
+    SharedMemoryCache::Use::FallbackDoneCallback callback, kj::Maybe<double> expirationJitter) {
+  auto& context = IoContext::current();
+  auto heapCallback = kj::heap(kj::mv(callback));
+
+  return js.evalNow([&]() { return fallback(js, kj::mv(key)); })
+      .then(js,
+          [callback = context.addObject(*heapCallback), expirationJitter](jsg::Lock& js,
+              CacheValueProduceResult result) mutable -> jsg::JsRef<jsg::JsValue> {
+    // NOTE: `callback` is IoPtr, not IoOwn. The catch block gets the IoOwn, which
+    //   ensures the object still exists at this point.
+    auto serialized = hackySerialize(js, result.value);
+    kj::Maybe<double> expiration = result.expiration;
+    KJ_IF_SOME(e, expiration) {
+      JSG_REQUIRE(!kj::isNaN(e), TypeError, "Expiration time must not be NaN.");
+      KJ_IF_SOME(jitter, expirationJitter) {
+        uint32_t random = 0;
+        IoContext::current().getEntropySource().generate(
+            kj::arrayPtr(reinterpret_cast<kj::byte*>(&random), sizeof(random)));
+        expiration = e - jitter * (random / 4294967296.0);
+      }
+    }
+    (*callback)(SharedMemoryCache::Use::FallbackResult{
+      kj::mv(serialized), expiration});
+    return kj::mv(result.value);
+  })
+      .catch_(js,
+          [callback = context.addObject(kj::mv(heapCallback))](jsg::Lock& js,
+              jsg::Value&& exception) mutable -> jsg::JsRef<jsg::JsValue> {
+    (*callback)(kj::none);
+    js.throwException(kj::mv(exception));
+  });
+}
+
 jsg::Promise<jsg::JsRef<jsg::JsValue>> MemoryCache::read(jsg::Lock& js,
     jsg::NonCoercible<kj::String> key,
-    jsg::Optional<FallbackFunction> optionalFallback) {
+    jsg::Optional<FallbackFunction> optionalFallback,
+    jsg::Optional<ReadOptions> options) {
   if (key.value.size() > MAX_KEY_SIZE) {
     return js.rejectedPromise<jsg::JsRef<jsg::JsValue>>(js.rangeError("Key too large."_kj));
   }
 
+  kj::Maybe<double> staleWhileRevalidate;
+  kj::Maybe<double> expirationJitter;
+  KJ_IF_SOME(o, options) {
+    KJ_IF_SOME(swr, o.staleWhileRevalidate) {
+      JSG_REQUIRE(swr >= 0, RangeError, "staleWhileRevalidate must not be negative.");
+      staleWhileRevalidate = swr;
+    }
+    KJ_IF_SOME(jitter, o.expirationJitter) {
+      JSG_REQUIRE(jitter >= 0, RangeError, "expirationJitter must not be negative.");
+      expirationJitter = jitter;
+    }
+  }
+
   KJ_IF_SOME(fallback, optionalFallback) {
-    KJ_SWITCH_ONEOF(cacheUse.getWithFallback(key.value)) {
-      KJ_CASE_ONEOF(result, kj::Own<CacheValue>) {
+    KJ_SWITCH_ONEOF(cacheUse.getWithFallback(key.value, staleWhileRevalidate)) {
+      KJ_CASE_ONEOF(result, kj::Own<const CacheValue>) {
         // Optimization: Don't even release the isolate lock if the value is aleady in cache.
         jsg::Deserializer deserializer(js, result->bytes.asPtr());
         return js.resolvedPromise(jsg::JsRef(js, deserializer.readValue(js)));
       }
+      KJ_CASE_ONEOF(stale, SharedMemoryCache::Use::StaleValue) {
+        KJ_IF_SOME(refresh, stale.refresh) {
+          // Refresh the value in the background. The request is kept alive until the refresh
+          // completes, but its failure is not reported to the caller, who already has a value.
+          auto& context = IoContext::current();
+          auto promise = runFallback(js, fallback, kj::str(key.value), kj::mv(refresh),
+                                     expirationJitter)
+              .then(js, [](jsg::Lock&, jsg::JsRef<jsg::JsValue>) {},
+                        [](jsg::Lock&, jsg::Value) {});
+          context.addWaitUntil(context.awaitJs(js, kj::mv(promise)));
+        }
+        jsg::Deserializer deserializer(js, stale.value->bytes.asPtr());
+        return js.resolvedPromise(jsg::JsRef(js, deserializer.readValue(js)));
+      }
       KJ_CASE_ONEOF(promise, kj::Promise<SharedMemoryCache::Use::GetWithFallbackOutcome>) {
         return IoContext::current().awaitIo(js, kj::mv(promise),
-            [fallback = kj::mv(fallback), key = kj::str(key.value)](
+            [fallback = kj::mv(fallback), key = kj::str(key.value), expirationJitter](
                 jsg::Lock& js, SharedMemoryCache::Use::GetWithFallbackOutcome cacheResult) mutable
             -> jsg::Promise<jsg::JsRef<jsg::JsValue>> {
           KJ_SWITCH_ONEOF(cacheResult) {
-            KJ_CASE_ONEOF(serialized, kj::Own<CacheValue>) {
+            KJ_CASE_ONEOF(serialized, kj::Own<const CacheValue>) {
               jsg::Deserializer deserializer(js, serialized->bytes.asPtr());
               return js.resolvedPromise(jsg::JsRef(js, deserializer.readValue(js)));
             }
             KJ_CASE_ONEOF(callback, SharedMemoryCache::Use::FallbackDoneCallback) {
-              auto& context = IoContext::current();
-              auto heapCallback = kj::heap(kj::mv(callback));
-
-              return js.evalNow([&]() { return fallback(js, kj::mv(key)); })
-                  .then(js,
-                      [callback = context.addObject(*heapCallback)](jsg::Lock& js,
-                          CacheValueProduceResult result) mutable -> jsg::JsRef<jsg::JsValue> {
-                // NOTE: `callback` is IoPtr, not IoOwn. The catch block gets the IoOwn, which
-                //   ensures the object still exists at this point.
-                auto serialized = hackySerialize(js, result.value);
-                KJ_IF_SOME(expiration, result.expiration) {
-                  JSG_REQUIRE(
-                      !kj::isNaN(expiration), TypeError, "Expiration time must not be NaN.");
-                }
-                (*callback)(SharedMemoryCache::Use::FallbackResult{
-                  kj::mv(serialized), result.expiration});
-                return kj::mv(result.value);
-              })
-                  .catch_(js,
-                      [callback = context.addObject(kj::mv(heapCallback))](jsg::Lock& js,
-                          jsg::Value&& exception) mutable -> jsg::JsRef<jsg::JsValue> {
-                (*callback)(kj::none);
-                js.throwException(kj::mv(exception));
-              });
+              return runFallback(js, fallback, kj::mv(key), kj::mv(callback), expirationJitter);
             }
           }
           KJ_UNREACHABLE;
@@ -7,6 +7,7 @@
 #include <kj/map.h>
 #include <kj/mutex.h>
 #include <kj/table.h>
+#include <atomic>
 #include <set>
 
 namespace workerd::api {
@@ -38,26 +39,30 @@ struct CacheValue: kj::AtomicRefcounted {
 };
 
 struct MemoryCacheEntry {
+  MemoryCacheEntry(kj::String key, kj::Own<CacheValue> value, kj::Maybe<double> expiration)
+      : key(kj::mv(key)), value(kj::mv(value)), expiration(expiration) {}
+
+  // Entries are only moved while the cache is locked exclusively, so there
+  // can't be a concurrent update to `referenced`.
+  MemoryCacheEntry(MemoryCacheEntry&& other)
+      : key(kj::mv(other.key)), value(kj::mv(other.value)), expiration(other.expiration),
+        referenced(other.referenced.load(std::memory_order_relaxed)) {}
+  MemoryCacheEntry& operator=(MemoryCacheEntry&& other) {
+    key = kj::mv(other.key);
+    value = kj::mv(other.value);
+    expiration = other.expiration;
+    referenced.store(other.referenced.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    return *this;
+  }
+
   // The key that this entry is associated with.
   kj::String key;
 
-  // Whenever an entry is created, updated, or retrieved, its liveliness is
-  // set to the value of a monotonically increasing counter.
-  uint64_t liveliness;
-  // TODO(cleanup): The liveliness index accomplishes the same thing as
-  //   kj::InsertionOrderIndex.
-  //
-  // TODO(perf): Updating a cache entry's liveliness requires a re-insertion,
-  //   which means that cache reads require an exclusive lock. This may be
-  //   suboptimal for a read-heavy workload. WorkerSet avoids this by atomically
-  //   updating a `lastUsed` timestamp. The tradeoff is that LRU-eviction
-  //   becomes O(n) instead of O(1), since we can no longer use kj::Table's
-  //   index to find the LRU entry.
-
   // The stored JavaScript value, serialized by V8. It is atomicRefcounted to
   // allow threads to deserialize the value without having to lock the cache,
   // so the value can even be deserialized while the cache entry is being
-  // evicted.
+  // evicted. Values are never modified once stored, so readers are handed
+  // const references.
   kj::Own<CacheValue> value;
 
   inline size_t size() const { return value->bytes.size(); }
@@ -67,6 +72,12 @@ struct MemoryCacheEntry {
   // stored as a double so that it is compatible with api::dateNow() and
   // EdgeWorkerPlatform::CurrentClockTimeMillis().
   kj::Maybe<double> expiration;
+
+  // Set whenever the entry is retrieved, and cleared whenever the CLOCK hand
+  // passes over the entry without evicting it (see evictNextWhileLocked()).
+  // Retrieving an entry only requires a shared lock on the cache, which is why
+  // this is atomic.
+  mutable std::atomic<bool> referenced = false;
 };
 
 struct CacheValueProduceResult {
@@ -171,22 +182,34 @@ public:
     // Returns a cached value for the given key if one exists (and has not
     // expired). If no such value exists, nothing is returned, regardless of any
     // in-progress fallbacks trying to produce such a value.
-    kj::Maybe<kj::Own<CacheValue>> getWithoutFallback(const kj::String& key) const;
+    kj::Maybe<kj::Own<const CacheValue>> getWithoutFallback(const kj::String& key) const;
 
     struct FallbackResult {
       kj::Own<CacheValue> value;
       kj::Maybe<double> expiration;
     };
     typedef kj::Function<void(kj::Maybe<FallbackResult>)> FallbackDoneCallback;
-    using GetWithFallbackOutcome = kj::OneOf<kj::Own<CacheValue>, FallbackDoneCallback>;
+    using GetWithFallbackOutcome = kj::OneOf<kj::Own<const CacheValue>, FallbackDoneCallback>;
+
+    // A value that has expired, but by no more than the caller's
+    // stale-while-revalidate period. If `refresh` is set, the caller should
+    // invoke the fallback function in the background and pass its result to
+    // `refresh`. Otherwise, another refresh is already in progress.
+    struct StaleValue {
+      kj::Own<const CacheValue> value;
+      kj::Maybe<FallbackDoneCallback> refresh;
+    };
 
     // Returns either:
     // 1. The immediate value, if already in cache.
-    // 2. A Promise that will eventually resolve either to the cached value
+    // 2. A stale value, if `staleWhileRevalidate` (in milliseconds) is given
+    //    and the cached value expired less than that long ago.
+    // 3. A Promise that will eventually resolve either to the cached value
     //    or to a FallbackDoneCallback. In the latter case, the caller should
     //    invoke the fallback function.
-    kj::OneOf<kj::Own<CacheValue>, kj::Promise<GetWithFallbackOutcome>> getWithFallback(
-        const kj::String& key) const;
+    kj::OneOf<kj::Own<const CacheValue>, StaleValue, kj::Promise<GetWithFallbackOutcome>>
+        getWithFallback(const kj::String& key,
+                        kj::Maybe<double> staleWhileRevalidate = kj::none) const;
 
   private:
     // Creates a new FallbackDoneCallback associated with the given
@@ -257,14 +280,19 @@ private:
   // does not change the cache contents).
   void resize(ThreadUnsafeData& data) const;
 
-  // Returns a cached value while the cache's data is already locked by the
-  // calling thread. If such a cache entry exists, it will be marked as the
-  // most recently used entry.
-  kj::Maybe<kj::Own<CacheValue>> getWhileLocked(
-      ThreadUnsafeData& data, const kj::String& key) const;
+  // Returns a cached value while the cache's data is already locked (shared or
+  // exclusively) by the calling thread. If such a cache entry exists, it will
+  // be marked as referenced. Expired entries are not returned, but are left in
+  // place, since that would require an exclusive lock.
+  kj::Maybe<kj::Own<const CacheValue>> getWhileLocked(
+      const ThreadUnsafeData& data, const kj::String& key) const;
+
+  // Like getWhileLocked(), but only returns a value if it has expired less
+  // than `staleWhileRevalidate` milliseconds ago.
+  kj::Maybe<kj::Own<const CacheValue>> getStaleWhileLocked(
+      const ThreadUnsafeData& data, const kj::String& key, double staleWhileRevalidate) const;
 
-  // Stores a value in the cache, with an optional expiration timestamp. It is
-  // marked as the most recently used entry.
+  // Stores a value in the cache, with an optional expiration timestamp.
   void putWhileLocked(ThreadUnsafeData& data,
       const kj::String& key,
       kj::Own<CacheValue>&& value,
@@ -274,6 +302,11 @@ private:
   // the calling thread, and the cache must not be empty. Expiration timestamps
   // are only considered if called from within an I/O context or if
   // allowOutsideIoContext is true.
+  //
+  // If no entry has expired, this evicts the next unreferenced entry in CLOCK
+  // order: the hand sweeps over the entries, clearing the referenced bit of
+  // each referenced entry (giving it a second chance) until it finds one that
+  // has not been referenced since the hand last passed over it.
   void evictNextWhileLocked(ThreadUnsafeData& data, bool allowOutsideIoContext = false) const;
 
   // Removes the cache entry with the given key, if it exists.
@@ -297,24 +330,6 @@ private:
     }
   };
 
-  // Callbacks for a TreeIndex that allow sorting cache entries by their
-  // liveliness. This is used to evict the least recently used entry.
-  class LivelinessCallbacks {
-  public:
-    inline const uint64_t& keyForRow(const MemoryCacheEntry& entry) const {
-      return entry.liveliness;
-    }
-
-    template <typename KeyLike>
-    inline bool matches(const MemoryCacheEntry& e, KeyLike&& key) const {
-      return e.liveliness == key;
-    }
-
-    template <typename KeyLike>
-    inline bool isBefore(const MemoryCacheEntry& e, KeyLike&& key) const {
-      return e.liveliness < key;
-    }
-  };
 
   // Callbacks for a TreeIndex that allow sorting cache entries by the sizes
   // of the serialized values. The entries are sorted in reverse order, i.e.,
@@ -391,14 +406,10 @@ public:
     // are attached to this cache.
     Limits effectiveLimits = Limits::min();
 
-    // Returns the next liveliness and increments it so that the next call to
-    // this function will return a different value.
-    inline uint64_t stepLiveliness() { return nextLiveliness++; }
-
-    // We do not handle integer overflow, but a 64-bit counter should never wrap
-    // around, at least not in the foreseeable future. (Even at a billion cache
-    // operations per second, it would take almost 600 years.)
-    uint64_t nextLiveliness = 0;
+    // Position of the CLOCK hand, as an index into `cache`'s rows. Erasing a
+    // row moves the last row into its place, so the hand remains valid (modulo
+    // the table's size) when entries are erased.
+    size_t clockHand = 0;
 
     // The sum of the sizes of all values that are currently stored in the cache.
     // This is technically redundant information, but more efficient than
@@ -408,7 +419,6 @@ public:
     // The actual cache contents.
     kj::Table<MemoryCacheEntry,            // row type
         kj::HashIndex<KeyCallbacks>,         // index over keys
-        kj::TreeIndex<LivelinessCallbacks>,  // index over liveliness
         kj::TreeIndex<ValueSizeCallbacks>,   // index over value sizes
         kj::TreeIndex<ExpirationCallbacks>   // index over expiration
         >
@@ -425,9 +435,9 @@ public:
 
 private:
 
-  // To ensure thread-safety, all mutable data is guarded by a mutex. Each cache
-  // operation requires an exclusive lock. Even read-only operations need to
-  // update the liveliness of cache entries, which currently requires a lock.
+  // To ensure thread-safety, all mutable data is guarded by a mutex. Cache hits
+  // only require a shared lock, since they only need to set the entry's atomic
+  // `referenced` bit. All other operations require an exclusive lock.
   kj::MutexGuarded<ThreadUnsafeData> data;
 
   // The MemoryCacheProvider instance needs to be guaranteed to outlive the SharedMemoryCache
@@ -457,11 +467,26 @@ public:
 
   using FallbackFunction = jsg::Function<jsg::Promise<CacheValueProduceResult>(kj::String)>;
 
+  struct ReadOptions {
+    // For how long (in milliseconds) after a value has expired it may still be
+    // returned, while the fallback function is invoked in the background to
+    // refresh it. Only one such refresh runs at a time for each key.
+    jsg::Optional<double> staleWhileRevalidate;
+
+    // If set, the expiration time returned by the fallback function is moved
+    // earlier by a random amount of up to this many milliseconds. This spreads
+    // out the expiration of values that were produced at the same time.
+    jsg::Optional<double> expirationJitter;
+
+    JSG_STRUCT(staleWhileRevalidate, expirationJitter);
+  };
+
   // Reads a value from the cache or invokes a fallback function to obtain the
   // value, if a fallback function was given.
   jsg::Promise<jsg::JsRef<jsg::JsValue>> read(jsg::Lock& js,
       jsg::NonCoercible<kj::String> key,
-      jsg::Optional<FallbackFunction> optionalFallback);
+      jsg::Optional<FallbackFunction> optionalFallback,
+      jsg::Optional<ReadOptions> options);
 
   JSG_RESOURCE_TYPE(MemoryCache) { JSG_METHOD(read); }
 
@@ -504,6 +529,7 @@ private:
 // clang-format off
 #define EW_MEMORY_CACHE_ISOLATE_TYPES                                                   \
   api::MemoryCache,                                                                     \
+  api::MemoryCache::ReadOptions,                                                        \
   api::CacheValueProduceResult
 // clang-format on
 
@@ -24,6 +24,7 @@
 // USE OR OTHER DEALINGS IN THE SOFTWARE.
 #pragma once
 
+#include <workerd/util/base64.h>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
@@ -134,6 +135,17 @@ size_t base64_decode_fast(char* const dst, const size_t dstlen,
   size_t i = 0;
   size_t k = 0;
   while (i < max_i && k < max_k) {
+    if constexpr (sizeof(TypeName) == 1) {
+      // Runs of complete groups go through the vectorized decoder. It stops at the same places
+      // the group-at-a-time code below does, which then takes care of whatever is there.
+      size_t consumed = workerd::base64::decodePrefix(
+          kj::arrayPtr(reinterpret_cast<const kj::byte*>(src + i), max_i - i),
+          kj::arrayPtr(reinterpret_cast<kj::byte*>(dst + k), max_k - k));
+      i += consumed;
+      k += consumed / 4 * 3;
+      if (i >= max_i || k >= max_k) break;
+    }
+
     const unsigned char txt[] = {
         static_cast<unsigned char>(unbase64(static_cast<uint8_t>(src[i + 0]))),
         static_cast<unsigned char>(unbase64(static_cast<uint8_t>(src[i + 1]))),
@@ -625,6 +625,19 @@ export const base64 = {
 
     // // Regression test for https://github.com/nodejs/node/issues/13657.
     deepStrictEqual(Buffer.from(' YWJvcnVtLg', 'base64'), Buffer.from('YWJvcnVtLg', 'base64'));
+
+    {
+      // Inputs long enough to be decoded in blocks, broken up by whitespace and stray characters.
+      const data = Buffer.alloc(1000);
+      for (let i = 0; i < data.length; i++) {
+        data[i] = (i * 37 + 11) & 0xff;
+      }
+      const encoded = data.toString('base64');
+      deepStrictEqual(Buffer.from(encoded.replace(/.{76}/g, '$&\r\n'), 'base64'), data);
+      deepStrictEqual(Buffer.from(data.toString('base64url'), 'base64'), data);
+      deepStrictEqual(Buffer.from(encoded.slice(0, 400) + '=' + encoded.slice(400), 'base64'),
+                      data.subarray(0, 300));
+    }
   }
 
 };
@@ -662,6 +675,18 @@ export const hex = {
       }
     }
 
+    {
+      // Long inputs stop at the first invalid pair, whichever case the digits are in.
+      const data = Buffer.alloc(100, 0xab);
+      const encoded = data.toString('hex');
+      deepStrictEqual(Buffer.from(encoded.toUpperCase(), 'hex'), data);
+      deepStrictEqual(Buffer.from(encoded.slice(0, 150) + 'xy' + encoded.slice(150), 'hex'),
+                      data.subarray(0, 75));
+      const b = Buffer.alloc(40);
+      strictEqual(b.write(encoded, 'hex'), 40);
+      deepStrictEqual(b, data.subarray(0, 40));
+    }
+
     // Test single hex character is discarded.
     strictEqual(Buffer.from('A', 'hex').length, 0);
 
@@ -3454,6 +3479,23 @@ export const indexof = {
       strictEqual(haystack.indexOf(needle), 2);
       strictEqual(haystack.lastIndexOf(needle), haystack.length - 3);
     }
+
+    // Delimiters in a long buffer, searched in both directions and in both encodings.
+    {
+      const boundary = '--boundary';
+      const body = Buffer.from(`${'x'.repeat(1000)}${boundary}${'-'.repeat(1000)}${boundary}--`);
+      strictEqual(body.indexOf(boundary), 1000);
+      strictEqual(body.indexOf(boundary, 1001), 2010);
+      strictEqual(body.lastIndexOf(boundary), 2010);
+      strictEqual(body.lastIndexOf(boundary, 2009), 1000);
+      strictEqual(body.indexOf('--boundarY'), -1);
+      ok(body.includes('\x2d\x2d\x62', 1500));
+
+      const wide = Buffer.from(body.toString(), 'ucs2');
+      strictEqual(wide.indexOf(boundary, 'ucs2'), 2000);
+      strictEqual(wide.lastIndexOf(boundary, undefined, 'ucs2'), 4020);
+      strictEqual(wide.indexOf('-', 2020, 'ucs2'), 2020);
+    }
   }
 };
 
@@ -28,6 +28,7 @@
 // found in the LICENSE file.
 #pragma once
 
+#include <workerd/util/substring-search.h>
 #include <cstring>
 #include <algorithm>
 
@@ -597,6 +598,12 @@ size_t SearchString(Vector<const Char> subject,
 
 namespace workerd::api::node {
 
+// Needles up to this length are searched for by filtering candidate positions on their first
+// and last characters a vector at a time, which outperforms Boyer-Moore(-Horspool) until the
+// needle is long enough for its skips to cover more than a vector's worth of haystack.
+// Single-byte needles are left to memchr().
+constexpr size_t kMaxFilteredNeedleLength = 128;
+
 template <typename Char>
 size_t SearchString(const Char* haystack,
                     size_t haystack_length,
@@ -605,6 +612,23 @@ size_t SearchString(const Char* haystack,
                     size_t start_index,
                     bool is_forward) {
   if (haystack_length < needle_length) return haystack_length;
+
+  if (needle_length <= kMaxFilteredNeedleLength &&
+      (needle_length > 1 || (sizeof(Char) > 1 && needle_length == 1))) {
+    auto subject = kj::arrayPtr(haystack, haystack_length);
+    auto pattern = kj::arrayPtr(needle, needle_length);
+    if (is_forward) {
+      if (start_index > haystack_length - needle_length) return haystack_length;
+      size_t pos = substring::findFirst(subject.slice(start_index, haystack_length), pattern);
+      return pos == haystack_length - start_index ? haystack_length : start_index + pos;
+    } else {
+      // Matches may start at start_index at the latest.
+      size_t end = std::min(start_index, haystack_length - needle_length) + needle_length;
+      size_t pos = substring::findLast(subject.slice(0, end), pattern);
+      return pos == end ? haystack_length : pos;
+    }
+  }
+
   // To do a reverse search (lastIndexOf instead of indexOf) without redundant
   // code, create two vectors that are reversed views into the input strings.
   // For example, v_needle[0] would return the *last* character of the needle.
@@ -7,6 +7,9 @@
 #include "buffer-base64.h"
 #include "buffer-string-search.h"
 #include <workerd/jsg/buffersource.h>
+#include <workerd/util/base64.h>
+#include <workerd/util/hex.h>
+#include <workerd/util/utf8.h>
 #include <kj/encoding.h>
 #include <algorithm>
 
@@ -114,17 +117,6 @@ Encoding getEncoding(kj::StringPtr encoding) {
   KJ_UNREACHABLE;
 }
 
-kj::Maybe<uint> tryFromHexDigit(char c) {
-  if ('0' <= c && c <= '9') {
-    return c - '0';
-  } else if ('a' <= c && c <= 'f') {
-    return c - ('a' - 10);
-  } else if ('A' <= c && c <= 'F') {
-    return c - ('A' - 10);
-  }
-  return kj::none;
-}
-
 kj::Array<byte> decodeHexTruncated(kj::ArrayPtr<kj::byte> text, bool strict = false) {
   // We do not use kj::decodeHex because we need to match Node.js'
   // behavior of truncating the response at the first invalid hex
@@ -136,30 +128,16 @@ kj::Array<byte> decodeHexTruncated(kj::ArrayPtr<kj::byte> text, bool strict = fa
     }
     text = text.slice(0, text.size() - 1);
   }
-  kj::Vector vec = kj::Vector<kj::byte>(text.size() / 2);
 
-  for (size_t i = 0; i < text.size(); i += 2) {
-    byte b = 0;
-    KJ_IF_SOME(d1, tryFromHexDigit(text[i])) {
-      b = d1 << 4;
-    } else {
-      if (strict) {
-        JSG_FAIL_REQUIRE(TypeError, "The text is not valid hex");
-      }
-      break;
-    }
-    KJ_IF_SOME(d2, tryFromHexDigit(text[i+1])) {
-      b |= d2;
-    } else {
-      if (strict) {
-        JSG_FAIL_REQUIRE(TypeError, "The text is not valid hex");
-      }
-      break;
+  auto result = kj::heapArray<kj::byte>(text.size() / 2);
+  auto written = hex::decodePrefix(text, result);
+  if (written < result.size()) {
+    if (strict) {
+      JSG_FAIL_REQUIRE(TypeError, "The text is not valid hex");
     }
-    vec.add(b);
+    return result.slice(0, written).attach(kj::mv(result));
   }
-
-  return vec.releaseAsArray();
+  return kj::mv(result);
 }
 
 uint32_t writeInto(
@@ -210,10 +188,8 @@ uint32_t writeInto(
           static_cast<jsg::JsString::WriteOptions>(jsg::JsString::NO_NULL_TERMINATION |
                                                    jsg::JsString::REPLACE_INVALID_UTF8);
       string.writeInto(js, buf, options);
-      auto bytes = decodeHexTruncated(buf, false);
-      auto amountToCopy = kj::min(bytes.size(), dest.size());
-      memcpy(dest.begin(), bytes.begin(), amountToCopy);
-      return amountToCopy;
+      // Decoding stops when dest is full, so there's no need for an intermediate copy.
+      return hex::decodePrefix(buf, dest);
     }
   }
   KJ_UNREACHABLE;
@@ -528,10 +504,11 @@ jsg::JsString toStringImpl(
   if (slice.size() == 0) return js.str();
   switch (encoding) {
     case Encoding::ASCII: {
-      // TODO(perf): We can look at making this more performant later.
-      // Essentially we have to modify the buffer such that every byte
-      // has the highest bit turned off. Whee! Node.js has a faster
-      // algorithm that it implements so we can likely adopt that.
+      // Every byte needs its highest bit turned off, which is only worth a copy when some of
+      // them actually have it set.
+      if (utf8::isAscii(slice)) {
+        return js.str(slice);
+      }
       kj::Array<kj::byte> copy = KJ_MAP(b, slice) -> kj::byte { return b & 0x7f; };
       return js.str(copy);
     }
@@ -547,14 +524,21 @@ jsg::JsString toStringImpl(
           reinterpret_cast<uint16_t*>(slice.begin()), slice.size() / 2);
       return js.str(data);
     }
-    case Encoding::BASE64: {
-      return js.str(kj::encodeBase64(slice));
-    }
+    case Encoding::BASE64:
+      // Fall-through
     case Encoding::BASE64URL: {
-      return js.str(kj::encodeBase64Url(slice));
+      // Encoded output is always ASCII, so it's handed to v8 as a one-byte string rather than
+      // going through UTF-8 decoding.
+      auto alphabet = encoding == Encoding::BASE64 ? base64::Alphabet::STANDARD
+                                                   : base64::Alphabet::URL;
+      auto encoded = kj::heapArray<kj::byte>(base64::encodedLength(slice.size(), alphabet));
+      base64::encode(slice, encoded.asChars(), alphabet);
+      return js.str(encoded);
     }
     case Encoding::HEX: {
-      return js.str(kj::encodeHex(slice));
+      auto encoded = kj::heapArray<kj::byte>(slice.size() * 2);
+      hex::encode(slice, encoded.asChars());
+      return js.str(encoded);
     }
   }
   KJ_UNREACHABLE;
@@ -217,8 +217,8 @@ kj::Promise<R2Result> doR2HTTPPutRequest(kj::Own<kj::HttpClient> client,
         co_await request.body->write(data.begin(), data.size());
       }
       KJ_CASE_ONEOF(blob, jsg::Ref<Blob>) {
-        auto data = blob->getData();
-        co_await request.body->write(data.begin(), data.size());
+        auto pieces = KJ_MAP(segment, blob->getSegments()) { return segment.data; };
+        co_await request.body->write(pieces);
       }
       KJ_CASE_ONEOF(stream, jsg::Ref<ReadableStream>) {
         // Because the ReadableStream might be a fully JavaScript-backed stream, we must
@@ -617,6 +617,39 @@ async function test(storage) {
     const execIterator = sql.exec(`SELECT * FROM abc, cde`)
     assert.deepEqual(execIterator.columnNames, ['a', 'b', 'c', 'c', 'd', 'e'])
     assert.equal(Array.from(execIterator.raw())[0].length, 6)
+
+    // toArray() returns the remaining rows all at once, also with the last 'c' winning.
+    const arrayResults = stmt().toArray()
+    assert.equal(arrayResults.length, 4)
+    assert.deepEqual(arrayResults[1], { a: 1, b: 2, c: 1, d: 2, e: 3 })
+  }
+
+  // Test toArray() with every type of value, and on a partially consumed cursor
+  {
+    const cursor = sql.exec(
+      "SELECT 1 AS int, 1.5 AS real, 'text' AS text, x'0102' AS blob, NULL AS nil\n" +
+        'UNION ALL\n' +
+        "SELECT 2, 2.5, 'more', x'', NULL"
+    )
+    assert.equal(cursor[Symbol.iterator]().next().value.int, 1)
+
+    const rows = cursor.toArray()
+    assert.equal(rows.length, 1)
+    assert.equal(rows[0].int, 2)
+    assert.equal(rows[0].real, 2.5)
+    assert.equal(rows[0].text, 'more')
+    assert.ok(rows[0].blob instanceof ArrayBuffer)
+    assert.equal(rows[0].blob.byteLength, 0)
+    assert.equal(rows[0].nil, null)
+    assert.deepEqual(Object.keys(rows[0]), ['int', 'real', 'text', 'blob', 'nil'])
+
+    assert.deepEqual(cursor.toArray(), [])
+  }
+
+  // Column names that aren't plain identifiers still work
+  {
+    const [row] = sql.exec("SELECT 1 AS '0', 2 AS 'héllo', 3 AS ''").toArray()
+    assert.deepEqual(row, { 0: 1, héllo: 2, '': 3 })
   }
 
   await scheduler.wait(1)
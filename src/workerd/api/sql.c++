@@ -78,19 +78,59 @@ SqlStorage::Cursor::~Cursor() noexcept(false) {
   }
 }
 
+// Rows whose column names can't be expressed by an object template are built property by
+// property instead. Array-index names become elements rather than named properties, and
+// "__proto__" is excluded since the slow path assigns it rather than defining an own property.
+static bool canUseInRowTemplate(kj::StringPtr name) {
+  if (name == "__proto__") return false;
+
+  bool allDigits = name.size() > 0;
+  for (char c: name) {
+    if (c < '0' || c > '9') allDigits = false;
+  }
+  return !allDigits;
+}
+
 void SqlStorage::Cursor::CachedColumnNames::ensureInitialized(
     jsg::Lock& js, SqliteDatabase::Query& source) {
   if (names == kj::none) {
     js.withinHandleScope([&] {
       auto builder = kj::heapArrayBuilder<jsg::JsRef<jsg::JsString>>(source.columnCount());
+      kj::HashSet<kj::StringPtr> seen;
+      bool useTemplate = useRowTemplate;
       for (auto i: kj::zeroTo(builder.capacity())) {
-        builder.add(js, js.str(source.getColumnName(i)));
+        auto name = source.getColumnName(i);
+        builder.add(js, js.str(name));
+
+        // With duplicate names, the last column wins, which a template can't express.
+        if (!canUseInRowTemplate(name) || seen.contains(name)) {
+          useTemplate = false;
+        } else {
+          seen.insert(name);
+        }
       }
       names = builder.finish();
+
+      if (useTemplate) {
+        // Declare every column, in order, so that instances start out with all of the row's
+        // properties and only need their values filled in.
+        auto tmpl = v8::ObjectTemplate::New(js.v8Isolate);
+        for (auto& name: KJ_ASSERT_NONNULL(names)) {
+          tmpl->Set(v8::Local<v8::String>(name.getHandle(js)), v8::Undefined(js.v8Isolate));
+        }
+        rowTemplate = jsg::V8Ref<v8::ObjectTemplate>(js.v8Isolate, tmpl);
+      }
     });
   }
 }
 
+kj::Maybe<v8::Local<v8::ObjectTemplate>>
+    SqlStorage::Cursor::CachedColumnNames::getRowTemplate(jsg::Lock& js) {
+  return rowTemplate.map([&](jsg::V8Ref<v8::ObjectTemplate>& t) {
+    return t.getHandle(js);
+  });
+}
+
 double SqlStorage::Cursor::getRowsRead() {
   KJ_IF_SOME(st, state) {
     return static_cast<double>(st->query.getRowsRead());
@@ -114,20 +154,10 @@ jsg::Ref<SqlStorage::Cursor::RowIterator> SqlStorage::Cursor::rows(jsg::Lock& js
   return jsg::alloc<RowIterator>(JSG_THIS);
 }
 
-kj::Maybe<SqlStorage::Cursor::RowDict> SqlStorage::Cursor::rowIteratorNext(
+kj::Maybe<jsg::JsObject> SqlStorage::Cursor::rowIteratorNext(
     jsg::Lock& js, jsg::Ref<Cursor>& obj) {
-  auto names = obj->cachedColumnNames.get();
-  return iteratorImpl(js, obj,
-      [&](State& state, uint i, Value&& value) {
-    return RowDict::Field{
-      // A little trick here: We know there are no HandleScopes on the stack between JSG and here,
-      // so we can return a dict keyed by local handles, which avoids constructing new V8Refs here
-      // which would be relatively slower.
-      .name = names[i].getHandle(js),
-      .value = kj::mv(value)
-    };
-  }).map([&](kj::Array<RowDict::Field>&& fields) {
-    return RowDict { .fields = kj::mv(fields) };
+  return obj->nextRow().map([&](SqliteDatabase::Query& query) {
+    return obj->rowToObject(js, query);
   });
 }
 
@@ -149,22 +179,33 @@ kj::Array<jsg::JsRef<jsg::JsString>> SqlStorage::Cursor::getColumnNames(jsg::Loc
   }
 }
 
-kj::Maybe<kj::Array<SqlStorage::Cursor::Value>> SqlStorage::Cursor::rawIteratorNext(
+kj::Maybe<jsg::JsArray> SqlStorage::Cursor::rawIteratorNext(
     jsg::Lock& js, jsg::Ref<Cursor>& obj) {
-  return iteratorImpl(js, obj,
-      [&](State& state, uint i, Value&& value) {
-    return kj::mv(value);
+  return obj->nextRow().map([&](SqliteDatabase::Query& query) {
+    return obj->rowToArray(js, query);
   });
 }
 
-template <typename Func>
-auto SqlStorage::Cursor::iteratorImpl(jsg::Lock& js, jsg::Ref<Cursor>& obj, Func&& func)
-    -> kj::Maybe<kj::Array<
-        decltype(func(kj::instance<State&>(), uint(), kj::instance<Value&&>()))>> {
-  using Element = decltype(func(kj::instance<State&>(), uint(), kj::instance<Value&&>()));
+jsg::JsArray SqlStorage::Cursor::toArray(jsg::Lock& js) {
+  KJ_IF_SOME(s, state) {
+    cachedColumnNames.ensureInitialized(js, s->query);
+  }
+
+  // The rows are all created in the caller's handle scope, so we can hold plain local handles.
+  kj::Vector<v8::Local<v8::Value>> rows;
+  for (;;) {
+    KJ_IF_SOME(query, nextRow()) {
+      rows.add(rowToObject(js, query));
+    } else {
+      break;
+    }
+  }
+  return jsg::JsArray(v8::Array::New(js.v8Isolate, rows.begin(), rows.size()));
+}
 
-  auto& state = *KJ_UNWRAP_OR(obj->state, {
-    if (obj->canceled) {
+kj::Maybe<SqliteDatabase::Query&> SqlStorage::Cursor::nextRow() {
+  auto& state = *KJ_UNWRAP_OR(this->state, {
+    if (canceled) {
       JSG_FAIL_REQUIRE(Error,
           "SQL cursor was closed because the same statement was executed again. If you need to "
           "run multiple copies of the same statement concurrently, you must create multiple "
@@ -176,8 +217,7 @@ auto SqlStorage::Cursor::iteratorImpl(jsg::Lock& js, jsg::Ref<Cursor>& obj, Func
   });
 
   if (state.isFirst) {
-    // Little hack: We don't want to call query.nextRow() at the end of this method because it
-    // may invalidate the backing buffers of StringPtrs that we haven't returned to JS yet.
+    // The query is already positioned on the first row as soon as it has been run.
     state.isFirst = false;
   } else {
     state.query.nextRow();
@@ -187,39 +227,73 @@ auto SqlStorage::Cursor::iteratorImpl(jsg::Lock& js, jsg::Ref<Cursor>& obj, Func
 
   if (query.isDone()) {
     // Save off row counts before the query goes away.
-    obj->rowsRead = query.getRowsRead();
-    obj->rowsWritten = query.getRowsWritten();
+    rowsRead = query.getRowsRead();
+    rowsWritten = query.getRowsWritten();
     // Clean up the query proactively.
-    obj->state = kj::none;
+    this->state = kj::none;
     return kj::none;
   }
 
-  auto results = kj::heapArrayBuilder<Element>(query.columnCount());
-  for (auto i: kj::zeroTo(results.capacity())) {
-    Value value;
-    KJ_SWITCH_ONEOF(query.getValue(i)) {
-      KJ_CASE_ONEOF(data, kj::ArrayPtr<const byte>) {
-        value.emplace(kj::heapArray(data));
-      }
-      KJ_CASE_ONEOF(text, kj::StringPtr) {
-        value.emplace(text);
-      }
-      KJ_CASE_ONEOF(i, int64_t) {
-        // int64 will become BigInt, but most applications won't want all their integers to be
-        // BigInt. We will coerce to a double here.
-        // TODO(someday): Allow applications to request that certain columns use BigInt.
-        value.emplace(static_cast<double>(i));
-      }
-      KJ_CASE_ONEOF(d, double) {
-        value.emplace(d);
-      }
-      KJ_CASE_ONEOF(_, decltype(nullptr)) {
-        // leave value null
+  return query;
+}
+
+jsg::JsObject SqlStorage::Cursor::rowToObject(jsg::Lock& js, SqliteDatabase::Query& query) {
+  auto names = cachedColumnNames.get();
+
+  // A row created from the template already has every property, so setting them below only
+  // overwrites values without changing the object's shape.
+  auto row = [&]() {
+    KJ_IF_SOME(rowTemplate, cachedColumnNames.getRowTemplate(js)) {
+      return jsg::JsObject(jsg::check(rowTemplate->NewInstance(js.v8Context())));
+    }
+    return js.obj();
+  }();
+
+  for (auto i: kj::zeroTo(query.columnCount())) {
+    row.set(js, names[i].getHandle(js), valueToJs(js, query, i));
+  }
+  return row;
+}
+
+jsg::JsArray SqlStorage::Cursor::rowToArray(jsg::Lock& js, SqliteDatabase::Query& query) {
+  static constexpr size_t MAX_STACK = 64;
+  auto columnCount = query.columnCount();
+
+  KJ_STACK_ARRAY(v8::Local<v8::Value>, values, columnCount, MAX_STACK, MAX_STACK);
+  for (auto i: kj::zeroTo(columnCount)) {
+    values[i] = valueToJs(js, query, i);
+  }
+  return jsg::JsArray(v8::Array::New(js.v8Isolate, values.begin(), values.size()));
+}
+
+jsg::JsValue SqlStorage::Cursor::valueToJs(
+    jsg::Lock& js, SqliteDatabase::Query& query, uint column) {
+  KJ_SWITCH_ONEOF(query.getValue(column)) {
+    KJ_CASE_ONEOF(data, kj::ArrayPtr<const byte>) {
+      // Copy straight into the ArrayBuffer, rather than via an intermediate kj::Array.
+      auto buffer = v8::ArrayBuffer::New(js.v8Isolate, data.size());
+      if (data.size() > 0) {
+        memcpy(buffer->Data(), data.begin(), data.size());
       }
+      return jsg::JsValue(buffer);
+    }
+    KJ_CASE_ONEOF(text, kj::StringPtr) {
+      return js.str(text);
+    }
+    KJ_CASE_ONEOF(i, int64_t) {
+      // int64 will become BigInt, but most applications won't want all their integers to be
+      // BigInt. We will coerce to a double here.
+      // TODO(someday): Allow applications to request that certain columns use BigInt.
+      return js.num(static_cast<double>(i));
+    }
+    KJ_CASE_ONEOF(d, double) {
+      return js.num(d);
+    }
+    KJ_CASE_ONEOF(_, decltype(nullptr)) {
+      return js.null();
     }
-    results.add(func(state, i, kj::mv(value)));
   }
-  return results.finish();
+  KJ_UNREACHABLE;
 }
 
 SqlStorage::Statement::Statement(SqliteDatabase::Statement&& statement)
@@ -103,23 +103,31 @@ public:
   double getRowsWritten();
 
   kj::Array<jsg::JsRef<jsg::JsString>> getColumnNames(jsg::Lock& js);
+
+  // Returns all remaining rows as an array of row objects, materialized in a single call rather
+  // than one iterator step per row.
+  jsg::JsArray toArray(jsg::Lock& js);
+
   JSG_RESOURCE_TYPE(Cursor) {
     JSG_ITERABLE(rows);
     JSG_METHOD(raw);
+    JSG_METHOD(toArray);
     JSG_READONLY_PROTOTYPE_PROPERTY(columnNames, getColumnNames);
     JSG_READONLY_PROTOTYPE_PROPERTY(rowsRead, getRowsRead);
     JSG_READONLY_PROTOTYPE_PROPERTY(rowsWritten, getRowsWritten);
-  }
 
-  // One value returned from SQL. Note that we intentionally return StringPtr instead of String
-  // because we know that the underlying buffer returned by SQLite will be valid long enough to be
-  // converted by JSG into a V8 string. For byte arrays, on the other hand, we pass ownership to
-  // JSG, which does not need to make a copy.
-  using Value = kj::Maybe<kj::OneOf<kj::Array<byte>, kj::StringPtr, double>>;
+    JSG_TS_DEFINE(type SqlStorageValue = ArrayBuffer | string | number | null);
+    JSG_TS_OVERRIDE({
+      [Symbol.iterator](): IterableIterator<Record<string, SqlStorageValue>>;
+      raw(): IterableIterator<SqlStorageValue[]>;
+      toArray(): Record<string, SqlStorageValue>[];
+    });
+  }
 
-  using RowDict = jsg::Dict<Value, jsg::JsString>;
-  JSG_ITERATOR(RowIterator, rows, RowDict, jsg::Ref<Cursor>, rowIteratorNext);
-  JSG_ITERATOR(RawIterator, raw, kj::Array<Value>, jsg::Ref<Cursor>, rawIteratorNext);
+  // Rows are converted straight from SQLite's values to JavaScript, without an intermediate C++
+  // representation.
+  JSG_ITERATOR(RowIterator, rows, jsg::JsObject, jsg::Ref<Cursor>, rowIteratorNext);
+  JSG_ITERATOR(RawIterator, raw, jsg::JsArray, jsg::Ref<Cursor>, rawIteratorNext);
 
   void visitForMemoryInfo(jsg::MemoryTracker& tracker) const {
     if (state != kj::none) {
@@ -132,12 +140,22 @@ public:
 private:
   // Helper class to cache column names for a query so that we don't have to recreate the V8
   // strings for every row.
+  //
+  // For a prepared statement, where the names allow it, this also caches a V8 object template
+  // declaring every column, so that all rows share one hidden class and are created with their
+  // properties already laid out. Ad-hoc queries don't get a template: V8 keeps every template it
+  // has instantiated alive for the life of the context, so one per exec() call would pile up.
   class CachedColumnNames {
-    // TODO(perf): Can we further cache the V8 object layout information for a row?
   public:
+    explicit CachedColumnNames(bool useRowTemplate = false): useRowTemplate(useRowTemplate) {}
+
     // Get the cached names. ensureInitialized() must have been called previously.
     kj::ArrayPtr<jsg::JsRef<jsg::JsString>> get() { return KJ_REQUIRE_NONNULL(names); }
 
+    // Get the row template, or none if rows must be built property by property, e.g. because
+    // some column names are duplicated. ensureInitialized() must have been called previously.
+    kj::Maybe<v8::Local<v8::ObjectTemplate>> getRowTemplate(jsg::Lock& js);
+
     void ensureInitialized(jsg::Lock& js, SqliteDatabase::Query& source);
 
     JSG_MEMORY_INFO(cachedColumnNames) {
@@ -149,7 +167,9 @@ private:
     }
 
   private:
+    bool useRowTemplate;
     kj::Maybe<kj::Array<jsg::JsRef<jsg::JsString>>> names;
+    kj::Maybe<jsg::V8Ref<v8::ObjectTemplate>> rowTemplate;
   };
 
   struct State {
@@ -202,12 +222,17 @@ private:
   static kj::Array<const SqliteDatabase::Query::ValuePtr> mapBindings(
       kj::ArrayPtr<BindingValue> values);
 
-  static kj::Maybe<RowDict> rowIteratorNext(jsg::Lock& js, jsg::Ref<Cursor>& obj);
-  static kj::Maybe<kj::Array<Value>> rawIteratorNext(jsg::Lock& js, jsg::Ref<Cursor>& obj);
-  template <typename Func>
-  static auto iteratorImpl(jsg::Lock& js, jsg::Ref<Cursor>& obj, Func&& func)
-      -> kj::Maybe<kj::Array<
-          decltype(func(kj::instance<State&>(), uint(), kj::instance<Value&&>()))>>;
+  static kj::Maybe<jsg::JsObject> rowIteratorNext(jsg::Lock& js, jsg::Ref<Cursor>& obj);
+  static kj::Maybe<jsg::JsArray> rawIteratorNext(jsg::Lock& js, jsg::Ref<Cursor>& obj);
+
+  // Steps the query to the next row, returning it positioned there, or none if there are no more
+  // rows.
+  kj::Maybe<SqliteDatabase::Query&> nextRow();
+
+  // Build the JavaScript representation of the query's current row.
+  jsg::JsObject rowToObject(jsg::Lock& js, SqliteDatabase::Query& query);
+  jsg::JsArray rowToArray(jsg::Lock& js, SqliteDatabase::Query& query);
+  static jsg::JsValue valueToJs(jsg::Lock& js, SqliteDatabase::Query& query, uint column);
 
   friend class Statement;
 };
@@ -236,8 +261,8 @@ private:
   kj::Maybe<Cursor&> currentCursor;
 
   // All queries from the same prepared statement have the same column names, so we can cache them
-  // on the statement.
-  Cursor::CachedColumnNames cachedColumnNames;
+  // on the statement, along with a row template.
+  Cursor::CachedColumnNames cachedColumnNames { true };
 
   friend class Cursor;
 };
@@ -13,13 +13,25 @@ class CompressionStream: public TransformStream {
 public:
   using TransformStream::TransformStream;
 
-  static jsg::Ref<CompressionStream> constructor(jsg::Lock& js, kj::String format);
+  // Non-standard tuning for the compressor. Both fields are interpreted according to the format:
+  // for the zlib formats, `level` is 0-9 and `windowBits` is 9-15; for "br", `level` is the
+  // Brotli quality, 0-11, and `windowBits` is 10-24.
+  struct Options {
+    jsg::Optional<int> level;
+    jsg::Optional<int> windowBits;
+
+    JSG_STRUCT(level, windowBits);
+  };
+
+  static jsg::Ref<CompressionStream> constructor(
+      jsg::Lock& js, kj::String format, jsg::Optional<Options> options);
 
   JSG_RESOURCE_TYPE(CompressionStream) {
     JSG_INHERIT(TransformStream);
 
     JSG_TS_OVERRIDE(extends TransformStream<ArrayBuffer | ArrayBufferView, Uint8Array> {
-      constructor(format: "gzip" | "deflate" | "deflate-raw");
+      constructor(format: "gzip" | "deflate" | "deflate-raw" | "br",
+                  options?: CompressionStreamOptions);
     });
   }
 };
@@ -34,7 +46,7 @@ public:
     JSG_INHERIT(TransformStream);
 
     JSG_TS_OVERRIDE(extends TransformStream<ArrayBuffer | ArrayBufferView, Uint8Array> {
-      constructor(format: "gzip" | "deflate" | "deflate-raw");
+      constructor(format: "gzip" | "deflate" | "deflate-raw" | "br");
     });
   }
 };
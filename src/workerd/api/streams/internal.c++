@@ -2024,29 +2024,11 @@ kj::Promise<size_t> IdentityTransformStreamImpl::tryRead(
     void* buffer,
     size_t minBytes,
     size_t maxBytes) {
-  size_t total = 0;
-  while (total < minBytes) {
-    // TODO(perf): tryReadInternal was written assuming minBytes would always be 1 but we've now
-    // introduced an API for user to specify a larger minBytes. For now, this is implemented as a
-    // naiive loop dispatching to the 1 byte version but would be better to bake it deeper into
-    // the implementation where it can be more efficient.
-    auto amount = co_await tryReadInternal(buffer, maxBytes);
-    KJ_ASSERT(amount <= maxBytes);
-    if (amount == 0) {
-      // EOF.
-      break;
-    }
-
-    total += amount;
-    buffer = reinterpret_cast<char*>(buffer) + amount;
-    maxBytes -= amount;
-  }
-
-  co_return total;
-}
+  KJ_ASSERT(minBytes <= maxBytes);
 
-kj::Promise<size_t> IdentityTransformStreamImpl::tryReadInternal(void* buffer, size_t maxBytes) {
-  auto promise = readHelper(kj::arrayPtr(static_cast<kj::byte*>(buffer), maxBytes));
+  // A read which asks for nothing still waits for at least one byte, or EOF.
+  auto promise = readHelper(kj::arrayPtr(static_cast<kj::byte*>(buffer), maxBytes),
+                            kj::max(minBytes, size_t(1)));
 
   KJ_IF_SOME(l, limit) {
     promise = promise.then([this, &l = l](size_t amount) -> kj::Promise<size_t> {
@@ -2099,7 +2081,8 @@ void IdentityTransformStreamImpl::cancel(kj::Exception reason) {
       // This is fine.
     }
     KJ_CASE_ONEOF(request, ReadRequest) {
-      request.fulfiller->fulfill(size_t(0));
+      // Hand over whatever the read has received so far; the next read will see EOF.
+      request.fulfiller->fulfill(kj::cp(request.filled));
     }
     KJ_CASE_ONEOF(request, WriteRequest) {
       request.fulfiller->reject(kj::cp(reason));
@@ -2165,13 +2148,18 @@ void IdentityTransformStreamImpl::abort(kj::Exception reason) {
   // TODO(conform): Proactively put ReadableStream into Errored state.
 }
 
-kj::Promise<size_t> IdentityTransformStreamImpl::readHelper(kj::ArrayPtr<kj::byte> bytes) {
+kj::Promise<size_t> IdentityTransformStreamImpl::readHelper(
+    kj::ArrayPtr<kj::byte> bytes, size_t minBytes) {
   KJ_SWITCH_ONEOF(state) {
     KJ_CASE_ONEOF(idle, Idle) {
       // No outstanding write request, switch to ReadRequest state.
 
       auto paf = kj::newPromiseAndFulfiller<size_t>();
-      state = ReadRequest { bytes, kj::mv(paf.fulfiller) };
+      state = ReadRequest {
+        .bytes = bytes,
+        .minBytes = minBytes,
+        .fulfiller = kj::mv(paf.fulfiller),
+      };
       return kj::mv(paf.promise);
     }
     KJ_CASE_ONEOF(request, ReadRequest) {
@@ -2179,18 +2167,30 @@ kj::Promise<size_t> IdentityTransformStreamImpl::readHelper(kj::ArrayPtr<kj::byt
     }
     KJ_CASE_ONEOF(request, WriteRequest) {
       if (bytes.size() >= request.bytes.size()) {
-        // The write buffer will entirely fit into our read buffer; fulfill both requests.
+        // The write buffer will entirely fit into our read buffer; fulfill the write request.
         memcpy(bytes.begin(), request.bytes.begin(), request.bytes.size());
         auto result = request.bytes.size();
         request.fulfiller->fulfill();
 
-        // Switch to idle state.
-        state = Idle();
+        if (result >= minBytes) {
+          // That's enough for the read too. Switch to idle state.
+          state = Idle();
+          return result;
+        }
 
-        return result;
+        // Wait for further writes to fill the rest of the read.
+        auto paf = kj::newPromiseAndFulfiller<size_t>();
+        state = ReadRequest {
+          .bytes = bytes.slice(result, bytes.size()),
+          .minBytes = minBytes,
+          .filled = result,
+          .fulfiller = kj::mv(paf.fulfiller),
+        };
+        return kj::mv(paf.promise);
       }
 
-      // The write buffer won't quite fit into our read buffer; fulfill only the read request.
+      // The write buffer won't quite fit into our read buffer; fulfill only the read request. The
+      // read buffer is full, and so it must have at least `minBytes`.
       memcpy(bytes.begin(), request.bytes.begin(), bytes.size());
       request.bytes = request.bytes.slice(bytes.size(), request.bytes.size());
       return bytes.size();
@@ -2235,8 +2235,9 @@ kj::Promise<void> IdentityTransformStreamImpl::writeHelper(kj::ArrayPtr<const kj
       }
 
       if (bytes.size() == 0) {
-        // This is a close operation.
-        request.fulfiller->fulfill(size_t(0));
+        // This is a close operation. The read gets whatever it has received so far, which may be
+        // less than it asked for.
+        request.fulfiller->fulfill(kj::cp(request.filled));
         state = StreamStates::Closed();
         return kj::READY_NOW;
       }
@@ -2244,17 +2245,24 @@ kj::Promise<void> IdentityTransformStreamImpl::writeHelper(kj::ArrayPtr<const kj
       KJ_ASSERT(request.bytes.size() > 0);
 
       if (request.bytes.size() >= bytes.size()) {
-        // Our write buffer will entirely fit into the read buffer; fulfill both requests.
+        // Our write buffer will entirely fit into the read buffer; fulfill the write request.
         memcpy(request.bytes.begin(), bytes.begin(), bytes.size());
-        request.fulfiller->fulfill(bytes.size());
-        state = Idle();
+        request.bytes = request.bytes.slice(bytes.size(), request.bytes.size());
+        request.filled += bytes.size();
+
+        if (request.filled >= request.minBytes) {
+          request.fulfiller->fulfill(kj::cp(request.filled));
+          state = Idle();
+        } else {
+          // Leave the read pending until further writes bring it up to `minBytes`.
+        }
         return kj::READY_NOW;
       }
 
       // Our write buffer won't quite fit into the read buffer; fulfill only the read request.
       memcpy(request.bytes.begin(), bytes.begin(), request.bytes.size());
       bytes = bytes.slice(request.bytes.size(), bytes.size());
-      request.fulfiller->fulfill(request.bytes.size());
+      request.fulfiller->fulfill(request.filled + request.bytes.size());
 
       auto paf = kj::newPromiseAndFulfiller<void>();
       state = WriteRequest { bytes, kj::mv(paf.fulfiller) };
@@ -382,8 +382,6 @@ public:
 
   kj::Promise<size_t> tryRead(void* buffer, size_t minBytes, size_t maxBytes) override;
 
-  kj::Promise<size_t> tryReadInternal(void* buffer, size_t maxBytes);
-
   kj::Promise<DeferredProxy<void>> pumpTo(WritableStreamSink& output, bool end) override;
 
   kj::Maybe<uint64_t> tryGetLength(StreamEncoding encoding) override;
@@ -401,17 +399,25 @@ public:
   void abort(kj::Exception reason) override;
 
 private:
-  kj::Promise<size_t> readHelper(kj::ArrayPtr<kj::byte> bytes);
+  kj::Promise<size_t> readHelper(kj::ArrayPtr<kj::byte> bytes, size_t minBytes);
 
   kj::Promise<void> writeHelper(kj::ArrayPtr<const kj::byte> bytes);
 
   kj::Maybe<uint64_t> limit;
 
+  // A read is only fulfilled once at least `minBytes` have been written into it (or the stream
+  // closes), so a large read can be filled by several writes without waking up the reader.
   struct ReadRequest {
+    // The part of the read buffer which has not been filled yet.
     kj::ArrayPtr<kj::byte> bytes;
     // WARNING: `bytes` may be invalid if fulfiller->isWaiting() returns false! (This indicates the
     //   read was canceled.)
 
+    size_t minBytes;
+
+    // Number of bytes already copied into the read buffer.
+    size_t filled = 0;
+
     kj::Own<kj::PromiseFulfiller<size_t>> fulfiller;
   };
 
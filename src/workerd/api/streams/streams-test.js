@@ -44,6 +44,72 @@ export const arrayBufferOfReadable = {
   }
 }
 
+export const brotliRoundTrip = {
+  async test() {
+    const input = new TextEncoder().encode("0123456789".repeat(1000));
+
+    async function roundTrip(options) {
+      const cs = new CompressionStream("br", options);
+      const cw = cs.writable.getWriter();
+      await cw.write(input);
+      await cw.close();
+      const data = await new Response(cs.readable).arrayBuffer();
+      assert.ok(data.byteLength < input.byteLength / 10, `${data.byteLength}`);
+
+      const ds = new DecompressionStream("br");
+      const dw = ds.writable.getWriter();
+      await dw.write(data);
+      await dw.close();
+      const read = new Uint8Array(await new Response(ds.readable).arrayBuffer());
+      assert.deepStrictEqual(read, input);
+    }
+
+    await roundTrip();
+    await roundTrip({ level: 11, windowBits: 24 });
+    await roundTrip({ level: 0, windowBits: 10 });
+
+    assert.throws(() => new CompressionStream("br", { level: 12 }), RangeError);
+    assert.throws(() => new CompressionStream("gzip", { windowBits: 16 }), RangeError);
+    assert.throws(() => new CompressionStream("zstd"), TypeError);
+
+    // Levels and window sizes apply to zlib formats too.
+    const cs = new CompressionStream("deflate", { level: 1, windowBits: 9 });
+    const cw = cs.writable.getWriter();
+    await cw.write(input);
+    await cw.close();
+    const ds = new DecompressionStream("deflate");
+    const read = await new Response(cs.readable.pipeThrough(ds)).arrayBuffer();
+    assert.equal(read.byteLength, input.byteLength);
+  }
+}
+
+export const identityTransformReadAtLeast = {
+  async test() {
+    const { readable, writable } = new IdentityTransformStream();
+    const writer = writable.getWriter();
+    const reader = readable.getReader({ mode: 'byob' });
+
+    // Several small writes are gathered into a single read.
+    const read = reader.readAtLeast(6, new Uint8Array(8));
+    const writes = [
+      writer.write(new Uint8Array([1, 2])),
+      writer.write(new Uint8Array([3, 4])),
+      writer.write(new Uint8Array([5, 6, 7])),
+    ];
+    const { value, done } = await read;
+    assert.ok(!done);
+    assert.deepStrictEqual(value, new Uint8Array([1, 2, 3, 4, 5, 6, 7]));
+    await Promise.all(writes);
+
+    // Closing the stream hands over a short read.
+    const short = reader.readAtLeast(4, new Uint8Array(4));
+    await writer.write(new Uint8Array([8]));
+    await writer.close();
+    assert.deepStrictEqual((await short).value, new Uint8Array([8]));
+    assert.ok((await reader.read(new Uint8Array(1))).done);
+  }
+};
+
 export const inspect = {
   async test() {
     const inspectOpts = { breakLength: Infinity };
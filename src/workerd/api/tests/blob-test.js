@@ -119,6 +119,54 @@ export default {
   }
 };
 
+export const testSharedSegments = {
+  async test(ctrl, env, ctx) {
+    // Parts large enough to be shared rather than copied, so that the resulting Blobs are made
+    // up of several segments.
+    const a = 'a'.repeat(3000);
+    const b = 'b'.repeat(2000);
+    const blobA = new Blob([a]);
+    const blobB = new Blob([b]);
+
+    const combined = new Blob([blobA, 'xyz', blobB, blobA]);
+    const expected = a + 'xyz' + b + a;
+    strictEqual(combined.size, expected.length);
+    strictEqual(await combined.text(), expected);
+    strictEqual(new TextDecoder().decode(await combined.arrayBuffer()), expected);
+
+    // Slices spanning segment boundaries, and slices of slices.
+    const slice = combined.slice(1500, 6000);
+    strictEqual(await slice.text(), expected.slice(1500, 6000));
+    strictEqual(await slice.slice(1400, 3600).text(), expected.slice(2900, 5100));
+    strictEqual(await new Blob([slice, combined.slice(-10)]).text(),
+                expected.slice(1500, 6000) + expected.slice(-10));
+
+    // Reading a stream in small chunks crosses segment boundaries.
+    {
+      const reader = combined.stream().getReader({ mode: 'byob' });
+      let result = '';
+      for (;;) {
+        const { value, done } = await reader.read(new Uint8Array(777));
+        if (done) break;
+        result += new TextDecoder().decode(value);
+      }
+      strictEqual(result, expected);
+    }
+
+    // Bodies backed by the Blob are streamed without flattening it.
+    strictEqual(await new Response(combined).text(), expected);
+    strictEqual(await new Request('http://example.org', { method: 'POST', body: slice }).text(),
+                expected.slice(1500, 6000));
+
+    const file = new File([combined], 'file.txt');
+    strictEqual(await file.text(), expected);
+    const form = new FormData();
+    form.append('file', combined, 'renamed.txt');
+    strictEqual(await form.get('file').text(), expected);
+    strictEqual(form.get('file').name, 'renamed.txt');
+  }
+};
+
 export const testInspect = {
   async test(ctrl, env, ctx) {
     const blob = new Blob(["abc"], { type: "text/plain" });
@@ -346,6 +346,43 @@ export const utf16leFastTrack = {
   }
 };
 
+export const utf8FastTrack = {
+  test() {
+    // Whole, non-streaming inputs are decoded without going through ICU. The results must match
+    // those of the streaming path, which does.
+    const enc = new TextEncoder();
+    const inputs = [
+      'plain ascii which is long enough to span several blocks of input',
+      'caf\u00e9 cr\u00e8me br\u00fbl\u00e9e, all of which fits in latin-1',
+      '\u20ac and \u{1f63a} need two-byte strings',
+      '\ufeffa leading BOM',
+    ];
+    for (const str of inputs) {
+      const bytes = enc.encode(str);
+      const expected = decodeStreaming(new TextDecoder(), bytes);
+      strictEqual(new TextDecoder().decode(bytes), expected);
+      strictEqual(new TextDecoder('utf-8', { ignoreBOM: true }).decode(bytes), str);
+    }
+
+    // Invalid sequences are replaced, one U+FFFD per maximal subpart, or rejected when fatal.
+    const invalid = new Uint8Array([0x61, 0xf0, 0x9f, 0x98, 0x62, 0xed, 0xa0, 0x80, 0xff]);
+    strictEqual(new TextDecoder().decode(invalid), 'a\ufffdb\ufffd\ufffd\ufffd\ufffd');
+    strictEqual(decodeStreaming(new TextDecoder(), invalid),
+                'a\ufffdb\ufffd\ufffd\ufffd\ufffd');
+    throws(() => new TextDecoder('utf-8', { fatal: true }).decode(invalid));
+
+    // A sequence split across chunks is held back until the next one.
+    const dec = new TextDecoder();
+    strictEqual(dec.decode(new Uint8Array([0xc3, 0xa9, 0xe2, 0x82]), { stream: true }), '\u00e9');
+    strictEqual(dec.decode(new Uint8Array([0xac])), '\u20ac');
+
+    // Unpaired surrogates are encoded as U+FFFD.
+    deepStrictEqual(enc.encode('a\ud800b'), new Uint8Array([0x61, 0xef, 0xbf, 0xbd, 0x62]));
+    const buffer = new Uint8Array(5);
+    deepStrictEqual(enc.encodeInto('\u00e9\u20ac\u20ac', buffer), { read: 2, written: 5 });
+  }
+};
+
 export const allTheDecoders = {
   test() {
     [
@@ -150,6 +150,40 @@ qux-content
   }
 };
 
+export const formDataLargeFileRoundTrip = {
+  async test() {
+    // Binary content which contains near-misses of the delimiter and of the header terminator.
+    const content = new Uint8Array(256 * 1024);
+    for (let i = 0; i < content.length; i++) {
+      content[i] = (i * 31) & 0xff;
+    }
+    const nearMiss = new TextEncoder().encode('\r\n--boundar\n\r\n\r');
+    for (let i = 0; i < content.length - nearMiss.length; i += 4096) {
+      content.set(nearMiss, i);
+    }
+
+    const form = new FormData();
+    form.append('text', 'hello');
+    form.append('upload', new File([content], 'upload.bin', { type: 'application/x-test' }));
+    form.append('empty', new File([], 'empty.bin'));
+
+    const form2 = await new Request('https://example.org', {
+      method: 'POST',
+      body: form,
+    }).formData();
+
+    strictEqual(form2.get('text'), 'hello');
+    const upload = form2.get('upload');
+    strictEqual(upload.name, 'upload.bin');
+    strictEqual(upload.type, 'application/x-test');
+    deepStrictEqual(new Uint8Array(await upload.arrayBuffer()), content);
+    deepStrictEqual(new Uint8Array(await upload.slice(4096, 4100).arrayBuffer()),
+                    content.slice(4096, 4100));
+    strictEqual(form2.get('empty').size, 0);
+    strictEqual(form2.get('empty').type, 'application/octet-stream');
+  }
+};
+
 export const sendFilesInFormdata = {
   async test() {
     const INPUT = `--2a2a2a2a2a2a2a2a2a2a2a2a2a2a2a2a
@@ -76,15 +76,15 @@ export const evictionsHappen = {
       return { value: 'bar' };
     });
     // Nothing should be evicted at this point.
-    // Let's make foo our most recently accessed item.
-    strictEqual(await env.CACHE2.read('bar'), 'bar');
+    // Let's read foo, so that it gets a second chance when evicting.
     strictEqual(await env.CACHE2.read('foo'), 'foo');
     // Now, let's add a third item, baz.
     await env.CACHE2.read('baz', async (key) => {
       return { value: 'baz' };
     });
-    // At this point, 'bar' should have been evicted.
+    // At this point, 'bar' should have been evicted, since it was never read.
     strictEqual(await env.CACHE2.read('bar'), undefined);
+    strictEqual(await env.CACHE2.read('foo'), 'foo');
   }
 };
 
@@ -148,6 +148,32 @@ export const expiredEviction = {
   }
 };
 
+export const staleWhileRevalidate = {
+  async test(ctrl, env) {
+    strictEqual(await env.CACHE2.read('swr', async () => {
+      return { value: 'old', expiration: Date.now() + 100 };
+    }), 'old');
+    await scheduler.wait(200);
+
+    // The expired value is still returned, while the fallback refreshes it in the background.
+    let refreshStarted;
+    const refreshing = new Promise((resolve) => refreshStarted = resolve);
+    strictEqual(await env.CACHE2.read('swr', async () => {
+      refreshStarted();
+      return { value: 'new', expiration: Date.now() + 100 };
+    }, { staleWhileRevalidate: 10000 }), 'old');
+    await refreshing;
+    await scheduler.wait(10);
+    strictEqual(await env.CACHE2.read('swr'), 'new');
+
+    // Once the stale-while-revalidate period has passed, the fallback's result is awaited.
+    await scheduler.wait(200);
+    strictEqual(await env.CACHE2.read('swr', async () => {
+      return { value: 'newer' };
+    }, { staleWhileRevalidate: 50 }), 'newer');
+  }
+};
+
 export const fallbackThrows = {
   async test(ctrl, env) {
     try {
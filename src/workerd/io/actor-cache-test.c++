@@ -10,6 +10,7 @@
 #include "io-gate.h"
 #include <kj/thread.h>
 #include <kj/source-location.h>
+#include <kj/timer.h>
 #include <workerd/util/capnp-mock.h>
 
 namespace workerd {
@@ -197,6 +198,22 @@ struct ActorCacheTestOptions {
   size_t maxKeysPerRpc = 128;
   bool noCache = false;
   bool neverFlush = false;
+  uint shardCount = 1;
+};
+
+struct TxnFlush {
+  size_t batchCount;
+  size_t byteCount;
+  kj::Duration latency;
+};
+
+// Records the flushes reported to ActorCache::Hooks.
+struct TestHooks final: public ActorCache::Hooks {
+  kj::Vector<TxnFlush> txnFlushes;
+
+  void txnFlushCompleted(size_t batchCount, size_t byteCount, kj::Duration latency) override {
+    txnFlushes.add(TxnFlush { batchCount, byteCount, latency });
+  }
 };
 
 struct ActorCacheTest: public ActorCacheConvenienceWrappers {
@@ -206,6 +223,10 @@ struct ActorCacheTest: public ActorCacheConvenienceWrappers {
   kj::WaitScope ws;
   kj::Own<MockServer> mockStorage;
 
+  // Time only passes when a test advances this.
+  kj::TimerImpl clock;
+  TestHooks hooks;
+
   ActorCache::SharedLru lru;
   OutputGate gate;
   ActorCache cache;
@@ -219,10 +240,11 @@ struct ActorCacheTest: public ActorCacheConvenienceWrappers {
                  MockServer::make<rpc::ActorStorage::Stage>())
       : ActorCacheConvenienceWrappers(cache),
         ws(loop), mockStorage(kj::mv(mockPair.mock)),
+        clock(kj::origin<kj::TimePoint>()),
         lru({options.softLimit, options.hardLimit,
              options.staleTimeout, options.dirtyListByteLimit, options.maxKeysPerRpc,
-             options.noCache, options.neverFlush}),
-        cache(kj::mv(mockPair.client), lru, gate),
+             options.noCache, options.neverFlush, options.shardCount}),
+        cache(kj::mv(mockPair.client), lru, gate, hooks, clock),
         gateBrokenPromise(options.monitorOutputGate
             ? eagerlyReportExceptions(gate.onBroken())
             : kj::Promise<void>(kj::READY_NOW)) {}
@@ -700,6 +722,137 @@ KJ_TEST("ActorCache batching due to max storage RPC words") {
   mockTxn->expectDropped(ws);
 }
 
+// Puts values large enough that each makes a batch of a little over 200 KiB, so five fit in the
+// initial 1 MiB flush window. The values all share LARGE_VALUE's bytes.
+const kj::Array<const byte> LARGE_VALUE = kj::heapArray<const byte>(200 * 1024);
+
+void putLargeValues(ActorCacheTest& test, uint count) {
+  for (uint i = 0; i < count; ++i) {
+    test.cache.put(kj::str(i),
+        kj::Array<const byte>(LARGE_VALUE.begin(), LARGE_VALUE.size(),
+                              kj::NullArrayDisposer::instance),
+        ActorCache::WriteOptions());
+  }
+}
+
+KJ_TEST("ActorCache flush window limits the batches in flight") {
+  ActorCacheTest test({.hardLimit = 64 * 1024 * 1024, .maxKeysPerRpc = 1});
+  auto& ws = test.ws;
+  auto& mockStorage = test.mockStorage;
+
+  putLargeValues(test, 8);
+
+  auto mockTxn = mockStorage->expectCall("txn", ws).returnMock("transaction");
+  kj::Vector<MockServer::ExpectedCall> puts(8);
+  for (uint i = 0; i < 5; ++i) {
+    puts.add(mockTxn->expectCall("put", ws));
+  }
+  mockTxn->expectNoActivity(ws);
+
+  // A prompt response grows the window by 256 KiB, which makes room for two more batches.
+  kj::mv(puts[0]).thenReturn(CAPNP());
+  puts.add(mockTxn->expectCall("put", ws));
+  puts.add(mockTxn->expectCall("put", ws));
+  mockTxn->expectNoActivity(ws);
+
+  kj::mv(puts[1]).thenReturn(CAPNP());
+  puts.add(mockTxn->expectCall("put", ws));
+  auto commit = mockTxn->expectCall("commit", ws);
+  mockTxn->expectNoActivity(ws);
+
+  for (uint i = 2; i < 8; ++i) {
+    kj::mv(puts[i]).thenReturn(CAPNP());
+  }
+  kj::mv(commit).thenReturn(CAPNP());
+  mockTxn->expectDropped(ws);
+
+  KJ_ASSERT(test.hooks.txnFlushes.size() == 1);
+  KJ_EXPECT(test.hooks.txnFlushes[0].batchCount == 8);
+  KJ_EXPECT(test.hooks.txnFlushes[0].byteCount > 8 * 200 * 1024);
+  KJ_EXPECT(test.hooks.txnFlushes[0].latency == 0 * kj::SECONDS);
+}
+
+KJ_TEST("ActorCache flush window shrinks when storage is slow") {
+  ActorCacheTest test({.hardLimit = 64 * 1024 * 1024, .maxKeysPerRpc = 1});
+  auto& ws = test.ws;
+  auto& mockStorage = test.mockStorage;
+
+  putLargeValues(test, 8);
+
+  auto mockTxn = mockStorage->expectCall("txn", ws).returnMock("transaction");
+  kj::Vector<MockServer::ExpectedCall> puts(8);
+  for (uint i = 0; i < 5; ++i) {
+    puts.add(mockTxn->expectCall("put", ws));
+  }
+  mockTxn->expectNoActivity(ws);
+
+  // Each response slower than the target latency halves the window, down to 256 KiB, so nothing
+  // more is sent while any of the first batches are outstanding.
+  test.clock.advanceTo(test.clock.now() + 300 * kj::MILLISECONDS);
+  for (uint i = 0; i < 4; ++i) {
+    kj::mv(puts[i]).thenReturn(CAPNP());
+    mockTxn->expectNoActivity(ws);
+  }
+
+  // A window smaller than a batch still lets one batch through at a time.
+  kj::mv(puts[4]).thenReturn(CAPNP());
+  puts.add(mockTxn->expectCall("put", ws));
+  mockTxn->expectNoActivity(ws);
+
+  // Once storage responds promptly again, the window grows back.
+  kj::mv(puts[5]).thenReturn(CAPNP());
+  puts.add(mockTxn->expectCall("put", ws));
+  puts.add(mockTxn->expectCall("put", ws));
+  auto commit = mockTxn->expectCall("commit", ws);
+
+  kj::mv(puts[6]).thenReturn(CAPNP());
+  kj::mv(puts[7]).thenReturn(CAPNP());
+  kj::mv(commit).thenReturn(CAPNP());
+  mockTxn->expectDropped(ws);
+
+  KJ_ASSERT(test.hooks.txnFlushes.size() == 1);
+  KJ_EXPECT(test.hooks.txnFlushes[0].batchCount == 8);
+  KJ_EXPECT(test.hooks.txnFlushes[0].latency == 300 * kj::MILLISECONDS);
+}
+
+KJ_TEST("ActorCache counted delete spanning several flush windows") {
+  ActorCacheTest test({.hardLimit = 64 * 1024 * 1024, .maxKeysPerRpc = 1});
+  auto& ws = test.ws;
+  auto& mockStorage = test.mockStorage;
+
+  // Keys this large make each delete batch about as big as the puts in the tests above.
+  auto keys = kj::heapArrayBuilder<kj::String>(6);
+  for (char c = 'a'; c < 'g'; ++c) {
+    keys.add(kj::str(kj::repeat(c, 200 * 1024)));
+  }
+  auto promise = expectUncached(test.cache.delete_(keys.finish(), ActorCache::WriteOptions()));
+
+  auto mockTxn = mockStorage->expectCall("txn", ws).returnMock("transaction");
+  kj::Vector<MockServer::ExpectedCall> deletes(6);
+  for (uint i = 0; i < 5; ++i) {
+    deletes.add(mockTxn->expectCall("delete", ws));
+  }
+  mockTxn->expectNoActivity(ws);
+
+  kj::mv(deletes[0]).thenReturn(CAPNP(numDeleted = 1));
+  deletes.add(mockTxn->expectCall("delete", ws));
+  auto commit = mockTxn->expectCall("commit", ws);
+
+  // The count isn't known until every batch has reported back.
+  kj::StringPtr results[] = {
+    CAPNP(numDeleted = 0), CAPNP(numDeleted = 1), CAPNP(numDeleted = 1),
+    CAPNP(numDeleted = 0), CAPNP(numDeleted = 1)
+  };
+  for (uint i = 1; i < 6; ++i) {
+    KJ_EXPECT(!promise.poll(ws));
+    kj::mv(deletes[i]).thenReturn(results[i - 1]);
+  }
+  KJ_EXPECT(promise.wait(ws) == 4);
+
+  kj::mv(commit).thenReturn(CAPNP());
+  mockTxn->expectDropped(ws);
+}
+
 KJ_TEST("ActorCache deleteAll()") {
   ActorCacheTest test;
   auto& ws = test.ws;
@@ -1746,6 +1899,63 @@ KJ_TEST("ActorCache list() with limit") {
       kvs({{"bar", "456"}, {"baz", "789"}, {"foo", "123"}, {"garply", "54321"}}));
 }
 
+KJ_TEST("ActorCache list() reads ahead when paginating") {
+  ActorCacheTest test;
+  auto& ws = test.ws;
+  auto& mockStorage = test.mockStorage;
+
+  {
+    auto promise = expectUncached(test.list("a", "z", 2));
+
+    mockStorage->expectCall("list", ws)
+        .withParams(CAPNP(start = "a", end = "z", limit = 2), "stream"_kj)
+        .useCallback("stream", [&](MockClient stream) {
+      stream.call("values", CAPNP(list = [(key = "aa", value = "1"),
+                                          (key = "bb", value = "2")]))
+          .expectReturns(CAPNP(), ws);
+      stream.call("end", CAPNP()).expectReturns(CAPNP(), ws);
+    }).expectCanceled();
+
+    KJ_ASSERT(promise.wait(ws) == kvs({{"aa", "1"}, {"bb", "2"}}));
+  }
+
+  // The next page continues where the first left off, so we request an extra page.
+  {
+    auto promise = expectUncached(test.list("bc", "z", 2));
+
+    mockStorage->expectCall("list", ws)
+        .withParams(CAPNP(start = "bc", end = "z", limit = 4), "stream"_kj)
+        .useCallback("stream", [&](MockClient stream) {
+      stream.call("values", CAPNP(list = [(key = "cc", value = "3"),
+                                          (key = "dd", value = "4"),
+                                          (key = "ee", value = "5"),
+                                          (key = "ff", value = "6")]))
+          .expectReturns(CAPNP(), ws);
+      stream.call("end", CAPNP()).expectReturns(CAPNP(), ws);
+    }).expectCanceled();
+
+    KJ_ASSERT(promise.wait(ws) == kvs({{"cc", "3"}, {"dd", "4"}}));
+  }
+
+  // So the page after that comes from cache.
+  KJ_ASSERT(expectCached(test.list("de", "z", 2)) == kvs({{"ee", "5"}, {"ff", "6"}}));
+
+  // Listing a different range doesn't read ahead.
+  {
+    auto promise = expectUncached(test.list("ffa", "zz", 2));
+
+    mockStorage->expectCall("list", ws)
+        .withParams(CAPNP(start = "ffa", end = "zz", limit = 2), "stream"_kj)
+        .useCallback("stream", [&](MockClient stream) {
+      stream.call("values", CAPNP(list = [(key = "gg", value = "7")]))
+          .expectReturns(CAPNP(), ws);
+      stream.call("end", CAPNP()).expectReturns(CAPNP(), ws);
+    }).expectCanceled();
+
+    KJ_ASSERT(promise.wait(ws) == kvs({{"gg", "7"}}));
+  }
+}
+
 KJ_TEST("ActorCache list() with limit around negative entries") {
   // This checks for a bug where the initial scan through cache for list() applies the limit to
   // the total number of entries seen (positive or negative), when it really needs to apply only
@@ -3562,6 +3772,75 @@ KJ_TEST("ActorCache LRU purge ordering") {
   KJ_ASSERT(KJ_ASSERT_NONNULL(expectCached(test.get("yyy"))) == "bbb");
 }
 
+KJ_TEST("ActorCache LRU purge with multiple shards") {
+  // Two shards, so each shard's share of the soft limit is two entries.
+  ActorCacheTest test({.softLimit = 4 * ENTRY_SIZE, .shardCount = 2});
+  auto& ws = test.ws;
+  auto& mockStorage = test.mockStorage;
+
+  // A second cache sharing the same LRU is assigned the other shard.
+  auto mockPair = MockServer::make<rpc::ActorStorage::Stage>();
+  auto& mockStorage2 = mockPair.mock;
+  OutputGate gate2;
+  ActorCache cache2(kj::mv(mockPair.client), test.lru, gate2);
+  ActorCacheConvenienceWrappers test2(cache2);
+
+  {
+    auto promise = expectUncached(test.get("foo"));
+    mockStorage->expectCall("get", ws)
+        .withParams(CAPNP(key = "foo"))
+        .thenReturn(CAPNP(value = "123"));
+    KJ_ASSERT(KJ_ASSERT_NONNULL(promise.wait(ws)) == "123");
+  }
+  {
+    auto promise = expectUncached(test.get("bar"));
+    mockStorage->expectCall("get", ws)
+        .withParams(CAPNP(key = "bar"))
+        .thenReturn(CAPNP(value = "123"));
+    KJ_ASSERT(KJ_ASSERT_NONNULL(promise.wait(ws)) == "123");
+  }
+  {
+    auto promise = expectUncached(test.get("baz"));
+    mockStorage->expectCall("get", ws)
+        .withParams(CAPNP(key = "baz"))
+        .thenReturn(CAPNP(value = "123"));
+    KJ_ASSERT(KJ_ASSERT_NONNULL(promise.wait(ws)) == "123");
+  }
+
+  {
+    auto promise = expectUncached(test2.get("qux"));
+    mockStorage2->expectCall("get", ws)
+        .withParams(CAPNP(key = "qux"))
+        .thenReturn(CAPNP(value = "456"));
+    KJ_ASSERT(KJ_ASSERT_NONNULL(promise.wait(ws)) == "456");
+  }
+  {
+    auto promise = expectUncached(test2.get("xxx"));
+    mockStorage2->expectCall("get", ws)
+        .withParams(CAPNP(key = "xxx"))
+        .thenReturn(CAPNP(value = "456"));
+    KJ_ASSERT(KJ_ASSERT_NONNULL(promise.wait(ws)) == "456");
+  }
+
+  // We're over the soft limit, but the second shard is within its share, so it didn't evict
+  // anything, and it can't evict from the first.
+  KJ_ASSERT(KJ_ASSERT_NONNULL(expectCached(test.get("foo"))) == "123");
+  KJ_ASSERT(KJ_ASSERT_NONNULL(expectCached(test.get("bar"))) == "123");
+  KJ_ASSERT(KJ_ASSERT_NONNULL(expectCached(test.get("baz"))) == "123");
+  KJ_ASSERT(KJ_ASSERT_NONNULL(expectCached(test2.get("qux"))) == "456");
+  KJ_ASSERT(KJ_ASSERT_NONNULL(expectCached(test2.get("xxx"))) == "456");
+
+  // evictStale() trims the largest shard, which is the first one, evicting its LRU entry.
+  KJ_ASSERT(cache2.evictStale(kj::UNIX_EPOCH) == kj::none);
+  KJ_ASSERT(KJ_ASSERT_NONNULL(expectCached(test.get("bar"))) == "123");
+  KJ_ASSERT(KJ_ASSERT_NONNULL(expectCached(test.get("baz"))) == "123");
+  KJ_ASSERT(KJ_ASSERT_NONNULL(expectCached(test2.get("qux"))) == "456");
+  KJ_ASSERT(KJ_ASSERT_NONNULL(expectCached(test2.get("xxx"))) == "456");
+  mockStorage2->expectNoActivity(ws);
+
+  (void)expectUncached(test.get("foo"));
+}
+
 KJ_TEST("ActorCache LRU purge larger") {
   ActorCacheTest test({.softLimit = 32 * ENTRY_SIZE});
   auto& ws = test.ws;
@@ -26,13 +26,13 @@ static constexpr size_t MAX_ACTOR_STORAGE_RPC_WORDS = (16u << 20) / sizeof(capnp
 ActorCache::Hooks ActorCache::Hooks::DEFAULT;
 
 ActorCache::ActorCache(rpc::ActorStorage::Stage::Client storage, const SharedLru& lru,
-                       OutputGate& gate, Hooks& hooks)
-    : storage(kj::mv(storage)), lru(lru), gate(gate), hooks(hooks), clock(kj::systemPreciseMonotonicClock()),
-      currentValues(lru.cleanList.lockExclusive()) {}
+                       OutputGate& gate, Hooks& hooks, const kj::MonotonicClock& clock)
+    : storage(kj::mv(storage)), lru(lru), lruShard(lru.assignShard()), gate(gate), hooks(hooks),
+      clock(clock), currentValues(lruShard.cleanList.lockExclusive()) {}
 
 ActorCache::~ActorCache() noexcept(false) {
   // Need to remove all entries from any lists they might be in.
-  auto lock = lru.cleanList.lockExclusive();
+  auto lock = lruShard.cleanList.lockExclusive();
   clear(lock);
 }
 
@@ -54,7 +54,7 @@ ActorCache::Entry::Entry(ActorCache& cache, Key key, Value value)
     : maybeCache(cache), key(kj::mv(key)), value(kj::mv(value)),
       valueStatus(EntryValueStatus::PRESENT) {
   KJ_IF_SOME(c, maybeCache) {
-    c.lru.size.fetch_add(size(), std::memory_order_relaxed);
+    c.lruShard.size.fetch_add(size(), std::memory_order_relaxed);
   }
 }
 
@@ -64,7 +64,7 @@ ActorCache::Entry::Entry(ActorCache& cache, Key key, EntryValueStatus valueStatu
     valueStatus != EntryValueStatus::PRESENT,
     "Pass a serialized empty v8 value if you want a present but empty entry!");
   KJ_IF_SOME(c, maybeCache) {
-    c.lru.size.fetch_add(size(), std::memory_order_relaxed);
+    c.lruShard.size.fetch_add(size(), std::memory_order_relaxed);
   }
 }
 
@@ -77,13 +77,13 @@ ActorCache::Entry::~Entry() noexcept(false) {
   KJ_IF_SOME(c, maybeCache) {
     size_t size = this->size();
 
-    size_t before = c.lru.size.fetch_sub(size, std::memory_order_relaxed);
+    size_t before = c.lruShard.size.fetch_sub(size, std::memory_order_relaxed);
 
     if (KJ_UNLIKELY(before < size)) {
       // underflow -- shouldn't happen, but just in case, let's fix
       KJ_LOG(ERROR, "SharedLru size tracking inconsistency detected",
             before, size, kj::getStackTrace());
-      c.lru.size.store(0, std::memory_order_relaxed);
+      c.lruShard.size.store(0, std::memory_order_relaxed);
     }
 
     KJ_REQUIRE(!link.isLinked(),
@@ -91,17 +91,32 @@ ActorCache::Entry::~Entry() noexcept(false) {
   }
 }
 
-ActorCache::SharedLru::SharedLru(Options options): options(options) {}
+ActorCache::SharedLru::SharedLru(Options options)
+    : options(options), shards(kj::heapArray<Shard>(kj::max(options.shardCount, 1u))) {}
 
 ActorCache::SharedLru::~SharedLru() noexcept(false) {
-  KJ_REQUIRE(cleanList.getWithoutLock().empty(),
-      "ActorCache::SharedLru destroyed while an ActorCache still exists?");
-  if (size.load(std::memory_order_relaxed) != 0) {
+  for (auto& shard: shards) {
+    KJ_REQUIRE(shard.cleanList.getWithoutLock().empty(),
+        "ActorCache::SharedLru destroyed while an ActorCache still exists?");
+  }
+  if (currentSize() != 0) {
     KJ_LOG(ERROR, "SharedLru destroyed while cache entries still exist, "
         "this will lead to use-after-free");
   }
 }
 
+size_t ActorCache::SharedLru::currentSize() const {
+  size_t total = 0;
+  for (auto& shard: shards) {
+    total += shard.size.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+const ActorCache::SharedLru::Shard& ActorCache::SharedLru::assignShard() const {
+  return shards[nextShard.fetch_add(1, std::memory_order_relaxed) % shards.size()];
+}
+
 kj::Maybe<kj::Promise<void>> ActorCache::evictStale(kj::Date now) {
   int64_t nowNs = (now - kj::UNIX_EPOCH) / kj::NANOSECONDS;
   int64_t oldValue = lru.nextStaleCheckNs.load(std::memory_order_relaxed);
@@ -109,19 +124,26 @@ kj::Maybe<kj::Promise<void>> ActorCache::evictStale(kj::Date now) {
   if (nowNs >= oldValue) {
     int64_t newValue = nowNs + lru.options.staleTimeout / kj::NANOSECONDS;
     if (lru.nextStaleCheckNs.compare_exchange_strong(oldValue, newValue)) {
-      auto lock = lru.cleanList.lockExclusive();
-      for (auto& entry: *lock) {
-        if (entry.isStale) {
-          auto& cache = KJ_ASSERT_NONNULL(entry.maybeCache);
-          cache.removeEntry(lock, entry);
-          cache.evictEntry(lock, entry);
-        } else {
-          entry.isStale = true;
+      for (auto& shard: lru.shards) {
+        auto lock = shard.cleanList.lockExclusive();
+        for (auto& entry: *lock) {
+          if (entry.isStale) {
+            auto& cache = KJ_ASSERT_NONNULL(entry.maybeCache);
+            cache.removeEntry(lock, entry);
+            cache.evictEntry(lock, entry);
+          } else {
+            entry.isStale = true;
+          }
         }
       }
     }
   }
 
+  if (lru.shards.size() > 1) {
+    // With a single shard, evictIfNeeded() already keeps the whole cache within the limits.
+    lru.evictFromLargestShard();
+  }
+
   // Apply backpressure if we're over the soft limit.
   return getBackpressure();
 }
@@ -208,7 +230,7 @@ void ActorCache::requireNotTerminal() {
 }
 
 void ActorCache::evictOrOomIfNeeded(Lock& lock) {
-  if (lru.evictIfNeeded(lock)) {
+  if (lru.evictIfNeeded(lruShard, lock)) {
     auto exception = KJ_EXCEPTION(OVERLOADED,
         "broken.exceededMemory; jsg.Error: Durable Object's isolate exceeded its memory limit due to overflowing the "
         "storage cache. This could be due to writing too many values to storage without stopping "
@@ -241,18 +263,26 @@ void ActorCache::evictOrOomIfNeeded(Lock& lock) {
   }
 }
 
-bool ActorCache::SharedLru::evictIfNeeded(Lock& lock) const {
+bool ActorCache::SharedLru::evictIfNeeded(const Shard& shard, Lock& lock) const {
   for (;;) {
-    size_t current = size.load(std::memory_order_relaxed);
+    size_t current = currentSize();
     if (current <= options.softLimit) {
       // All good.
       return false;
     }
 
+    size_t shardSize = shard.size.load(std::memory_order_relaxed);
+    if (shardSize <= options.softLimit / shards.size()) {
+      // This shard is within its share of the limit, so the excess is in other shards, which we
+      // can't evict from without their locks.
+      return false;
+    }
+
     // We're over the limit, let's evict stuff.
     if (lock->empty()) {
-      // Nothing to evict.
-      return current > options.hardLimit;
+      // Nothing to evict. Only fail if this shard is also holding more than its share of the hard
+      // limit, so that one shard's caches don't get killed for memory held by another's.
+      return current > options.hardLimit && shardSize > options.hardLimit / shards.size();
     }
 
     Entry& entry = lock->front();
@@ -262,6 +292,23 @@ bool ActorCache::SharedLru::evictIfNeeded(Lock& lock) const {
   }
 }
 
+void ActorCache::SharedLru::evictFromLargestShard() const {
+  if (currentSize() <= options.softLimit) return;
+
+  const Shard* largest = &shards[0];
+  for (auto& shard: shards.slice(1, shards.size())) {
+    if (shard.size.load(std::memory_order_relaxed) >
+        largest->size.load(std::memory_order_relaxed)) {
+      largest = &shard;
+    }
+  }
+
+  auto lock = largest->cleanList.lockExclusive();
+  // Since this is an opportunistic pass there's nothing to fail if the shard is still over the
+  // hard limit; that will be detected by the next operation on one of its caches.
+  (void)evictIfNeeded(*largest, lock);
+}
+
 void ActorCache::touchEntry(Lock& lock, Entry& entry, const ReadOptions& options) {
   if (!options.noCache) {
     if (!entry.isDirty()) {
@@ -310,7 +357,7 @@ void ActorCache::evictEntry(Lock& lock, Entry& entry) {
 }
 
 void ActorCache::verifyConsistencyForTest() {
-  auto lock = lru.cleanList.lockExclusive();
+  auto lock = lruShard.cleanList.lockExclusive();
   currentValues.get(lock).verify();  // verify the table's BTreeIndex
   bool prevGapIsKnownEmpty = false;
   kj::Maybe<kj::StringPtr> prevKey = kj::none;
@@ -353,7 +400,7 @@ kj::OneOf<kj::Maybe<ActorCache::Value>, kj::Promise<kj::Maybe<ActorCache::Value>
   options.noCache = options.noCache || lru.options.noCache;
   requireNotTerminal();
 
-  auto lock = lru.cleanList.lockExclusive();
+  auto lock = lruShard.cleanList.lockExclusive();
   auto entry = findInCache(lock, kj::mv(key), options);
   switch (entry->valueStatus) {
     case EntryValueStatus::PRESENT:
@@ -380,7 +427,7 @@ auto ActorCache::getImpl(kj::Own<Entry> entry, ReadOptions options)
   if (response.hasValue()) {
     value = response.getValue();
   }
-  auto lock = lru.cleanList.lockExclusive();
+  auto lock = lruShard.cleanList.lockExclusive();
   auto newEntry = addReadResultToCache(lock, cloneKey(entry->key), value, options);
   evictOrOomIfNeeded(lock);
   co_return newEntry->getValue();
@@ -404,7 +451,7 @@ public:
       return KJ_EXCEPTION(DISCONNECTED, "canceled");
     }
 
-    auto lock = cache.lru.cleanList.lockExclusive();
+    auto lock = cache.lruShard.cleanList.lockExclusive();
     auto params = context.getParams();
     kj::String prevKey;
     for (auto kv: params.getList()) {
@@ -454,7 +501,7 @@ public:
 
     if (nextExpectedKey < keysToFetch.end()) {
       // Some trailing keys weren't seen, better mark them as not present.
-      auto lock = cache.lru.cleanList.lockExclusive();
+      auto lock = cache.lruShard.cleanList.lockExclusive();
       while (nextExpectedKey < keysToFetch.end()) {
         cache.addReadResultToCache(lock, kj::mv(*nextExpectedKey++), kj::none, options);
       }
@@ -525,7 +572,7 @@ kj::OneOf<ActorCache::GetResultList, kj::Promise<ActorCache::GetResultList>>
   capnp::MessageSize sizeHint { 4, 1 };
 
   {
-    auto lock = lru.cleanList.lockExclusive();
+    auto lock = lruShard.cleanList.lockExclusive();
     for (auto& key: keys) {
       auto entry = findInCache(lock, key, options);
       switch(entry->valueStatus) {
@@ -709,7 +756,7 @@ public:
     }
 
     {
-      auto lock = cache.lru.cleanList.lockExclusive();
+      auto lock = cache.lruShard.cleanList.lockExclusive();
       auto list = context.getParams().getList();
 
       bool insertedAny = false;
@@ -767,7 +814,7 @@ public:
 
     // Mark the rest of the range as empty.
     {
-      auto lock = cache.lru.cleanList.lockExclusive();
+      auto lock = cache.lruShard.cleanList.lockExclusive();
 
       if (!beginKeyIsKnown) {
         // We received no results at all, so the start of the list is definitely not in storage.
@@ -850,6 +897,52 @@ public:
   ReadOptions options;
 };
 
+uint ActorCache::updateListReadAhead(kj::Maybe<ListPagination>& last, bool reverse,
+    const Key& beginKey, const kj::Maybe<Key>& endKey, uint limit, const ReadOptions& options) {
+  uint sequentialPages = 0;
+  KJ_IF_SOME(l, last) {
+    // Forward pagination keeps the end of the range and moves the beginning forward past the
+    // last key seen, while reverse pagination keeps the beginning and moves the end backwards.
+    bool continuesLast;
+    if (reverse) {
+      continuesLast = beginKey == l.beginKey && endKey != kj::none &&
+          KJ_ASSERT_NONNULL(endKey) < l.endKey;
+    } else {
+      bool sameEnd;
+      KJ_IF_SOME(e, endKey) {
+        sameEnd = e == l.endKey;
+      } else {
+        sameEnd = l.endKey == kj::none;
+      }
+      continuesLast = sameEnd && l.beginKey < beginKey;
+    }
+    if (continuesLast) {
+      sequentialPages = l.sequentialPages + 1;
+    }
+  }
+
+  last = ListPagination {
+    .beginKey = cloneKey(beginKey),
+    .endKey = endKey.map([](const Key& k) { return cloneKey(k); }),
+    .sequentialPages = sequentialPages,
+  };
+
+  if (sequentialPages == 0 || limit >= MAX_LIST_READ_AHEAD_KEYS || options.noCache) {
+    // Not paginating, or the pages are already large enough that another round trip doesn't
+    // matter, or the results won't be cached anyway.
+    return 0;
+  }
+
+  if (lru.currentSize() > lru.options.softLimit / 2) {
+    // Prefetched entries would just push other, possibly more useful, entries out of the cache.
+    return 0;
+  }
+
+  // Read further ahead the longer the pagination goes on.
+  return kj::min(limit * kj::min(sequentialPages, MAX_LIST_READ_AHEAD_PAGES),
+                 MAX_LIST_READ_AHEAD_KEYS);
+}
+
 kj::OneOf<ActorCache::GetResultList, kj::Promise<ActorCache::GetResultList>>
     ActorCache::list(Key beginKey, kj::Maybe<Key> endKey,
                      kj::Maybe<uint> limit, ReadOptions options) {
@@ -870,12 +963,18 @@ kj::OneOf<ActorCache::GetResultList, kj::Promise<ActorCache::GetResultList>>
     return ActorCache::GetResultList(kj::mv(cachedEntries), {}, GetResultList::FORWARD);
   }
 
+  // If the app is paginating through the range, we'll ask storage for this many keys beyond
+  // `limit` so that the next pages can be served from cache.
+  uint readAhead = limit.map([&](uint l) {
+    return updateListReadAhead(lastForwardList, false, beginKey, endKey, l, options);
+  }).orDefault(0);
+
   uint limitAdjustment = 0;
   // When requesting to storage, we need to adjust the limit to increase it by the number of cached
   // negative entries in the range, since each of those negative entries could potentially negate a
   // positive entry read from disk.
 
-  auto lock = lru.cleanList.lockExclusive();
+  auto lock = lruShard.cleanList.lockExclusive();
   auto& map = currentValues.get(lock);
   auto ordered = map.ordered();
 
@@ -984,7 +1083,7 @@ kj::OneOf<ActorCache::GetResultList, kj::Promise<ActorCache::GetResultList>>
   }
 
   auto adjustedLimit = limit.map([&](uint orig) {
-    return orig + limitAdjustment - knownPrefixSize;
+    return orig + limitAdjustment - knownPrefixSize + readAhead;
   });
 
   auto paf = kj::newPromiseAndFulfiller<GetResultList>();
@@ -1078,7 +1177,7 @@ public:
     }
 
     {
-      auto lock = cache.lru.cleanList.lockExclusive();
+      auto lock = cache.lruShard.cleanList.lockExclusive();
       auto list = context.getParams().getList();
 
       bool insertedAny = false;
@@ -1126,7 +1225,7 @@ public:
 
     // Mark the rest of the range as empty.
     {
-      auto lock = cache.lru.cleanList.lockExclusive();
+      auto lock = cache.lruShard.cleanList.lockExclusive();
 
       if (fetchedEntries.size() < adjustedLimit.orDefault(kj::maxValue)) {
         // We didn't reach the limit, so the rest of the range must be empty.
@@ -1209,12 +1308,18 @@ kj::OneOf<ActorCache::GetResultList, kj::Promise<ActorCache::GetResultList>>
     return ActorCache::GetResultList(kj::mv(cachedEntries), {}, GetResultList::REVERSE);
   }
 
+  // If the app is paginating backwards through the range, we'll ask storage for this many keys
+  // beyond `limit` so that the next pages can be served from cache.
+  uint readAhead = limit.map([&](uint l) {
+    return updateListReadAhead(lastReverseList, true, beginKey, endKey, l, options);
+  }).orDefault(0);
+
   uint limitAdjustment = 0;
   // When requesting to storage, we need to adjust the limit to increase it by the number of cached
   // negative entries in the range, since each of those negative entries could potentially negate a
   // positive entry read from disk.
 
-  auto lock = lru.cleanList.lockExclusive();
+  auto lock = lruShard.cleanList.lockExclusive();
   auto& map = currentValues.get(lock);
   auto ordered = map.ordered();
 
@@ -1321,7 +1426,7 @@ kj::OneOf<ActorCache::GetResultList, kj::Promise<ActorCache::GetResultList>>
   }
 
   auto adjustedLimit = limit.map([&](uint orig) {
-    return orig + limitAdjustment - knownSuffixSize;
+    return orig + limitAdjustment - knownSuffixSize + readAhead;
   });
 
   auto paf = kj::newPromiseAndFulfiller<GetResultList>();
@@ -1781,7 +1886,7 @@ kj::Maybe<kj::Promise<void>> ActorCache::put(Key key, Value value, WriteOptions
   options.noCache = options.noCache || lru.options.noCache;
   requireNotTerminal();
   {
-    auto lock = lru.cleanList.lockExclusive();
+    auto lock = lruShard.cleanList.lockExclusive();
     kj::Maybe<CountedDelete> maybeCountedDelete;
     auto entry = kj::atomicRefcounted<Entry>(*this, kj::mv(key), kj::mv(value));
     putImpl(lock, kj::mv(entry), options, maybeCountedDelete);
@@ -1794,7 +1899,7 @@ kj::Maybe<kj::Promise<void>> ActorCache::put(kj::Array<KeyValuePair> pairs, Writ
   options.noCache = options.noCache || lru.options.noCache;
   requireNotTerminal();
   {
-    auto lock = lru.cleanList.lockExclusive();
+    auto lock = lruShard.cleanList.lockExclusive();
     for (auto& pair: pairs) {
       kj::Maybe<CountedDelete> maybeCountedDelete;
       auto entry = kj::atomicRefcounted<Entry>(*this, kj::mv(pair.key), kj::mv(pair.value));
@@ -1842,7 +1947,7 @@ kj::OneOf<bool, kj::Promise<bool>> ActorCache::delete_(Key key, WriteOptions opt
 
   auto countedDelete = kj::refcounted<CountedDelete>();
   {
-    auto lock = lru.cleanList.lockExclusive();
+    auto lock = lruShard.cleanList.lockExclusive();
     auto entry = kj::atomicRefcounted<Entry>(*this, kj::mv(key), EntryValueStatus::ABSENT);
     putImpl(lock, kj::mv(entry), options, *countedDelete);
     evictOrOomIfNeeded(lock);
@@ -1880,7 +1985,7 @@ kj::OneOf<uint, kj::Promise<uint>> ActorCache::delete_(kj::Array<Key> keys, Writ
 
   auto countedDelete = kj::refcounted<CountedDelete>();
   {
-    auto lock = lru.cleanList.lockExclusive();
+    auto lock = lruShard.cleanList.lockExclusive();
     for (auto& key: keys) {
       auto entry = kj::atomicRefcounted<Entry>(*this, kj::mv(key), EntryValueStatus::ABSENT);
       putImpl(lock, kj::mv(entry), options, *countedDelete);
@@ -1933,7 +2038,7 @@ ActorCache::DeleteAllResults ActorCache::deleteAll(WriteOptions options) {
   kj::Promise<uint> result { (uint)0 };
 
   {
-    auto lock = lru.cleanList.lockExclusive();
+    auto lock = lruShard.cleanList.lockExclusive();
     auto& map = currentValues.get(lock);
 
     kj::Vector<kj::Own<Entry>> deletedDirty;
@@ -2220,14 +2325,6 @@ constexpr size_t bytesToWordsRoundUp(size_t bytes) {
   return (bytes + sizeof(capnp::word) - 1) / sizeof(capnp::word);
 }
 
-namespace {
-using RpcPutRequest = capnp::Request<rpc::ActorStorage::Operations::PutParams,
-    rpc::ActorStorage::Operations::PutResults>;
-
-using RpcDeleteRequest = capnp::Request<rpc::ActorStorage::Operations::DeleteParams,
-    rpc::ActorStorage::Operations::DeleteResults>;
-}
-
 kj::Promise<void> ActorCache::flushImpl(uint retryCount) {
   KJ_IF_SOME(e, maybeTerminalException) {
     // If we have a terminal exception, throw here to break the output gate and prevent any calls
@@ -2247,7 +2344,7 @@ kj::Promise<void> ActorCache::flushImpl(uint retryCount) {
   // Perhaps this would be possible to fix by adding more complex logic. But, it doesn't seem
   // like a big deal to require all flushes to be complete flushes.
 
-  // We don't take a lock on `lru.cleanList` here, because we don't need it. We only access
+  // We don't take a lock on `lruShard.cleanList` here, because we don't need it. We only access
   // `dirtyList`, which is only ever accessed within the actor's thread, so it's safe. We know
   // that `SharedLru` will only ever mess with CLEAN entries, which we don't look at here.
 
@@ -2268,11 +2365,8 @@ kj::Promise<void> ActorCache::flushImpl(uint retryCount) {
   // muted deletes, we go ahead and construct batches of no more than 128 keys. They all end up
   // being part of the same transaction in the end, though.
   //
-  // TODO(perf): Currently we send all the batches at the same time. If the batches are large,
-  //   it could be worth spacing them out a bit so we don't saturate the connection. However, we
-  //   still need to make sure that the whole transaction represents a consistent snapshot in time,
-  //   so getting this right, without making a copy of everything upfront, could get complicated.
-  //   Punting for now.
+  // When there are many batches, flushImplUsingTxn() doesn't send them all at once, but paces
+  // them so that only a limited number of bytes are in flight at a time.
 
   PutFlush putFlush;
   MutedDeleteFlush mutedDeleteFlush;
@@ -2464,7 +2558,7 @@ kj::Promise<void> ActorCache::flushImpl(uint retryCount) {
       return flushImplDeleteAll();
     }
 
-    auto lock = lru.cleanList.lockExclusive();
+    auto lock = lruShard.cleanList.lockExclusive();
 
     KJ_IF_SOME(r, requestedDeleteAll) {
       // It would appear that all dirty entries were moved into `requestedDeleteAll` during the
@@ -2702,70 +2796,60 @@ kj::Promise<void> ActorCache::flushImplUsingTxn(
 
   struct RpcCountedDelete {
     kj::Own<CountedDelete> countedDelete;
-    kj::Array<RpcDeleteRequest> rpcDeletes;
+    size_t batchesOutstanding;
+  };
+
+  // A batch of keys to write in one RPC. Rather than building all of the RPC messages upfront,
+  // which for a large flush would double the memory used by the dirty data, we hold strong
+  // references to the entries and only build each message just before it is sent. An entry's key
+  // and value never change, so this captures the same consistent snapshot even if the entries
+  // are overwritten while we wait.
+  struct TxnBatch {
+    kj::Array<kj::Own<Entry>> entries;
+    size_t wordCount;
+    bool isPut;
+    kj::Maybe<RpcCountedDelete&> countedDelete;
   };
+
   auto rpcCountedDeletes = kj::heapArrayBuilder<RpcCountedDelete>(countedDeleteFlushes.size());
-  auto rpcMutedDeletes = kj::heapArrayBuilder<RpcDeleteRequest>(mutedDeleteFlush.batches.size());
-  auto rpcPuts = kj::heapArrayBuilder<RpcPutRequest>(putFlush.batches.size());
+  kj::Vector<TxnBatch> txnBatches;
 
-  for (auto& flush: countedDeleteFlushes) {
-    auto entryIt = flush.entries.begin();
-    kj::Vector<RpcDeleteRequest> rpcDeletes;
-    for (auto& batch: flush.batches) {
+  auto addBatches = [&](kj::ArrayPtr<Entry*> entries, kj::ArrayPtr<FlushBatch> batches,
+                        bool isPut, kj::Maybe<RpcCountedDelete&> countedDelete) {
+    auto entryIt = entries.begin();
+    for (auto& batch: batches) {
       KJ_ASSERT(batch.wordCount < MAX_ACTOR_STORAGE_RPC_WORDS);
+      KJ_ASSERT(entryIt + batch.pairCount <= entries.end());
 
-      auto request = txn.deleteRequest(capnp::MessageSize { 4 + batch.wordCount, 0 });
-      auto listBuilder = request.initKeys(batch.pairCount);
-      for (size_t i = 0; i < batch.pairCount; ++i) {
-        KJ_ASSERT(entryIt != flush.entries.end());
-        auto& entry = **(entryIt++);
-        listBuilder.set(i, entry.key.asBytes());
-      }
+      auto batchEntries = KJ_MAP(entry, kj::arrayPtr(entryIt, batch.pairCount)) {
+        return kj::atomicAddRef(*entry);
+      };
+      entryIt += batch.pairCount;
 
-      rpcDeletes.add(kj::mv(request));
+      txnBatches.add(TxnBatch{
+        .entries = kj::mv(batchEntries),
+        .wordCount = batch.wordCount,
+        .isPut = isPut,
+        .countedDelete = countedDelete,
+      });
     }
-    rpcCountedDeletes.add(RpcCountedDelete{
+    KJ_ASSERT(entryIt == entries.end());
+  };
+
+  // It's important that counted deletes are sent first since they can overlap with puts.
+  // Specifically this can happen if someone does a delete() immediately followed by a put() on the
+  // same key. These two writes may have been coalesced into a single flush. Unfortunately, we
+  // can't just skip the delete because we still need to count it. So we issue a delete, followed
+  // by a put, in the same transaction.
+  for (auto& flush: countedDeleteFlushes) {
+    auto& rpcCountedDelete = rpcCountedDeletes.add(RpcCountedDelete{
       .countedDelete = kj::mv(flush.countedDelete),
-      .rpcDeletes = rpcDeletes.releaseAsArray(),
+      .batchesOutstanding = flush.batches.size(),
     });
-    KJ_ASSERT(entryIt == flush.entries.end());
-  }
-
-  {
-    auto entryIt = mutedDeleteFlush.entries.begin();
-    for (auto& batch: mutedDeleteFlush.batches) {
-      KJ_ASSERT(batch.wordCount < MAX_ACTOR_STORAGE_RPC_WORDS);
-
-      auto request = txn.deleteRequest(capnp::MessageSize { 4 + batch.wordCount, 0 });
-      auto listBuilder = request.initKeys(batch.pairCount);
-      for (size_t i = 0; i < batch.pairCount; ++i) {
-        KJ_ASSERT(entryIt != mutedDeleteFlush.entries.end());
-        auto& entry = **(entryIt++);
-        listBuilder.set(i, entry.key.asBytes());
-      }
-      rpcMutedDeletes.add(kj::mv(request));
-    }
-    KJ_ASSERT(entryIt == mutedDeleteFlush.entries.end());
-  }
-
-  {
-    auto entryIt = putFlush.entries.begin();
-    for (auto& batch: putFlush.batches) {
-      KJ_ASSERT(batch.wordCount < MAX_ACTOR_STORAGE_RPC_WORDS);
-
-      auto request = txn.putRequest(capnp::MessageSize { 4 + batch.wordCount, 0 });
-      auto listBuilder = request.initEntries(batch.pairCount);
-      for (auto kv : listBuilder) {
-        KJ_ASSERT(entryIt != putFlush.entries.end());
-        auto& entry = **(entryIt++);
-        auto v = KJ_ASSERT_NONNULL(entry.getValuePtr());
-        kv.setKey(entry.key.asBytes());
-        kv.setValue(v);
-      }
-      rpcPuts.add(kj::mv(request));
-    }
-    KJ_ASSERT(entryIt == putFlush.entries.end());
+    addBatches(flush.entries, flush.batches, false, rpcCountedDelete);
   }
+  addBatches(mutedDeleteFlush.entries, mutedDeleteFlush.batches, false, kj::none);
+  addBatches(putFlush.entries, putFlush.batches, true, kj::none);
 
   // We're done with the batching instructions, free them before we go async.
   putFlush.entries.clear();
@@ -2787,66 +2871,107 @@ kj::Promise<void> ActorCache::flushImplUsingTxn(
   // avoid taking any internal DB latches that may block a read (which could in turn block
   // waitForPastReads).
   //
-  // But it is important that we created our put/delete batches prior to waiting on past reads,
+  // But it is important that we collected our put/delete batches prior to waiting on past reads,
   // because if we were to wait before doing so then more new writes might sneak into the flush, and
   // if we were to include those new writes we'd potentially have to wait on past reads again.
-  // Similarly, we have to copy the data into our RPC structs prior to waiting instead of after to
+  // Similarly, we have to take references to the entries prior to waiting instead of after to
   // avoid the data changing out from under us while we wait.
   co_await waitForPastReads();
 
-  // Send all the RPCs. It's important that counted deletes are sent first since they can overlap
-  // with puts. Specifically this can happen if someone does a delete() immediately followed by a
-  // put() on the same key. These two writes may have been coalesced into a single flush.
-  // Unfortunately, we can't just skip the delete because we still need to count it. So we issue
-  // a delete, followed by a put, in the same transaction.
-  // The constant extra 2 promises are those added outside of the rpc batches, currently one
-  // to work around a bug in capnp::autoreconnect, and one to actually commit the flush txn
-  // A 3rd promise may be added to write the alarm time if necessary.
-  auto promises = kj::heapArrayBuilder<kj::Promise<void>>(
-      rpcPuts.size() + rpcMutedDeletes.size() + rpcCountedDeletes.size()
-      + 2 + !maybeAlarmChange.is<CleanAlarm>());
+  auto sendBatch = [&txn](TxnBatch& batch) -> kj::Promise<void> {
+    if (batch.isPut) {
+      auto request = txn.putRequest(capnp::MessageSize { 4 + batch.wordCount, 0 });
+      auto listBuilder = request.initEntries(batch.entries.size());
+      for (auto i: kj::indices(batch.entries)) {
+        auto& entry = *batch.entries[i];
+        listBuilder[i].setKey(entry.key.asBytes());
+        listBuilder[i].setValue(KJ_ASSERT_NONNULL(entry.getValuePtr()));
+      }
+      return request.send().ignoreResult();
+    }
+
+    auto request = txn.deleteRequest(capnp::MessageSize { 4 + batch.wordCount, 0 });
+    auto listBuilder = request.initKeys(batch.entries.size());
+    for (auto i: kj::indices(batch.entries)) {
+      listBuilder.set(i, batch.entries[i]->key.asBytes());
+    }
 
-  auto joinCountedDelete = [](RpcCountedDelete& rpcCountedDelete) -> kj::Promise<void> {
-    auto promises = KJ_MAP(request, rpcCountedDelete.rpcDeletes) {
+    KJ_IF_SOME(rpcCountedDelete, batch.countedDelete) {
       return request.send().then(
-          [](capnp::Response<rpc::ActorStorage::Operations::DeleteResults>&& response) mutable
-          -> uint {
-        return response.getNumDeleted();
+          [&rpcCountedDelete](capnp::Response<rpc::ActorStorage::Operations::DeleteResults>&&
+              response) {
+        // Reuse `countDeleted` since it's already in a state object anyway.
+        auto& countedDelete = *rpcCountedDelete.countedDelete;
+        countedDelete.countDeleted += response.getNumDeleted();
+        if (--rpcCountedDelete.batchesOutstanding == 0 &&
+            countedDelete.resultFulfiller->isWaiting()) {
+          // Note that it's OK to trust the delete count even if the transaction ultimately gets
+          // rolled back, because:
+          // - We know that nothing else could be concurrently modifying our storage in a way that
+          //   makes the count different on a retry.
+          // - If retries fail and the flush never completes at all, the output gate will kick in
+          //   and make it impossible for anyone to observe the bogus result.
+          // HACK: This uses a `kj::mv()` because promise fulfillers require rvalues even for
+          // trivially copyable types.
+          countedDelete.resultFulfiller->fulfill(kj::mv(countedDelete.countDeleted));
+        }
+      }, [&countedDelete = *rpcCountedDelete.countedDelete](kj::Exception&& e) {
+        if (e.getType() == kj::Exception::Type::DISCONNECTED) {
+          // This deletion will be retried, so don't touch the fulfiller.
+        } else if (countedDelete.resultFulfiller->isWaiting()) {
+          countedDelete.resultFulfiller->reject(kj::mv(e));
+        }
       });
-    };
-
-    for (auto& promise : promises) {
-      // Reuse `countDeleted` since it's already in a state object anyway.
-      rpcCountedDelete.countedDelete->countDeleted += co_await promise;
     }
+
+    return request.send().ignoreResult();
   };
-  for (auto& rpcCountedDelete: rpcCountedDeletes) {
-    promises.add(joinCountedDelete(rpcCountedDelete).then(
-        [&countedDelete = *rpcCountedDelete.countedDelete]() mutable {
-      // Note that it's OK to trust the delete count even if the transaction ultimately gets rolled
-      // back, because:
-      // - We know that nothing else could be concurrently modifying our storage in a way that
-      //   makes the count different on a retry.
-      // - If retries fail and the flush never completes at all, the output gate will kick in and
-      //   make it impossible for anyone to observe the bogus result.
-      // HACK: This uses a `kj::mv()` because promise fulfillers require rvalues even for trivially
-      // copyable types.
-      countedDelete.resultFulfiller->fulfill(kj::mv(countedDelete.countDeleted));
-    }, [&countedDelete = *rpcCountedDelete.countedDelete](kj::Exception&& e) {
-      if (e.getType() == kj::Exception::Type::DISCONNECTED) {
-        // This deletion will be retried, so don't touch the fulfiller.
-      } else {
-        countedDelete.resultFulfiller->reject(kj::mv(e));
-      }
-    }));
-  }
 
-  for (auto& request: rpcMutedDeletes) {
-    promises.add(request.send().ignoreResult());
+  // Send the batches in order, but stop sending whenever `flushWindowBytes` worth of them are
+  // still awaiting responses, so that a huge flush doesn't saturate the storage connection and
+  // delay everything else sharing it. The window adapts to the observed batch latency, see
+  // `adjustFlushWindow()`. Since the batches all go to the same transaction, which storage
+  // processes in order, the oldest outstanding batch is always the next to complete.
+  struct InFlightBatch {
+    kj::Promise<void> promise;
+    size_t bytes;
+  };
+  kj::Vector<InFlightBatch> inFlight(txnBatches.size());
+  size_t oldestInFlight = 0;
+  size_t inFlightBytes = 0;
+  size_t totalBytes = 0;
+  auto flushStart = clock.now();
+
+  for (auto& batch: txnBatches) {
+    size_t bytes = batch.wordCount * sizeof(capnp::word);
+    while (oldestInFlight < inFlight.size() && inFlightBytes + bytes > flushWindowBytes) {
+      auto& oldest = inFlight[oldestInFlight++];
+      co_await kj::mv(oldest.promise);
+      inFlightBytes -= oldest.bytes;
+    }
+
+    auto sendTime = clock.now();
+    inFlight.add(InFlightBatch{
+      .promise = sendBatch(batch).then([this, sendTime]() {
+        adjustFlushWindow(clock.now() - sendTime);
+      }).eagerlyEvaluate(nullptr),
+      .bytes = bytes,
+    });
+    inFlightBytes += bytes;
+    totalBytes += bytes;
+
+    // The message has been built, so we no longer need to hold the entries.
+    batch.entries = nullptr;
   }
 
-  for (auto& request: rpcPuts) {
-    promises.add(request.send().ignoreResult());
+  // The constant extra 2 promises are those added outside of the rpc batches, currently one
+  // to work around a bug in capnp::autoreconnect, and one to actually commit the flush txn
+  // A 3rd promise may be added to write the alarm time if necessary.
+  auto promises = kj::heapArrayBuilder<kj::Promise<void>>(
+      inFlight.size() - oldestInFlight + 2 + !maybeAlarmChange.is<CleanAlarm>());
+
+  for (auto& batch: inFlight.asPtr().slice(oldestInFlight, inFlight.size())) {
+    promises.add(kj::mv(batch.promise));
   }
 
   KJ_SWITCH_ONEOF(maybeAlarmChange) {
@@ -2899,6 +3024,17 @@ kj::Promise<void> ActorCache::flushImplUsingTxn(
 
     co_await kj::joinPromises(promises.finish());
   }
+
+  hooks.txnFlushCompleted(txnBatches.size(), totalBytes, clock.now() - flushStart);
+}
+
+void ActorCache::adjustFlushWindow(kj::Duration batchLatency) {
+  if (batchLatency > FLUSH_BATCH_TARGET_LATENCY) {
+    // Storage is falling behind, back off quickly.
+    flushWindowBytes = kj::max(flushWindowBytes / 2, FLUSH_WINDOW_MIN_BYTES);
+  } else {
+    flushWindowBytes = kj::min(flushWindowBytes + FLUSH_WINDOW_MIN_BYTES, FLUSH_WINDOW_MAX_BYTES);
+  }
 }
 
 kj::Promise<void> ActorCache::flushImplDeleteAll(uint retryCount) {
@@ -2921,7 +3057,7 @@ kj::Promise<void> ActorCache::flushImplDeleteAll(uint retryCount) {
     requestedDeleteAll = kj::none;
 
     {
-      auto lock = lru.cleanList.lockExclusive();
+      auto lock = lruShard.cleanList.lockExclusive();
       evictOrOomIfNeeded(lock);
     }
 
@@ -2961,7 +3097,7 @@ ActorCache::Transaction::~Transaction() noexcept(false) {
 
 kj::Maybe<kj::Promise<void>> ActorCache::Transaction::commit() {
   {
-    auto lock = cache.lru.cleanList.lockExclusive();
+    auto lock = cache.lruShard.cleanList.lockExclusive();
     for (auto& change: entriesToWrite) {
       cache.putImpl(lock, kj::mv(change.entry), change.options, kj::none);
     }
@@ -3112,7 +3248,7 @@ kj::OneOf<ActorCache::GetResultList, kj::Promise<ActorCache::GetResultList>>
 kj::Maybe<kj::Promise<void>> ActorCache::Transaction::put(
     Key key, Value value, WriteOptions options) {
   options.noCache = options.noCache || cache.lru.options.noCache;
-  auto lock = cache.lru.cleanList.lockExclusive();
+  auto lock = cache.lruShard.cleanList.lockExclusive();
   auto entry = kj::atomicRefcounted<Entry>(cache, kj::mv(key), kj::mv(value));
   putImpl(lock, kj::mv(entry), options);
 
@@ -3123,7 +3259,7 @@ kj::Maybe<kj::Promise<void>> ActorCache::Transaction::put(
 kj::Maybe<kj::Promise<void>> ActorCache::Transaction::put(
     kj::Array<KeyValuePair> pairs, WriteOptions options) {
   options.noCache = options.noCache || cache.lru.options.noCache;
-  auto lock = cache.lru.cleanList.lockExclusive();
+  auto lock = cache.lruShard.cleanList.lockExclusive();
 
   for (auto& pair: pairs) {
     auto entry = kj::atomicRefcounted<Entry>(cache, kj::mv(pair.key), kj::mv(pair.value));
@@ -3150,7 +3286,7 @@ kj::OneOf<bool, kj::Promise<bool>> ActorCache::Transaction::delete_(
   kj::Maybe<KeyPtr> keyToCount;
 
   {
-    auto lock = cache.lru.cleanList.lockExclusive();
+    auto lock = cache.lruShard.cleanList.lockExclusive();
     auto entry = kj::atomicRefcounted<Entry>(cache, kj::mv(key), EntryValueStatus::ABSENT);
     keyToCount = putImpl(lock, kj::mv(entry), options, count);
   }
@@ -3189,7 +3325,7 @@ kj::OneOf<uint, kj::Promise<uint>> ActorCache::Transaction::delete_(
   auto currentBatch = startNewBatch();
 
   {
-    auto lock = cache.lru.cleanList.lockExclusive();
+    auto lock = cache.lruShard.cleanList.lockExclusive();
     for (auto& key: keys) {
       auto entry = kj::atomicRefcounted<Entry>(cache, kj::mv(key), EntryValueStatus::ABSENT);
       KJ_IF_SOME(keyToCount, putImpl(lock, kj::mv(entry), options, count)) {
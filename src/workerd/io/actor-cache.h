@@ -19,6 +19,7 @@ using kj::byte;
 using kj::uint;
 class OutputGate;
 class SqliteDatabase;
+class SqliteKv;
 
 struct ActorCacheReadOptions {
   // If the entry is not already in cache and has to be read from disk, don't store the result in
@@ -154,6 +155,12 @@ public:
       Key key, WriteOptions options) = 0;
   virtual kj::OneOf<uint, kj::Promise<uint>> delete_(
       kj::Array<Key> keys, WriteOptions options) = 0;
+
+  // If reads can be served synchronously from a SqliteKv, returns it, so that callers can read
+  // values directly out of SQLite's row buffers rather than having them copied into a
+  // GetResultList. Reads made through the returned object have the same semantics as get() and
+  // list().
+  virtual kj::Maybe<SqliteKv&> getSqliteKv() { return kj::none; }
 };
 
 // Abstract interface that is implemneted by ActorCache as well as ActorSqlite.
@@ -246,6 +253,7 @@ class ActorCache final: public ActorCacheInterface {
 public:
   // Shared LRU for a whole isolate.
   class SharedLru;
+  struct SharedLruShard;
 
   // Hooks that can be used to customize ActorCache behavior
   class Hooks {
@@ -253,6 +261,11 @@ public:
     // Called when the alarm time is dirty when neverFlush is set and ensureFlushScheduled is called.
     virtual void updateAlarmInMemory(kj::Maybe<kj::Date> newAlarmTime) {};
 
+    // Called when a flush that used a transaction has committed, with the number of write batches
+    // it was split into, their total size in bytes, and the time from sending the first batch
+    // until the commit completed.
+    virtual void txnFlushCompleted(size_t batchCount, size_t byteCount, kj::Duration latency) {};
+
     static Hooks DEFAULT;
   };
 
@@ -260,8 +273,10 @@ public:
       "broken.ignored; jsg.Error: "
       "Durable Object storage is no longer accessible."_kj;
 
+  // `clock` is used to time storage operations, and may be overridden for tests.
   ActorCache(rpc::ActorStorage::Stage::Client storage, const SharedLru& lru, OutputGate& gate,
-      Hooks& hooks = Hooks::DEFAULT);
+      Hooks& hooks = Hooks::DEFAULT,
+      const kj::MonotonicClock& clock = kj::systemPreciseMonotonicClock());
   ~ActorCache() noexcept(false);
 
   kj::Maybe<SqliteDatabase&> getSqliteDatabase() override { return kj::none; }
@@ -378,7 +393,7 @@ private:
     // the read operation still has the original value from when it was called.
     //
     // The mutable content of an `Entry` is protected by the same mutex that protects
-    // `lru.cleanList`. `key` and `value` are declared `const` so that they can safely be used
+    // `lruShard.cleanList`. `key` and `value` are declared `const` so that they can safely be used
     // without a lock.
 
     Entry(ActorCache& cache, Key key, Value value);
@@ -509,6 +524,10 @@ private:
 
   rpc::ActorStorage::Stage::Client storage;
   const SharedLru& lru;
+
+  // The shard of `lru` that this cache's clean entries live in, assigned at construction.
+  const SharedLruShard& lruShard;
+
   OutputGate& gate;
   Hooks& hooks;
   const kj::MonotonicClock& clock;
@@ -544,8 +563,8 @@ private:
 
   // Map of current known values for keys. Searchable by key, including ordered iteration.
   //
-  // This map is protected by the same lock as lru.cleanList. ExternalMutexGuarded helps enforce
-  // this.
+  // This map is protected by the same lock as lruShard.cleanList. ExternalMutexGuarded helps
+  // enforce this.
   kj::ExternalMutexGuarded<kj::Table<kj::Own<Entry>, kj::TreeIndex<EntryTableCallbacks>>>
       currentValues;
 
@@ -620,7 +639,8 @@ private:
   // Will be canceled if and when `oomException` becomes non-null.
   kj::Canceler oomCanceler;
 
-  // Type of a lock on `SharedLru::cleanList`. We use the same lock to protect `currentValues`.
+  // Type of a lock on `SharedLruShard::cleanList`. We use the same lock to protect
+  // `currentValues`.
   typedef kj::Locked<kj::List<Entry, &Entry::link>> Lock;
 
   // Indicate that an entry was observed by a read operation and so should be moved to the end of
@@ -651,6 +671,29 @@ private:
   // Mark all gaps empty between the begin and end key.
   void markGapsEmpty(Lock& lock, KeyPtr begin, kj::Maybe<KeyPtr> end, const ReadOptions& options);
 
+  // The range of the last limited list() or listReverse() call, used to detect an app paginating
+  // through a range, i.e. repeatedly listing a page and then continuing after its last key.
+  struct ListPagination {
+    Key beginKey;
+    kj::Maybe<Key> endKey;
+
+    // How many calls in a row, not counting the first, have continued the previous one.
+    uint sequentialPages = 0;
+  };
+  kj::Maybe<ListPagination> lastForwardList;
+  kj::Maybe<ListPagination> lastReverseList;
+
+  // Bounds on how far ahead of a paginated list we read: at most this many pages, or keys.
+  static constexpr uint MAX_LIST_READ_AHEAD_PAGES = 8;
+  static constexpr uint MAX_LIST_READ_AHEAD_KEYS = 1024;
+
+  // Records a limited list() (or, if `reverse`, listReverse()) call in `last`, and returns how
+  // many keys beyond `limit` it should request from storage, if it needs to, so that the pages
+  // after it can be served from cache. This is zero unless the call continues a pagination.
+  uint updateListReadAhead(kj::Maybe<ListPagination>& last, bool reverse,
+                           const Key& beginKey, const kj::Maybe<Key>& endKey, uint limit,
+                           const ReadOptions& options);
+
   // Implements put() or delete(). Multi-key variants call this for each key.
   void putImpl(Lock& lock, kj::Own<Entry> newEntry,
                const WriteOptions& options,  kj::Maybe<CountedDelete&> counted);
@@ -710,6 +753,22 @@ private:
       PutFlush putFlush, MutedDeleteFlush mutedDeleteFlush,
       CountedDeleteFlushes countedDeleteFlushes, MaybeAlarmChange maybeAlarmChange);
 
+  // Bounds on `flushWindowBytes`. The window always allows at least one batch in flight, however
+  // large it is.
+  static constexpr size_t FLUSH_WINDOW_MIN_BYTES = 256u << 10;
+  static constexpr size_t FLUSH_WINDOW_MAX_BYTES = 16u << 20;
+
+  // If a batch takes longer than this to be acknowledged, storage is falling behind and we shrink
+  // the window.
+  static constexpr kj::Duration FLUSH_BATCH_TARGET_LATENCY = 250 * kj::MILLISECONDS;
+
+  // How many bytes of write batches flushImplUsingTxn() may have sent without a response yet.
+  // Adapted over the lifetime of the cache: grows additively while batches are acknowledged
+  // within FLUSH_BATCH_TARGET_LATENCY, and is halved when they aren't.
+  size_t flushWindowBytes = 1u << 20;
+
+  void adjustFlushWindow(kj::Duration batchLatency);
+
   // Carefully remove a clean entry from `currentValues`, making sure to update gaps.
   void evictEntry(Lock& lock, Entry& entry);
 
@@ -829,38 +888,69 @@ struct ActorCacheSharedLruOptions {
   // If true, don't actually flush anything. This is used in preview sessions, since they keep
   // state strictly in memory.
   bool neverFlush = false;
+
+  // Number of shards the clean list is split into. Each ActorCache is assigned to one shard when
+  // it is created and only ever locks that shard, so caches in different shards don't contend
+  // with each other. With more than one shard, eviction is only approximately LRU across caches;
+  // see SharedLru::evictIfNeeded().
+  uint shardCount = 1;
+};
+
+// One shard of an ActorCache::SharedLru.
+struct ActorCache::SharedLruShard {
+  // List of clean values in this shard, ordered from least-recently-used to most-recently-used.
+  kj::MutexGuarded<kj::List<Entry, &Entry::link>> cleanList;
+
+  // Total byte size of everything cached by the caches in this shard, including dirty values
+  // that are not in `cleanList`.
+  mutable std::atomic<size_t> size = 0;
 };
 
 class ActorCache::SharedLru {
 public:
   using Options = ActorCacheSharedLruOptions;
+  using Shard = SharedLruShard;
 
   explicit SharedLru(Options options);
 
   ~SharedLru() noexcept(false);
   KJ_DISALLOW_COPY_AND_MOVE(SharedLru);
 
-  // Mostly for testing.
-  size_t currentSize() const { return size.load(std::memory_order_relaxed); }
+  // Total byte size of everything that is cached, across all shards. The shards are summed
+  // without synchronization, so this is only approximate while caches are being modified
+  // concurrently.
+  size_t currentSize() const;
 
 private:
   Options options;
 
-  // List of clean values, across all caches, ordered from least-recently-used to
-  // most-recently-used.
-  kj::MutexGuarded<kj::List<Entry, &Entry::link>> cleanList;
+  kj::Array<Shard> shards;
 
-  // Total byte size of everything that is cached, including dirty values that are not in `list`.
-  mutable std::atomic<size_t> size = 0;
+  // Used to assign shards to new caches round-robin.
+  mutable std::atomic<uint> nextShard = 0;
 
   // TimePoint when we should next evict stale entries. Represented as an int64_t of nanoseconds
   // instead of kj::TimePoint to allow for atomic operations.
   mutable std::atomic<int64_t> nextStaleCheckNs = 0;
 
-  // Evict cache entries as needed according to the cache limits. Returns true if the hard limit
-  // is exceeded and nothing can be evicted, in which case the caller should fail out in the
-  // appropriate way for the kind of operation being performed.
-  bool evictIfNeeded(Lock& lock) const KJ_WARN_UNUSED_RESULT;
+  const Shard& assignShard() const;
+
+  // Evict cache entries from `shard` as needed according to the cache limits. `lock` must be a
+  // lock on `shard.cleanList`. Returns true if the hard limit is exceeded and nothing can be
+  // evicted, in which case the caller should fail out in the appropriate way for the kind of
+  // operation being performed.
+  //
+  // Only `shard` can be evicted from, since it's the only one the caller has locked. A shard is
+  // therefore only trimmed down to its share of the limits (the limit divided by the number of
+  // shards); any excess beyond that belongs to other shards, which evict it on their own next
+  // operation, or in evictFromLargestShard().
+  bool evictIfNeeded(const Shard& shard, Lock& lock) const KJ_WARN_UNUSED_RESULT;
+
+  // If the total size is over the soft limit, pick the largest shard and evict from it down to
+  // its share of the limit. This makes sure that memory held by idle caches, which never call
+  // evictIfNeeded() themselves, is eventually reclaimed. Must be called without any shard locked.
+  // Only needed when there is more than one shard.
+  void evictFromLargestShard() const;
 
   friend class ActorCache;
 };
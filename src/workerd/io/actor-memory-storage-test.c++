@@ -0,0 +1,215 @@
+// Copyright (c) 2024 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "actor-memory-storage.h"
+#include <kj/test.h>
+#include <kj/debug.h>
+
+namespace workerd {
+namespace {
+
+using Store = ActorMemoryStorage::Store;
+
+// Convenience wrappers converting values to/from strings, and unwrapping the results, which
+// ActorMemoryStorage always returns synchronously.
+struct MemoryStorageWrappers {
+  ActorCacheOps& target;
+
+  kj::Maybe<kj::String> get(kj::StringPtr key) {
+    auto result = target.get(kj::str(key), {});
+    auto& value = result.get<kj::Maybe<ActorCacheOps::Value>>();
+    return value.map([](ActorCacheOps::Value& v) { return kj::str(v.asChars()); });
+  }
+
+  kj::String stringify(kj::OneOf<ActorCacheOps::GetResultList,
+                                 kj::Promise<ActorCacheOps::GetResultList>> result) {
+    auto& list = result.get<ActorCacheOps::GetResultList>();
+    return kj::strArray(KJ_MAP(e, list) { return kj::str(e.key, "=", e.value.asChars()); }, ",");
+  }
+
+  kj::String get(kj::ArrayPtr<const kj::StringPtr> keys) {
+    return stringify(target.get(KJ_MAP(k, keys) { return kj::str(k); }, {}));
+  }
+
+  kj::String list(kj::StringPtr begin, kj::Maybe<kj::StringPtr> end,
+                  kj::Maybe<uint> limit = kj::none) {
+    return stringify(target.list(
+        kj::str(begin), end.map([](kj::StringPtr e) { return kj::str(e); }), limit, {}));
+  }
+
+  kj::String listReverse(kj::StringPtr begin, kj::Maybe<kj::StringPtr> end,
+                         kj::Maybe<uint> limit = kj::none) {
+    return stringify(target.listReverse(
+        kj::str(begin), end.map([](kj::StringPtr e) { return kj::str(e); }), limit, {}));
+  }
+
+  void put(kj::StringPtr key, kj::StringPtr value) {
+    target.put(kj::str(key), kj::heapArray(value.asBytes()), {});
+  }
+
+  bool delete_(kj::StringPtr key) {
+    auto result = target.delete_(kj::str(key), {});
+    return result.get<bool>();
+  }
+};
+
+KJ_TEST("ActorMemoryStorage basics") {
+  kj::EventLoop loop;
+  kj::WaitScope ws(loop);
+
+  Store store(Store::Options{});
+  ActorMemoryStorage storage(store, "ns", "obj");
+  MemoryStorageWrappers test { storage };
+
+  KJ_EXPECT(test.get("foo") == kj::none);
+
+  test.put("foo", "123");
+  test.put("bar", "456");
+  test.put("baz", "789");
+  KJ_EXPECT(KJ_ASSERT_NONNULL(test.get("foo")) == "123");
+
+  test.put("foo", "321");
+  KJ_EXPECT(KJ_ASSERT_NONNULL(test.get("foo")) == "321");
+
+  const kj::StringPtr keys[] = { "foo", "qux", "bar", "foo" };
+  KJ_EXPECT(test.get(keys) == "bar=456,foo=321");
+
+  KJ_EXPECT(test.list("", kj::none) == "bar=456,baz=789,foo=321");
+  KJ_EXPECT(test.list("bar", "foo"_kj) == "bar=456,baz=789");
+  KJ_EXPECT(test.list("bas", kj::none, 1u) == "baz=789");
+  KJ_EXPECT(test.listReverse("", kj::none) == "foo=321,baz=789,bar=456");
+  KJ_EXPECT(test.listReverse("bar", "foo"_kj) == "baz=789,bar=456");
+  KJ_EXPECT(test.listReverse("", "fop"_kj, 1u) == "foo=321");
+  KJ_EXPECT(test.listReverse("foo", "bar"_kj) == "");
+
+  KJ_EXPECT(test.delete_("bar"));
+  KJ_EXPECT(!test.delete_("bar"));
+  KJ_EXPECT(test.list("", kj::none) == "baz=789,foo=321");
+
+  KJ_EXPECT(storage.deleteAll({}).count.wait(ws) == 2);
+  KJ_EXPECT(test.list("", kj::none) == "");
+  KJ_EXPECT(store.getUsedBytes() == 0);
+}
+
+KJ_TEST("ActorMemoryStorage data outlives the object") {
+  Store store(Store::Options{});
+
+  {
+    ActorMemoryStorage storage(store, "ns", "obj");
+    MemoryStorageWrappers { storage }.put("foo", "123");
+  }
+
+  ActorMemoryStorage storage(store, "ns", "obj");
+  KJ_EXPECT(KJ_ASSERT_NONNULL(MemoryStorageWrappers { storage }.get("foo")) == "123");
+
+  ActorMemoryStorage other(store, "ns", "other");
+  KJ_EXPECT(MemoryStorageWrappers { other }.get("foo") == kj::none);
+}
+
+KJ_TEST("ActorMemoryStorage transactions") {
+  kj::EventLoop loop;
+  kj::WaitScope ws(loop);
+
+  Store store(Store::Options{});
+  ActorMemoryStorage storage(store, "ns", "obj");
+  MemoryStorageWrappers test { storage };
+
+  test.put("foo", "123");
+  auto usedBytes = store.getUsedBytes();
+
+  {
+    auto txn = storage.startTransaction();
+    MemoryStorageWrappers { *txn }.put("foo", "456");
+    MemoryStorageWrappers { *txn }.put("bar", "789");
+
+    {
+      // A committed nested transaction is still rolled back with its parent.
+      auto nested = storage.startTransaction();
+      MemoryStorageWrappers { *nested }.put("foo", "000");
+      MemoryStorageWrappers { *nested }.delete_("bar");
+      nested->commit();
+    }
+
+    KJ_EXPECT(test.list("", kj::none) == "foo=000");
+    txn->rollback().wait(ws);
+  }
+
+  KJ_EXPECT(test.list("", kj::none) == "foo=123");
+  KJ_EXPECT(store.getUsedBytes() == usedBytes);
+
+  {
+    auto txn = storage.startTransaction();
+    MemoryStorageWrappers { *txn }.put("bar", "456");
+    {
+      // A nested transaction can roll back on its own.
+      auto nested = storage.startTransaction();
+      MemoryStorageWrappers { *nested }.put("foo", "000");
+    }
+    txn->commit();
+  }
+
+  KJ_EXPECT(test.list("", kj::none) == "bar=456,foo=123");
+}
+
+KJ_TEST("ActorMemoryStorage memory limit") {
+  Store store({ .memoryLimit = 1000 });
+  ActorMemoryStorage storage(store, "ns", "obj");
+  MemoryStorageWrappers test { storage };
+
+  auto big = kj::str(kj::repeat('x', 600));
+  test.put("foo", big);
+
+  KJ_EXPECT_THROW_MESSAGE("memory limit exceeded", test.put("bar", big));
+  KJ_EXPECT(test.get("bar") == kj::none);
+
+  // Batches are all-or-nothing.
+  auto pairs = kj::heapArrayBuilder<ActorCacheOps::KeyValuePair>(2);
+  pairs.add(ActorCacheOps::KeyValuePair { kj::str("a"), kj::heapArray("1"_kj.asBytes()) });
+  pairs.add(ActorCacheOps::KeyValuePair { kj::str("b"), kj::heapArray(big.asBytes()) });
+  KJ_EXPECT_THROW_MESSAGE("memory limit exceeded", storage.put(pairs.finish(), {}));
+  KJ_EXPECT(test.get("a") == kj::none);
+
+  // Overwriting with a value of the same size is fine, and deleting frees space.
+  test.put("foo", big);
+  test.delete_("foo");
+  test.put("bar", big);
+}
+
+KJ_TEST("ActorMemoryStorage snapshots") {
+  kj::EventLoop loop;
+  kj::WaitScope ws(loop);
+
+  auto dir = kj::newInMemoryDirectory(kj::nullClock());
+
+  {
+    Store store({}, *dir);
+    ActorMemoryStorage storage(store, "ns", "obj");
+    MemoryStorageWrappers test { storage };
+    test.put("foo", "123");
+    test.put("bar", "456");
+
+    ActorMemoryStorage unmodified(store, "ns", "unmodified");
+    store.writeSnapshot();
+  }
+
+  KJ_EXPECT(dir->exists(kj::Path({"ns", "obj.snapshot"})));
+  KJ_EXPECT(!dir->exists(kj::Path({"ns", "unmodified.snapshot"})));
+
+  {
+    Store store({}, *dir);
+    ActorMemoryStorage storage(store, "ns", "obj");
+    MemoryStorageWrappers test { storage };
+    KJ_EXPECT(test.list("", kj::none) == "bar=456,foo=123");
+    KJ_EXPECT(store.getUsedBytes() > 0);
+
+    // Deleting everything removes the snapshot.
+    KJ_EXPECT(storage.deleteAll({}).count.wait(ws) == 2);
+    store.writeSnapshot();
+  }
+
+  KJ_EXPECT(!dir->exists(kj::Path({"ns", "obj.snapshot"})));
+}
+
+}  // namespace
+}  // namespace workerd
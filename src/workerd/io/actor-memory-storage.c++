@@ -0,0 +1,521 @@
+// Copyright (c) 2024 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "actor-memory-storage.h"
+#include <workerd/io/actor-storage.capnp.h>
+#include <workerd/jsg/jsg.h>
+#include <capnp/serialize.h>
+#include <kj/encoding.h>
+#include <algorithm>
+
+namespace workerd {
+
+// =======================================================================================
+// Store
+
+ActorMemoryStorage::Store::Store(Options options, kj::Maybe<const kj::Directory&> snapshotDir)
+    : options(options), snapshotDir(snapshotDir) {}
+
+ActorMemoryStorage::Store::~Store() noexcept(false) {}
+
+// Returns the name of the snapshot subdirectory for the namespace with the given unique key. The
+// key can be any text, so it is URI-encoded to make it a valid file name. Typical keys, made of
+// letters, digits and dashes, are unchanged.
+static kj::String snapshotDirName(kj::StringPtr uniqueKey) {
+  kj::String name = kj::encodeUriComponent(uniqueKey);
+  // These aren't valid path components, and nothing else encodes to them.
+  if (name == "") return kj::str("%");
+  if (name == ".") return kj::str("%2E");
+  if (name == "..") return kj::str("%2E%2E");
+  return name;
+}
+
+ActorMemoryStorage::Store::Object& ActorMemoryStorage::Store::getObject(
+    kj::StringPtr uniqueKey, kj::StringPtr id) {
+  return *objects.findOrCreate(kj::str(uniqueKey, '/', id), [&]() {
+    auto object = kj::heap<Object>();
+    if (snapshotDir != kj::none) {
+      object->snapshotPath = kj::Path({snapshotDirName(uniqueKey), kj::str(id, ".snapshot")});
+      loadSnapshot(*object);
+    }
+    return decltype(objects)::Entry { kj::str(uniqueKey, '/', id), kj::mv(object) };
+  });
+}
+
+// A snapshot is a single Cap'n Proto message whose root is a List(ActorStorage.KeyValue), in key
+// order.
+
+void ActorMemoryStorage::Store::loadSnapshot(Object& object) {
+  auto& dir = KJ_ASSERT_NONNULL(snapshotDir);
+  auto& path = KJ_ASSERT_NONNULL(object.snapshotPath);
+
+  try {
+    KJ_IF_SOME(file, dir.tryOpenFile(path)) {
+      auto bytes = file->readAllBytes();
+      auto words = kj::heapArray<capnp::word>(bytes.size() / sizeof(capnp::word));
+      memcpy(words.begin(), bytes.begin(), words.asBytes().size());
+
+      capnp::ReaderOptions readerOptions;
+      readerOptions.traversalLimitInWords = kj::maxValue;
+      capnp::FlatArrayMessageReader reader(words, readerOptions);
+      auto list = reader.getRoot<capnp::AnyPointer>()
+          .getAs<capnp::List<rpc::ActorStorage::KeyValue>>();
+
+      object.rows.reserve(list.size());
+      for (auto kv: list) {
+        auto& row = object.rows.insert(Row {
+          kj::heapString(kv.getKey().asChars()),
+          kj::heapArray(kv.getValue())
+        });
+        // Data already on disk is admitted even if it exceeds the limit; new writes will fail.
+        usedBytes += rowSize(row.key, row.value);
+      }
+    }
+  } catch (...) {
+    auto exception = kj::getCaughtExceptionAsKj();
+    KJ_LOG(ERROR, "failed to load Durable Object storage snapshot", path.toString(), exception);
+  }
+}
+
+void ActorMemoryStorage::Store::writeSnapshot(Object& object) {
+  auto& dir = KJ_ASSERT_NONNULL(snapshotDir);
+  auto& path = KJ_ASSERT_NONNULL(object.snapshotPath);
+
+  if (object.rows.size() == 0) {
+    dir.tryRemove(path);
+  } else {
+    capnp::MallocMessageBuilder message;
+    auto list = message.getRoot<capnp::AnyPointer>()
+        .initAs<capnp::List<rpc::ActorStorage::KeyValue>>(object.rows.size());
+    uint i = 0;
+    for (auto& row: object.rows.ordered()) {
+      list[i].setKey(row.key.asBytes());
+      list[i].setValue(row.value.asPtr());
+      ++i;
+    }
+
+    auto words = capnp::messageToFlatArray(message);
+    auto replacer = dir.replaceFile(path,
+        kj::WriteMode::CREATE | kj::WriteMode::MODIFY | kj::WriteMode::CREATE_PARENT);
+    replacer->get().writeAll(words.asBytes());
+    replacer->commit();
+  }
+
+  object.dirty = false;
+}
+
+void ActorMemoryStorage::Store::writeSnapshot() {
+  if (snapshotDir == kj::none) return;
+
+  for (auto& entry: objects) {
+    auto& object = *entry.value;
+    if (!object.dirty) continue;
+
+    KJ_IF_SOME(exception, kj::runCatchingExceptions([&]() { writeSnapshot(object); })) {
+      KJ_LOG(ERROR, "failed to write Durable Object storage snapshot", entry.key, exception);
+    }
+  }
+}
+
+void ActorMemoryStorage::Store::requireCapacity(uint64_t growth) {
+  if (options.memoryLimit == 0) return;
+
+  JSG_REQUIRE(usedBytes + growth <= options.memoryLimit, Error,
+      "Durable Object storage memory limit exceeded. This workerd instance is configured to "
+      "store at most ", options.memoryLimit, " bytes of in-memory Durable Object data.");
+}
+
+// =======================================================================================
+// ExplicitTxn
+
+ActorMemoryStorage::ExplicitTxn::ExplicitTxn(ActorMemoryStorage& storage)
+    : storage(storage) {
+  KJ_IF_SOME(exp, storage.currentTxn) {
+    KJ_REQUIRE(!exp.hasChild,
+        "critical section should have blocked creation of more than one child at a time");
+    parent = kj::addRef(exp);
+    exp.hasChild = true;
+  }
+  storage.currentTxn = *this;
+}
+
+ActorMemoryStorage::ExplicitTxn::~ExplicitTxn() noexcept(false) {
+  [&]() noexcept {
+    // We'd better crash if any of this state update fails, otherwise dangling pointers.
+
+    KJ_ASSERT(!hasChild);
+    KJ_ASSERT(&KJ_ASSERT_NONNULL(storage.currentTxn) == this);
+    KJ_IF_SOME(p, parent) {
+      p->hasChild = false;
+      storage.currentTxn = *p;
+    } else {
+      storage.currentTxn = kj::none;
+    }
+  }();
+
+  if (!committed) {
+    // Assume rollback if not committed.
+    rollbackImpl();
+  }
+}
+
+kj::Maybe<kj::Promise<void>> ActorMemoryStorage::ExplicitTxn::commit() {
+  KJ_REQUIRE(!hasChild, "critical sections should have prevented committing transaction while "
+      "nested txn is outstanding");
+
+  KJ_IF_SOME(p, parent) {
+    // The parent may still roll back, in which case it must undo our writes too.
+    for (auto& undo: undoLog) {
+      p->undoLog.add(kj::mv(undo));
+    }
+  }
+  undoLog.clear();
+  committed = true;
+
+  // Writes were applied as they happened, so there's nothing to wait for.
+  return kj::none;
+}
+
+kj::Promise<void> ActorMemoryStorage::ExplicitTxn::rollback() {
+  JSG_REQUIRE(!hasChild, Error,
+      "Cannot roll back an outer transaction while a nested transaction is still running.");
+  if (!committed) {
+    rollbackImpl();
+    committed = true;
+  }
+  return kj::READY_NOW;
+}
+
+void ActorMemoryStorage::ExplicitTxn::rollbackImpl() {
+  // Restore values in reverse order, so that a key written several times ends up with the value
+  // it had before the first write. The restored values fit because they were stored before, so
+  // there's no need to check the memory limit.
+  auto& rows = storage.object.rows;
+  auto& usedBytes = storage.store.usedBytes;
+  if (undoLog.size() > 0) storage.object.dirty = true;
+  for (size_t i = undoLog.size(); i > 0; i--) {
+    auto& undo = undoLog[i - 1];
+    KJ_IF_SOME(row, rows.find(undo.key)) {
+      usedBytes -= Store::rowSize(row.key, row.value);
+      KJ_IF_SOME(value, undo.oldValue) {
+        usedBytes += Store::rowSize(row.key, value);
+        row.value = kj::mv(value);
+      } else {
+        rows.erase(row);
+      }
+    } else KJ_IF_SOME(value, undo.oldValue) {
+      usedBytes += Store::rowSize(undo.key, value);
+      rows.insert(Row { kj::mv(undo.key), kj::mv(value) });
+    }
+  }
+  undoLog.clear();
+}
+
+kj::OneOf<kj::Maybe<ActorCacheOps::Value>, kj::Promise<kj::Maybe<ActorCacheOps::Value>>>
+    ActorMemoryStorage::ExplicitTxn::get(Key key, ReadOptions options) {
+  return storage.get(kj::mv(key), options);
+}
+kj::OneOf<ActorCacheOps::GetResultList, kj::Promise<ActorCacheOps::GetResultList>>
+    ActorMemoryStorage::ExplicitTxn::get(kj::Array<Key> keys, ReadOptions options) {
+  return storage.get(kj::mv(keys), options);
+}
+kj::OneOf<kj::Maybe<kj::Date>, kj::Promise<kj::Maybe<kj::Date>>>
+    ActorMemoryStorage::ExplicitTxn::getAlarm(ReadOptions options) {
+  return storage.getAlarm(options);
+}
+kj::OneOf<ActorCacheOps::GetResultList, kj::Promise<ActorCacheOps::GetResultList>>
+    ActorMemoryStorage::ExplicitTxn::list(
+        Key begin, kj::Maybe<Key> end, kj::Maybe<uint> limit, ReadOptions options) {
+  return storage.list(kj::mv(begin), kj::mv(end), limit, options);
+}
+kj::OneOf<ActorCacheOps::GetResultList, kj::Promise<ActorCacheOps::GetResultList>>
+    ActorMemoryStorage::ExplicitTxn::listReverse(
+        Key begin, kj::Maybe<Key> end, kj::Maybe<uint> limit, ReadOptions options) {
+  return storage.listReverse(kj::mv(begin), kj::mv(end), limit, options);
+}
+kj::Maybe<kj::Promise<void>> ActorMemoryStorage::ExplicitTxn::put(
+    Key key, Value value, WriteOptions options) {
+  return storage.put(kj::mv(key), kj::mv(value), options);
+}
+kj::Maybe<kj::Promise<void>> ActorMemoryStorage::ExplicitTxn::put(
+    kj::Array<KeyValuePair> pairs, WriteOptions options) {
+  return storage.put(kj::mv(pairs), options);
+}
+kj::OneOf<bool, kj::Promise<bool>> ActorMemoryStorage::ExplicitTxn::delete_(
+    Key key, WriteOptions options) {
+  return storage.delete_(kj::mv(key), options);
+}
+kj::OneOf<uint, kj::Promise<uint>> ActorMemoryStorage::ExplicitTxn::delete_(
+    kj::Array<Key> keys, WriteOptions options) {
+  return storage.delete_(kj::mv(keys), options);
+}
+kj::Maybe<kj::Promise<void>> ActorMemoryStorage::ExplicitTxn::setAlarm(
+    kj::Maybe<kj::Date> newAlarmTime, WriteOptions options) {
+  return storage.setAlarm(newAlarmTime, options);
+}
+
+// =======================================================================================
+// ActorMemoryStorage
+
+ActorMemoryStorage::ActorMemoryStorage(
+    Store& store, kj::StringPtr uniqueKey, kj::StringPtr id, Hooks& hooks)
+    : store(store), object(store.getObject(uniqueKey, id)), hooks(hooks) {}
+
+bool ActorMemoryStorage::write(Key key, kj::Maybe<Value> newValue) {
+  auto& rows = object.rows;
+  auto& usedBytes = store.usedBytes;
+
+  kj::Maybe<Value> oldValue;
+  KJ_IF_SOME(row, rows.find(key)) {
+    usedBytes -= Store::rowSize(row.key, row.value);
+    oldValue = kj::mv(row.value);
+    KJ_IF_SOME(value, newValue) {
+      usedBytes += Store::rowSize(row.key, value);
+      row.value = kj::mv(value);
+    } else {
+      rows.erase(row);
+    }
+  } else KJ_IF_SOME(value, newValue) {
+    usedBytes += Store::rowSize(key, value);
+    rows.insert(Row { currentTxn == kj::none ? kj::mv(key) : cloneKey(key), kj::mv(value) });
+  } else {
+    // Deleting a key that isn't there changes nothing.
+    return false;
+  }
+
+  object.dirty = true;
+  bool existed = oldValue != kj::none;
+  KJ_IF_SOME(txn, currentTxn) {
+    txn.undoLog.add(Undo { kj::mv(key), kj::mv(oldValue) });
+  }
+  return existed;
+}
+
+uint64_t ActorMemoryStorage::growthFor(KeyPtr key, ValuePtr value) {
+  size_t newSize = Store::rowSize(key, value);
+  size_t oldSize = object.rows.find(key)
+      .map([](const Row& row) { return Store::rowSize(row.key, row.value); })
+      .orDefault(0);
+  return newSize > oldSize ? newSize - oldSize : 0;
+}
+
+void ActorMemoryStorage::requireNotBroken() {
+  KJ_IF_SOME(e, broken) {
+    kj::throwFatalException(kj::cp(e));
+  }
+}
+
+kj::OneOf<kj::Maybe<ActorCacheOps::Value>,
+          kj::Promise<kj::Maybe<ActorCacheOps::Value>>>
+    ActorMemoryStorage::get(Key key, ReadOptions options) {
+  requireNotBroken();
+
+  return object.rows.find(key).map([](const Row& row) -> Value {
+    return kj::heapArray(row.value.asPtr());
+  });
+}
+
+kj::OneOf<ActorCacheOps::GetResultList, kj::Promise<ActorCacheOps::GetResultList>>
+    ActorMemoryStorage::get(kj::Array<Key> keys, ReadOptions options) {
+  requireNotBroken();
+
+  // Results must be sorted.
+  std::sort(keys.begin(), keys.end());
+  kj::Vector<KeyValuePair> results(keys.size());
+  for (auto i: kj::indices(keys)) {
+    if (i > 0 && keys[i] == keys[i - 1]) continue;
+    KJ_IF_SOME(row, object.rows.find(keys[i])) {
+      results.add(KeyValuePair { cloneKey(row.key), kj::heapArray(row.value.asPtr()) });
+    }
+  }
+  return GetResultList(kj::mv(results));
+}
+
+kj::OneOf<kj::Maybe<kj::Date>, kj::Promise<kj::Maybe<kj::Date>>> ActorMemoryStorage::getAlarm(
+    ReadOptions options) {
+  requireNotBroken();
+
+  return hooks.getAlarm();
+}
+
+kj::OneOf<ActorCacheOps::GetResultList, kj::Promise<ActorCacheOps::GetResultList>>
+    ActorMemoryStorage::list(Key begin, kj::Maybe<Key> end, kj::Maybe<uint> limit,
+                             ReadOptions options) {
+  requireNotBroken();
+
+  kj::Vector<KeyValuePair> results;
+  auto ordered = object.rows.ordered();
+  for (auto iter = object.rows.seek(begin); iter != ordered.end(); ++iter) {
+    KJ_IF_SOME(l, limit) {
+      if (results.size() >= l) break;
+    }
+    KJ_IF_SOME(e, end) {
+      if (!(iter->key < e)) break;
+    }
+    results.add(KeyValuePair { cloneKey(iter->key), kj::heapArray(iter->value.asPtr()) });
+  }
+
+  return GetResultList(kj::mv(results));
+}
+
+kj::OneOf<ActorCacheOps::GetResultList, kj::Promise<ActorCacheOps::GetResultList>>
+    ActorMemoryStorage::listReverse(Key begin, kj::Maybe<Key> end, kj::Maybe<uint> limit,
+                                    ReadOptions options) {
+  requireNotBroken();
+
+  kj::Vector<KeyValuePair> results;
+  KJ_IF_SOME(e, end) {
+    // Walking backwards from `end` would never reach `begin`.
+    if (!(begin < e)) return GetResultList(kj::mv(results));
+  }
+
+  auto beginIter = object.rows.seek(begin);
+  auto iter = object.rows.ordered().end();
+  KJ_IF_SOME(e, end) {
+    iter = object.rows.seek(e);
+  }
+  while (iter != beginIter) {
+    KJ_IF_SOME(l, limit) {
+      if (results.size() >= l) break;
+    }
+    --iter;
+    results.add(KeyValuePair { cloneKey(iter->key), kj::heapArray(iter->value.asPtr()) });
+  }
+
+  return GetResultList(kj::mv(results));
+}
+
+kj::Maybe<kj::Promise<void>> ActorMemoryStorage::put(Key key, Value value, WriteOptions options) {
+  requireNotBroken();
+
+  store.requireCapacity(growthFor(key, value));
+  write(kj::mv(key), kj::mv(value));
+  return kj::none;
+}
+
+kj::Maybe<kj::Promise<void>> ActorMemoryStorage::put(
+    kj::Array<KeyValuePair> pairs, WriteOptions options) {
+  requireNotBroken();
+
+  // Check the limit for the whole batch up front, so that a batch is never partially applied.
+  uint64_t growth = 0;
+  for (auto& pair: pairs) {
+    growth += growthFor(pair.key, pair.value);
+  }
+  store.requireCapacity(growth);
+
+  for (auto& pair: pairs) {
+    write(kj::mv(pair.key), kj::mv(pair.value));
+  }
+  return kj::none;
+}
+
+kj::OneOf<bool, kj::Promise<bool>> ActorMemoryStorage::delete_(Key key, WriteOptions options) {
+  requireNotBroken();
+
+  return write(kj::mv(key), kj::none);
+}
+
+kj::OneOf<uint, kj::Promise<uint>> ActorMemoryStorage::delete_(
+    kj::Array<Key> keys, WriteOptions options) {
+  requireNotBroken();
+
+  uint count = 0;
+  for (auto& key: keys) {
+    if (write(kj::mv(key), kj::none)) ++count;
+  }
+  return count;
+}
+
+kj::Maybe<kj::Promise<void>> ActorMemoryStorage::setAlarm(
+    kj::Maybe<kj::Date> newAlarmTime, WriteOptions options) {
+  requireNotBroken();
+
+  return hooks.setAlarm(newAlarmTime);
+}
+
+kj::Own<ActorCacheInterface::Transaction> ActorMemoryStorage::startTransaction() {
+  requireNotBroken();
+
+  return kj::refcounted<ExplicitTxn>(*this);
+}
+
+ActorCacheInterface::DeleteAllResults ActorMemoryStorage::deleteAll(WriteOptions options) {
+  requireNotBroken();
+
+  uint count = object.rows.size();
+  for (auto& row: object.rows) {
+    store.usedBytes -= Store::rowSize(row.key, row.value);
+    KJ_IF_SOME(txn, currentTxn) {
+      txn.undoLog.add(Undo { kj::mv(row.key), kj::mv(row.value) });
+    }
+  }
+  object.rows.clear();
+  if (count > 0) object.dirty = true;
+
+  return {
+    .backpressure = kj::none,
+    .count = count,
+  };
+}
+
+kj::Maybe<kj::Promise<void>> ActorMemoryStorage::evictStale(kj::Date now) {
+  // Nothing is cached, so there's nothing to evict, and no writes to wait for.
+  return kj::none;
+}
+
+void ActorMemoryStorage::shutdown(kj::Maybe<const kj::Exception&> maybeException) {
+  if (broken == kj::none) {
+    KJ_IF_SOME(e, maybeException) {
+      // We were given an exception, use it.
+      broken = kj::cp(e);
+    } else {
+      // Use the direct constructor so that we can reuse the constexpr message variable for
+      // testing.
+      auto exception = kj::Exception(
+          kj::Exception::Type::OVERLOADED, __FILE__, __LINE__,
+          kj::heapString(ActorCache::SHUTDOWN_ERROR_MESSAGE));
+
+      // Add trace info sufficient to tell us which operation caused the failure.
+      exception.addTraceHere();
+      exception.addTrace(__builtin_return_address(0));
+      broken = kj::mv(exception);
+    }
+  }
+}
+
+kj::Maybe<kj::Own<void>> ActorMemoryStorage::armAlarmHandler(
+    kj::Date scheduledTime, bool noCache) {
+  return hooks.armAlarmHandler(scheduledTime, noCache);
+}
+
+void ActorMemoryStorage::cancelDeferredAlarmDeletion() {
+  hooks.cancelDeferredAlarmDeletion();
+}
+
+kj::Maybe<kj::Promise<void>> ActorMemoryStorage::onNoPendingFlush() {
+  // Writes are applied immediately and never flushed anywhere, so sync() never needs to wait.
+  return kj::none;
+}
+
+ActorMemoryStorage::Hooks ActorMemoryStorage::Hooks::DEFAULT = ActorMemoryStorage::Hooks{};
+
+kj::Promise<kj::Maybe<kj::Date>> ActorMemoryStorage::Hooks::getAlarm() {
+  JSG_FAIL_REQUIRE(Error, "getAlarm() is not supported by this Durable Object storage");
+}
+
+kj::Promise<void> ActorMemoryStorage::Hooks::setAlarm(kj::Maybe<kj::Date>) {
+  JSG_FAIL_REQUIRE(Error, "setAlarm() is not supported by this Durable Object storage");
+}
+
+kj::Maybe<kj::Own<void>> ActorMemoryStorage::Hooks::armAlarmHandler(
+    kj::Date scheduledTime, bool noCache) {
+  JSG_FAIL_REQUIRE(Error, "alarms are not supported by this Durable Object storage");
+}
+
+void ActorMemoryStorage::Hooks::cancelDeferredAlarmDeletion() {
+  JSG_FAIL_REQUIRE(Error, "alarms are not supported by this Durable Object storage");
+}
+
+}  // namespace workerd
@@ -0,0 +1,212 @@
+// Copyright (c) 2024 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#pragma once
+
+#include "actor-cache.h"
+#include <kj/filesystem.h>
+#include <kj/table.h>
+
+namespace workerd {
+
+// An implementation of ActorCacheInterface that keeps all data in memory, for Durable Objects
+// whose storage does not need to be durable (e.g. local testing).
+//
+// Unlike ActorCache, there is no underlying storage: the in-memory B-tree *is* the storage, so
+// there is no dirty tracking, no flushing, no LRU and no backpressure. Every operation completes
+// synchronously.
+//
+// The data lives in a `Store`, which outlives the ActorMemoryStorage instances so that an
+// object's data survives the object being evicted while idle.
+class ActorMemoryStorage final: public ActorCacheInterface {
+public:
+  // Hooks to plug in a backend for alarm operations, as with ActorSqlite::Hooks. Alarms are not
+  // stored in the Store; the default implementation throws.
+  class Hooks {
+  public:
+    virtual kj::Promise<kj::Maybe<kj::Date>> getAlarm();
+    virtual kj::Promise<void> setAlarm(kj::Maybe<kj::Date> newAlarmTime);
+    virtual kj::Maybe<kj::Own<void>> armAlarmHandler(kj::Date scheduledTime, bool noCache);
+    virtual void cancelDeferredAlarmDeletion();
+
+    static Hooks DEFAULT;
+  };
+
+  // Holds the data of a set of objects, keyed by their namespace's unique key and their ID.
+  //
+  // Memory usage is accounted across all objects in the store. A write which would take the total
+  // over `memoryLimit` fails with an exception, leaving storage unchanged.
+  //
+  // Optionally, the store can be backed by a snapshot directory. An object's data is then loaded
+  // from the directory the first time the object is opened, and `writeSnapshot()` writes back
+  // the data of every object which has been modified since.
+  class Store {
+  public:
+    struct Options {
+      // Maximum total size of the stored data, in bytes, or zero for no limit.
+      uint64_t memoryLimit = 0;
+    };
+
+    explicit Store(Options options, kj::Maybe<const kj::Directory&> snapshotDir = kj::none);
+    ~Store() noexcept(false);
+    KJ_DISALLOW_COPY_AND_MOVE(Store);
+
+    // Approximate total size of the stored data, in bytes, including per-key overhead.
+    uint64_t getUsedBytes() const { return usedBytes; }
+
+    // Writes the data of every object modified since it was loaded (or last snapshotted) to the
+    // snapshot directory. Does nothing if there is no snapshot directory. Errors are logged
+    // rather than thrown, so that one bad object does not prevent saving the others.
+    void writeSnapshot();
+
+  private:
+    struct Row {
+      Key key;
+      Value value;
+    };
+
+    class RowCallbacks {
+    public:
+      inline KeyPtr keyForRow(const Row& row) const { return row.key; }
+      inline bool isBefore(const Row& row, KeyPtr key) const { return row.key < key; }
+      inline bool isBefore(const Row& a, const Row& b) const { return a.key < b.key; }
+      inline bool matches(const Row& row, KeyPtr key) const { return row.key == key; }
+    };
+
+    struct Object {
+      // Set if the store has a snapshot directory.
+      kj::Maybe<kj::Path> snapshotPath;
+      kj::Table<Row, kj::TreeIndex<RowCallbacks>> rows;
+
+      // Modified since it was last loaded from or written to the snapshot directory.
+      bool dirty = false;
+    };
+
+    // Accounting overhead per key, roughly covering the B-tree slot and heap allocations.
+    static constexpr size_t ROW_OVERHEAD = 64;
+    static size_t rowSize(KeyPtr key, ValuePtr value) {
+      return key.size() + value.size() + ROW_OVERHEAD;
+    }
+
+    Options options;
+    kj::Maybe<const kj::Directory&> snapshotDir;
+    uint64_t usedBytes = 0;
+
+    // Keyed by `<uniqueKey>/<id>`.
+    kj::HashMap<kj::String, kj::Own<Object>> objects;
+
+    Object& getObject(kj::StringPtr uniqueKey, kj::StringPtr id);
+    void loadSnapshot(Object& object);
+    void writeSnapshot(Object& object);
+
+    // Throws if growing the stored data by `growth` bytes would exceed the memory limit.
+    void requireCapacity(uint64_t growth);
+
+    friend class ActorMemoryStorage;
+  };
+
+  // Opens the data of the object `id` in the namespace `uniqueKey` within `store`, which must
+  // outlive this object.
+  ActorMemoryStorage(Store& store, kj::StringPtr uniqueKey, kj::StringPtr id,
+                     Hooks& hooks = Hooks::DEFAULT);
+  KJ_DISALLOW_COPY_AND_MOVE(ActorMemoryStorage);
+
+  kj::Maybe<SqliteDatabase&> getSqliteDatabase() override { return kj::none; }
+
+  kj::OneOf<kj::Maybe<Value>, kj::Promise<kj::Maybe<Value>>> get(
+      Key key, ReadOptions options) override;
+  kj::OneOf<GetResultList, kj::Promise<GetResultList>> get(
+      kj::Array<Key> keys, ReadOptions options) override;
+  kj::OneOf<kj::Maybe<kj::Date>, kj::Promise<kj::Maybe<kj::Date>>> getAlarm(
+      ReadOptions options) override;
+  kj::OneOf<GetResultList, kj::Promise<GetResultList>> list(
+      Key begin, kj::Maybe<Key> end, kj::Maybe<uint> limit, ReadOptions options) override;
+  kj::OneOf<GetResultList, kj::Promise<GetResultList>> listReverse(
+      Key begin, kj::Maybe<Key> end, kj::Maybe<uint> limit, ReadOptions options) override;
+  kj::Maybe<kj::Promise<void>> put(Key key, Value value, WriteOptions options) override;
+  kj::Maybe<kj::Promise<void>> put(kj::Array<KeyValuePair> pairs, WriteOptions options) override;
+  kj::OneOf<bool, kj::Promise<bool>> delete_(Key key, WriteOptions options) override;
+  kj::OneOf<uint, kj::Promise<uint>> delete_(kj::Array<Key> keys, WriteOptions options) override;
+  kj::Maybe<kj::Promise<void>> setAlarm(kj::Maybe<kj::Date> newAlarmTime, WriteOptions options) override;
+  // See ActorCacheOps.
+
+  kj::Own<ActorCacheInterface::Transaction> startTransaction() override;
+  DeleteAllResults deleteAll(WriteOptions options) override;
+  kj::Maybe<kj::Promise<void>> evictStale(kj::Date now) override;
+  void shutdown(kj::Maybe<const kj::Exception&> maybeException) override;
+  kj::Maybe<kj::Own<void>> armAlarmHandler(kj::Date scheduledTime, bool noCache = false) override;
+  void cancelDeferredAlarmDeletion() override;
+  kj::Maybe<kj::Promise<void>> onNoPendingFlush() override;
+  // See ActorCacheInterface
+
+private:
+  using Row = Store::Row;
+
+  // The previous value of a key written during an explicit transaction, used to roll it back.
+  struct Undo {
+    Key key;
+    kj::Maybe<Value> oldValue;
+  };
+
+  // Writes go directly to the store. An explicit transaction records the previous value of each
+  // key it writes, and rolls back by restoring them in reverse order. Committing a nested
+  // transaction hands its log to the parent, which may still roll back.
+  class ExplicitTxn: public ActorCacheInterface::Transaction, public kj::Refcounted {
+  public:
+    ExplicitTxn(ActorMemoryStorage& storage);
+    ~ExplicitTxn() noexcept(false);
+    KJ_DISALLOW_COPY_AND_MOVE(ExplicitTxn);
+
+    kj::Maybe<kj::Promise<void>> commit() override;
+    kj::Promise<void> rollback() override;
+    // Implements ActorCacheInterface::Transaction.
+
+    kj::OneOf<kj::Maybe<Value>, kj::Promise<kj::Maybe<Value>>> get(
+        Key key, ReadOptions options) override;
+    kj::OneOf<GetResultList, kj::Promise<GetResultList>> get(
+        kj::Array<Key> keys, ReadOptions options) override;
+    kj::OneOf<kj::Maybe<kj::Date>, kj::Promise<kj::Maybe<kj::Date>>> getAlarm(
+        ReadOptions options) override;
+    kj::OneOf<GetResultList, kj::Promise<GetResultList>> list(
+        Key begin, kj::Maybe<Key> end, kj::Maybe<uint> limit, ReadOptions options) override;
+    kj::OneOf<GetResultList, kj::Promise<GetResultList>> listReverse(
+        Key begin, kj::Maybe<Key> end, kj::Maybe<uint> limit, ReadOptions options) override;
+    kj::Maybe<kj::Promise<void>> put(Key key, Value value, WriteOptions options) override;
+    kj::Maybe<kj::Promise<void>> put(kj::Array<KeyValuePair> pairs, WriteOptions options) override;
+    kj::OneOf<bool, kj::Promise<bool>> delete_(Key key, WriteOptions options) override;
+    kj::OneOf<uint, kj::Promise<uint>> delete_(kj::Array<Key> keys, WriteOptions options) override;
+    kj::Maybe<kj::Promise<void>> setAlarm(
+        kj::Maybe<kj::Date> newAlarmTime, WriteOptions options) override;
+    // Implements ActorCacheOps. These will all forward to the ActorMemoryStorage instance.
+
+  private:
+    ActorMemoryStorage& storage;
+    kj::Maybe<kj::Own<ExplicitTxn>> parent;
+    kj::Vector<Undo> undoLog;
+    bool hasChild = false;
+    bool committed = false;
+
+    void rollbackImpl();
+  };
+
+  Store& store;
+  Store::Object& object;
+  Hooks& hooks;
+
+  kj::Maybe<ExplicitTxn&> currentTxn;
+
+  kj::Maybe<kj::Exception> broken;
+
+  // Sets `key` to `newValue`, or deletes it if `newValue` is null, recording the previous value
+  // in the current transaction, if any. Returns true if the key was present beforehand. Does not
+  // check the memory limit.
+  bool write(Key key, kj::Maybe<Value> newValue);
+
+  // Amount by which storing `value` at `key` would grow the stored data (zero if it would shrink).
+  uint64_t growthFor(KeyPtr key, ValuePtr value);
+
+  void requireNotBroken();
+};
+
+}  // namespace workerd
@@ -0,0 +1,108 @@
+// Copyright (c) 2024 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "actor-sqlite.h"
+#include "io-gate.h"
+#include <kj/test.h>
+#include <kj/debug.h>
+
+namespace workerd {
+namespace {
+
+// Counts the syncs of the write-ahead log, failing them with `syncError` if set.
+struct TestHooks final: public ActorSqlite::Hooks {
+  uint syncCount = 0;
+  kj::Maybe<kj::Exception> syncError;
+
+  void syncWal(SqliteDatabase& db) override {
+    ++syncCount;
+    KJ_IF_SOME(e, syncError) {
+      kj::throwFatalException(kj::cp(e));
+    }
+    db.syncWal();
+  }
+};
+
+struct ActorSqliteTest {
+  kj::EventLoop loop;
+  kj::WaitScope ws;
+  kj::Own<const kj::Directory> dir;
+  SqliteDatabase::Vfs vfs;
+  OutputGate gate;
+  TestHooks hooks;
+  ActorSqlite actor;
+
+  ActorSqliteTest()
+      : ws(loop),
+        dir(kj::newInMemoryDirectory(kj::nullClock())),
+        vfs(*dir),
+        actor(kj::heap<SqliteDatabase>(vfs, kj::Path({"foo"}),
+                                       kj::WriteMode::CREATE | kj::WriteMode::MODIFY),
+              gate, []() -> kj::Promise<void> { return kj::READY_NOW; }, hooks) {}
+
+  void put(ActorCacheOps& target, kj::StringPtr key, kj::StringPtr value) {
+    target.put(kj::str(key), kj::heapArray(value.asBytes()), {});
+  }
+  void put(kj::StringPtr key, kj::StringPtr value) { put(actor, key, value); }
+
+  // Commits an explicit transaction containing the given write.
+  void putInTxn(kj::StringPtr key, kj::StringPtr value) {
+    auto txn = actor.startTransaction();
+    put(*txn, key, value);
+    txn->commit();
+  }
+};
+
+KJ_TEST("ActorSqlite output gate waits for the write-ahead log to be synced") {
+  ActorSqliteTest test;
+
+  test.put("foo", "123");
+
+  bool released = false;
+  auto promise = test.gate.wait().then([&]() {
+    // The write was committed and synced before the gate let anything out.
+    KJ_EXPECT(test.hooks.syncCount == 1);
+    released = true;
+  });
+  KJ_EXPECT(test.hooks.syncCount == 0);
+
+  promise.wait(test.ws);
+  KJ_EXPECT(released);
+  KJ_EXPECT(test.hooks.syncCount == 1);
+}
+
+KJ_TEST("ActorSqlite commits in the same turn share one sync") {
+  ActorSqliteTest test;
+
+  // Starting the first explicit transaction commits the implicit one, so these are three separate
+  // commits.
+  test.put("foo", "123");
+  test.putInTxn("bar", "456");
+  test.putInTxn("baz", "789");
+
+  test.gate.wait().wait(test.ws);
+  KJ_EXPECT(test.hooks.syncCount == 1);
+
+  // A commit in a later turn needs a sync of its own.
+  test.put("qux", "555");
+  test.gate.wait().wait(test.ws);
+  KJ_EXPECT(test.hooks.syncCount == 2);
+}
+
+KJ_TEST("ActorSqlite failure to sync breaks the output gate") {
+  ActorSqliteTest test;
+  test.hooks.syncError = KJ_EXCEPTION(FAILED, "test sync failure");
+
+  test.put("foo", "123");
+
+  KJ_EXPECT_THROW_MESSAGE("test sync failure", test.gate.onBroken().wait(test.ws));
+  KJ_EXPECT_THROW_MESSAGE("test sync failure", test.gate.wait().wait(test.ws));
+  KJ_EXPECT(test.hooks.syncCount == 1);
+
+  // The actor can't be used any further.
+  KJ_EXPECT_THROW_MESSAGE("test sync failure", test.actor.get(kj::str("foo"), {}));
+}
+
+}  // namespace
+}  // namespace workerd
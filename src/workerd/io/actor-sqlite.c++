@@ -14,7 +14,15 @@ ActorSqlite::ActorSqlite(kj::Own<SqliteDatabase> dbParam, OutputGate& outputGate
                          Hooks& hooks)
     : db(kj::mv(dbParam)), outputGate(outputGate), commitCallback(kj::mv(commitCallback)),
       hooks(hooks), kv(*db), commitTasks(*this) {
+  // SqliteKv has already switched the database to WAL mode, if the VFS supports it. In that mode,
+  // `synchronous = NORMAL` keeps commits atomic but leaves syncing the log to syncCommits().
+  if (db->run("PRAGMA journal_mode").getText(0) == "wal") {
+    db->run("PRAGMA synchronous = NORMAL");
+    groupCommit = true;
+  }
+
   db->onWrite(KJ_BIND_METHOD(*this, onWrite));
+  db->onWalCommit(KJ_BIND_METHOD(*this, onWalCommit));
 }
 
 ActorSqlite::ImplicitTxn::ImplicitTxn(ActorSqlite& parent)
@@ -107,7 +115,7 @@ kj::Maybe<kj::Promise<void>> ActorSqlite::ExplicitTxn::commit() {
     // We committed the root transaction, so it's time to signal any replication layer and lock
     // the output gate in the meantime.
     actorSqlite.commitTasks.add(
-        actorSqlite.outputGate.lockWhile(actorSqlite.commitCallback()));
+        actorSqlite.outputGate.lockWhile(actorSqlite.afterCommit()));
   }
 
   // No backpressure for SQLite.
@@ -157,11 +165,66 @@ void ActorSqlite::onWrite() {
       // rather than after the callback.
       { auto drop = kj::mv(txn); }
 
-      return commitCallback();
+      return afterCommit();
     })));
   }
 }
 
+kj::Promise<void> ActorSqlite::afterCommit() {
+  auto promises = kj::heapArrayBuilder<kj::Promise<void>>(2);
+  promises.add(syncCommits());
+  promises.add(commitCallback());
+  return kj::joinPromises(promises.finish());
+}
+
+kj::Promise<void> ActorSqlite::syncCommits() {
+  if (!groupCommit) {
+    // Each commit was synced as it happened.
+    return kj::READY_NOW;
+  }
+
+  if (!syncScheduled) {
+    // Defer the sync so that any other transactions committed during this turn of the event loop,
+    // including the implicit transaction, can share it.
+    syncScheduled = true;
+    pendingSync = kj::evalLater([this]() {
+      // Commits made from now on need another sync.
+      syncScheduled = false;
+
+      requireNotBroken();
+      hooks.syncWal(*db);
+    }).fork();
+  }
+
+  return KJ_ASSERT_NONNULL(pendingSync).addBranch();
+}
+
+void ActorSqlite::onWalCommit(uint walPages) {
+  if (walPages >= CHECKPOINT_THRESHOLD_PAGES && !checkpointScheduled) {
+    checkpointScheduled = true;
+    commitTasks.add(kj::evalLast([this]() {
+      checkpointScheduled = false;
+      checkpoint();
+    }));
+  }
+}
+
+void ActorSqlite::checkpoint() {
+  if (broken != kj::none) return;
+
+  if (!currentTxn.is<NoTxn>()) {
+    // SQLite can't checkpoint in the middle of a transaction. The log is still over the threshold,
+    // so another checkpoint will be scheduled when the transaction commits.
+    return;
+  }
+
+  // A failed checkpoint leaves the log intact, so it shouldn't break the actor. The next commit
+  // will schedule another attempt.
+  KJ_IF_SOME(exception, kj::runCatchingExceptions([&]() { db->checkpoint(); })) {
+    KJ_LOG(WARNING, "SQLite checkpoint failed", exception);
+  }
+}
+
 void ActorSqlite::taskFailed(kj::Exception&& exception) {
   // The output gate should already have been broken since it wraps all commits tasks. So, we
   // don't have to report anything here, the exception will already propagate elsewhere. We
@@ -196,14 +259,13 @@ kj::OneOf<ActorCacheOps::GetResultList, kj::Promise<ActorCacheOps::GetResultList
     ActorSqlite::get(kj::Array<Key> keys, ReadOptions options) {
   requireNotBroken();
 
-  kj::Vector<KeyValuePair> results;
-  for (auto& key: keys) {
-    kv.get(key, [&](ValuePtr value) {
-      results.add(KeyValuePair { kj::mv(key), kj::heapArray(value) });
-    });
-  }
-  std::sort(results.begin(), results.end(),
-      [](auto& a, auto& b) { return a.key < b.key; });
+  // With sorted keys, results come back sorted.
+  auto keyPtrs = KJ_MAP(key, keys) -> KeyPtr { return key; };
+  std::sort(keyPtrs.begin(), keyPtrs.end());
+  kj::Vector<KeyValuePair> results(keys.size());
+  kv.get(keyPtrs, [&](KeyPtr key, ValuePtr value) {
+    results.add(KeyValuePair { kj::str(key), kj::heapArray(value) });
+  });
   return GetResultList(kj::mv(results));
 }
 
@@ -252,9 +314,9 @@ kj::Maybe<kj::Promise<void>> ActorSqlite::put(
     kj::Array<KeyValuePair> pairs, WriteOptions options) {
   requireNotBroken();
 
-  for (auto& pair: pairs) {
-    kv.put(pair.key, pair.value);
-  }
+  auto keyPtrs = KJ_MAP(pair, pairs) -> KeyPtr { return pair.key; };
+  auto valuePtrs = KJ_MAP(pair, pairs) -> ValuePtr { return pair.value; };
+  kv.put(keyPtrs, valuePtrs);
   return kj::none;
 }
 
@@ -268,11 +330,8 @@ kj::OneOf<uint, kj::Promise<uint>> ActorSqlite::delete_(
     kj::Array<Key> keys, WriteOptions options) {
   requireNotBroken();
 
-  uint count = 0;
-  for (auto& key: keys) {
-    count += kv.delete_(key);
-  }
-  return count;
+  auto keyPtrs = KJ_MAP(key, keys) -> KeyPtr { return key; };
+  return kv.delete_(keyPtrs);
 }
 
 kj::Maybe<kj::Promise<void>> ActorSqlite::setAlarm(
@@ -282,6 +341,12 @@ kj::Maybe<kj::Promise<void>> ActorSqlite::setAlarm(
   return hooks.setAlarm(newAlarmTime);
 }
 
+kj::Maybe<SqliteKv&> ActorSqlite::getSqliteKv() {
+  requireNotBroken();
+
+  return kv;
+}
+
 kj::Own<ActorCacheInterface::Transaction> ActorSqlite::startTransaction() {
   requireNotBroken();
 
@@ -375,6 +440,10 @@ kj::Promise<void> ActorSqlite::Hooks::setAlarm(kj::Maybe<kj::Date>) {
   JSG_FAIL_REQUIRE(Error, "setAlarm() is not yet implemented for SQLite-backed Durable Objects");
 }
 
+void ActorSqlite::Hooks::syncWal(SqliteDatabase& db) {
+  db.syncWal();
+}
+
 kj::OneOf<kj::Maybe<ActorCacheOps::Value>, kj::Promise<kj::Maybe<ActorCacheOps::Value>>>
     ActorSqlite::ExplicitTxn::get(Key key, ReadOptions options) {
   return actorSqlite.get(kj::mv(key), options);
@@ -417,5 +486,8 @@ kj::Maybe<kj::Promise<void>> ActorSqlite::ExplicitTxn::setAlarm(
     kj::Maybe<kj::Date> newAlarmTime, WriteOptions options) {
   return actorSqlite.setAlarm(newAlarmTime, options);
 }
+kj::Maybe<SqliteKv&> ActorSqlite::ExplicitTxn::getSqliteKv() {
+  return actorSqlite.getSqliteKv();
+}
 
 }  // namespace workerd
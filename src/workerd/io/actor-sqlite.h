@@ -11,15 +11,14 @@ namespace workerd {
 
 // An implementation of ActorCacheOps that is backed by SqliteKv.
 class ActorSqlite final: public ActorCacheInterface, private kj::TaskSet::ErrorHandler {
-  // TODO(perf): This interface is not designed ideally for wrapping SqliteKv. In particular, we
-  //   end up allocating extra copies of all the results. It would be nicer if we could actually
-  //   parse the V8-serialized values directly from the blob pointers that SQLite spits out.
-  //   However, that probably requires rewriting `DurableObjectStorageOperations`. For now, hooking
-  //   here is easier and not too costly.
+  // Note: This interface is not designed ideally for wrapping SqliteKv, as it allocates copies
+  //   of all the results. So, `DurableObjectStorageOperations` uses getSqliteKv() to parse
+  //   V8-serialized values directly from the blob pointers that SQLite spits out when doing
+  //   multi-key get()s and list()s.
 
 public:
-  // Hooks to configure ActorSqlite behavior, right now only used to allow plugging in a backend
-  // for alarm operations.
+  // Hooks to configure ActorSqlite behavior, used to allow plugging in a backend for alarm
+  // operations, and to customize how grouped commits are made durable.
   class Hooks {
   public:
     virtual kj::Promise<kj::Maybe<kj::Date>> getAlarm();
@@ -27,6 +26,11 @@ public:
     virtual kj::Maybe<kj::Own<void>> armAlarmHandler(kj::Date scheduledTime, bool noCache);
     virtual void cancelDeferredAlarmDeletion();
 
+    // Called to sync the write-ahead log once the transactions of a group commit have committed.
+    // The output gate stays locked until this returns, and is broken if it throws. The default
+    // implementation calls `db.syncWal()`.
+    virtual void syncWal(SqliteDatabase& db);
+
     static Hooks DEFAULT;
   };
 
@@ -39,6 +43,11 @@ public:
   // `commitCallback` will be invoked after committing a transaction. The output gate will block on
   // the returned promise. This can be used e.g. when the database needs to be replicated to other
   // machines before being considered durable.
+  //
+  // If the database is in WAL mode, commits are grouped: transactions committed in the same turn
+  // of the event loop do not sync the write-ahead log individually, but share a single sync which
+  // the output gate waits on. Checkpoints are likewise taken off the commit path, running once the
+  // event loop is otherwise idle.
   explicit ActorSqlite(kj::Own<SqliteDatabase> dbParam, OutputGate& outputGate,
                        kj::Function<kj::Promise<void>()> commitCallback,
                        Hooks& hooks = Hooks::DEFAULT);
@@ -62,6 +71,7 @@ public:
   kj::OneOf<bool, kj::Promise<bool>> delete_(Key key, WriteOptions options) override;
   kj::OneOf<uint, kj::Promise<uint>> delete_(kj::Array<Key> keys, WriteOptions options) override;
   kj::Maybe<kj::Promise<void>> setAlarm(kj::Maybe<kj::Date> newAlarmTime, WriteOptions options) override;
+  kj::Maybe<SqliteKv&> getSqliteKv() override;
   // See ActorCacheOps.
 
   kj::Own<ActorCacheInterface::Transaction> startTransaction() override;
@@ -85,6 +95,20 @@ private:
 
   kj::Maybe<kj::Exception> broken;
 
+  // Checkpoint once the write-ahead log holds this many pages. This is the same threshold SQLite
+  // uses for automatic checkpoints.
+  static constexpr uint CHECKPOINT_THRESHOLD_PAGES = 1000;
+
+  // True if the database is in WAL mode, in which case commits don't sync the log themselves, and
+  // syncCommits() must be used to make them durable.
+  bool groupCommit = false;
+
+  // Sync shared by the commits made since the last one started. Only valid while `syncScheduled`.
+  kj::Maybe<kj::ForkedPromise<void>> pendingSync;
+  bool syncScheduled = false;
+
+  bool checkpointScheduled = false;
+
   struct NoTxn {};
 
   class ImplicitTxn {
@@ -127,6 +151,7 @@ private:
     kj::OneOf<uint, kj::Promise<uint>> delete_(kj::Array<Key> keys, WriteOptions options) override;
     kj::Maybe<kj::Promise<void>> setAlarm(
         kj::Maybe<kj::Date> newAlarmTime, WriteOptions options) override;
+    kj::Maybe<SqliteKv&> getSqliteKv() override;
     // Implements ActorCacheOps. These will all forward to the ActorSqlite instance.
 
   private:
@@ -153,6 +178,17 @@ private:
 
   void onWrite();
 
+  // Returns a promise that resolves once everything committed so far is durable, including
+  // anything `commitCallback` does.
+  kj::Promise<void> afterCommit();
+
+  // Returns a promise that resolves once the write-ahead log has been synced, covering all commits
+  // made so far. All calls made before the sync starts share it.
+  kj::Promise<void> syncCommits();
+
+  void onWalCommit(uint walPages);
+  void checkpoint();
+
   void taskFailed(kj::Exception&& exception) override;
 
   void requireNotBroken();
@@ -215,6 +215,10 @@ public:
   virtual void addStorageWriteUnits(uint32_t units) {}
   virtual void addStorageDeletes(uint32_t count) {}
 
+  // Reports a storage flush that was written as a transaction split into `batchCount` batches,
+  // totaling `byteCount` bytes, which took `latency` from the first batch being sent to commit.
+  virtual void storageTxnFlushed(size_t batchCount, size_t byteCount, kj::Duration latency) {}
+
   virtual void inputGateLocked() {}
   virtual void inputGateReleased() {}
   virtual void inputGateWaiterAdded() {}
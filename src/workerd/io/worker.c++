@@ -1415,6 +1415,10 @@ Worker::Worker(kj::Own<const Script> scriptParam,
                         "module was originally instantiated in a different context");
                   }
 
+                  // Now that the bundle's top-level code has run, V8 has compiled the functions it
+                  // called, so any code cache data produced now covers them.
+                  registry.produceCodeCache(lock);
+
                   impl->env = lock.v8Ref(bindingsScope.As<v8::Value>());
 
                   auto& api = script->isolate->getApi();
@@ -2882,6 +2886,9 @@ struct Worker::Actor::Impl {
     // Implements ActorCache::Hooks
 
     void updateAlarmInMemory(kj::Maybe<kj::Date> newAlarmTime) override;
+    void txnFlushCompleted(size_t batchCount, size_t byteCount, kj::Duration latency) override {
+      metrics.storageTxnFlushed(batchCount, byteCount, latency);
+    }
 
   private:
     kj::Own<Loopback> loopback;    // only for updateAlarmInMemory()
@@ -376,12 +376,55 @@ static CompilationObserver::Option convertOption(ModuleInfoCompileOption option)
   KJ_UNREACHABLE;
 }
 
+// Looks for code cache data to compile a bundle module with. Sets `pending`, which the caller
+// clears if V8 accepts the data.
+kj::Maybe<kj::Array<const kj::byte>> findCodeCache(
+    kj::Maybe<const CodeCache&> codeCache,
+    CodeCache::Type type,
+    kj::ArrayPtr<const char> content,
+    kj::Maybe<PendingCodeCache>& pending) {
+  KJ_IF_SOME(cache, codeCache) {
+    auto key = cache.getKey(type, content);
+    auto result = cache.get(key);
+    pending = PendingCodeCache { &cache, kj::mv(key) };
+    return result;
+  }
+  return kj::none;
+}
+
+// Wraps data returned by findCodeCache() for a v8::ScriptCompiler::Source, which takes ownership
+// of the wrapper (but not the data).
+v8::ScriptCompiler::CachedData* wrapCodeCache(kj::Maybe<kj::Array<const kj::byte>>& data) {
+  KJ_IF_SOME(d, data) {
+    return new v8::ScriptCompiler::CachedData(d.begin(), d.size());
+  }
+  return nullptr;
+}
+
+// Reports whether V8 accepted the data passed with `source`, if any.
+void checkCodeCacheConsumed(jsg::Lock& js,
+    kj::StringPtr name,
+    const v8::ScriptCompiler::Source& source,
+    kj::Maybe<PendingCodeCache>& pending,
+    const CompilationObserver& observer) {
+  auto cached = source.GetCachedData();
+  if (cached == nullptr) return;
+  if (cached->rejected) {
+    observer.onCodeCacheRejected(js.v8Isolate, name);
+  } else {
+    observer.onCodeCacheHit(js.v8Isolate, name);
+    pending = kj::none;
+  }
+}
+
 v8::Local<v8::Module> compileEsmModule(
     jsg::Lock& js,
     kj::StringPtr name,
     kj::ArrayPtr<const char> content,
     ModuleInfoCompileOption option,
-    const CompilationObserver& observer) {
+    const CompilationObserver& observer,
+    kj::Maybe<const CodeCache&> codeCache,
+    kj::Maybe<PendingCodeCache>& pendingCodeCache) {
   // destroy the observer after compilation finished to indicate the end of the process.
   auto compilationObserver = observer.onEsmCompilationStart(js.v8Isolate, name, convertOption(option));
 
@@ -430,8 +473,12 @@ v8::Local<v8::Module> compileEsmModule(
 
   contentStr = jsg::v8Str(js.v8Isolate, content);
 
-  v8::ScriptCompiler::Source source(contentStr, origin);
-  auto module = jsg::check(v8::ScriptCompiler::CompileModule(js.v8Isolate, &source));
+  auto cachedData = findCodeCache(codeCache, CodeCache::Type::ESM, content, pendingCodeCache);
+  v8::ScriptCompiler::Source source(contentStr, origin, wrapCodeCache(cachedData));
+  auto options = cachedData == kj::none ? v8::ScriptCompiler::kNoCompileOptions
+                                        : v8::ScriptCompiler::kConsumeCodeCache;
+  auto module = jsg::check(v8::ScriptCompiler::CompileModule(js.v8Isolate, &source, options));
+  checkCodeCacheConsumed(js, name, source, pendingCodeCache, observer);
 
   return module;
 }
@@ -467,8 +514,10 @@ ModuleRegistry::ModuleInfo::ModuleInfo(
     kj::StringPtr name,
     kj::ArrayPtr<const char> content,
     ModuleInfoCompileOption flags,
-    const CompilationObserver& observer)
-    : ModuleInfo(js, compileEsmModule(js, name, content, flags, observer)) {}
+    const CompilationObserver& observer,
+    kj::Maybe<const CodeCache&> codeCache)
+    : module(js.v8Isolate,
+             compileEsmModule(js, name, content, flags, observer, codeCache, pendingCodeCache)) {}
 
 ModuleRegistry::ModuleInfo::ModuleInfo(
     jsg::Lock& js,
@@ -484,6 +533,66 @@ ModuleRegistry::CommonJsModuleInfo::initModuleContext(
   return jsg::alloc<jsg::CommonJsModuleContext>(js, kj::Path::parse(name));
 }
 
+void ModuleRegistry::ModuleInfo::produceCodeCache(
+    jsg::Lock& js,
+    const kj::Path& specifier,
+    const CompilationObserver& observer) {
+  kj::Maybe<PendingCodeCache>* pending = &pendingCodeCache;
+  std::unique_ptr<v8::ScriptCompiler::CachedData> data;
+
+  KJ_IF_SOME(synthetic, maybeSynthetic) {
+    kj::Maybe<jsg::Function<void()>&> evalFunc;
+    KJ_IF_SOME(info, synthetic.tryGet<CommonJsModuleInfo>()) {
+      pending = &info.pendingCodeCache;
+      evalFunc = info.evalFunc;
+    } else KJ_IF_SOME(info, synthetic.tryGet<NodeJsModuleInfo>()) {
+      pending = &info.pendingCodeCache;
+      evalFunc = info.evalFunc;
+    }
+    if (*pending == kj::none) return;
+    KJ_IF_SOME(func, evalFunc) {
+      KJ_IF_SOME(handle, func.tryGetHandle(js.v8Isolate)) {
+        data.reset(v8::ScriptCompiler::CreateCodeCacheForFunction(handle));
+      }
+    }
+  } else {
+    if (pendingCodeCache == kj::none) return;
+    auto handle = module.getHandle(js);
+    if (handle->GetStatus() != v8::Module::Status::kErrored) {
+      data.reset(v8::ScriptCompiler::CreateCodeCache(handle->GetUnboundModuleScript()));
+    }
+  }
+
+  auto& p = KJ_ASSERT_NONNULL(*pending);
+  if (data != nullptr) {
+    p.cache->put(p.key, kj::arrayPtr(data->data, data->length));
+    observer.onCodeCacheProduced(js.v8Isolate, specifier.toString(), data->length);
+  }
+  *pending = kj::none;
+}
+
+v8::Local<v8::Function> compileModuleFunction(jsg::Lock& js,
+    kj::StringPtr name,
+    kj::StringPtr content,
+    v8::Local<v8::Object> moduleContext,
+    kj::Maybe<const CodeCache&> codeCache,
+    kj::Maybe<PendingCodeCache>& pending) {
+  auto cachedData = findCodeCache(codeCache, CodeCache::Type::FUNCTION, content, pending);
+  v8::ScriptOrigin origin(v8StrIntern(js.v8Isolate, name));
+  v8::ScriptCompiler::Source source(v8Str(js.v8Isolate, content), origin,
+                                    wrapCodeCache(cachedData));
+  auto options = cachedData == kj::none ? v8::ScriptCompiler::kNoCompileOptions
+                                        : v8::ScriptCompiler::kConsumeCodeCache;
+  auto fn = jsg::check(v8::ScriptCompiler::CompileFunction(
+      js.v8Context(),
+      &source,
+      0, nullptr,
+      1, &moduleContext,
+      options));
+  checkCodeCacheConsumed(js, name, source, pending, IsolateBase::from(js.v8Isolate).getObserver());
+  return fn;
+}
+
 ModuleRegistry::CapnpModuleInfo::CapnpModuleInfo(
     Value fileScope,
     kj::HashMap<kj::StringPtr, jsg::Value> topLevelDecls)
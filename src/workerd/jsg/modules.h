@@ -194,6 +194,45 @@ enum class ModuleInfoCompileOption {
   BUILTIN,
 };
 
+// Storage for V8 code cache data (see v8::ScriptCompiler::CreateCodeCache()) of worker bundle
+// modules, so that a module which was compiled before -- by another isolate, or by a previous run
+// of the process -- can skip most of parsing and compilation. Implementations must be thread-safe.
+class CodeCache {
+public:
+  // Compiling the same source as an ES module or as a function produces incompatible data.
+  enum class Type { ESM, FUNCTION };
+
+  // Returns the key identifying data for a module of the given type and source. Besides the
+  // source, the key must reflect the V8 version and flags (see
+  // v8::ScriptCompiler::CachedDataVersionTag()), since data produced under others is rejected.
+  virtual kj::String getKey(Type type, kj::ArrayPtr<const char> content) const = 0;
+
+  virtual kj::Maybe<kj::Array<const kj::byte>> get(kj::StringPtr key) const = 0;
+
+  // Stores `data` under `key`, replacing any previous data.
+  virtual void put(kj::StringPtr key, kj::ArrayPtr<const kj::byte> data) const = 0;
+};
+
+// Identifies code cache data to be produced for a module that was compiled without any (or whose
+// data was rejected). Production is deferred until the module has been evaluated, by which time V8
+// has also compiled the functions called during evaluation, so the data covers those too. See
+// ModuleRegistry::produceCodeCache().
+struct PendingCodeCache {
+  // A pointer so that module infos remain move-assignable.
+  const CodeCache* cache;
+  kj::String key;
+};
+
+// Compiles the source of a CommonJS-style module as a function, with the properties of
+// `moduleContext` in scope. If `codeCache` is given, data found there is consumed; otherwise
+// `pending` is set.
+v8::Local<v8::Function> compileModuleFunction(jsg::Lock& js,
+    kj::StringPtr name,
+    kj::StringPtr content,
+    v8::Local<v8::Object> moduleContext,
+    kj::Maybe<const CodeCache&> codeCache,
+    kj::Maybe<PendingCodeCache>& pending);
+
 v8::Local<v8::WasmModuleObject> compileWasmModule(jsg::Lock& js,
     kj::ArrayPtr<const uint8_t> code,
     const CompilationObserver& observer);
@@ -237,12 +276,15 @@ public:
   };
 
   struct NodeJsModuleInfo {
+    // Declared first since it is set while initializing `evalFunc`.
+    kj::Maybe<PendingCodeCache> pendingCodeCache;
     jsg::Ref<jsg::Object> moduleContext;
     jsg::Function<void()> evalFunc;
 
-    NodeJsModuleInfo(auto& lock, kj::StringPtr name, kj::StringPtr content)
+    NodeJsModuleInfo(auto& lock, kj::StringPtr name, kj::StringPtr content,
+                     kj::Maybe<const CodeCache&> codeCache = kj::none)
         : moduleContext(initModuleContext(lock, name)),
-          evalFunc(initEvalFunc(lock, moduleContext, name, content)) {}
+          evalFunc(initEvalFunc(lock, moduleContext, name, content, codeCache, pendingCodeCache)) {}
 
     NodeJsModuleInfo(NodeJsModuleInfo&&) = default;
     NodeJsModuleInfo& operator=(NodeJsModuleInfo&&) = default;
@@ -255,31 +297,30 @@ public:
                                               NodeJsModuleInfo& info,
                                               v8::Local<v8::Module> module);
 
-    jsg::Function<void()> initEvalFunc(
+    static jsg::Function<void()> initEvalFunc(
         auto& lock,
         jsg::Ref<jsg::Object>& moduleContext,
         kj::StringPtr name,
-        kj::StringPtr content) {
-      v8::ScriptOrigin origin(v8StrIntern(lock.v8Isolate, name));
-      v8::ScriptCompiler::Source source(v8Str(lock.v8Isolate, content), origin);
+        kj::StringPtr content,
+        kj::Maybe<const CodeCache&> codeCache,
+        kj::Maybe<PendingCodeCache>& pendingCodeCache) {
       auto context = lock.v8Context();
       auto handle = lock.wrap(context, moduleContext.addRef());
-      auto fn = jsg::check(v8::ScriptCompiler::CompileFunction(
-          context,
-          &source,
-          0, nullptr,
-          1, &handle));
+      auto fn = compileModuleFunction(lock, name, content, handle, codeCache, pendingCodeCache);
       return lock.template unwrap<jsg::Function<void()>>(context, fn);
     }
   };
 
   struct CommonJsModuleInfo {
+    // Declared first since it is set while initializing `evalFunc`.
+    kj::Maybe<PendingCodeCache> pendingCodeCache;
     Ref<CommonJsModuleContext> moduleContext;
     jsg::Function<void()> evalFunc;
 
-    CommonJsModuleInfo(auto& lock, kj::StringPtr name, kj::StringPtr content)
+    CommonJsModuleInfo(auto& lock, kj::StringPtr name, kj::StringPtr content,
+                       kj::Maybe<const CodeCache&> codeCache = kj::none)
         : moduleContext(initModuleContext(lock, name)),
-          evalFunc(initEvalFunc(lock, moduleContext, name, content)) {}
+          evalFunc(initEvalFunc(lock, moduleContext, name, content, codeCache, pendingCodeCache)) {}
 
     CommonJsModuleInfo(CommonJsModuleInfo&&) = default;
     CommonJsModuleInfo& operator=(CommonJsModuleInfo&&) = default;
@@ -292,16 +333,12 @@ public:
         auto& lock,
         Ref<CommonJsModuleContext>& moduleContext,
         kj::StringPtr name,
-        kj::StringPtr content) {
-      v8::ScriptOrigin origin(v8StrIntern(lock.v8Isolate, name));
-      v8::ScriptCompiler::Source source(v8Str(lock.v8Isolate, content), origin);
+        kj::StringPtr content,
+        kj::Maybe<const CodeCache&> codeCache,
+        kj::Maybe<PendingCodeCache>& pendingCodeCache) {
       auto context = lock.v8Context();
       auto handle = lock.wrap(context, moduleContext.addRef());
-      auto fn = jsg::check(v8::ScriptCompiler::CompileFunction(
-          context,
-          &source,
-          0, nullptr,
-          1, &handle));
+      auto fn = compileModuleFunction(lock, name, content, handle, codeCache, pendingCodeCache);
       return lock.template unwrap<jsg::Function<void()>>(context, fn);
     }
   };
@@ -323,6 +360,9 @@ public:
   using ObjectModuleInfo = ValueModuleInfo<v8::Object>;
 
   struct ModuleInfo {
+    // Set for ES modules compiled without usable code cache data. Declared first since it is set
+    // while initializing `module`.
+    kj::Maybe<PendingCodeCache> pendingCodeCache;
     HashableV8Ref<v8::Module> module;
 
     using SyntheticModuleInfo = kj::OneOf<CapnpModuleInfo,
@@ -339,11 +379,13 @@ public:
                v8::Local<v8::Module> module,
                kj::Maybe<SyntheticModuleInfo> maybeSynthetic = kj::none);
 
+    // `codeCache` is only used for BUNDLE modules.
     ModuleInfo(jsg::Lock& js,
                kj::StringPtr name,
                kj::ArrayPtr<const char> content,
                ModuleInfoCompileOption flags,
-               const CompilationObserver& observer);
+               const CompilationObserver& observer,
+               kj::Maybe<const CodeCache&> codeCache = kj::none);
 
     ModuleInfo(jsg::Lock& js, kj::StringPtr name,
                kj::Maybe<kj::ArrayPtr<kj::StringPtr>> maybeExports,
@@ -353,6 +395,10 @@ public:
     ModuleInfo& operator=(ModuleInfo&&) = default;
 
     uint hashCode() const { return module.hashCode(); }
+
+    // Produces and stores pending code cache data, if any.
+    void produceCodeCache(jsg::Lock& js, const kj::Path& specifier,
+                          const CompilationObserver& observer);
   };
 
   struct ModuleRef {
@@ -391,6 +437,10 @@ public:
   using DynamicImportCallback = Promise<Value>(jsg::Lock& js, kj::Function<Value()> handler);
 
   virtual void setDynamicImportCallback(kj::Function<DynamicImportCallback> func) = 0;
+
+  // Produces code cache data for all bundle modules that were compiled without usable data (see
+  // CodeCache). Should be called once the main module has been evaluated.
+  virtual void produceCodeCache(jsg::Lock& js) = 0;
 };
 
 template <typename TypeWrapper>
@@ -687,6 +737,14 @@ public:
     return js.v8Ref(handle->GetModuleNamespace());
   }
 
+  void produceCodeCache(jsg::Lock& js) override {
+    for (const kj::Own<Entry>& entry : entries) {
+      KJ_IF_SOME(info, entry->info.template tryGet<ModuleInfo>()) {
+        const_cast<ModuleInfo&>(info).produceCodeCache(js, entry->specifier, observer);
+      }
+    }
+  }
+
   CompilationObserver& getObserver() { return observer; }
 
 private:
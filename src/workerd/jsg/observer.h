@@ -36,6 +36,18 @@ struct CompilationObserver {
   virtual kj::Own<void> onWasmCompilationStart(v8::Isolate* isolate, size_t codeSize) const {
     return kj::Own<void>();
   }
+
+  // Called when a worker bundle module was compiled using data from the code cache (see
+  // jsg::CodeCache).
+  virtual void onCodeCacheHit(v8::Isolate* isolate, kj::StringPtr name) const {}
+
+  // Called when code cache data was found for a worker bundle module, but V8 rejected it (e.g.
+  // because it is corrupt). The module is compiled from scratch and the data is replaced.
+  virtual void onCodeCacheRejected(v8::Isolate* isolate, kj::StringPtr name) const {}
+
+  // Called when code cache data of `size` bytes was produced for a worker bundle module and
+  // stored in the code cache.
+  virtual void onCodeCacheProduced(v8::Isolate* isolate, kj::StringPtr name, size_t size) const {}
 };
 
 struct InternalExceptionObserver {
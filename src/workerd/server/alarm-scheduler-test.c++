@@ -0,0 +1,283 @@
+// Copyright (c) 2023 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "alarm-scheduler.h"
+#include <kj/test.h>
+#include <kj/filesystem.h>
+
+namespace workerd::server {
+namespace {
+
+constexpr kj::Date START = kj::UNIX_EPOCH + 1'000'000 * kj::SECONDS;
+
+class MockClock final: public kj::Clock {
+public:
+  kj::Date now() const override { return time; }
+
+  kj::Date time = START;
+};
+
+// Wraps an expected getAlarm() result for comparison.
+kj::Maybe<kj::Date> at(kj::Date time) { return time; }
+
+struct FiredAlarm {
+  kj::String actorId;
+  kj::Date scheduledTime;
+  uint32_t retryCount;
+};
+
+// An actor whose alarm handler records each invocation, failing while `failuresLeft` is nonzero.
+class MockActor final: public WorkerInterface {
+public:
+  MockActor(kj::Vector<FiredAlarm>& fired, uint& failuresLeft, kj::String id)
+      : fired(fired), failuresLeft(failuresLeft), id(kj::mv(id)) {}
+
+  kj::Promise<AlarmResult> runAlarm(kj::Date scheduledTime, uint32_t retryCount) override {
+    fired.add(FiredAlarm { kj::mv(id), scheduledTime, retryCount });
+    if (failuresLeft > 0) {
+      --failuresLeft;
+      return AlarmResult { .retry = true, .outcome = EventOutcome::EXCEPTION };
+    }
+    return AlarmResult { .retry = false, .outcome = EventOutcome::OK };
+  }
+
+  kj::Promise<void> request(
+      kj::HttpMethod method, kj::StringPtr url, const kj::HttpHeaders& headers,
+      kj::AsyncInputStream& requestBody, kj::HttpService::Response& response) override {
+    KJ_UNIMPLEMENTED("not used");
+  }
+  kj::Promise<void> connect(kj::StringPtr host, const kj::HttpHeaders& headers,
+                            kj::AsyncIoStream& connection, ConnectResponse& response,
+                            kj::HttpConnectSettings settings) override {
+    KJ_UNIMPLEMENTED("not used");
+  }
+  void prewarm(kj::StringPtr url) override {}
+  kj::Promise<ScheduledResult> runScheduled(kj::Date scheduledTime, kj::StringPtr cron) override {
+    KJ_UNIMPLEMENTED("not used");
+  }
+  kj::Promise<CustomEvent::Result> customEvent(kj::Own<CustomEvent> event) override {
+    KJ_UNIMPLEMENTED("not used");
+  }
+
+private:
+  kj::Vector<FiredAlarm>& fired;
+  uint& failuresLeft;
+  kj::String id;
+};
+
+// An AlarmScheduler whose database can outlive it, to test reloading alarms after a restart.
+struct AlarmTest {
+  kj::EventLoop loop;
+  kj::WaitScope ws;
+  MockClock clock;
+  kj::TimerImpl timer;
+  kj::Own<const kj::Directory> dir;
+  SqliteDatabase::Vfs vfs;
+  kj::Own<AlarmScheduler> scheduler;
+
+  kj::Vector<FiredAlarm> fired;
+  uint failuresLeft = 0;
+
+  AlarmTest()
+      : ws(loop),
+        timer(kj::origin<kj::TimePoint>()),
+        dir(kj::newInMemoryDirectory(kj::nullClock())),
+        vfs(*dir) {
+    restart();
+  }
+
+  // Replaces the scheduler with a new one, which loads its alarms from the database.
+  void restart() {
+    scheduler = nullptr;
+    scheduler = kj::heap<AlarmScheduler>(clock, timer, vfs, kj::Path({"alarms.sqlite"}));
+    scheduler->registerNamespace("ns", [this](kj::String id) -> kj::Own<WorkerInterface> {
+      return kj::heap<MockActor>(fired, failuresLeft, kj::mv(id));
+    });
+  }
+
+  // Moves the clock forward, letting the scheduler run whatever became due (including loading
+  // further pages of alarms from the database, which takes a wake-up per page).
+  void advance(kj::Duration duration) {
+    clock.time += duration;
+    for (uint i = 0; i < 16; i++) {
+      timer.advanceTo(kj::origin<kj::TimePoint>() + (clock.time - START));
+      ws.poll();
+    }
+  }
+
+  void set(kj::StringPtr id, kj::Date time) {
+    scheduler->setAlarm(ActorKey { .uniqueKey = "ns", .actorId = id }, time).wait(ws);
+  }
+  void remove(kj::StringPtr id) {
+    scheduler->deleteAlarm(ActorKey { .uniqueKey = "ns", .actorId = id }).wait(ws);
+  }
+  kj::Maybe<kj::Date> get(kj::StringPtr id) {
+    return scheduler->getAlarm(ActorKey { .uniqueKey = "ns", .actorId = id });
+  }
+};
+
+KJ_TEST("AlarmScheduler: set and delete") {
+  AlarmTest test;
+
+  test.set("a", START + 10 * kj::SECONDS);
+  test.set("b", START + 20 * kj::SECONDS);
+  test.set("c", START + 30 * kj::SECONDS);
+  KJ_EXPECT(test.get("b") == at(START + 20 * kj::SECONDS));
+
+  // Setting an alarm again replaces it.
+  test.set("c", START + 15 * kj::SECONDS);
+  KJ_EXPECT(test.get("c") == at(START + 15 * kj::SECONDS));
+
+  test.remove("b");
+  KJ_EXPECT(test.get("b") == kj::none);
+  KJ_EXPECT(test.scheduler->getStats().pending == 2);
+
+  test.advance(9 * kj::SECONDS);
+  KJ_EXPECT(test.fired.size() == 0);
+
+  test.advance(1 * kj::SECONDS);
+  KJ_ASSERT(test.fired.size() == 1);
+  KJ_EXPECT(test.fired[0].actorId == "a");
+  KJ_EXPECT(test.fired[0].scheduledTime == START + 10 * kj::SECONDS);
+  KJ_EXPECT(test.fired[0].retryCount == 0);
+  KJ_EXPECT(test.get("a") == kj::none);
+
+  test.advance(30 * kj::SECONDS);
+  KJ_ASSERT(test.fired.size() == 2);
+  KJ_EXPECT(test.fired[1].actorId == "c");
+
+  auto stats = test.scheduler->getStats();
+  KJ_EXPECT(stats.pending == 0);
+  KJ_EXPECT(stats.fired == 2);
+  KJ_EXPECT(stats.retried == 0);
+}
+
+KJ_TEST("AlarmScheduler: changes are written when setAlarm() completes") {
+  AlarmTest test;
+
+  // Read the table through a separate connection, so that nothing is flushed on our behalf.
+  SqliteDatabase db(test.vfs, kj::Path({"alarms.sqlite"}));
+  auto countRows = [&]() { return db.run("SELECT COUNT(*) FROM _cf_ALARM").getInt64(0); };
+
+  // Changes made in one turn are written together at the end of it, and each caller hears once
+  // they're committed.
+  auto promiseA = test.scheduler->setAlarm(
+      ActorKey { .uniqueKey = "ns", .actorId = "a" }, START + 10 * kj::SECONDS);
+  auto promiseB = test.scheduler->setAlarm(
+      ActorKey { .uniqueKey = "ns", .actorId = "b" }, START + 20 * kj::SECONDS);
+  KJ_EXPECT(countRows() == 0);
+  KJ_EXPECT(test.get("a") == at(START + 10 * kj::SECONDS));
+
+  promiseA.wait(test.ws);
+  KJ_EXPECT(countRows() == 2);
+  promiseB.wait(test.ws);
+
+  test.remove("a");
+  KJ_EXPECT(countRows() == 1);
+}
+
+KJ_TEST("AlarmScheduler: failed alarms are retried") {
+  AlarmTest test;
+  test.failuresLeft = 2;
+
+  test.set("a", START + 10 * kj::SECONDS);
+  test.advance(10 * kj::SECONDS);
+  KJ_ASSERT(test.fired.size() == 1);
+
+  // The first retry waits RETRY_START_SECONDS, plus up to 25% jitter. The alarm stays set.
+  test.advance(1 * kj::SECONDS);
+  KJ_EXPECT(test.fired.size() == 1);
+  KJ_EXPECT(test.get("a") == at(START + 10 * kj::SECONDS));
+  test.advance(2 * kj::SECONDS);
+  KJ_ASSERT(test.fired.size() == 2);
+  KJ_EXPECT(test.fired[1].retryCount == 1);
+
+  // The second retry backs off to twice as long.
+  test.advance(3 * kj::SECONDS);
+  KJ_EXPECT(test.fired.size() == 2);
+  test.advance(3 * kj::SECONDS);
+  KJ_ASSERT(test.fired.size() == 3);
+  KJ_EXPECT(test.fired[2].retryCount == 2);
+
+  // Every attempt is passed the time the alarm was set for.
+  for (auto& f: test.fired) {
+    KJ_EXPECT(f.scheduledTime == START + 10 * kj::SECONDS);
+  }
+
+  // The third attempt succeeded, so the alarm is gone.
+  test.advance(60 * kj::SECONDS);
+  KJ_EXPECT(test.fired.size() == 3);
+  auto stats = test.scheduler->getStats();
+  KJ_EXPECT(stats.pending == 0);
+  KJ_EXPECT(stats.fired == 3);
+  KJ_EXPECT(stats.retried == 2);
+}
+
+KJ_TEST("AlarmScheduler: alarms are reloaded after a restart") {
+  AlarmTest test;
+
+  // One alarm due soon, and one beyond LOAD_WINDOW, which isn't held in memory.
+  test.set("soon", START + 10 * kj::SECONDS);
+  test.set("later", START + 2 * kj::HOURS);
+  test.set("deleted", START + 20 * kj::SECONDS);
+  test.remove("deleted");
+
+  test.restart();
+  KJ_EXPECT(test.get("soon") == at(START + 10 * kj::SECONDS));
+  KJ_EXPECT(test.get("later") == at(START + 2 * kj::HOURS));
+  KJ_EXPECT(test.get("deleted") == kj::none);
+  KJ_EXPECT(test.scheduler->getStats().pending == 2);
+
+  test.advance(10 * kj::SECONDS);
+  KJ_ASSERT(test.fired.size() == 1);
+  KJ_EXPECT(test.fired[0].actorId == "soon");
+
+  // The later alarm is loaded as its time approaches, and fires on time.
+  test.advance(1 * kj::HOURS);
+  KJ_EXPECT(test.fired.size() == 1);
+  test.advance(1 * kj::HOURS - 10 * kj::SECONDS - 1 * kj::MILLISECONDS);
+  KJ_EXPECT(test.fired.size() == 1);
+  test.advance(1 * kj::MILLISECONDS);
+  KJ_ASSERT(test.fired.size() == 2);
+  KJ_EXPECT(test.fired[1].actorId == "later");
+  KJ_EXPECT(test.scheduler->getStats().lateFired == 0);
+}
+
+KJ_TEST("AlarmScheduler: alarms are loaded a page at a time") {
+  AlarmTest test;
+
+  // More than two pages of alarms, with pages ending among alarms that share a time, so that
+  // resuming after a page has to compare the actor as well as the time.
+  constexpr uint COUNT = AlarmScheduler::LOAD_PAGE_SIZE * 2 + 100;
+  kj::Vector<kj::Promise<void>> writes;
+  for (uint i = 0; i < COUNT; i++) {
+    writes.add(test.scheduler->setAlarm(
+        ActorKey { .uniqueKey = "ns", .actorId = kj::str(kj::hex(i)) },
+        START + 10 * kj::SECONDS + (i / 10) * kj::MILLISECONDS));
+  }
+  for (auto& write: writes) {
+    write.wait(test.ws);
+  }
+
+  test.restart();
+  KJ_EXPECT(test.scheduler->getStats().pending == COUNT);
+
+  test.advance(20 * kj::SECONDS);
+  KJ_EXPECT(test.fired.size() == COUNT);
+
+  // Each alarm ran exactly once.
+  kj::HashSet<kj::StringPtr> ids;
+  for (auto& f: test.fired) {
+    if (ids.contains(f.actorId)) {
+      KJ_FAIL_EXPECT("alarm ran twice", f.actorId);
+    } else {
+      ids.insert(f.actorId);
+    }
+  }
+  KJ_EXPECT(ids.size() == COUNT);
+  KJ_EXPECT(test.scheduler->getStats().pending == 0);
+}
+
+}  // namespace
+}  // namespace workerd::server
@@ -22,6 +22,21 @@ std::default_random_engine makeSeededRandomEngine() {
   return engine;
 }
 
+kj::Own<ActorKey> ownActorKey(const ActorKey& actor) {
+  auto ownUniqueKey = kj::str(actor.uniqueKey);
+  auto ownActorId = kj::str(actor.actorId);
+  return kj::attachVal(ActorKey { .uniqueKey = ownUniqueKey, .actorId = ownActorId },
+      kj::mv(ownUniqueKey), kj::mv(ownActorId));
+}
+
+int64_t toNanos(kj::Date date) {
+  return (date - kj::UNIX_EPOCH) / kj::NANOSECONDS;
+}
+
+kj::Date fromNanos(int64_t ns) {
+  return kj::UNIX_EPOCH + (kj::NANOSECONDS * ns);
+}
+
 } // namespace
 
 AlarmScheduler::AlarmScheduler(
@@ -37,8 +52,19 @@ AlarmScheduler::AlarmScheduler(
         return kj::mv(db);
       }()),
       tasks(*this) {
-    loadAlarmsFromDb();
+    loadAlarmsFromDb(clock.now());
+    tasks.add(runLoop());
+  }
+
+AlarmScheduler::~AlarmScheduler() noexcept(false) {
+  // Don't lose changes made during the current turn.
+  try {
+    flushWrites();
+  } catch (...) {
+    auto exception = kj::getCaughtExceptionAsKj();
+    KJ_LOG(ERROR, "failed to write alarms", exception);
   }
+}
 
 void AlarmScheduler::ensureInitialized(SqliteDatabase& db) {
   // TODO(sqlite): Do this automatically at a lower layer?
@@ -52,28 +78,74 @@ void AlarmScheduler::ensureInitialized(SqliteDatabase& db) {
       PRIMARY KEY (actor_unique_key, actor_id)
     ) WITHOUT ROWID;
   )");
+
+  // Alarms are loaded in time order, a page at a time.
+  db.run(R"(
+    CREATE INDEX IF NOT EXISTS _cf_ALARM_BY_TIME
+      ON _cf_ALARM (scheduled_time, actor_unique_key, actor_id);
+  )");
 }
 
-void AlarmScheduler::loadAlarmsFromDb() {
-  auto now = clock.now();
+void AlarmScheduler::loadAlarmsFromDb(kj::Date now) {
+  // Loading must see every change made so far. This runs from the run loop, so a failed write
+  // mustn't escape. The changes take precedence over the rows they'd replace in the meantime.
+  tryFlushWrites();
+
+  uint count = 0;
+  kj::Maybe<LoadedUntil> lastRow;
+  auto readPage = [&](SqliteDatabase::Query& query) {
+    while (!query.isDone()) {
+      auto date = fromNanos(query.getInt64(2));
+      ActorKey actor { .uniqueKey = query.getText(0), .actorId = query.getText(1) };
+
+      // An alarm which is already in memory (e.g. retrying), or has an unwritten change, is more
+      // up-to-date than its row.
+      if (alarms.find(actor) == kj::none && pendingWrites.find(actor) == kj::none) {
+        addAlarm(actor, date);
+      }
 
-  // TODO(someday): don't maintain the entire alarm set in memory -- right now for the usecase of
-  // local development, doing so is sufficent.
-  auto query = db->run(R"(
-    SELECT actor_unique_key, actor_id, scheduled_time FROM _cf_ALARM;
-  )");
+      if (++count == LOAD_PAGE_SIZE) {
+        lastRow = LoadedUntil {
+          .time = date, .uniqueKey = kj::str(actor.uniqueKey), .actorId = kj::str(actor.actorId) };
+      }
 
-  while (!query.isDone()) {
-    auto date = kj::UNIX_EPOCH + (kj::NANOSECONDS * query.getInt64(2));
+      query.nextRow();
+    }
+  };
 
-    auto ownUniqueKey = kj::str(query.getText(0));
-    auto ownActorId = kj::str(query.getText(1));
-    auto actor = kj::attachVal(ActorKey { .uniqueKey = ownUniqueKey, .actorId = ownActorId },
-        kj::mv(ownUniqueKey), kj::mv(ownActorId));
+  KJ_IF_SOME(until, loadedUntil) {
+    auto query = stmtLoadNextPage.run(
+        toNanos(until.time), until.uniqueKey.asPtr(), until.actorId.asPtr(), LOAD_PAGE_SIZE);
+    readPage(query);
+  } else {
+    auto query = stmtLoadFirstPage.run(LOAD_PAGE_SIZE);
+    readPage(query);
+  }
 
-    alarms.insert(*actor, scheduleAlarm(now, kj::mv(actor), date));
+  KJ_IF_SOME(row, lastRow) {
+    // The page was full, there may be more rows right after it.
+    loadedUntil = kj::mv(row);
+  } else {
+    // Everything in the database has been loaded, so we can hold every alarm within the window
+    // in memory from now on.
+    auto horizon = now + LOAD_WINDOW;
+    bool extend = true;
+    KJ_IF_SOME(until, loadedUntil) {
+      extend = until.time < horizon;
+    }
+    if (extend) {
+      loadedUntil = LoadedUntil { .time = horizon, .uniqueKey = kj::str(), .actorId = kj::str() };
+    }
+  }
 
-    query.nextRow();
+  // Unwritten alarms aren't loaded from their rows, so add those now within the loaded range.
+  for (auto& write: pendingWrites) {
+    KJ_IF_SOME(time, write.value.scheduledTime) {
+      auto& actor = *write.value.actor;
+      if (alarms.find(actor) == kj::none && isLoaded(time, actor)) {
+        addAlarm(actor, time);
+      }
+    }
   }
 }
 
@@ -92,44 +164,45 @@ kj::Maybe<kj::Date> AlarmScheduler::getAlarm(ActorKey actor) {
     } else {
       return alarm.scheduledTime;
     }
-  } else {
-    // We currently retain the entire set of queued alarms in memory, no need to hit sqlite
-    return kj::none;
   }
-}
 
-bool AlarmScheduler::setAlarm(ActorKey actor, kj::Date scheduledTime) {
-  int64_t scheduledTimeNs = (scheduledTime - kj::UNIX_EPOCH) / kj::NANOSECONDS;
-  auto query = stmtSetAlarm.run(actor.uniqueKey, actor.actorId, scheduledTimeNs);
-
-  bool existing = true;
-  auto& entry = alarms.findOrCreate(actor, [&]() {
-    existing = false;
+  KJ_IF_SOME(write, pendingWrites.find(actor)) {
+    return write.scheduledTime;
+  }
 
-    auto ownUniqueKey = kj::str(actor.uniqueKey);
-    auto ownActorId = kj::str(actor.actorId);
-    auto ownActor = kj::attachVal(ActorKey { .uniqueKey = ownUniqueKey, .actorId = ownActorId },
-    kj::mv(ownUniqueKey), kj::mv(ownActorId));
+  // Alarms which aren't due soon are only stored in the database.
+  auto query = stmtGetAlarm.run(actor.uniqueKey, actor.actorId);
+  if (query.isDone()) {
+    return kj::none;
+  }
+  return fromNanos(query.getInt64(0));
+}
 
-    return decltype(alarms)::Entry {
-        *ownActor, scheduleAlarm(clock.now(), kj::mv(ownActor), scheduledTime) };
-  });
+kj::Promise<void> AlarmScheduler::setAlarm(ActorKey actor, kj::Date scheduledTime) {
+  writeAlarm(actor, scheduledTime);
 
-  if (existing) {
+  KJ_IF_SOME(entry, alarms.find(actor)) {
     if (entry.status != AlarmStatus::WAITING) {
       // We queue any new alarm after the existing alarm even if the new alarm has the same scheduled
       // time, as receiving a notification directly maps to a write for that time in the actor.
       entry.queuedAlarm = scheduledTime;
     } else {
-      entry = scheduleAlarm(clock.now(), kj::mv(entry.actor), scheduledTime);
+      reschedule(entry, scheduledTime);
     }
+  } else if (isLoaded(scheduledTime, actor)) {
+    addAlarm(actor, scheduledTime);
   }
 
-  return query.changeCount() > 0;
+  return whenWritten();
+}
+
+kj::Promise<void> AlarmScheduler::deleteAlarm(ActorKey actor) {
+  removeAlarm(actor);
+  return whenWritten();
 }
 
-bool AlarmScheduler::deleteAlarm(ActorKey actor) {
-  auto query = stmtDeleteAlarm.run(actor.uniqueKey, actor.actorId);
+void AlarmScheduler::removeAlarm(const ActorKey& actor) {
+  writeAlarm(actor, kj::none);
 
   KJ_IF_SOME(entry, alarms.findEntry(actor)) {
     KJ_IF_SOME(queued, entry.value.queuedAlarm) {
@@ -137,64 +210,139 @@ bool AlarmScheduler::deleteAlarm(ActorKey actor) {
         // If we are currently running an alarm, we want to delete the queued instead of current.
         entry.value.queuedAlarm = kj::none;
       } else {
-        entry.value = scheduleAlarm(clock.now(), kj::mv(entry.value.actor), queued);
+        auto time = queued;
+        writeAlarm(actor, time);
+        reschedule(entry.value, time);
       }
     } else {
       if (entry.value.status != AlarmStatus::STARTED) {
         // We can't remove running alarms.
+        dequeue(entry.value);
         alarms.erase(entry);
       }
     }
   }
+}
 
-  return query.changeCount() > 0;
+AlarmScheduler::Stats AlarmScheduler::getStats() {
+  // Count changes made during the current turn too.
+  tryFlushWrites();
+  auto query = stmtCountAlarms.run();
+  return Stats {
+    .pending = static_cast<uint64_t>(query.getInt64(0)),
+    .fired = firedCount,
+    .retried = retriedCount,
+    .lateFired = lateFiredCount,
+  };
 }
 
-kj::Promise<AlarmScheduler::RetryInfo> AlarmScheduler::runAlarm(
-    const ActorKey& actor, kj::Date scheduledTime, uint32_t retryCount) {
-  KJ_IF_SOME(ns, namespaces.find(actor.uniqueKey)) {
-    auto result = co_await ns.getActor(kj::str(actor.actorId))->runAlarm(scheduledTime, retryCount);
+bool AlarmScheduler::QueueKey::operator<(const QueueKey& other) const {
+  if (time != other.time) return time < other.time;
+  if (actor->uniqueKey != other.actor->uniqueKey) {
+    return actor->uniqueKey < other.actor->uniqueKey;
+  }
+  return actor->actorId < other.actor->actorId;
+}
 
-    co_return RetryInfo {
-      .retry = result.outcome != EventOutcome::OK && result.retry,
-      .retryCountsAgainstLimit = result.retryCountsAgainstLimit
-    };
-  } else {
-    throw KJ_EXCEPTION(FAILED, "uniqueKey for stored alarm was not registered?");
+bool AlarmScheduler::isLoaded(kj::Date time, const ActorKey& actor) {
+  // Positions are compared in the same order as the index alarms are loaded by.
+  auto& until = KJ_ASSERT_NONNULL(loadedUntil);
+  if (time != until.time) return time < until.time;
+  if (actor.uniqueKey != until.uniqueKey) return actor.uniqueKey < until.uniqueKey;
+  return !(until.actorId < actor.actorId);
+}
+
+AlarmScheduler::ScheduledAlarm& AlarmScheduler::addAlarm(
+    const ActorKey& actor, kj::Date scheduledTime) {
+  auto ownActor = ownActorKey(actor);
+  ActorKey key = *ownActor;
+  auto& alarm = alarms.insert(key, ScheduledAlarm {
+    .actor = kj::mv(ownActor), .scheduledTime = scheduledTime, .runTime = scheduledTime }).value;
+  enqueue(alarm);
+  return alarm;
+}
+
+void AlarmScheduler::reschedule(ScheduledAlarm& alarm, kj::Date scheduledTime) {
+  dequeue(alarm);
+
+  if (!isLoaded(scheduledTime, *alarm.actor)) {
+    // It's stored in the database, and will be loaded again when its time approaches.
+    alarms.erase(KJ_ASSERT_NONNULL(alarms.findEntry(*alarm.actor)));
+    return;
+  }
+
+  auto actor = kj::mv(alarm.actor);
+  alarm = ScheduledAlarm {
+    .actor = kj::mv(actor), .scheduledTime = scheduledTime, .runTime = scheduledTime };
+  enqueue(alarm);
+}
+
+void AlarmScheduler::enqueue(ScheduledAlarm& alarm) {
+  KJ_ASSERT(!alarm.inQueue);
+  queue.insert(QueueKey { .time = alarm.runTime, .actor = alarm.actor.get() });
+  alarm.inQueue = true;
+
+  KJ_IF_SOME(w, wakeTime) {
+    if (alarm.runTime < w) {
+      // The run loop is sleeping past this alarm's time, wake it so it can wait again.
+      wakeTime = kj::none;
+      wakeUp->fulfill();
+    }
+  }
+}
+
+void AlarmScheduler::dequeue(ScheduledAlarm& alarm) {
+  if (alarm.inQueue) {
+    queue.erase(QueueKey { .time = alarm.runTime, .actor = alarm.actor.get() });
+    alarm.inQueue = false;
   }
 }
 
-AlarmScheduler::ScheduledAlarm AlarmScheduler::scheduleAlarm(
-    kj::Date now, kj::Own<ActorKey> actor, kj::Date scheduledTime) {
-  auto task = makeAlarmTask(scheduledTime - now, *actor, scheduledTime);
+kj::Promise<void> AlarmScheduler::runLoop() {
+  for (;;) {
+    // Wake up for the next alarm, or when it's time to load more alarms from the database.
+    auto next = KJ_ASSERT_NONNULL(loadedUntil).time - LOAD_WINDOW / 2;
+    if (!queue.empty()) {
+      next = kj::min(next, queue.begin()->time);
+    }
 
-  return ScheduledAlarm { kj::mv(actor), scheduledTime, kj::mv(task) };
+    auto paf = kj::newPromiseAndFulfiller<void>();
+    wakeTime = next;
+    wakeUp = kj::mv(paf.fulfiller);
+    co_await timer.afterDelay(next - clock.now()).exclusiveJoin(kj::mv(paf.promise));
+    wakeTime = kj::none;
+
+    // Since we are waiting on timer.afterDelay, it's possible that timer.now() was behind
+    // the real time by a few ms. Checking the clock here ensures we run alarms only on or after
+    // their scheduled time; otherwise we just go around the loop again.
+    auto now = clock.now();
+    if (KJ_ASSERT_NONNULL(loadedUntil).time - LOAD_WINDOW / 2 <= now) {
+      loadAlarmsFromDb(now);
+    }
+    runDueAlarms(now);
+  }
 }
 
-kj::Promise<void> AlarmScheduler::checkTimestamp(kj::Duration delay, kj::Date scheduledTime) {
-  co_await timer.afterDelay(delay);
-
-  // Since we are waiting on timer.afterDelay, it's possible that timer.now() was behind
-  // the real time by a few ms, leading to premature alarm() execution. This checks it the current
-  // time is >= than scheduledTime to ensure we run alarms only on or after their scheduled time.
-  auto now = clock.now();
-  if (now < scheduledTime) {
-    // If it's not yet time to trigger the alarm, we shall wait a while longer until we can
-    // trigger it. This repeats until it's time for the alarm to run.
-    co_await checkTimestamp(scheduledTime - now, scheduledTime);
+void AlarmScheduler::runDueAlarms(kj::Date now) {
+  while (!queue.empty() && queue.begin()->time <= now) {
+    auto& alarm = KJ_ASSERT_NONNULL(alarms.find(*queue.begin()->actor));
+    dequeue(alarm);
+
+    if (now - alarm.runTime > LATE_THRESHOLD) {
+      ++lateFiredCount;
+    }
+    tasks.add(runAlarmTask(*alarm.actor, alarm.scheduledTime));
   }
 }
 
-kj::Promise<void> AlarmScheduler::makeAlarmTask(kj::Duration delay,
-                                                const ActorKey& actorRef,
-                                                kj::Date scheduledTime) {
-  co_await checkTimestamp(delay, scheduledTime);
+kj::Promise<void> AlarmScheduler::runAlarmTask(const ActorKey& actorRef, kj::Date scheduledTime) {
   uint32_t retryCount = 0;
   {
     auto& entry = KJ_ASSERT_NONNULL(alarms.findEntry(actorRef));
     entry.value.status = AlarmStatus::STARTED;
     retryCount = entry.value.countedRetry;
   }
+  ++firedCount;
 
   auto retryInfo = co_await ([&]() -> kj::Promise<RetryInfo> {
     try {
@@ -215,31 +363,27 @@ kj::Promise<void> AlarmScheduler::makeAlarmTask(kj::Duration delay,
   })();
 
   try {
+    // Running alarms are never removed from memory, so the entry is still there.
     auto& entry = KJ_ASSERT_NONNULL(alarms.findEntry(actorRef));
 
-    // We can't overwrite our entry before moving ourselves out of it, as a promise cannot
-    // delete itself.
-    tasks.add(kj::mv(entry.value.task));
-
     // If an alarm is queued, there's no point in retrying the current one -- proceed
     // to running the queued alarm instead.
     KJ_IF_SOME(a, entry.value.queuedAlarm) {
-      // creating a new alarm and overwriting the old one will reset
-      // `status` to WAITING and `queuedAlarm` to null
-      entry.value = scheduleAlarm(clock.now(), kj::mv(entry.value.actor), a);
+      // rescheduling will reset `status` to WAITING and `queuedAlarm` to null
+      reschedule(entry.value, a);
       co_return;
     }
 
     // When we reach this block of code and alarm has either successed or failed and may (or may
     // not) retry. Setting the status of an alarm as FINISHED here, will allow deletion of alarms
-    // between retries. If there's a retry, `makeAlarmTask` is called, setting status as RUNNING
-    // again.
+    // between retries. If there's a retry, `runAlarmTask` is called again once it's due, setting
+    // status as STARTED again.
     entry.value.status = AlarmStatus::FINISHED;
 
     if (retryInfo.retry) {
-      // recreate the task, running after a delay determined using the retry factor
+      // requeue the alarm, running after a delay determined using the retry factor
       if (entry.value.countedRetry >= AlarmScheduler::RETRY_MAX_TRIES) {
-        deleteAlarm(*entry.value.actor);
+        removeAlarm(*entry.value.actor);
         co_return;
       }
       if (retryInfo.retryCountsAgainstLimit) {
@@ -265,11 +409,13 @@ kj::Promise<void> AlarmScheduler::makeAlarmTask(kj::Duration delay,
 
       entry.value.backoff++;
       entry.value.retry++;
+      ++retriedCount;
 
-      entry.value.task = makeAlarmTask(delay, actorRef, scheduledTime);
+      entry.value.runTime = clock.now() + delay;
+      enqueue(entry.value);
     } else {
       KJ_ASSERT(entry.value.queuedAlarm == kj::none);
-      deleteAlarm(actorRef);
+      removeAlarm(actorRef);
     }
   } catch (...) {
     auto exception = kj::getCaughtExceptionAsKj();
@@ -277,6 +423,96 @@ kj::Promise<void> AlarmScheduler::makeAlarmTask(kj::Duration delay,
   }
 }
 
+void AlarmScheduler::writeAlarm(const ActorKey& actor, kj::Maybe<kj::Date> scheduledTime) {
+  KJ_IF_SOME(write, pendingWrites.find(actor)) {
+    write.scheduledTime = scheduledTime;
+  } else {
+    auto ownActor = ownActorKey(actor);
+    ActorKey key = *ownActor;
+    pendingWrites.insert(key, PendingWrite {
+      .actor = kj::mv(ownActor), .scheduledTime = scheduledTime });
+  }
+
+  if (!flushScheduled) {
+    flushScheduled = true;
+    tasks.add(kj::evalLater([this]() { runScheduledFlush(); }));
+  }
+}
+
+kj::Promise<void> AlarmScheduler::whenWritten() {
+  KJ_ASSERT(flushScheduled);
+  auto paf = kj::newPromiseAndFulfiller<void>();
+  flushWaiters.add(kj::mv(paf.fulfiller));
+  return kj::mv(paf.promise);
+}
+
+void AlarmScheduler::runScheduledFlush() {
+  flushScheduled = false;
+  auto waiters = kj::mv(flushWaiters);
+
+  // The writes may already have been flushed earlier in the turn (e.g. by loadAlarmsFromDb()), in
+  // which case this is a no-op. A failed flush leaves the writes pending, to be retried by the next
+  // one.
+  KJ_IF_SOME(exception, kj::runCatchingExceptions([&]() { flushWrites(); })) {
+    if (waiters.size() == 0) {
+      // Only the scheduler itself made these changes, so let taskFailed() report the failure.
+      kj::throwFatalException(kj::mv(exception));
+    }
+    for (auto& waiter: waiters) {
+      waiter->reject(kj::cp(exception));
+    }
+    return;
+  }
+
+  for (auto& waiter: waiters) {
+    waiter->fulfill();
+  }
+}
+
+void AlarmScheduler::tryFlushWrites() {
+  KJ_IF_SOME(exception, kj::runCatchingExceptions([&]() { flushWrites(); })) {
+    KJ_LOG(ERROR, "failed to write alarms", exception);
+    for (auto& waiter: flushWaiters) {
+      waiter->reject(kj::cp(exception));
+    }
+    flushWaiters.clear();
+  }
+}
+
+void AlarmScheduler::flushWrites() {
+  if (pendingWrites.size() == 0) return;
+
+  // Write all changes made during the turn in one transaction, so they cost a single commit.
+  db->run("BEGIN TRANSACTION;");
+  KJ_ON_SCOPE_FAILURE(db->run("ROLLBACK;"));
+
+  for (auto& write: pendingWrites) {
+    auto& actor = *write.value.actor;
+    KJ_IF_SOME(time, write.value.scheduledTime) {
+      stmtSetAlarm.run(actor.uniqueKey, actor.actorId, toNanos(time));
+    } else {
+      stmtDeleteAlarm.run(actor.uniqueKey, actor.actorId);
+    }
+  }
+
+  db->run("COMMIT;");
+  pendingWrites.clear();
+}
+
+kj::Promise<AlarmScheduler::RetryInfo> AlarmScheduler::runAlarm(
+    const ActorKey& actor, kj::Date scheduledTime, uint32_t retryCount) {
+  KJ_IF_SOME(ns, namespaces.find(actor.uniqueKey)) {
+    auto result = co_await ns.getActor(kj::str(actor.actorId))->runAlarm(scheduledTime, retryCount);
+
+    co_return RetryInfo {
+      .retry = result.outcome != EventOutcome::OK && result.retry,
+      .retryCountsAgainstLimit = result.retryCountsAgainstLimit
+    };
+  } else {
+    throw KJ_EXCEPTION(FAILED, "uniqueKey for stored alarm was not registered?");
+  }
+}
+
 void AlarmScheduler::taskFailed(kj::Exception&& e) {
   KJ_LOG(WARNING, e);
 }
@@ -12,6 +12,7 @@
 #include <kj/map.h>
 
 #include <random>
+#include <set>
 
 #include <workerd/util/sqlite.h>
 #include <workerd/io/worker-interface.h>
@@ -42,6 +43,12 @@ inline uint KJ_HASHCODE(const ActorKey& k) { return kj::hashCode(k.uniqueKey, k.
 
 // Allows scheduling alarm executions at specific times, returning a promise representing
 // the completion of the alarm event.
+//
+// Alarms are stored in SQLite, but only those due soon (see LOAD_WINDOW) are held in memory,
+// ordered by time in a single queue which is driven by one timer. Alarms further ahead are loaded
+// from the database in time-ordered pages as time advances. Writes to the database are batched:
+// all alarm changes made in one turn of the event loop are written in a single transaction, and
+// setAlarm() and deleteAlarm() complete once it has committed.
 class AlarmScheduler final : kj::TaskSet::ErrorHandler {
 public:
   static constexpr auto RETRY_START_SECONDS = WorkerInterface::ALARM_RETRY_START_SECONDS;
@@ -58,6 +65,16 @@ public:
   // some common dependency between a set of failed alarms
   static constexpr auto RETRY_JITTER_FACTOR = 0.25;
 
+  // Alarms scheduled further ahead than this are left in the database until their time
+  // approaches.
+  static constexpr auto LOAD_WINDOW = 1 * kj::HOURS;
+
+  // Max number of alarms loaded from the database at once.
+  static constexpr uint LOAD_PAGE_SIZE = 1024;
+
+  // Alarms which start running more than this long after they were due count as late.
+  static constexpr auto LATE_THRESHOLD = 1 * kj::SECONDS;
+
   using GetActorFn = kj::Function<kj::Own<WorkerInterface>(kj::String)>;
 
   AlarmScheduler(
@@ -65,13 +82,35 @@ public:
     kj::Timer& timer,
     const SqliteDatabase::Vfs& vfs,
     kj::PathPtr path);
+  ~AlarmScheduler() noexcept(false);
 
   kj::Maybe<kj::Date> getAlarm(ActorKey actor);
-  bool setAlarm(ActorKey actor, kj::Date scheduledTime);
-  bool deleteAlarm(ActorKey actor);
+
+  // The change takes effect immediately, as far as getAlarm() and the alarm's execution are
+  // concerned. The returned promise resolves once it has been written to the database, or rejects
+  // if writing it fails.
+  kj::Promise<void> setAlarm(ActorKey actor, kj::Date scheduledTime);
+  kj::Promise<void> deleteAlarm(ActorKey actor);
 
   void registerNamespace(kj::StringPtr uniqueKey, GetActorFn getActor);
 
+  struct Stats {
+    // Alarms set and not yet completed (successfully, or by running out of retries). If recent
+    // changes can't be written to the database, this reflects only the stored alarms.
+    uint64_t pending;
+
+    // Alarm handler invocations, including retries.
+    uint64_t fired;
+
+    // Retries scheduled after a failed invocation.
+    uint64_t retried;
+
+    // Invocations which started more than LATE_THRESHOLD after they were due.
+    uint64_t lateFired;
+  };
+
+  Stats getStats();
+
 private:
   enum class AlarmStatus {WAITING, STARTED, FINISHED};
   const kj::Clock& clock;
@@ -83,12 +122,19 @@ private:
   };
   kj::HashMap<kj::StringPtr, Namespace> namespaces;
   kj::Own<SqliteDatabase> db;
-  kj::TaskSet tasks;
 
   struct ScheduledAlarm {
     kj::Own<ActorKey> actor;
+
+    // The time the alarm was set for, which is passed to the handler.
     kj::Date scheduledTime;
-    kj::Promise<void> task;
+
+    // When the alarm is to run next: `scheduledTime`, or later when retrying.
+    kj::Date runTime;
+
+    // Whether the alarm is in `queue`, waiting for `runTime`.
+    bool inQueue = false;
+
     kj::Maybe<kj::Date> queuedAlarm = kj::none;
     // Once started, an alarm can have a single alarm queued behind it.
     AlarmStatus status = AlarmStatus::WAITING;
@@ -106,21 +152,86 @@ private:
     uint32_t countedRetry = 0;
   };
 
+  // Alarms held in memory: those due up to `loadedUntil`, plus any that are running or retrying.
   kj::HashMap<ActorKey, ScheduledAlarm> alarms;
 
+  // Position of an alarm in time order. Ties are broken by actor, as in the database index.
+  struct QueueKey {
+    kj::Date time;
+    const ActorKey* actor;
+
+    bool operator<(const QueueKey& other) const;
+  };
+
+  // Alarms in `alarms` that are waiting to run, ordered by `runTime`.
+  std::set<QueueKey> queue;
+
+  // Every stored alarm ordered at or before this position is in `alarms`. Null until the first
+  // page has been loaded.
+  struct LoadedUntil {
+    kj::Date time;
+    kj::String uniqueKey;
+    kj::String actorId;
+  };
+  kj::Maybe<LoadedUntil> loadedUntil;
+
+  // Changes not yet written to the database. A null time means the alarm is deleted.
+  struct PendingWrite {
+    kj::Own<ActorKey> actor;
+    kj::Maybe<kj::Date> scheduledTime;
+  };
+  kj::HashMap<ActorKey, PendingWrite> pendingWrites;
+  bool flushScheduled = false;
+
+  // Callers of setAlarm() and deleteAlarm() waiting for the scheduled flush.
+  kj::Vector<kj::Own<kj::PromiseFulfiller<void>>> flushWaiters;
+
+  // Time the run loop is sleeping until, and a fulfiller to wake it early.
+  kj::Maybe<kj::Date> wakeTime;
+  kj::Own<kj::PromiseFulfiller<void>> wakeUp;
+
+  uint64_t firedCount = 0;
+  uint64_t retriedCount = 0;
+  uint64_t lateFiredCount = 0;
+
   struct RetryInfo {
     bool retry;
     bool retryCountsAgainstLimit;
   };
   kj::Promise<RetryInfo> runAlarm(const ActorKey& actor, kj::Date scheduledTime, uint32_t retryCount);
 
-  void setAlarmInMemory(kj::Own<ActorKey> actor, kj::Date scheduledTime);
+  // Whether an alarm at this position is within the range held in memory.
+  bool isLoaded(kj::Date time, const ActorKey& actor);
+
+  ScheduledAlarm& addAlarm(const ActorKey& actor, kj::Date scheduledTime);
+
+  // Resets `alarm` to wait for `scheduledTime`, or drops it from memory if that is beyond the
+  // loaded range.
+  void reschedule(ScheduledAlarm& alarm, kj::Date scheduledTime);
+
+  void enqueue(ScheduledAlarm& alarm);
+  void dequeue(ScheduledAlarm& alarm);
 
-  ScheduledAlarm scheduleAlarm(kj::Date now, kj::Own<ActorKey> actor, kj::Date scheduledTime);
+  kj::Promise<void> runLoop();
+  void runDueAlarms(kj::Date now);
+  kj::Promise<void> runAlarmTask(const ActorKey& actor, kj::Date scheduledTime);
 
-  kj::Promise<void> makeAlarmTask(kj::Duration delay, const ActorKey& actor, kj::Date scheduledTime);
+  // Removes the alarm, or replaces it with its queued alarm, if any.
+  void removeAlarm(const ActorKey& actor);
 
-  kj::Promise<void> checkTimestamp(kj::Duration delay, kj::Date scheduledTime);
+  // Records a change to be written by the next flushWrites(), which is scheduled to run at the
+  // end of the current turn. A null time deletes the alarm.
+  void writeAlarm(const ActorKey& actor, kj::Maybe<kj::Date> scheduledTime);
+
+  // Returns a promise for the completion of the flush scheduled by writeAlarm().
+  kj::Promise<void> whenWritten();
+
+  void runScheduledFlush();
+  void flushWrites();
+
+  // Like flushWrites(), but logs a failure instead of throwing, and fails the callers waiting on
+  // the scheduled flush. The changes stay pending, to be retried by the next flush.
+  void tryFlushWrites();
 
   SqliteDatabase::Statement stmtSetAlarm = db->prepare(R"(
     INSERT INTO _cf_ALARM VALUES(?, ?, ?)
@@ -129,13 +240,33 @@ private:
   SqliteDatabase::Statement stmtDeleteAlarm = db->prepare(R"(
     DELETE FROM _cf_ALARM WHERE actor_unique_key = ? AND actor_id = ?
   )");
+  SqliteDatabase::Statement stmtGetAlarm = db->prepare(R"(
+    SELECT scheduled_time FROM _cf_ALARM WHERE actor_unique_key = ? AND actor_id = ?
+  )");
+  SqliteDatabase::Statement stmtLoadFirstPage = db->prepare(R"(
+    SELECT actor_unique_key, actor_id, scheduled_time FROM _cf_ALARM
+      ORDER BY scheduled_time, actor_unique_key, actor_id LIMIT ?
+  )");
+  SqliteDatabase::Statement stmtLoadNextPage = db->prepare(R"(
+    SELECT actor_unique_key, actor_id, scheduled_time FROM _cf_ALARM
+      WHERE (scheduled_time, actor_unique_key, actor_id) > (?, ?, ?)
+      ORDER BY scheduled_time, actor_unique_key, actor_id LIMIT ?
+  )");
+  SqliteDatabase::Statement stmtCountAlarms = db->prepare(R"(
+    SELECT COUNT(*) FROM _cf_ALARM
+  )");
+
+  // Declared last so that running tasks are canceled before the state they use is destroyed.
+  kj::TaskSet tasks;
 
   void taskFailed(kj::Exception&& exception) override;
 
   int maxJitterMsForDelay(kj::Duration delay);
 
   static void ensureInitialized(SqliteDatabase& db);
-  void loadAlarmsFromDb();
+
+  // Loads the next page of alarms from the database, extending `loadedUntil`.
+  void loadAlarmsFromDb(kj::Date now);
 };
 
 } // namespace workerd::server
@@ -0,0 +1,102 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "code-cache.h"
+#include <kj/debug.h>
+#include <kj/encoding.h>
+#include <openssl/sha.h>
+#include <v8.h>
+
+namespace workerd::server {
+
+kj::String getCodeCacheKey(jsg::CodeCache::Type type, kj::ArrayPtr<const char> content) {
+  kj::byte digest[SHA256_DIGEST_LENGTH];
+  SHA256(content.asBytes().begin(), content.size(), digest);
+
+  kj::StringPtr prefix;
+  switch (type) {
+    case jsg::CodeCache::Type::ESM: prefix = "esm"; break;
+    case jsg::CodeCache::Type::FUNCTION: prefix = "fn"; break;
+  }
+
+  // The version tag covers both the V8 version and the flags which affect code generation.
+  return kj::str(prefix, '-', kj::hex(v8::ScriptCompiler::CachedDataVersionTag()), '-',
+                 kj::encodeHex(digest));
+}
+
+kj::Maybe<kj::Array<const kj::byte>> DiskCodeCache::get(kj::StringPtr key) const {
+  try {
+    KJ_IF_SOME(file, dir->tryOpenFile(kj::Path({key}))) {
+      return kj::Array<const kj::byte>(file->readAllBytes());
+    }
+  } catch (...) {
+    auto exception = kj::getCaughtExceptionAsKj();
+    KJ_LOG(WARNING, "failed to read code cache entry", key, exception);
+  }
+  return kj::none;
+}
+
+void DiskCodeCache::put(kj::StringPtr key, kj::ArrayPtr<const kj::byte> data) const {
+  try {
+    auto replacer = dir->replaceFile(kj::Path({key}),
+        kj::WriteMode::CREATE | kj::WriteMode::MODIFY);
+    replacer->get().writeAll(data);
+    replacer->commit();
+  } catch (...) {
+    auto exception = kj::getCaughtExceptionAsKj();
+    KJ_LOG(WARNING, "failed to write code cache entry", key, exception);
+  }
+}
+
+kj::Maybe<kj::Array<const kj::byte>> MemoryCodeCache::get(kj::StringPtr key) const {
+  auto lock = entries.lockShared();
+  return lock->find(key).map([](const kj::Array<kj::byte>& data) {
+    return kj::Array<const kj::byte>(kj::heapArray(data.asPtr()));
+  });
+}
+
+void MemoryCodeCache::put(kj::StringPtr key, kj::ArrayPtr<const kj::byte> data) const {
+  entries.lockExclusive()->upsert(kj::str(key), kj::heapArray(data),
+      [](kj::Array<kj::byte>& existing, kj::Array<kj::byte>&& replacement) {
+    existing = kj::mv(replacement);
+  });
+}
+
+void MemoryCodeCache::copyTo(capnp::List<config::Config::CodeCacheEntry>::Builder builder) const {
+  auto lock = entries.lockShared();
+  uint i = 0;
+  for (auto& entry: *lock) {
+    builder[i].setKey(entry.key);
+    builder[i].setData(entry.value.asPtr());
+    ++i;
+  }
+}
+
+EmbeddedCodeCache::EmbeddedCodeCache(
+    capnp::List<config::Config::CodeCacheEntry>::Reader entriesParam,
+    kj::Maybe<kj::Own<jsg::CodeCache>> fallback)
+    : fallback(kj::mv(fallback)) {
+  for (auto entry: entriesParam) {
+    entries.upsert(entry.getKey(), entry.getData(), [](auto&, auto&&) {});
+  }
+}
+
+kj::Maybe<kj::Array<const kj::byte>> EmbeddedCodeCache::get(kj::StringPtr key) const {
+  KJ_IF_SOME(data, entries.find(key)) {
+    // The config outlives us, so there's no need to copy the data.
+    return kj::Array<const kj::byte>(data.begin(), data.size(), kj::NullArrayDisposer::instance);
+  }
+  KJ_IF_SOME(f, fallback) {
+    return f->get(key);
+  }
+  return kj::none;
+}
+
+void EmbeddedCodeCache::put(kj::StringPtr key, kj::ArrayPtr<const kj::byte> data) const {
+  KJ_IF_SOME(f, fallback) {
+    f->put(key, data);
+  }
+}
+
+}  // namespace workerd::server
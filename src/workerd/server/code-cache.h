@@ -0,0 +1,129 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#pragma once
+
+#include <kj/filesystem.h>
+#include <kj/map.h>
+#include <kj/mutex.h>
+#include <workerd/io/observer.h>
+#include <workerd/jsg/modules.h>
+#include <atomic>
+#include <workerd/server/workerd.capnp.h>
+
+namespace workerd::server {
+
+// Returns the key used by all the code caches below: a SHA-256 hash of the module source,
+// along with V8's CachedDataVersionTag(), so that entries for old versions of a module, or
+// produced by a different V8 version or flags, are never looked up again.
+kj::String getCodeCacheKey(jsg::CodeCache::Type type, kj::ArrayPtr<const char> content);
+
+// A jsg::CodeCache that stores each entry as a file in a directory, so that entries survive
+// restarts and are shared by all isolates in the process (and by other processes using the same
+// directory). Files are replaced atomically, so concurrent readers and writers are safe.
+// Entries are never removed.
+class DiskCodeCache final: public jsg::CodeCache {
+public:
+  explicit DiskCodeCache(kj::Own<const kj::Directory> dir): dir(kj::mv(dir)) {}
+
+  kj::String getKey(Type type, kj::ArrayPtr<const char> content) const override {
+    return getCodeCacheKey(type, content);
+  }
+  kj::Maybe<kj::Array<const kj::byte>> get(kj::StringPtr key) const override;
+  void put(kj::StringPtr key, kj::ArrayPtr<const kj::byte> data) const override;
+
+private:
+  kj::Own<const kj::Directory> dir;
+};
+
+// A jsg::CodeCache that keeps entries in memory. Used to collect entries to embed in a config.
+class MemoryCodeCache final: public jsg::CodeCache {
+public:
+  kj::String getKey(Type type, kj::ArrayPtr<const char> content) const override {
+    return getCodeCacheKey(type, content);
+  }
+  kj::Maybe<kj::Array<const kj::byte>> get(kj::StringPtr key) const override;
+  void put(kj::StringPtr key, kj::ArrayPtr<const kj::byte> data) const override;
+
+  // Copies all entries into `builder`, which must have room for `size()` of them.
+  void copyTo(capnp::List<config::Config::CodeCacheEntry>::Builder builder) const;
+  size_t size() const { return entries.lockShared()->size(); }
+
+private:
+  kj::MutexGuarded<kj::HashMap<kj::String, kj::Array<kj::byte>>> entries;
+};
+
+// A jsg::CodeCache serving the entries embedded in a config (`Config.embeddedCodeCache`), which
+// must outlive it. Entries not found there are looked up in `fallback`, if any, and new entries
+// are stored there.
+class EmbeddedCodeCache final: public jsg::CodeCache {
+public:
+  EmbeddedCodeCache(capnp::List<config::Config::CodeCacheEntry>::Reader entries,
+                    kj::Maybe<kj::Own<jsg::CodeCache>> fallback);
+
+  kj::String getKey(Type type, kj::ArrayPtr<const char> content) const override {
+    return getCodeCacheKey(type, content);
+  }
+  kj::Maybe<kj::Array<const kj::byte>> get(kj::StringPtr key) const override;
+  void put(kj::StringPtr key, kj::ArrayPtr<const kj::byte> data) const override;
+
+private:
+  kj::HashMap<kj::StringPtr, kj::ArrayPtr<const kj::byte>> entries;
+  kj::Maybe<kj::Own<jsg::CodeCache>> fallback;
+};
+
+// Counts of code cache events, totalled across all isolates.
+struct CodeCacheStats {
+  // Modules compiled using data from the code cache.
+  uint64_t hits = 0;
+  // Modules for which data was found, but rejected by V8 (e.g. because it was corrupt).
+  uint64_t rejections = 0;
+  // Entries stored in the code cache, and their total size.
+  uint64_t produced = 0;
+  uint64_t producedBytes = 0;
+};
+
+class CodeCacheCounters final: public kj::AtomicRefcounted {
+public:
+  CodeCacheStats get() const {
+    return {
+      .hits = hits.load(std::memory_order_relaxed),
+      .rejections = rejections.load(std::memory_order_relaxed),
+      .produced = produced.load(std::memory_order_relaxed),
+      .producedBytes = producedBytes.load(std::memory_order_relaxed),
+    };
+  }
+
+private:
+  std::atomic<uint64_t> hits = 0;
+  std::atomic<uint64_t> rejections = 0;
+  std::atomic<uint64_t> produced = 0;
+  std::atomic<uint64_t> producedBytes = 0;
+
+  friend class CodeCacheCountingObserver;
+};
+
+// An IsolateObserver which counts code cache events in `counters`, which may be shared by many
+// isolates.
+class CodeCacheCountingObserver final: public IsolateObserver {
+public:
+  explicit CodeCacheCountingObserver(kj::Own<CodeCacheCounters> counters)
+      : counters(kj::mv(counters)) {}
+
+  void onCodeCacheHit(v8::Isolate* isolate, kj::StringPtr name) const override {
+    counters->hits.fetch_add(1, std::memory_order_relaxed);
+  }
+  void onCodeCacheRejected(v8::Isolate* isolate, kj::StringPtr name) const override {
+    counters->rejections.fetch_add(1, std::memory_order_relaxed);
+  }
+  void onCodeCacheProduced(v8::Isolate* isolate, kj::StringPtr name, size_t size) const override {
+    counters->produced.fetch_add(1, std::memory_order_relaxed);
+    counters->producedBytes.fetch_add(size, std::memory_order_relaxed);
+  }
+
+private:
+  kj::Own<CodeCacheCounters> counters;
+};
+
+}  // namespace workerd::server
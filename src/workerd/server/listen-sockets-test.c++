@@ -0,0 +1,135 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#if !_WIN32
+
+#include "listen-sockets.h"
+#include <kj/debug.h>
+#include <kj/test.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace workerd::server {
+namespace {
+
+uint getPort(int fd) {
+  struct sockaddr_storage addr;
+  socklen_t addrLen = sizeof(addr);
+  KJ_SYSCALL(getsockname(fd, reinterpret_cast<struct sockaddr*>(&addr), &addrLen));
+  KJ_ASSERT(addr.ss_family == AF_INET);
+  return ntohs(reinterpret_cast<struct sockaddr_in&>(addr).sin_port);
+}
+
+kj::AutoCloseFd connectTo(const struct sockaddr* addr, socklen_t addrLen) {
+  int fd;
+  KJ_SYSCALL(fd = socket(addr->sa_family, SOCK_STREAM | SOCK_CLOEXEC, 0));
+  kj::AutoCloseFd ownFd(fd);
+  KJ_SYSCALL(connect(fd, addr, addrLen));
+  return ownFd;
+}
+
+struct sockaddr_in loopback(uint port) {
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  return addr;
+}
+
+// Accepts every connection waiting on any of `fds`, returning how many there were.
+uint acceptAll(kj::ArrayPtr<kj::AutoCloseFd> fds) {
+  auto pollFds = KJ_MAP(fd, fds) { return pollfd { fd, POLLIN, 0 }; };
+  uint accepted = 0;
+  for (;;) {
+    int n;
+    KJ_SYSCALL(n = poll(pollFds.begin(), pollFds.size(), 100));
+    if (n == 0) return accepted;
+    for (auto& pollFd: pollFds) {
+      if (pollFd.revents & POLLIN) {
+        int fd;
+        KJ_SYSCALL(fd = accept4(pollFd.fd, nullptr, nullptr, SOCK_CLOEXEC));
+        kj::AutoCloseFd ownFd(fd);
+        accepted++;
+      }
+    }
+  }
+}
+
+KJ_TEST("TCP listeners share a port picked by the kernel") {
+  auto fds = bindListenSockets("127.0.0.1:0", 80, 3);
+  KJ_ASSERT(fds.size() == 3);
+
+  uint port = getPort(fds[0]);
+  KJ_EXPECT(port != 0);
+  for (auto& fd: fds) {
+    KJ_EXPECT(getPort(fd) == port);
+  }
+
+  // The port is held the whole time, so a socket without SO_REUSEPORT can't take it.
+  {
+    int fd;
+    KJ_SYSCALL(fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0));
+    kj::AutoCloseFd ownFd(fd);
+    auto addr = loopback(port);
+    KJ_EXPECT(bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0);
+    KJ_EXPECT(errno == EADDRINUSE, errno);
+  }
+
+  // Every connection is accepted by one of the listeners.
+  kj::Vector<kj::AutoCloseFd> clients;
+  auto addr = loopback(port);
+  for (uint i = 0; i < 32; i++) {
+    clients.add(connectTo(reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)));
+  }
+  KJ_EXPECT(acceptAll(fds) == 32);
+}
+
+KJ_TEST("TCP listeners use the default port") {
+  // Bind a port ourselves to find a free one, then release it.
+  uint port;
+  {
+    auto fds = bindListenSockets("127.0.0.1:0", 0, 1);
+    port = getPort(fds[0]);
+  }
+
+  auto fds = bindListenSockets("127.0.0.1", port, 2);
+  KJ_EXPECT(getPort(fds[0]) == port);
+  KJ_EXPECT(getPort(fds[1]) == port);
+}
+
+KJ_TEST("Unix listeners share one socket") {
+  auto path = kj::str("/tmp/workerd-listen-sockets-test-", getpid());
+  unlink(path.cStr());
+  KJ_DEFER(unlink(path.cStr()));
+
+  auto fds = bindListenSockets(kj::str("unix:", path), 0, 2);
+  KJ_ASSERT(fds.size() == 2);
+
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  memcpy(addr.sun_path, path.begin(), path.size());
+
+  // A connection made once is seen by both descriptors, since they're the same socket.
+  auto client = connectTo(reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr));
+  KJ_EXPECT(acceptAll(fds.slice(1, 2)) == 1);
+  KJ_EXPECT(acceptAll(fds.slice(0, 1)) == 0);
+}
+
+KJ_TEST("Bad addresses are reported") {
+  KJ_EXPECT_THROW_MESSAGE("Unix socket path is too long",
+      bindListenSockets(kj::str("unix:/", kj::repeat('x', 200)), 0, 2));
+  KJ_EXPECT_THROW_MESSAGE("Failed to resolve address",
+      bindListenSockets("127.0.0.1:not-a-port", 0, 2));
+}
+
+}  // namespace
+}  // namespace workerd::server
+
+#endif  // !_WIN32
@@ -0,0 +1,171 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "listen-sockets.h"
+
+#if !_WIN32
+
+#include <kj/debug.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace workerd::server {
+
+namespace {
+
+struct ResolvedAddress {
+  struct sockaddr_storage addr;
+  socklen_t addrLen;
+};
+
+kj::Maybe<ResolvedAddress> tryParseUnixAddress(kj::StringPtr addrStr) {
+  kj::StringPtr path;
+  bool abstract = false;
+  if (addrStr.startsWith("unix:")) {
+    path = addrStr.slice(strlen("unix:"));
+  } else if (addrStr.startsWith("unix-abstract:")) {
+    path = addrStr.slice(strlen("unix-abstract:"));
+    abstract = true;
+  } else {
+    return kj::none;
+  }
+
+  ResolvedAddress result;
+  memset(&result.addr, 0, sizeof(result.addr));
+  auto& un = reinterpret_cast<struct sockaddr_un&>(result.addr);
+  un.sun_family = AF_UNIX;
+  // Abstract socket names start with a nul byte, and aren't nul-terminated.
+  size_t offset = abstract ? 1 : 0;
+  KJ_REQUIRE(path.size() + offset < sizeof(un.sun_path), "Unix socket path is too long.", addrStr);
+  memcpy(un.sun_path + offset, path.begin(), path.size());
+  result.addrLen = offsetof(struct sockaddr_un, sun_path) + offset + path.size() +
+      (abstract ? 0 : 1);
+  return result;
+}
+
+ResolvedAddress resolveInetAddress(kj::StringPtr addrStr, uint defaultPort) {
+  kj::String host;
+  kj::String port;
+  if (addrStr.startsWith("[")) {
+    auto close = KJ_REQUIRE_NONNULL(addrStr.findFirst(']'), "Invalid address.", addrStr);
+    host = kj::str(addrStr.slice(1, close));
+    auto rest = addrStr.slice(close + 1);
+    if (rest.size() > 0) {
+      KJ_REQUIRE(rest.startsWith(":"), "Invalid address.", addrStr);
+      port = kj::str(rest.slice(1));
+    }
+  } else KJ_IF_SOME(colon, addrStr.findLast(':')) {
+    if (addrStr.findFirst(':') == colon) {
+      host = kj::str(addrStr.slice(0, colon));
+      port = kj::str(addrStr.slice(colon + 1));
+    } else {
+      // A bare IPv6 address.
+      host = kj::str(addrStr);
+    }
+  } else {
+    host = kj::str(addrStr);
+  }
+  if (port.size() == 0) {
+    port = kj::str(defaultPort);
+  }
+
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE;
+
+  bool wildcard = host == "*";
+  struct addrinfo* list;
+  int status = getaddrinfo(wildcard ? nullptr : host.cStr(), port.cStr(), &hints, &list);
+  KJ_REQUIRE(status == 0, "Failed to resolve address.", addrStr, gai_strerror(status));
+  KJ_DEFER(freeaddrinfo(list));
+
+  // Like KJ, only listen on the first address the name resolves to, except that wildcards prefer
+  // IPv6, which (with IPV6_V6ONLY turned off) accepts IPv4 connections too.
+  auto chosen = list;
+  if (wildcard) {
+    for (auto info = list; info != nullptr; info = info->ai_next) {
+      if (info->ai_family == AF_INET6) {
+        chosen = info;
+        break;
+      }
+    }
+  }
+
+  ResolvedAddress result;
+  KJ_ASSERT(chosen->ai_addrlen <= sizeof(result.addr));
+  memcpy(&result.addr, chosen->ai_addr, chosen->ai_addrlen);
+  result.addrLen = chosen->ai_addrlen;
+  return result;
+}
+
+kj::AutoCloseFd bindSocket(const struct sockaddr* addr, socklen_t addrLen, bool reusePort) {
+  int fd;
+  KJ_SYSCALL(fd = socket(addr->sa_family, SOCK_STREAM | SOCK_CLOEXEC, 0));
+  kj::AutoCloseFd ownFd(fd);
+
+  int one = 1;
+  if (addr->sa_family != AF_UNIX) {
+    KJ_SYSCALL(setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)));
+  }
+  if (reusePort) {
+    KJ_SYSCALL(setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)));
+  }
+  if (addr->sa_family == AF_INET6) {
+    // Match KJ, which accepts IPv4 connections on wildcard IPv6 addresses.
+    int zero = 0;
+    KJ_SYSCALL(setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero)));
+  }
+  KJ_SYSCALL(bind(fd, addr, addrLen));
+  KJ_SYSCALL(::listen(fd, SOMAXCONN));
+  return ownFd;
+}
+
+}  // namespace
+
+kj::AutoCloseFd dupFd(int fd) {
+  int result;
+  KJ_SYSCALL(result = fcntl(fd, F_DUPFD_CLOEXEC, 0));
+  return kj::AutoCloseFd(result);
+}
+
+kj::Array<kj::AutoCloseFd> bindListenSockets(kj::StringPtr addrStr, uint defaultPort, uint count) {
+  KJ_REQUIRE(count > 0);
+  ResolvedAddress resolved;
+  KJ_IF_SOME(unixAddress, tryParseUnixAddress(addrStr)) {
+    resolved = unixAddress;
+  } else {
+    resolved = resolveInetAddress(addrStr, defaultPort);
+  }
+  auto addr = reinterpret_cast<struct sockaddr*>(&resolved.addr);
+
+  bool reusePort = addr->sa_family == AF_INET || addr->sa_family == AF_INET6;
+  auto result = kj::heapArrayBuilder<kj::AutoCloseFd>(count);
+  result.add(bindSocket(addr, resolved.addrLen, reusePort));
+
+  if (reusePort) {
+    // Read back the address the first socket was bound to, which has a concrete port even if we
+    // asked for port 0, and bind the rest to that.
+    resolved.addrLen = sizeof(resolved.addr);
+    KJ_SYSCALL(getsockname(result[0], addr, &resolved.addrLen));
+  }
+
+  for (uint i = 1; i < count; i++) {
+    if (reusePort) {
+      result.add(bindSocket(addr, resolved.addrLen, true));
+    } else {
+      result.add(dupFd(result[0]));
+    }
+  }
+  return result.finish();
+}
+
+}  // namespace workerd::server
+
+#endif  // !_WIN32
@@ -0,0 +1,31 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#pragma once
+
+#include <kj/array.h>
+#include <kj/io.h>
+#include <kj/string.h>
+
+namespace workerd::server {
+
+#if !_WIN32
+
+// Binds `count` listening sockets to `addrStr`, for serving on that many threads. The address
+// uses the same syntax as socket addresses in the config, i.e. "host:port", "*:port",
+// "[ipv6]:port", "unix:path" or "unix-abstract:name", with `defaultPort` used if no port is given.
+//
+// TCP sockets are each bound separately with SO_REUSEPORT, so that the kernel spreads incoming
+// connections between them. The first one is bound before the others and stays open, so if the
+// address asks for port 0, the rest join whichever port the kernel picked for it. Other socket
+// types can't be shared that way, so one socket is bound and then dup()ed, and all threads accept
+// connections from it.
+kj::Array<kj::AutoCloseFd> bindListenSockets(kj::StringPtr addrStr, uint defaultPort, uint count);
+
+// Duplicates `fd`, with close-on-exec set on the copy.
+kj::AutoCloseFd dupFd(int fd);
+
+#endif
+
+}  // namespace workerd::server
@@ -0,0 +1,198 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "local-cache.h"
+#include <kj/test.h>
+
+namespace workerd::server {
+namespace {
+
+class MockClock final: public kj::Clock {
+public:
+  kj::Date now() const override { return time; }
+
+  kj::Date time = kj::UNIX_EPOCH + 1'000'000 * kj::SECONDS;
+};
+
+// A LocalCache, with an HttpClient to make requests to it.
+struct TestCache {
+  kj::EventLoop loop;
+  kj::WaitScope ws;
+  kj::HttpHeaderTable::Builder headerTableBuilder;
+  kj::Own<kj::HttpHeaderTable> headerTable;
+  LocalCache cache;
+  kj::Own<kj::HttpClient> client;
+
+  TestCache(const MockClock& clock, LocalCache::Options options,
+            kj::Maybe<const kj::Directory&> dir = kj::none)
+      : ws(loop),
+        cache(clock, headerTableBuilder, options),
+        client(kj::newHttpClient(cache)) {
+    headerTable = headerTableBuilder.build();
+    KJ_IF_SOME(d, dir) {
+      cache.setDiskDirectory(d);
+    }
+  }
+
+  // Stores a 200 response with the given header lines (each ending in "\r\n") and body, sending
+  // the given request headers along with it.
+  void put(kj::StringPtr url, kj::StringPtr headerLines, kj::StringPtr body,
+           kj::ArrayPtr<const kj::StringPtr> requestHeaders = nullptr) {
+    auto payload = kj::str("HTTP/1.1 200 OK\r\n", headerLines, "\r\n", body);
+    auto headers = makeHeaders(requestHeaders);
+    auto request = client->request(kj::HttpMethod::PUT, url, headers, payload.size());
+    request.body->write(payload.begin(), payload.size()).wait(ws);
+    request.body = nullptr;
+    auto response = request.response.wait(ws);
+    KJ_EXPECT(response.statusCode == 204, response.statusCode);
+    response.body->readAllBytes().wait(ws);
+  }
+
+  // Returns the cached body, or none on a miss.
+  kj::Maybe<kj::String> get(kj::StringPtr url,
+                            kj::ArrayPtr<const kj::StringPtr> requestHeaders = nullptr) {
+    auto headers = makeHeaders(requestHeaders);
+    auto request = client->request(kj::HttpMethod::GET, url, headers, uint64_t(0));
+    request.body = nullptr;
+    auto response = request.response.wait(ws);
+    auto body = response.body->readAllText().wait(ws);
+    if (response.statusCode == 504) {
+      return kj::none;
+    }
+    KJ_EXPECT(response.statusCode == 200, response.statusCode);
+    return kj::mv(body);
+  }
+
+  // Takes alternating header names and values.
+  kj::HttpHeaders makeHeaders(kj::ArrayPtr<const kj::StringPtr> nameValuePairs) {
+    kj::HttpHeaders headers(*headerTable);
+    for (size_t i = 0; i + 1 < nameValuePairs.size(); i += 2) {
+      headers.add(nameValuePairs[i], nameValuePairs[i + 1]);
+    }
+    return headers;
+  }
+};
+
+constexpr kj::StringPtr CACHEABLE = "Cache-Control: max-age=3600\r\n"_kj;
+
+// 100 bytes, so that (with the response head) an entry takes up about 150 bytes.
+const kj::String BODY = kj::str(kj::repeat('x', 100));
+
+kj::String bodyOf(kj::Maybe<kj::String> result) {
+  return kj::mv(result).orDefault([]() { return kj::str("(miss)"); });
+}
+
+KJ_TEST("LocalCache: Vary selects between variants") {
+  MockClock clock;
+  TestCache test(clock, { .memoryLimit = 1 << 20, .diskLimit = 0 });
+
+  kj::StringPtr en[] = { "Accept-Language", "en" };
+  kj::StringPtr fr[] = { "Accept-Language", "fr" };
+  auto vary = kj::str(CACHEABLE, "Vary: Accept-Language\r\n");
+
+  test.put("http://foo/", vary, "english", en);
+  KJ_EXPECT(bodyOf(test.get("http://foo/", en)) == "english");
+  KJ_EXPECT(test.get("http://foo/", fr) == kj::none);
+  KJ_EXPECT(test.get("http://foo/") == kj::none);
+
+  test.put("http://foo/", vary, "french", fr);
+  KJ_EXPECT(bodyOf(test.get("http://foo/", en)) == "english");
+  KJ_EXPECT(bodyOf(test.get("http://foo/", fr)) == "french");
+
+  // A request without the header is its own variant.
+  test.put("http://foo/", vary, "default");
+  KJ_EXPECT(bodyOf(test.get("http://foo/")) == "default");
+  KJ_EXPECT(bodyOf(test.get("http://foo/", en)) == "english");
+
+  // `Vary: *` can never match, so isn't stored.
+  test.put("http://bar/", kj::str(CACHEABLE, "Vary: *\r\n"), "anything");
+  KJ_EXPECT(test.get("http://bar/") == kj::none);
+}
+
+KJ_TEST("LocalCache: expiry") {
+  MockClock clock;
+  TestCache test(clock, { .memoryLimit = 1 << 20, .diskLimit = 0 });
+
+  // s-maxage takes precedence over max-age.
+  test.put("http://foo/", "Cache-Control: max-age=1000, s-maxage=10\r\n", "short");
+  KJ_EXPECT(bodyOf(test.get("http://foo/")) == "short");
+  clock.time += 11 * kj::SECONDS;
+  KJ_EXPECT(test.get("http://foo/") == kj::none);
+
+  // A max-age too long to represent as an expiry time is clamped rather than overflowing (which
+  // would make the entry expire immediately).
+  test.put("http://foo/", "Cache-Control: max-age=18446744073709551615\r\n", "forever");
+  KJ_EXPECT(bodyOf(test.get("http://foo/")) == "forever");
+  clock.time += 30 * kj::DAYS;
+  KJ_EXPECT(bodyOf(test.get("http://foo/")) == "forever");
+  clock.time += 400 * kj::DAYS;
+  KJ_EXPECT(test.get("http://foo/") == kj::none);
+}
+
+KJ_TEST("LocalCache: entries move between memory and disk") {
+  MockClock clock;
+  auto dir = kj::newInMemoryDirectory(kj::nullClock());
+  // Room for one entry in memory, and plenty on disk.
+  TestCache test(clock, { .memoryLimit = 200, .diskLimit = 1 << 20 }, *dir);
+
+  test.put("http://foo/a", CACHEABLE, BODY);
+  KJ_EXPECT(dir->listNames().size() == 0);
+
+  // Storing a second entry demotes the first to disk.
+  test.put("http://foo/b", CACHEABLE, BODY);
+  KJ_EXPECT(dir->listNames().size() == 1);
+
+  // Hitting the first promotes it back to memory, which demotes the second in turn.
+  KJ_EXPECT(bodyOf(test.get("http://foo/a")) == BODY);
+  KJ_EXPECT(dir->listNames().size() == 1);
+  KJ_EXPECT(bodyOf(test.get("http://foo/b")) == BODY);
+  KJ_EXPECT(bodyOf(test.get("http://foo/a")) == BODY);
+
+  // Entries too big for memory go straight to disk, and are served from there.
+  auto big = kj::str(kj::repeat('y', 1000));
+  test.put("http://foo/big", CACHEABLE, big);
+  KJ_EXPECT(dir->listNames().size() == 2);
+  KJ_EXPECT(bodyOf(test.get("http://foo/big")) == big);
+  KJ_EXPECT(dir->listNames().size() == 2);
+}
+
+KJ_TEST("LocalCache: disk tier evicts least recently used entries") {
+  MockClock clock;
+  auto dir = kj::newInMemoryDirectory(kj::nullClock());
+  // Nothing fits in memory, and only one entry fits on disk.
+  TestCache test(clock, { .memoryLimit = 0, .diskLimit = 200 }, *dir);
+
+  test.put("http://foo/a", CACHEABLE, BODY);
+  test.put("http://foo/b", CACHEABLE, BODY);
+  KJ_EXPECT(dir->listNames().size() == 1);
+  KJ_EXPECT(test.get("http://foo/a") == kj::none);
+  KJ_EXPECT(bodyOf(test.get("http://foo/b")) == BODY);
+}
+
+KJ_TEST("LocalCache: disk tier is re-indexed after a restart") {
+  MockClock clock;
+  auto dir = kj::newInMemoryDirectory(kj::nullClock());
+  kj::StringPtr en[] = { "Accept-Language", "en" };
+  kj::StringPtr fr[] = { "Accept-Language", "fr" };
+
+  {
+    TestCache test(clock, { .memoryLimit = 0, .diskLimit = 1 << 20 }, *dir);
+    test.put("http://foo/a", kj::str(CACHEABLE, "Vary: Accept-Language\r\n"), "english", en);
+    test.put("http://foo/b", "Cache-Control: max-age=10\r\n", "short-lived");
+    KJ_EXPECT(dir->listNames().size() == 2);
+  }
+
+  // Files that aren't cache entries are removed on startup, as are expired entries.
+  dir->openFile(kj::Path({"junk"}), kj::WriteMode::CREATE)->writeAll("not a cache entry");
+  clock.time += 20 * kj::SECONDS;
+
+  TestCache test(clock, { .memoryLimit = 0, .diskLimit = 1 << 20 }, *dir);
+  KJ_EXPECT(dir->listNames().size() == 1);
+  KJ_EXPECT(bodyOf(test.get("http://foo/a", en)) == "english");
+  KJ_EXPECT(test.get("http://foo/a", fr) == kj::none);
+  KJ_EXPECT(test.get("http://foo/b") == kj::none);
+}
+
+}  // namespace
+}  // namespace workerd::server
@@ -0,0 +1,689 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "local-cache.h"
+#include <kj/debug.h>
+#include <kj/encoding.h>
+#include <openssl/sha.h>
+#include <workerd/util/strings.h>
+
+namespace workerd::server {
+
+namespace {
+
+// First line of every entry file in the disk tier. Bump the version if the format changes;
+// files with any other first line are discarded.
+constexpr kj::StringPtr DISK_FORMAT_MAGIC = "workerd-cache-v1"_kj;
+
+// Upper bound on the metadata lines at the start of an entry file (they mostly consist of the
+// URL, so this is generous).
+constexpr size_t MAX_DISK_METADATA_SIZE = 65536;
+
+// Longest time an entry is kept, however long its `max-age` says it may be. Clamping also keeps the
+// expiry time from overflowing, which it would for lifetimes of a few hundred years or more.
+constexpr uint64_t MAX_TTL_SECONDS = 365 * 24 * 60 * 60;
+
+// Calls `func` for each element of a comma-separated header value, with surrounding whitespace
+// removed.
+template <typename Func>
+void forEachListElement(kj::StringPtr value, Func&& func) {
+  auto rest = value.asArray();
+  while (rest.size() > 0) {
+    size_t end = 0;
+    while (end < rest.size() && rest[end] != ',') ++end;
+    auto element = rest.slice(0, end);
+    rest = rest.slice(kj::min(end + 1, rest.size()), rest.size());
+
+    while (element.size() > 0 && (element.front() == ' ' || element.front() == '\t')) {
+      element = element.slice(1, element.size());
+    }
+    while (element.size() > 0 && (element.back() == ' ' || element.back() == '\t')) {
+      element = element.slice(0, element.size() - 1);
+    }
+    if (element.size() > 0) func(element);
+  }
+}
+
+struct CacheControl {
+  bool storable = true;
+  kj::Maybe<uint64_t> maxAge;
+  kj::Maybe<uint64_t> sMaxAge;
+};
+
+CacheControl parseCacheControl(kj::Maybe<kj::StringPtr> header) {
+  CacheControl result;
+  KJ_IF_SOME(h, header) {
+    forEachListElement(h, [&](kj::ArrayPtr<const char> directive) {
+      kj::ArrayPtr<const char> name = directive;
+      kj::ArrayPtr<const char> value = nullptr;
+      for (auto i: kj::indices(directive)) {
+        if (directive[i] == '=') {
+          name = directive.slice(0, i);
+          value = directive.slice(i + 1, directive.size());
+          if (value.size() >= 2 && value.front() == '"' && value.back() == '"') {
+            value = value.slice(1, value.size() - 1);
+          }
+          break;
+        }
+      }
+
+      auto lowerName = toLowerCopy(name);
+      if (lowerName == "no-store" || lowerName == "private") {
+        result.storable = false;
+      } else if (lowerName == "max-age") {
+        result.maxAge = kj::str(value).tryParseAs<uint64_t>();
+      } else if (lowerName == "s-maxage") {
+        result.sMaxAge = kj::str(value).tryParseAs<uint64_t>();
+      }
+    });
+  }
+  return result;
+}
+
+kj::Maybe<kj::String> decodeComponent(kj::ArrayPtr<const char> text) {
+  auto decoded = kj::decodeUriComponent(text);
+  if (decoded.hadErrors) return kj::none;
+  return kj::String(kj::mv(decoded));
+}
+
+kj::String diskFileName(kj::StringPtr key, kj::StringPtr encodedVary) {
+  auto data = kj::str(key, '\n', encodedVary);
+  kj::byte digest[SHA256_DIGEST_LENGTH];
+  SHA256(data.asBytes().begin(), data.size(), digest);
+  return kj::encodeHex(digest);
+}
+
+kj::Maybe<size_t> findHeadEnd(kj::ArrayPtr<const kj::byte> payload) {
+  for (size_t i = 0; i + 4 <= payload.size(); i++) {
+    if (payload[i] == '\r' && payload[i + 1] == '\n' &&
+        payload[i + 2] == '\r' && payload[i + 3] == '\n') {
+      return i + 4;
+    }
+  }
+  return kj::none;
+}
+
+}  // namespace
+
+LocalCache::LocalCache(const kj::Clock& clock, kj::HttpHeaderTable::Builder& headerTableBuilder,
+                       Options options)
+    : clock(clock),
+      headerTable(headerTableBuilder.getFutureTable()),
+      hCacheStatus(headerTableBuilder.add("CF-Cache-Status")),
+      hCacheNamespace(headerTableBuilder.add("CF-Cache-Namespace")),
+      hCacheControl(headerTableBuilder.add("Cache-Control")),
+      hVary(headerTableBuilder.add("Vary")),
+      hSetCookie(headerTableBuilder.add("Set-Cookie")),
+      options(options) {}
+
+LocalCache::~LocalCache() noexcept(false) {
+  while (!memoryLru.empty()) memoryLru.remove(memoryLru.front());
+  while (!diskLru.empty()) diskLru.remove(diskLru.front());
+}
+
+void LocalCache::setDiskDirectory(const kj::Directory& dir) {
+  diskDir = dir;
+
+  auto now = clock.now();
+  for (auto& name: dir.listNames()) {
+    // Skip temporary files from an interrupted replaceFile().
+    if (name.startsWith(".")) continue;
+
+    KJ_IF_SOME(entry, loadFromDisk(name)) {
+      KJ_IF_SOME(expires, entry->expires) {
+        if (expires <= now) {
+          dir.tryRemove(kj::Path({name}));
+          continue;
+        }
+      }
+      link(*entry);
+      auto& variants = index.findOrCreate(entry->key, [&]() {
+        return decltype(index)::Entry { kj::str(entry->key), {} };
+      });
+      variants.add(kj::mv(entry));
+    } else {
+      KJ_LOG(WARNING, "removing unreadable cache entry file", name);
+      dir.tryRemove(kj::Path({name}));
+    }
+  }
+
+  enforceLimits();
+}
+
+kj::Promise<void> LocalCache::request(
+    kj::HttpMethod method, kj::StringPtr url, const kj::HttpHeaders& headers,
+    kj::AsyncInputStream& requestBody, Response& response) {
+  auto key = kj::str(headers.get(hCacheNamespace).orDefault(""_kj), '\n', url);
+
+  switch (method) {
+    case kj::HttpMethod::GET:
+      return match(kj::mv(key), headers, response);
+    case kj::HttpMethod::PUT:
+      return put(kj::mv(key), headers, requestBody, response);
+    case kj::HttpMethod::PURGE:
+      return purge(kj::mv(key), response);
+    default:
+      return response.sendError(405, "Method Not Allowed", headerTable);
+  }
+}
+
+kj::Promise<void> LocalCache::match(
+    kj::String key, const kj::HttpHeaders& requestHeaders, Response& response) {
+  auto sendMiss = [&]() {
+    kj::HttpHeaders headers(headerTable);
+    headers.set(hCacheStatus, "MISS");
+    response.send(504, "Gateway Timeout", headers, uint64_t(0));
+  };
+
+  auto& found = KJ_UNWRAP_OR(findVariant(key, requestHeaders), {
+    sendMiss();
+    co_return;
+  });
+
+  KJ_IF_SOME(expires, found.expires) {
+    if (expires <= clock.now()) {
+      remove(found);
+      sendMiss();
+      co_return;
+    }
+  }
+
+  kj::Own<Entry> entry;
+  kj::Maybe<kj::Own<const kj::ReadableFile>> file;
+  if (found.fileName == kj::none) {
+    // Move to the front of the LRU list.
+    unlink(found);
+    link(found);
+    entry = kj::addRef(found);
+  } else if (found.size() <= options.memoryLimit) {
+    // Promote into memory.
+    entry = KJ_UNWRAP_OR(readFromDisk(found), {
+      remove(found);
+      sendMiss();
+      co_return;
+    });
+    replace(found, kj::addRef(*entry));
+    enforceLimits();
+  } else {
+    auto& dir = KJ_ASSERT_NONNULL(diskDir);
+    file = KJ_UNWRAP_OR(dir.tryOpenFile(kj::Path({KJ_ASSERT_NONNULL(found.fileName)})), {
+      remove(found);
+      sendMiss();
+      co_return;
+    });
+    unlink(found);
+    link(found);
+    entry = kj::addRef(found);
+  }
+
+  auto headers = entry->headers->cloneShallow();
+  headers.unset(kj::HttpHeaderId::CONTENT_LENGTH);
+  headers.unset(kj::HttpHeaderId::TRANSFER_ENCODING);
+  headers.set(hCacheStatus, "HIT");
+
+  uint statusCode = entry->statusCode;
+  kj::StringPtr statusText = entry->statusText;
+  uint64_t start = 0;
+  uint64_t size = entry->bodySize;
+
+  if (statusCode == 200) {
+    KJ_IF_SOME(range, requestHeaders.get(kj::HttpHeaderId::RANGE)) {
+      KJ_SWITCH_ONEOF(kj::tryParseHttpRangeHeader(range.asArray(), entry->bodySize)) {
+        KJ_CASE_ONEOF(ranges, kj::Array<kj::HttpByteRange>) {
+          // Like Cloudflare's cache, we only serve single ranges.
+          if (ranges.size() == 1) {
+            start = ranges[0].start;
+            size = ranges[0].end - ranges[0].start + 1;
+            headers.set(kj::HttpHeaderId::CONTENT_RANGE,
+                kj::str("bytes ", ranges[0].start, "-", ranges[0].end, "/", entry->bodySize));
+            statusCode = 206;
+            statusText = "Partial Content";
+          }
+        }
+        KJ_CASE_ONEOF(_, kj::HttpEverythingRange) {}
+        KJ_CASE_ONEOF(_, kj::HttpUnsatisfiableRange) {
+          kj::HttpHeaders errorHeaders(headerTable);
+          errorHeaders.set(hCacheStatus, "HIT");
+          errorHeaders.set(kj::HttpHeaderId::CONTENT_RANGE, kj::str("bytes */", entry->bodySize));
+          co_return co_await response.sendError(416, "Range Not Satisfiable", errorHeaders);
+        }
+      }
+    }
+  }
+
+  headers.set(kj::HttpHeaderId::CONTENT_LENGTH, kj::str(size));
+  auto out = response.send(statusCode, statusText, headers, size);
+
+  KJ_IF_SOME(f, file) {
+    auto in = kj::heap<kj::FileInputStream>(*f, entry->bodyOffset + start);
+    co_await in->pumpTo(*out, size);
+  } else {
+    co_await out->write(entry->payload.begin() + entry->bodyOffset + start, size);
+  }
+}
+
+kj::Promise<void> LocalCache::put(
+    kj::String key, const kj::HttpHeaders& requestHeaders,
+    kj::AsyncInputStream& requestBody, Response& response) {
+  uint64_t limit = options.memoryLimit;
+  if (diskDir != kj::none) limit = kj::max(limit, options.diskLimit);
+
+  // Read the whole payload, bailing out as soon as we know it can't be stored.
+  kj::Vector<kj::byte> buffer;
+  KJ_IF_SOME(length, requestBody.tryGetLength()) {
+    if (length > limit) {
+      co_return co_await response.sendError(413, "Payload Too Large", headerTable);
+    }
+    buffer.reserve(length);
+  }
+  for (;;) {
+    size_t pos = buffer.size();
+    buffer.resize(kj::max(pos + 4096, buffer.capacity()));
+    size_t n = co_await requestBody.tryRead(buffer.begin() + pos, 1, buffer.size() - pos);
+    buffer.resize(pos + n);
+    if (buffer.size() > limit) {
+      co_return co_await response.sendError(413, "Payload Too Large", headerTable);
+    }
+    if (n == 0) break;
+  }
+  auto payload = buffer.releaseAsArray();
+
+  auto headSize = KJ_UNWRAP_OR(findHeadEnd(payload), {
+    co_return co_await response.sendError(400, "Bad Request", headerTable);
+  });
+
+  auto entry = kj::refcounted<Entry>();
+  entry->key = kj::mv(key);
+  entry->headSize = headSize;
+  entry->bodyOffset = headSize;
+  entry->bodySize = payload.size() - headSize;
+  entry->parsedHead = kj::heapArray(payload.slice(0, headSize).asChars());
+  if (!parseHead(*entry)) {
+    co_return co_await response.sendError(400, "Bad Request", headerTable);
+  }
+
+  auto& responseHeaders = *entry->headers;
+  auto cacheControl = parseCacheControl(responseHeaders.get(hCacheControl));
+  bool storable = cacheControl.storable && responseHeaders.get(hSetCookie) == kj::none;
+
+  kj::Vector<VaryHeader> vary;
+  KJ_IF_SOME(varyHeader, responseHeaders.get(hVary)) {
+    forEachListElement(varyHeader, [&](kj::ArrayPtr<const char> name) {
+      if (name == "*"_kj.asArray()) {
+        storable = false;
+      } else {
+        auto lowerName = toLowerCopy(name);
+        auto value = getRequestHeader(requestHeaders, lowerName).map([](kj::StringPtr v) {
+          return kj::str(v);
+        });
+        vary.add(VaryHeader { kj::mv(lowerName), kj::mv(value) });
+      }
+    });
+  }
+  entry->vary = vary.releaseAsArray();
+
+  // s-maxage is meant for shared caches, which we are.
+  kj::Maybe<uint64_t> maxAge = cacheControl.sMaxAge;
+  if (maxAge == kj::none) maxAge = cacheControl.maxAge;
+  KJ_IF_SOME(ttl, maxAge) {
+    if (ttl == 0) storable = false;
+    entry->expires = clock.now() + kj::min(ttl, MAX_TTL_SECONDS) * kj::SECONDS;
+  }
+
+  if (storable) {
+    entry->payload = kj::mv(payload);
+    if (entry->size() <= options.memoryLimit) {
+      insert(kj::mv(entry));
+    } else {
+      // Too large for memory, so it must be going to disk.
+      auto onDisk = KJ_UNWRAP_OR(writeToDisk(*entry), {
+        co_return co_await response.sendError(413, "Payload Too Large", headerTable);
+      });
+      insert(kj::mv(onDisk));
+    }
+    enforceLimits();
+  }
+
+  kj::HttpHeaders headers(headerTable);
+  response.send(204, "No Content", headers);
+}
+
+kj::Promise<void> LocalCache::purge(kj::String key, Response& response) {
+  bool found = false;
+  KJ_IF_SOME(variants, index.find(key)) {
+    found = true;
+    while (variants.size() > 1) {
+      remove(*variants.back());
+    }
+    // Removing the last variant also removes the index entry (and `variants` along with it).
+    remove(*variants.front());
+  }
+
+  kj::HttpHeaders headers(headerTable);
+  if (found) {
+    response.send(200, "OK", headers, uint64_t(0));
+  } else {
+    response.send(404, "Not Found", headers, uint64_t(0));
+  }
+  return kj::READY_NOW;
+}
+
+bool LocalCache::VaryHeader::operator==(const VaryHeader& other) const {
+  if (name != other.name) return false;
+  KJ_IF_SOME(a, value) {
+    KJ_IF_SOME(b, other.value) {
+      return a == b;
+    }
+    return false;
+  }
+  return other.value == kj::none;
+}
+
+kj::Array<LocalCache::VaryHeader> LocalCache::cloneVary(kj::ArrayPtr<const VaryHeader> vary) {
+  return KJ_MAP(v, vary) {
+    return VaryHeader { kj::str(v.name), v.value.map([](const kj::String& s) {
+      return kj::str(s);
+    }) };
+  };
+}
+
+kj::String LocalCache::encodeVary(kj::ArrayPtr<const VaryHeader> vary) {
+  auto parts = KJ_MAP(v, vary) {
+    KJ_IF_SOME(value, v.value) {
+      return kj::str(kj::encodeUriComponent(v.name), ':', kj::encodeUriComponent(value));
+    }
+    return kj::encodeUriComponent(v.name);
+  };
+  return kj::strArray(parts, "&");
+}
+
+bool LocalCache::parseHead(Entry& entry) {
+  entry.headers = kj::heap<kj::HttpHeaders>(headerTable);
+  KJ_SWITCH_ONEOF(entry.headers->tryParseResponse(entry.parsedHead)) {
+    KJ_CASE_ONEOF(parsed, kj::HttpHeaders::Response) {
+      entry.statusCode = parsed.statusCode;
+      entry.statusText = parsed.statusText;
+      return true;
+    }
+    KJ_CASE_ONEOF(_, kj::HttpHeaders::ProtocolError) {
+      return false;
+    }
+  }
+  KJ_UNREACHABLE;
+}
+
+kj::Maybe<LocalCache::Entry&> LocalCache::findVariant(
+    kj::StringPtr key, const kj::HttpHeaders& headers) {
+  auto& variants = KJ_UNWRAP_OR(index.find(key), return kj::none);
+  for (auto& entry: variants) {
+    bool matches = true;
+    for (auto& v: entry->vary) {
+      auto value = getRequestHeader(headers, v.name);
+      KJ_IF_SOME(expected, v.value) {
+        KJ_IF_SOME(actual, value) {
+          matches = actual == expected;
+        } else {
+          matches = false;
+        }
+      } else {
+        matches = value == kj::none;
+      }
+      if (!matches) break;
+    }
+    if (matches) return *entry;
+  }
+  return kj::none;
+}
+
+kj::Maybe<kj::StringPtr> LocalCache::getRequestHeader(
+    const kj::HttpHeaders& headers, kj::StringPtr name) {
+  KJ_IF_SOME(id, headerTable.stringToId(name)) {
+    return headers.get(id);
+  }
+
+  kj::Maybe<kj::StringPtr> result;
+  headers.forEach([&](kj::StringPtr headerName, kj::StringPtr value) {
+    if (result == kj::none && toLowerCopy(headerName) == name) {
+      result = value;
+    }
+  });
+  return result;
+}
+
+void LocalCache::insert(kj::Own<Entry> entry) {
+  auto& variants = index.findOrCreate(entry->key, [&]() {
+    return decltype(index)::Entry { kj::str(entry->key), {} };
+  });
+
+  for (auto& existing: variants) {
+    if (existing->vary == entry->vary) {
+      replace(*existing, kj::mv(entry));
+      return;
+    }
+  }
+
+  link(*entry);
+  variants.add(kj::mv(entry));
+}
+
+void LocalCache::replace(Entry& old, kj::Own<Entry> replacement) {
+  auto& variants = KJ_ASSERT_NONNULL(index.find(old.key));
+  for (auto& slot: variants) {
+    if (slot.get() == &old) {
+      unlink(old);
+      KJ_IF_SOME(oldName, old.fileName) {
+        // A replacement written to disk for the same variant reuses the same file name.
+        bool sameFile = false;
+        KJ_IF_SOME(newName, replacement->fileName) {
+          sameFile = newName == oldName;
+        }
+        KJ_IF_SOME(dir, diskDir) {
+          if (!sameFile) dir.tryRemove(kj::Path({oldName}));
+        }
+      }
+      link(*replacement);
+      slot = kj::mv(replacement);
+      return;
+    }
+  }
+  KJ_FAIL_ASSERT("entry not in index");
+}
+
+void LocalCache::remove(Entry& entry) {
+  auto& variants = KJ_ASSERT_NONNULL(index.find(entry.key));
+  for (auto i: kj::indices(variants)) {
+    if (variants[i].get() == &entry) {
+      // Keep the entry alive until we're done with it.
+      auto own = kj::mv(variants[i]);
+      if (i != variants.size() - 1) variants[i] = kj::mv(variants.back());
+      variants.removeLast();
+
+      unlink(entry);
+      KJ_IF_SOME(name, entry.fileName) {
+        KJ_IF_SOME(dir, diskDir) {
+          dir.tryRemove(kj::Path({name}));
+        }
+      }
+      if (variants.size() == 0) {
+        index.erase(entry.key);
+      }
+      return;
+    }
+  }
+  KJ_FAIL_ASSERT("entry not in index");
+}
+
+void LocalCache::link(Entry& entry) {
+  if (entry.fileName == kj::none) {
+    memoryLru.addFront(entry);
+    memoryBytes += entry.size();
+  } else {
+    diskLru.addFront(entry);
+    diskBytes += entry.size();
+  }
+}
+
+void LocalCache::unlink(Entry& entry) {
+  if (entry.fileName == kj::none) {
+    memoryLru.remove(entry);
+    memoryBytes -= entry.size();
+  } else {
+    diskLru.remove(entry);
+    diskBytes -= entry.size();
+  }
+}
+
+void LocalCache::enforceLimits() {
+  while (memoryBytes > options.memoryLimit && !memoryLru.empty()) {
+    auto& victim = memoryLru.back();
+    if (diskDir != kj::none && victim.size() <= options.diskLimit) {
+      KJ_IF_SOME(demoted, writeToDisk(victim)) {
+        replace(victim, kj::mv(demoted));
+        continue;
+      }
+    }
+    remove(victim);
+  }
+
+  while (diskBytes > options.diskLimit && !diskLru.empty()) {
+    remove(diskLru.back());
+  }
+}
+
+kj::Maybe<kj::Own<LocalCache::Entry>> LocalCache::writeToDisk(const Entry& entry) {
+  auto& dir = KJ_UNWRAP_OR(diskDir, return kj::none);
+
+  auto encodedVary = encodeVary(entry.vary);
+
+  kj::String expires = entry.expires.map([](kj::Date d) {
+    return kj::str((d - kj::UNIX_EPOCH) / kj::MILLISECONDS);
+  }).orDefault([]() { return kj::str("-"); });
+
+  auto metadata = kj::str(
+      DISK_FORMAT_MAGIC, '\n',
+      expires, '\n',
+      entry.headSize, ' ', entry.bodySize, '\n',
+      kj::encodeUriComponent(entry.key), '\n',
+      encodedVary, '\n');
+  auto name = diskFileName(entry.key, encodedVary);
+
+  KJ_IF_SOME(exception, kj::runCatchingExceptions([&]() {
+    auto replacer = dir.replaceFile(kj::Path({name}),
+        kj::WriteMode::CREATE | kj::WriteMode::MODIFY);
+    auto& file = replacer->get();
+    file.write(0, metadata.asBytes());
+    file.write(metadata.size(), entry.payload.slice(0, entry.size()));
+    replacer->commit();
+  })) {
+    KJ_LOG(ERROR, "failed to write cache entry to disk", exception);
+    return kj::none;
+  }
+
+  auto result = kj::refcounted<Entry>();
+  result->key = kj::str(entry.key);
+  result->vary = cloneVary(entry.vary);
+  result->expires = entry.expires;
+  result->fileName = kj::mv(name);
+  result->headSize = entry.headSize;
+  result->bodySize = entry.bodySize;
+  result->bodyOffset = metadata.size() + entry.headSize;
+  result->parsedHead = kj::heapArray(entry.payload.slice(0, entry.headSize).asChars());
+  // We parsed the same head successfully when it was stored.
+  KJ_ASSERT(parseHead(*result));
+  return kj::mv(result);
+}
+
+kj::Maybe<kj::Own<LocalCache::Entry>> LocalCache::readFromDisk(const Entry& entry) {
+  auto& dir = KJ_UNWRAP_OR(diskDir, return kj::none);
+  auto& name = KJ_ASSERT_NONNULL(entry.fileName);
+
+  auto file = KJ_UNWRAP_OR(dir.tryOpenFile(kj::Path({name})), return kj::none);
+  auto result = kj::refcounted<Entry>();
+  result->payload = kj::heapArray<kj::byte>(entry.size());
+  auto headOffset = entry.bodyOffset - entry.headSize;
+  if (file->read(headOffset, result->payload) < result->payload.size()) {
+    return kj::none;
+  }
+
+  result->key = kj::str(entry.key);
+  result->vary = cloneVary(entry.vary);
+  result->expires = entry.expires;
+  result->headSize = entry.headSize;
+  result->bodySize = entry.bodySize;
+  result->bodyOffset = entry.headSize;
+  result->parsedHead = kj::heapArray(result->payload.slice(0, entry.headSize).asChars());
+  if (!parseHead(*result)) return kj::none;
+  return kj::mv(result);
+}
+
+kj::Maybe<kj::Own<LocalCache::Entry>> LocalCache::loadFromDisk(kj::StringPtr fileName) {
+  auto& dir = KJ_ASSERT_NONNULL(diskDir);
+  auto file = KJ_UNWRAP_OR(dir.tryOpenFile(kj::Path({fileName})), return kj::none);
+
+  auto fileSize = file->stat().size;
+  auto metadataBuffer = kj::heapArray<kj::byte>(kj::min(fileSize, MAX_DISK_METADATA_SIZE));
+  auto text = metadataBuffer.slice(0, file->read(0, metadataBuffer)).asChars();
+
+  // Split off the five metadata lines.
+  kj::ArrayPtr<const char> lines[5];
+  size_t pos = 0;
+  for (auto& line: lines) {
+    size_t end = pos;
+    while (end < text.size() && text[end] != '\n') ++end;
+    if (end == text.size()) return kj::none;
+    line = text.slice(pos, end);
+    pos = end + 1;
+  }
+  size_t metadataSize = pos;
+
+  if (lines[0] != DISK_FORMAT_MAGIC.asArray()) return kj::none;
+
+  auto result = kj::refcounted<Entry>();
+
+  if (lines[1] != "-"_kj.asArray()) {
+    auto ms = KJ_UNWRAP_OR(kj::str(lines[1]).tryParseAs<int64_t>(), return kj::none);
+    result->expires = kj::UNIX_EPOCH + ms * kj::MILLISECONDS;
+  }
+
+  auto sizes = kj::str(lines[2]);
+  auto space = KJ_UNWRAP_OR(sizes.findFirst(' '), return kj::none);
+  result->headSize = KJ_UNWRAP_OR(kj::str(sizes.slice(0, space)).tryParseAs<uint64_t>(),
+                                  return kj::none);
+  result->bodySize = KJ_UNWRAP_OR(sizes.slice(space + 1).tryParseAs<uint64_t>(),
+                                  return kj::none);
+  if (metadataSize + result->headSize + result->bodySize != fileSize) return kj::none;
+
+  result->key = KJ_UNWRAP_OR(decodeComponent(lines[3]), return kj::none);
+
+  kj::Vector<VaryHeader> vary;
+  auto varyText = lines[4];
+  while (varyText.size() > 0) {
+    size_t end = 0;
+    while (end < varyText.size() && varyText[end] != '&') ++end;
+    auto part = varyText.slice(0, end);
+    varyText = varyText.slice(kj::min(end + 1, varyText.size()), varyText.size());
+
+    VaryHeader header;
+    size_t colon = 0;
+    while (colon < part.size() && part[colon] != ':') ++colon;
+    header.name = KJ_UNWRAP_OR(decodeComponent(part.slice(0, colon)), return kj::none);
+    if (colon < part.size()) {
+      header.value = KJ_UNWRAP_OR(decodeComponent(part.slice(colon + 1, part.size())),
+                                  return kj::none);
+    }
+    vary.add(kj::mv(header));
+  }
+  result->vary = vary.releaseAsArray();
+
+  result->fileName = kj::str(fileName);
+  result->bodyOffset = metadataSize + result->headSize;
+  result->parsedHead = kj::heapArray<char>(result->headSize);
+  if (file->read(metadataSize, result->parsedHead.asBytes()) < result->headSize) {
+    return kj::none;
+  }
+  if (!parseHead(*result)) return kj::none;
+  return kj::mv(result);
+}
+
+}  // namespace workerd::server
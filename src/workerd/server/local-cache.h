@@ -0,0 +1,144 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#pragma once
+
+#include <kj/compat/http.h>
+#include <kj/filesystem.h>
+#include <kj/list.h>
+#include <kj/map.h>
+#include <kj/one-of.h>
+#include <kj/refcount.h>
+#include <kj/time.h>
+
+namespace workerd::server {
+
+// An in-process implementation of the HTTP protocol that the Cache API (see api/cache.c++) speaks
+// to a Worker's `cacheApiOutbound` service:
+//
+// * `GET` (sent with `Cache-Control: only-if-cached`) returns the stored response with
+//   `CF-Cache-Status: HIT`, or a 504 with `CF-Cache-Status: MISS`. A `Range` header is applied
+//   to the cached body.
+// * `PUT` carries a serialized HTTP response as its body, to be stored under the request URL.
+//   Responds 204, or 413 if the entry is too large to store.
+// * `PURGE` removes all variants stored under the URL, responding 200, or 404 if none existed.
+//
+// The `CF-Cache-Namespace` header, if present, selects a separate namespace (`caches.open()`).
+//
+// Responses are stored according to their `Cache-Control` (`s-maxage` takes precedence over
+// `max-age`; `no-store` and `private` responses are not stored) and `Vary` headers. As on
+// Cloudflare, responses with `Set-Cookie` are not stored.
+//
+// Entries live in memory, bounded by a byte budget. Optionally, a directory can be provided as a
+// second tier: entries evicted from memory, or too large for it, are written there (bounded by a
+// separate budget) and promoted back into memory when hit. Entries on disk survive restarts.
+class LocalCache final: public kj::HttpService {
+public:
+  struct Options {
+    // Maximum total size of entries kept in memory, in bytes.
+    uint64_t memoryLimit;
+
+    // Maximum total size of entries kept in the disk directory, if any, in bytes.
+    uint64_t diskLimit;
+  };
+
+  LocalCache(const kj::Clock& clock, kj::HttpHeaderTable::Builder& headerTableBuilder,
+             Options options);
+  ~LocalCache() noexcept(false);
+  KJ_DISALLOW_COPY_AND_MOVE(LocalCache);
+
+  // Enables the disk tier, storing entries in `dir`. Entries left there by a previous run are
+  // indexed; expired or unreadable ones are removed. Must be called before any requests.
+  void setDiskDirectory(const kj::Directory& dir);
+
+  kj::Promise<void> request(
+      kj::HttpMethod method, kj::StringPtr url, const kj::HttpHeaders& headers,
+      kj::AsyncInputStream& requestBody, Response& response) override;
+
+private:
+  struct VaryHeader {
+    // Lower-case header name.
+    kj::String name;
+    kj::Maybe<kj::String> value;
+
+    bool operator==(const VaryHeader& other) const;
+  };
+
+  // One stored response. Entries are immutable once indexed (except for their position in the
+  // LRU lists); moving an entry between tiers replaces it with a new one. They are refcounted
+  // so that a response being streamed out survives eviction.
+  struct Entry: public kj::Refcounted {
+    kj::String key;
+
+    // The request headers named by the response's `Vary` header, as they were sent with the PUT.
+    kj::Array<VaryHeader> vary;
+    kj::Maybe<kj::Date> expires;
+
+    // The serialized response head (status line and headers), followed by the body. Only held
+    // for entries in memory; entries on disk are read back from `fileName`, where the body starts
+    // at `bodyOffset` just as it does in `payload`.
+    kj::Array<kj::byte> payload;
+    kj::Maybe<kj::String> fileName;
+    uint64_t headSize = 0;
+    uint64_t bodySize = 0;
+    uint64_t bodyOffset = 0;
+
+    // Parsed copy of the response head. `headers` points into `parsedHead`.
+    kj::Array<char> parsedHead;
+    uint statusCode = 0;
+    kj::StringPtr statusText;
+    kj::Own<kj::HttpHeaders> headers;
+
+    kj::ListLink<Entry> link;
+
+    uint64_t size() const { return headSize + bodySize; }
+  };
+
+  const kj::Clock& clock;
+  kj::HttpHeaderTable& headerTable;
+  kj::HttpHeaderId hCacheStatus;
+  kj::HttpHeaderId hCacheNamespace;
+  kj::HttpHeaderId hCacheControl;
+  kj::HttpHeaderId hVary;
+  kj::HttpHeaderId hSetCookie;
+  Options options;
+
+  kj::Maybe<const kj::Directory&> diskDir;
+
+  // All variants stored under each key, where a key is the namespace and URL.
+  kj::HashMap<kj::String, kj::Vector<kj::Own<Entry>>> index;
+
+  // Entries in each tier, most recently used first.
+  kj::List<Entry, &Entry::link> memoryLru;
+  kj::List<Entry, &Entry::link> diskLru;
+  uint64_t memoryBytes = 0;
+  uint64_t diskBytes = 0;
+
+  kj::Promise<void> match(kj::String key, const kj::HttpHeaders& headers, Response& response);
+  kj::Promise<void> put(kj::String key, const kj::HttpHeaders& headers,
+                        kj::AsyncInputStream& requestBody, Response& response);
+  kj::Promise<void> purge(kj::String key, Response& response);
+
+  static kj::Array<VaryHeader> cloneVary(kj::ArrayPtr<const VaryHeader> vary);
+  static kj::String encodeVary(kj::ArrayPtr<const VaryHeader> vary);
+
+  // Parses `entry.parsedHead` into its status and headers. Returns false if it is malformed.
+  bool parseHead(Entry& entry);
+
+  kj::Maybe<Entry&> findVariant(kj::StringPtr key, const kj::HttpHeaders& headers);
+  kj::Maybe<kj::StringPtr> getRequestHeader(const kj::HttpHeaders& headers, kj::StringPtr name);
+
+  void insert(kj::Own<Entry> entry);
+  void replace(Entry& old, kj::Own<Entry> replacement);
+  void remove(Entry& entry);
+  void link(Entry& entry);
+  void unlink(Entry& entry);
+  void enforceLimits();
+
+  kj::Maybe<kj::Own<Entry>> writeToDisk(const Entry& entry);
+  kj::Maybe<kj::Own<Entry>> readFromDisk(const Entry& entry);
+  kj::Maybe<kj::Own<Entry>> loadFromDisk(kj::StringPtr fileName);
+};
+
+}  // namespace workerd::server
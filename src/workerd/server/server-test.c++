@@ -702,6 +702,199 @@ KJ_TEST("Server: serve modular Worker with imports") {
       "square.wasm says square(5) = 25");
 }
 
+KJ_TEST("Server: code cache directory") {
+  TestServer test(R"((
+    services = [
+      ( name = "hello",
+        worker = (
+          compatibilityDate = "2022-08-17",
+          modules = [
+            ( name = "main.js",
+              esModule =
+                `import { MESSAGE } from "foo.js";
+                `import BAR from "bar.js";
+                `export default {
+                `  async fetch(request) {
+                `    return new Response(MESSAGE + " " + BAR.message);
+                `  }
+                `}
+            ),
+            ( name = "foo.js",
+              esModule =
+                `export let MESSAGE = "Hello from foo.js"
+            ),
+            ( name = "bar.js",
+              commonJsModule =
+                `module.exports.message = "and bar.js";
+            )
+          ]
+        )
+      )
+    ],
+    sockets = [
+      ( name = "main",
+        address = "test-addr",
+        service = "hello"
+      )
+    ],
+    codeCacheDirectory = "../../code-cache"
+  ))"_kj);
+
+  test.start();
+  auto conn = test.connect("test-addr");
+  conn.httpGet200("/", "Hello from foo.js and bar.js");
+
+  // One entry was produced for each JavaScript module once the Worker's top-level code had run.
+  auto dir = test.root->openSubdir(kj::Path({"code-cache"_kj}));
+  uint esmCount = 0;
+  uint fnCount = 0;
+  for (auto& name: dir->listNames()) {
+    if (name.startsWith("esm-")) {
+      ++esmCount;
+    } else if (name.startsWith("fn-")) {
+      ++fnCount;
+    } else {
+      KJ_FAIL_EXPECT("unexpected code cache entry", name);
+    }
+    KJ_EXPECT(dir->openFile(kj::Path({name}))->stat().size > 0);
+  }
+  KJ_EXPECT(esmCount == 2);
+  KJ_EXPECT(fnCount == 1);
+}
+
+KJ_TEST("Server: code cache hits and rejections are counted") {
+  kj::StringPtr config = R"((
+    services = [
+      ( name = "hello",
+        worker = (
+          compatibilityDate = "2022-08-17",
+          modules = [
+            ( name = "main.js",
+              esModule =
+                `import BAR from "bar.js";
+                `export default {
+                `  async fetch(request) {
+                `    return new Response("Hello " + BAR.message);
+                `  }
+                `}
+            ),
+            ( name = "bar.js",
+              commonJsModule =
+                `module.exports.message = "from bar.js";
+            )
+          ]
+        )
+      )
+    ],
+    sockets = [
+      ( name = "main",
+        address = "test-addr",
+        service = "hello"
+      )
+    ],
+    codeCacheDirectory = "../../code-cache"
+  ))"_kj;
+
+  // Each run gets a fresh filesystem, so the entries are carried from one run to the next.
+  struct Entry {
+    kj::String name;
+    kj::Array<kj::byte> data;
+  };
+  kj::Vector<Entry> entries;
+
+  {
+    TestServer test(config);
+    test.start();
+    test.connect("test-addr").httpGet200("/", "Hello from bar.js");
+
+    auto stats = test.server.getCodeCacheStats();
+    KJ_EXPECT(stats.hits == 0);
+    KJ_EXPECT(stats.rejections == 0);
+    KJ_EXPECT(stats.produced == 2);
+    KJ_EXPECT(stats.producedBytes > 0);
+
+    auto dir = test.root->openSubdir(kj::Path({"code-cache"_kj}));
+    for (auto& name: dir->listNames()) {
+      auto data = dir->openFile(kj::Path({name}))->readAllBytes();
+      entries.add(Entry { kj::mv(name), kj::mv(data) });
+    }
+    KJ_ASSERT(entries.size() == 2);
+  }
+
+  {
+    TestServer test(config);
+    auto dir = test.root->openSubdir(kj::Path({"code-cache"_kj}), kj::WriteMode::CREATE);
+    for (auto& entry: entries) {
+      dir->openFile(kj::Path({entry.name}), kj::WriteMode::CREATE)->writeAll(entry.data);
+    }
+    test.start();
+    test.connect("test-addr").httpGet200("/", "Hello from bar.js");
+
+    auto stats = test.server.getCodeCacheStats();
+    KJ_EXPECT(stats.hits == 2);
+    KJ_EXPECT(stats.rejections == 0);
+    KJ_EXPECT(stats.produced == 0);
+  }
+
+  {
+    // Corrupt entries are rejected and replaced.
+    TestServer test(config);
+    auto dir = test.root->openSubdir(kj::Path({"code-cache"_kj}), kj::WriteMode::CREATE);
+    for (auto& entry: entries) {
+      dir->openFile(kj::Path({entry.name}), kj::WriteMode::CREATE)
+          ->writeAll("not code cache data"_kj);
+    }
+    test.start();
+    test.connect("test-addr").httpGet200("/", "Hello from bar.js");
+
+    auto stats = test.server.getCodeCacheStats();
+    KJ_EXPECT(stats.hits == 0);
+    KJ_EXPECT(stats.rejections == 2);
+    KJ_EXPECT(stats.produced == 2);
+  }
+}
+
+KJ_TEST("Server: embedded code cache falls back to code cache directory") {
+  TestServer test(R"((
+    services = [
+      ( name = "hello",
+        worker = (
+          compatibilityDate = "2022-08-17",
+          modules = [
+            ( name = "main.js",
+              esModule =
+                `export default {
+                `  async fetch(request) {
+                `    return new Response("Hello");
+                `  }
+                `}
+            )
+          ]
+        )
+      )
+    ],
+    sockets = [
+      ( name = "main",
+        address = "test-addr",
+        service = "hello"
+      )
+    ],
+    codeCacheDirectory = "../../code-cache",
+    embeddedCodeCache = [ (key = "esm-unrelated", data = 0x"00 01 02 03") ]
+  ))"_kj);
+
+  test.start();
+  auto conn = test.connect("test-addr");
+  conn.httpGet200("/", "Hello");
+
+  // The embedded entry doesn't match, so the entry produced was written to the directory.
+  auto dir = test.root->openSubdir(kj::Path({"code-cache"_kj}));
+  auto names = dir->listNames();
+  KJ_ASSERT(names.size() == 1);
+  KJ_EXPECT(names[0].startsWith("esm-"));
+  KJ_EXPECT(names[0] != "esm-unrelated");
+}
+
 KJ_TEST("Server: compatibility dates") {
   // The easiest flag to test is the presence of the global `navigator`.
   auto selfNavigatorCheckerWorker = [](kj::StringPtr compatProperties) {
@@ -1666,6 +1859,113 @@ KJ_TEST("Server: Durable Objects (on disk)") {
   }
 }
 
+KJ_TEST("Server: Durable Objects (in memory) with memory limit and snapshots") {
+  // The unique key contains a slash, which can't appear in the snapshot directory's name as is.
+  kj::StringPtr config = R"((
+    services = [
+      ( name = "hello",
+        worker = (
+          compatibilityDate = "2022-08-17",
+          modules = [
+            ( name = "main.js",
+              esModule =
+                `export default {
+                `  async fetch(request, env) {
+                `    let id = env.ns.idFromName("singleton")
+                `    let actor = env.ns.get(id)
+                `    return await actor.fetch(request)
+                `  }
+                `}
+                `export class MyActorClass {
+                `  constructor(state, env) {
+                `    this.storage = state.storage;
+                `  }
+                `  async fetch(request) {
+                `    let size = Number(new URL(request.url).searchParams.get("size"));
+                `    let count = (await this.storage.get("foo")) || 0;
+                `    try {
+                `      await this.storage.put("bar", "x".repeat(size));
+                `    } catch (e) {
+                `      return new Response(count + " " + e.message.split(".")[0]);
+                `    }
+                `    this.storage.put("foo", count + 1);
+                `    return new Response(count + "");
+                `  }
+                `}
+            )
+          ],
+          bindings = [(name = "ns", durableObjectNamespace = "MyActorClass")],
+          durableObjectNamespaces = [
+            ( className = "MyActorClass",
+              uniqueKey = "my/key",
+            )
+          ],
+          durableObjectStorage = (inMemory = void),
+          durableObjectInMemoryStorage = (
+            memoryLimit = 1000,
+            snapshotDisk = "my-disk",
+          )
+        )
+      ),
+      ( name = "my-disk",
+        disk = (
+          path = "../../var/do-snapshots",
+          writable = true,
+        )
+      ),
+    ],
+    sockets = [
+      ( name = "main",
+        address = "test-addr",
+        service = "hello"
+      )
+    ]
+  ))"_kj;
+
+  // Create a directory outside of the test scope which we can use across multiple TestServers.
+  auto dir = kj::newInMemoryDirectory(kj::nullClock());
+
+  {
+    TestServer test(config);
+    test.root->transfer(
+        kj::Path({"var"_kj, "do-snapshots"_kj}),
+        kj::WriteMode::CREATE | kj::WriteMode::CREATE_PARENT,
+        *dir, nullptr, kj::TransferMode::LINK);
+
+    auto paf = kj::newPromiseAndFulfiller<void>();
+    test.start(kj::mv(paf.promise));
+    auto conn = test.connect("test-addr");
+    conn.httpGet200("/?size=10", "0");
+
+    // A write that would take the data over the limit fails, and leaves storage as it was.
+    conn.httpGet200("/?size=2000", "1 Durable Object storage memory limit exceeded");
+    conn.httpGet200("/?size=10", "1");
+
+    // Nothing is written to the snapshot disk until the server drains.
+    KJ_EXPECT(dir->listNames().size() == 0);
+    paf.fulfiller->fulfill();
+    KJ_EXPECT(conn.isEof());
+    test.ws.poll();
+
+    auto names = dir->openSubdir(kj::Path({"my%2Fkey"}))->listNames();
+    KJ_ASSERT(names.size() == 1);
+    KJ_EXPECT(names[0].endsWith(".snapshot"));
+  }
+
+  // A new server picks up where the last one left off.
+  {
+    TestServer test(config);
+    test.root->transfer(
+        kj::Path({"var"_kj, "do-snapshots"_kj}),
+        kj::WriteMode::CREATE | kj::WriteMode::CREATE_PARENT,
+        *dir, nullptr, kj::TransferMode::LINK);
+
+    test.start();
+    auto conn = test.connect("test-addr");
+    conn.httpGet200("/?size=10", "2");
+  }
+}
+
 KJ_TEST("Server: Ephemeral Objects") {
   TestServer test(R"((
     services = [
@@ -2605,6 +2905,54 @@ KJ_TEST("Server: external server") {
   conn.recvHttp200("OK");
 }
 
+KJ_TEST("Server: external server connection limit") {
+  TestServer test(R"((
+    services = [
+      (name = "hello", external = (address = "ext-addr", connectionPool = (maxConnections = 1)))
+    ],
+    sockets = [
+      (name = "main", address = "test-addr", service = "hello")
+    ]
+  ))"_kj);
+
+  test.start();
+
+  auto conn1 = test.connect("test-addr");
+  auto conn2 = test.connect("test-addr");
+
+  conn1.sendHttpGet("/one");
+  conn2.sendHttpGet("/two");
+
+  // Only one connection is made. The second request waits for the first to finish, and then
+  // reuses its connection.
+  auto subreq = test.receiveSubrequest("ext-addr");
+  subreq.recv(R"(
+    GET /one HTTP/1.1
+    Host: foo
+
+  )"_blockquote);
+  subreq.send(R"(
+    HTTP/1.1 200 OK
+    Content-Length: 3
+    Content-Type: text/plain;charset=UTF-8
+
+    one)"_blockquote);
+  conn1.recvHttp200("one");
+
+  subreq.recv(R"(
+    GET /two HTTP/1.1
+    Host: foo
+
+  )"_blockquote);
+  subreq.send(R"(
+    HTTP/1.1 200 OK
+    Content-Length: 3
+    Content-Type: text/plain;charset=UTF-8
+
+    two)"_blockquote);
+  conn2.recvHttp200("two");
+}
+
 KJ_TEST("Server: external server proxy style") {
   TestServer test(R"((
     services = [
@@ -2824,6 +3172,7 @@ KJ_TEST("Server: disk service") {
     Content-Length: 19
     Content-Type: application/octet-stream
     Last-Modified: Sat, 03 Jan 1970 05:18:23 GMT
+    ETag: "ae88e6257600-13"
 
     hello from foo.txt
   )"_blockquote);
@@ -2834,6 +3183,7 @@ KJ_TEST("Server: disk service") {
     Content-Length: 19
     Content-Type: application/octet-stream
     Last-Modified: Fri, 05 Feb 1971 02:52:09 GMT
+    ETag: "7ad187fd8768c0-13"
 
     hello from bar.txt
   )"_blockquote);
@@ -2844,6 +3194,7 @@ KJ_TEST("Server: disk service") {
     Content-Length: 19
     Content-Type: application/octet-stream
     Last-Modified: Thu, 01 Jan 1970 00:00:00 GMT
+    ETag: "0-13"
 
     hello from qux.txt
   )"_blockquote);
@@ -2864,6 +3215,7 @@ KJ_TEST("Server: disk service") {
     Content-Length: 11
     Content-Type: application/octet-stream
     Last-Modified: Sat, 03 Jan 1970 05:18:23 GMT
+    ETag: "ae88e6257600-b"
 
   )"_blockquote);
 
@@ -2880,6 +3232,7 @@ KJ_TEST("Server: disk service") {
     Content-Type: application/octet-stream
     Content-Range: bytes 3-5/11
     Last-Modified: Sat, 03 Jan 1970 05:18:23 GMT
+    ETag: "ae88e6257600-b"
 
     345)"_blockquote);
 
@@ -2895,22 +3248,133 @@ KJ_TEST("Server: disk service") {
     Content-Length: 11
     Content-Type: application/octet-stream
     Last-Modified: Sat, 03 Jan 1970 05:18:23 GMT
+    ETag: "ae88e6257600-b"
 
     0123456789
   )"_blockquote);
 
-  // GET with many ranges returns full content.
+  // GET with many ranges returns multipart content.
   conn.send(R"(
     GET /numbers.txt HTTP/1.1
     Host: foo
     Range: bytes=1-3, 6-8
 
+  )"_blockquote);
+  conn.recv(R"(
+    HTTP/1.1 206 Partial Content
+    Content-Length: 240
+    Content-Type: multipart/byteranges; boundary=040404040404040404040404
+    Last-Modified: Sat, 03 Jan 1970 05:18:23 GMT
+    ETag: "ae88e6257600-b"
+
+
+    --040404040404040404040404
+    Content-Type: application/octet-stream
+    Content-Range: bytes 1-3/11
+
+    123
+    --040404040404040404040404
+    Content-Type: application/octet-stream
+    Content-Range: bytes 6-8/11
+
+    678
+    --040404040404040404040404--
+  )"_blockquote);
+
+  // GET with a range and a stale If-Range returns full content.
+  conn.send(R"(
+    GET /numbers.txt HTTP/1.1
+    Host: foo
+    Range: bytes=3-5
+    If-Range: "0-b"
+
+  )"_blockquote);
+  conn.recv(R"(
+    HTTP/1.1 200 OK
+    Content-Length: 11
+    Content-Type: application/octet-stream
+    Last-Modified: Sat, 03 Jan 1970 05:18:23 GMT
+    ETag: "ae88e6257600-b"
+
+    0123456789
+  )"_blockquote);
+
+  // GET with a matching If-None-Match returns 304.
+  conn.send(R"(
+    GET /numbers.txt HTTP/1.1
+    Host: foo
+    If-None-Match: "abc", W/"ae88e6257600-b"
+
+  )"_blockquote);
+  conn.recv(R"(
+    HTTP/1.1 304 Not Modified
+    Last-Modified: Sat, 03 Jan 1970 05:18:23 GMT
+    ETag: "ae88e6257600-b"
+
+  )"_blockquote);
+
+  // GET with a matching If-Modified-Since returns 304.
+  conn.send(R"(
+    GET /numbers.txt HTTP/1.1
+    Host: foo
+    If-Modified-Since: Sat, 03 Jan 1970 05:18:23 GMT
+
+  )"_blockquote);
+  conn.recv(R"(
+    HTTP/1.1 304 Not Modified
+    Last-Modified: Sat, 03 Jan 1970 05:18:23 GMT
+    ETag: "ae88e6257600-b"
+
+  )"_blockquote);
+
+  // Later dates, and dates in the other formats HTTP allows, also return 304.
+  for (auto date: { "Sat, 03 Jan 1970 05:18:24 GMT"_kj, "Fri, 01 Jan 2100 00:00:00 GMT"_kj,
+                    "Saturday, 03-Jan-70 05:18:23 GMT"_kj, "Sat Jan  3 05:18:23 1970"_kj }) {
+    conn.send(kj::str(
+        "GET /numbers.txt HTTP/1.1\n"
+        "Host: foo\n"
+        "If-Modified-Since: ", date, "\n"
+        "\n"));
+    conn.recv(R"(
+      HTTP/1.1 304 Not Modified
+      Last-Modified: Sat, 03 Jan 1970 05:18:23 GMT
+      ETag: "ae88e6257600-b"
+
+    )"_blockquote);
+  }
+
+  // Earlier and unparseable dates return the file.
+  for (auto date: { "Sat, 03 Jan 1970 05:18:22 GMT"_kj, "yesterday"_kj }) {
+    conn.send(kj::str(
+        "GET /numbers.txt HTTP/1.1\n"
+        "Host: foo\n"
+        "If-Modified-Since: ", date, "\n"
+        "\n"));
+    conn.recv(R"(
+      HTTP/1.1 200 OK
+      Content-Length: 11
+      Content-Type: application/octet-stream
+      Last-Modified: Sat, 03 Jan 1970 05:18:23 GMT
+      ETag: "ae88e6257600-b"
+
+      0123456789
+    )"_blockquote);
+  }
+
+  // A non-matching If-None-Match wins over a matching If-Modified-Since.
+  conn.send(R"(
+    GET /numbers.txt HTTP/1.1
+    Host: foo
+    If-None-Match: "abc"
+    If-Modified-Since: Sat, 03 Jan 1970 05:18:23 GMT
+
   )"_blockquote);
   conn.recv(R"(
     HTTP/1.1 200 OK
     Content-Length: 11
     Content-Type: application/octet-stream
     Last-Modified: Sat, 03 Jan 1970 05:18:23 GMT
+    ETag: "ae88e6257600-b"
 
     0123456789
   )"_blockquote);
@@ -3185,6 +3649,105 @@ KJ_TEST("Server: disk service writable") {
     Unauthorized)"_blockquote);
 }
 
+KJ_TEST("Server: disk service content types and cache") {
+  TestServer test(R"((
+    services = [
+      (name = "hello", disk = (path = "../../frob", writable = true,
+                               guessContentType = true, cacheSize = 16))
+    ],
+    sockets = [
+      (name = "main", address = "test-addr", service = "hello")
+    ]
+  ))"_kj);
+
+  auto mode = kj::WriteMode::CREATE | kj::WriteMode::CREATE_PARENT;
+  auto dir = test.root->openSubdir(kj::Path({"frob"_kj}), mode);
+  dir->openFile(kj::Path({"index.html"}), mode)->writeAll("<p>hi</p>\n");
+  dir->openFile(kj::Path({"big.js"}), mode)->writeAll("// too big to cache\n");
+  dir->openFile(kj::Path({"data.unknown"}), mode)->writeAll("???\n");
+
+  test.start();
+
+  auto conn = test.connect("test-addr");
+
+  // Requested twice, the second time served from the cache.
+  for (auto i KJ_UNUSED: kj::zeroTo(2)) {
+    conn.sendHttpGet("/index.html");
+    conn.recv(R"(
+      HTTP/1.1 200 OK
+      Content-Length: 10
+      Content-Type: text/html;charset=UTF-8
+      Last-Modified: Thu, 01 Jan 1970 00:00:00 GMT
+      ETag: "0-a"
+
+      <p>hi</p>
+    )"_blockquote);
+  }
+
+  conn.sendHttpGet("/big.js");
+  conn.recv(R"(
+    HTTP/1.1 200 OK
+    Content-Length: 20
+    Content-Type: text/javascript;charset=UTF-8
+    Last-Modified: Thu, 01 Jan 1970 00:00:00 GMT
+    ETag: "0-14"
+
+    // too big to cache
+  )"_blockquote);
+
+  conn.sendHttpGet("/data.unknown");
+  conn.recv(R"(
+    HTTP/1.1 200 OK
+    Content-Length: 4
+    Content-Type: application/octet-stream
+    Last-Modified: Thu, 01 Jan 1970 00:00:00 GMT
+    ETag: "0-4"
+
+    ???
+  )"_blockquote);
+
+  // Replacing a cached file serves the new content.
+  conn.send(R"(
+    PUT /index.html HTTP/1.1
+    Host: foo
+    Content-Length: 12
+
+    <p>bye!</p>
+  )"_blockquote);
+  conn.recv(R"(
+    HTTP/1.1 204 No Content
+
+    )"_blockquote);
+
+  conn.sendHttpGet("/index.html");
+  conn.recv(R"(
+    HTTP/1.1 200 OK
+    Content-Length: 12
+    Content-Type: text/html;charset=UTF-8
+    Last-Modified: Thu, 01 Jan 1970 00:00:00 GMT
+    ETag: "0-c"
+
+    <p>bye!</p>
+  )"_blockquote);
+
+  // Ranges are served out of the cached copy too.
+  conn.send(R"(
+    GET /index.html HTTP/1.1
+    Host: foo
+    Range: bytes=3-6
+
+  )"_blockquote);
+  conn.recv(R"(
+    HTTP/1.1 206 Partial Content
+    Content-Length: 4
+    Content-Type: text/html;charset=UTF-8
+    Content-Range: bytes 3-6/12
+    Last-Modified: Thu, 01 Jan 1970 00:00:00 GMT
+    ETag: "0-c"
+
+    bye!)"_blockquote);
+}
+
 KJ_TEST("Server: disk service allow dotfiles") {
   TestServer test(R"((
     services = [
@@ -3225,6 +3788,7 @@ KJ_TEST("Server: disk service allow dotfiles") {
     Content-Length: 6
     Content-Type: application/octet-stream
     Last-Modified: Thu, 01 Jan 1970 00:00:00 GMT
+    ETag: "0-6"
 
     waldo
   )"_blockquote);
@@ -3422,6 +3986,81 @@ KJ_TEST("Server: cache name is passed through to service") {
     cached)"_blockquote);
 }
 
+KJ_TEST("Server: local cache service") {
+  TestServer test(R"((
+    services = [
+      ( name = "hello",
+        worker = (
+          cacheApiOutbound = "cache",
+          compatibilityDate = "2022-08-17",
+          modules = [
+            ( name = "main.js",
+              esModule =
+                `export default {
+                `  async fetch(request, env, ctx) {
+                `    const key = "http://foo/thing";
+                `    const path = new URL(request.url).pathname;
+                `    const cache = path.startsWith("/named/") ? await caches.open("named")
+                `                                             : caches.default;
+                `    const op = path.slice(path.lastIndexOf("/") + 1);
+                `    if (op == "put") {
+                `      await cache.put(key, new Response("cached body", {
+                `        headers: {"Cache-Control": "max-age=3600"}
+                `      }));
+                `      return new Response("put");
+                `    } else if (op == "put-no-store") {
+                `      await cache.put(key, new Response("uncached body", {
+                `        headers: {"Cache-Control": "no-store"}
+                `      }));
+                `      return new Response("put");
+                `    } else if (op == "match") {
+                `      const response = await cache.match(key);
+                `      return new Response(response ? await response.text() : "miss");
+                `    } else if (op == "range") {
+                `      const response = await cache.match(new Request(key, {
+                `        headers: {"Range": "bytes=2-5"}
+                `      }));
+                `      return new Response(response.status + " " + await response.text());
+                `    } else if (op == "delete") {
+                `      return new Response(String(await cache.delete(key)));
+                `    }
+                `    return new Response("bad op", {status: 400});
+                `  }
+                `}
+            )
+          ]
+        )
+      ),
+      ( name = "cache", cache = () ),
+    ],
+    sockets = [
+      ( name = "main",
+        address = "test-addr",
+        service = "hello"
+      )
+    ]
+  ))"_kj);
+
+  test.start();
+  auto conn = test.connect("test-addr");
+
+  conn.httpGet200("/match", "miss");
+  conn.httpGet200("/put", "put");
+  conn.httpGet200("/match", "cached body");
+  conn.httpGet200("/range", "206 ched");
+
+  // Named caches are separate from the default one.
+  conn.httpGet200("/named/match", "miss");
+
+  conn.httpGet200("/delete", "true");
+  conn.httpGet200("/match", "miss");
+  conn.httpGet200("/delete", "false");
+
+  // Responses with `Cache-Control: no-store` are accepted but not stored.
+  conn.httpGet200("/put-no-store", "put");
+  conn.httpGet200("/match", "miss");
+}
+
 // =======================================================================================
 // Test the test command
 
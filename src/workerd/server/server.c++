@@ -24,6 +24,7 @@
 #include <openssl/bio.h>
 #include <openssl/pem.h>
 #include <workerd/io/actor-cache.h>
+#include <workerd/io/actor-memory-storage.h>
 #include <workerd/io/actor-sqlite.h>
 #include <workerd/io/request-tracker.h>
 #include <workerd/util/http-util.h>
@@ -33,6 +34,8 @@
 #include <workerd/util/use-perfetto-categories.h>
 #include <workerd/api/worker-rpc.h>
 #include "workerd-api.h"
+#include "local-cache.h"
+#include "code-cache.h"
 #include "workerd/io/hibernation-manager.h"
 #include <stdlib.h>
 
@@ -92,6 +95,59 @@ static kj::String httpTime(kj::Date date) {
   return kj::heapString(buf, n);
 }
 
+// Parses an HTTP date in any of the three formats HTTP recipients are required to accept (RFC 9110
+// section 5.6.7): the preferred "Sun, 06 Nov 1994 08:49:37 GMT", the obsolete RFC 850 format
+// "Sunday, 06-Nov-94 08:49:37 GMT", and asctime()'s "Sun Nov  6 08:49:37 1994". Returns none if
+// `text` is in none of them.
+static kj::Maybe<kj::Date> parseHttpTime(kj::StringPtr text) {
+  static constexpr const char* MONTHS[] = {
+    "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+  };
+
+  char monthName[4];
+  int day, year, hour, minute, second;
+  int consumed = 0;
+  auto matches = [&](int assigned) {
+    return assigned == 6 && consumed == static_cast<int>(text.size());
+  };
+
+  if (matches(sscanf(text.cStr(), "%*3[A-Za-z], %2d %3[A-Za-z] %4d %2d:%2d:%2d GMT%n",
+                     &day, monthName, &year, &hour, &minute, &second, &consumed))) {
+    // Preferred format.
+  } else if (matches(sscanf(text.cStr(), "%*[A-Za-z], %2d-%3[A-Za-z]-%2d %2d:%2d:%2d GMT%n",
+                            &day, monthName, &year, &hour, &minute, &second, &consumed))) {
+    // RFC 850 leaves out the century. These dates are from long before anyone used it again.
+    year += year < 70 ? 2000 : 1900;
+  } else if (matches(sscanf(text.cStr(), "%*3[A-Za-z] %3[A-Za-z] %2d %2d:%2d:%2d %4d%n",
+                            monthName, &day, &hour, &minute, &second, &year, &consumed))) {
+    // asctime() format.
+  } else {
+    return kj::none;
+  }
+
+  int month = 0;
+  for (int i = 0; i < 12; i++) {
+    if (strcmp(monthName, MONTHS[i]) == 0) {
+      month = i + 1;
+      break;
+    }
+  }
+  if (month == 0 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60) {
+    return kj::none;
+  }
+
+  // Count days since the epoch, using the days_from_civil() algorithm from
+  // https://howardhinnant.github.io/date_algorithms.html, which (unlike timegm()) is portable.
+  int64_t y = year - (month <= 2);
+  int64_t era = (y >= 0 ? y : y - 399) / 400;
+  int64_t yearOfEra = y - era * 400;
+  int64_t dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+  int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+  int64_t days = era * 146097 + dayOfEra - 719468;
+
+  return kj::UNIX_EPOCH + (((days * 24 + hour) * 60 + minute) * 60 + second) * kj::SECONDS;
+}
+
 static kj::Vector<char> escapeJsonString(kj::StringPtr text) {
   static const char HEXDIGITS[] = "0123456789abcdef";
   kj::Vector<char> escaped(text.size() + 1);
@@ -532,19 +588,25 @@ private:
 // Service used when the service is configured as external HTTP service.
 class Server::ExternalHttpService final: public Service, private kj::TaskSet::ErrorHandler {
 public:
-  ExternalHttpService(kj::Own<kj::NetworkAddress> addrParam,
+  ExternalHttpService(kj::StringPtr name, kj::Own<kj::NetworkAddress> addrParam,
                       kj::Own<HttpRewriter> rewriter, kj::HttpHeaderTable& headerTable,
                       kj::Timer& timer, kj::EntropySource& entropySource,
                       capnp::ByteStreamFactory& byteStreamFactory,
-                      capnp::HttpOverCapnpFactory& httpOverCapnpFactory)
-      : addr(kj::mv(addrParam)),
+                      capnp::HttpOverCapnpFactory& httpOverCapnpFactory,
+                      config::ExternalServer::ConnectionPool::Reader poolConf)
+      : name(kj::str(name)),
+        addr(kj::heap<CountingNetworkAddress>(*this, kj::mv(addrParam))),
+        idleTimeout(poolConf.getIdleTimeoutMs() * kj::MILLISECONDS),
+        maxConnections(poolConf.getMaxConnections()),
         inner(kj::newHttpClient(timer, headerTable, *addr, {
+          .idleTimeout = idleTimeout,
           .entropySource = entropySource,
           .webSocketCompressionMode = kj::HttpClientSettings::MANUAL_COMPRESSION
         })),
         serviceAdapter(kj::newHttpService(*inner)),
         rewriter(kj::mv(rewriter)),
         headerTable(headerTable),
+        timer(timer),
         byteStreamFactory(byteStreamFactory),
         httpOverCapnpFactory(httpOverCapnpFactory),
         waitUntilTasks(*this) {}
@@ -558,14 +620,24 @@ public:
   }
 
 private:
+  kj::String name;
   kj::Own<kj::NetworkAddress> addr;
 
+  // Settings from `ExternalServer.connectionPool`.
+  kj::Duration idleTimeout;
+  uint maxConnections;
+
+  // `inner` keeps connections open for reuse after each request completes, for up to
+  // `idleTimeout`. Since a connection only carries one request at a time, `inner` will never have
+  // more connections open than the largest number of concurrent requests it has seen, so we
+  // enforce `maxConnections` by limiting concurrent requests ourselves.
   kj::Own<kj::HttpClient> inner;
   kj::Own<kj::HttpService> serviceAdapter;
 
   kj::Own<HttpRewriter> rewriter;
 
   kj::HttpHeaderTable& headerTable;
+  kj::Timer& timer;
   capnp::ByteStreamFactory& byteStreamFactory;
   capnp::HttpOverCapnpFactory& httpOverCapnpFactory;
   kj::TaskSet waitUntilTasks;
@@ -574,6 +646,123 @@ private:
     LOG_EXCEPTION("externalServiceWaitUntilTasks", exception);
   }
 
+  struct PoolStats {
+    // Number of HTTP requests and CONNECTs made to the server.
+    uint64_t requests = 0;
+
+    // Number of connections opened to the server. Every other request reused a pooled connection.
+    uint64_t newConnections = 0;
+
+    // Number of requests that had to wait because `maxConnections` were already in use, and the
+    // total time they spent waiting.
+    uint64_t queuedRequests = 0;
+    kj::Duration queueWaitTime = 0 * kj::SECONDS;
+  };
+  PoolStats stats;
+
+  // Number of requests currently holding a connection slot, when `maxConnections` is set.
+  uint activeRequests = 0;
+
+  // Requests waiting for a connection slot, in FIFO order.
+  struct SlotWaiter {
+    kj::Own<kj::PromiseFulfiller<void>> fulfiller;
+    kj::ListLink<SlotWaiter> link;
+
+    // Set when releaseConnectionSlot() handed its slot over to this waiter.
+    bool granted = false;
+  };
+  kj::List<SlotWaiter, &SlotWaiter::link> slotWaiters;
+
+  // Wraps the server address to count how many connections `inner` opens.
+  class CountingNetworkAddress final: public kj::NetworkAddress {
+  public:
+    CountingNetworkAddress(ExternalHttpService& parent, kj::Own<kj::NetworkAddress> inner)
+        : parent(parent), inner(kj::mv(inner)) {}
+
+    kj::Promise<kj::Own<kj::AsyncIoStream>> connect() override {
+      ++parent.stats.newConnections;
+      return inner->connect();
+    }
+
+    kj::Promise<kj::AuthenticatedStream> connectAuthenticated() override {
+      ++parent.stats.newConnections;
+      return inner->connectAuthenticated();
+    }
+
+    kj::Own<kj::ConnectionReceiver> listen() override {
+      return inner->listen();
+    }
+    kj::Own<kj::NetworkAddress> clone() override {
+      return kj::heap<CountingNetworkAddress>(parent, inner->clone());
+    }
+    kj::String toString() override {
+      return inner->toString();
+    }
+
+  private:
+    ExternalHttpService& parent;
+    kj::Own<kj::NetworkAddress> inner;
+  };
+
+  // Waits until fewer than `maxConnections` requests are in flight. The returned object holds the
+  // slot until it is dropped.
+  kj::Promise<kj::Own<void>> acquireConnectionSlot() {
+    if (activeRequests < maxConnections) {
+      ++activeRequests;
+    } else {
+      auto paf = kj::newPromiseAndFulfiller<void>();
+      SlotWaiter waiter { .fulfiller = kj::mv(paf.fulfiller) };
+      slotWaiters.add(waiter);
+      bool acquired = false;
+      KJ_DEFER({
+        if (waiter.link.isLinked()) {
+          slotWaiters.remove(waiter);
+        } else if (waiter.granted && !acquired) {
+          // We were canceled after being handed a slot, but before we could use it.
+          releaseConnectionSlot();
+        }
+      });
+
+      auto start = timer.now();
+      co_await paf.promise;
+      acquired = true;
+
+      ++stats.queuedRequests;
+      stats.queueWaitTime += timer.now() - start;
+    }
+
+    co_return kj::heap(kj::defer([this]() { releaseConnectionSlot(); }));
+  }
+
+  void releaseConnectionSlot() {
+    if (slotWaiters.empty()) {
+      --activeRequests;
+    } else {
+      // Hand our slot directly to the next waiter, so that it can't be taken by a newer request.
+      auto& waiter = slotWaiters.front();
+      slotWaiters.remove(waiter);
+      waiter.granted = true;
+      waiter.fulfiller->fulfill();
+    }
+  }
+
+  // Makes a request or CONNECT by calling `func`, once a connection slot is available.
+  template <typename Func>
+  kj::Promise<void> withConnectionSlot(Func&& func) {
+    ++stats.requests;
+    TRACE_EVENT("workerd", "ExternalHttpService::withConnectionSlot()", "service", name.cStr(),
+                "requests", stats.requests, "newConnections", stats.newConnections,
+                "queuedRequests", stats.queuedRequests,
+                "queueWaitMs", stats.queueWaitTime / kj::MILLISECONDS);
+    if (maxConnections == 0) {
+      return func();
+    }
+    return acquireConnectionSlot().then(
+        [func = kj::fwd<Func>(func)](kj::Own<void> slot) mutable {
+      return func().attach(kj::mv(slot));
+    });
+  }
+
   struct CapnpClient {
     kj::Own<kj::AsyncIoStream> connection;
     capnp::TwoPartyClient rpcSystem;
@@ -605,8 +794,6 @@ private:
 
     // Arrange that when the connection is lost, we'll null out `capnpClient`. This ensures that
     // on the next event, we'll attempt to reconnect.
-    //
-    // TODO(perf): Time out idle connections?
     clearCapnpClientTask = c.rpcSystem.onDisconnect()
         .attach(kj::defer([this]() { capnpClient = kj::none; }))
         .eagerlyEvaluate(nullptr);
@@ -614,6 +801,26 @@ private:
     return c.rpcSystem.bootstrap().castAs<rpc::WorkerdBootstrap>();
   }
 
+  // Number of events currently using `capnpClient`.
+  uint capnpClientActiveEvents = 0;
+
+  // Closes `capnpClient` once it has gone unused for `idleTimeout`.
+  kj::Promise<void> capnpClientIdleTask = nullptr;
+
+  // Marks `capnpClient` as in use until the returned object is dropped.
+  kj::Own<void> useCapnpClient() {
+    ++capnpClientActiveEvents;
+    capnpClientIdleTask = nullptr;
+    return kj::heap(kj::defer([this]() {
+      if (--capnpClientActiveEvents == 0) {
+        capnpClientIdleTask = timer.afterDelay(idleTimeout).then([this]() {
+          // Canceling the disconnect watcher runs its attached cleanup, which drops `capnpClient`.
+          clearCapnpClientTask = nullptr;
+        }).eagerlyEvaluate(nullptr);
+      }
+    }));
+  }
+
   class WorkerInterfaceImpl final: public WorkerInterface, private kj::HttpService::Response {
   public:
     WorkerInterfaceImpl(ExternalHttpService& parent, IoChannelFactory::SubrequestMetadata metadata)
@@ -625,20 +832,26 @@ private:
       TRACE_EVENT("workerd", "ExternalHttpServer::request()");
       KJ_REQUIRE(wrappedResponse == kj::none, "object should only receive one request");
       wrappedResponse = response;
-      if (parent.rewriter->needsRewriteRequest()) {
-        auto rewrite = parent.rewriter->rewriteOutgoingRequest(url, headers, metadata.cfBlobJson);
-        return parent.serviceAdapter->request(method, url, *rewrite.headers, requestBody, *this)
-            .attach(kj::mv(rewrite));
-      } else {
-        return parent.serviceAdapter->request(method, url, headers, requestBody, *this);
-      }
+      return parent.withConnectionSlot([this, method, url, &headers, &requestBody]() {
+        if (parent.rewriter->needsRewriteRequest()) {
+          auto rewrite = parent.rewriter->rewriteOutgoingRequest(
+              url, headers, metadata.cfBlobJson);
+          return parent.serviceAdapter->request(method, url, *rewrite.headers, requestBody, *this)
+              .attach(kj::mv(rewrite));
+        } else {
+          return parent.serviceAdapter->request(method, url, headers, requestBody, *this);
+        }
+      });
     }
 
     kj::Promise<void> connect(
         kj::StringPtr host, const kj::HttpHeaders& headers, kj::AsyncIoStream& connection,
         ConnectResponse& tunnel, kj::HttpConnectSettings settings) override {
       TRACE_EVENT("workerd", "ExternalHttpServer::connect()");
-      return parent.serviceAdapter->connect(host, headers, connection, tunnel, kj::mv(settings));
+      return parent.withConnectionSlot(
+          [this, host, &headers, &connection, &tunnel, settings = kj::mv(settings)]() mutable {
+        return parent.serviceAdapter->connect(host, headers, connection, tunnel, kj::mv(settings));
+      });
     }
 
     void prewarm(kj::StringPtr url) override {}
@@ -656,7 +869,7 @@ private:
           bootstrap.startEventRequest(capnp::MessageSize {4, 0}).send().getDispatcher();
       return event->sendRpc(parent.httpOverCapnpFactory, parent.byteStreamFactory,
                             parent.waitUntilTasks, kj::mv(dispatcher))
-          .attach(kj::mv(event));
+          .attach(kj::mv(event), parent.useCapnpClient());
     }
 
   private:
@@ -722,9 +935,9 @@ kj::Own<Server::Service> Server::makeExternalService(
       auto rewriter = kj::heap<HttpRewriter>(conf.getHttp(), headerTableBuilder);
       auto addr = kj::heap<PromisedNetworkAddress>(network.parseAddress(addrStr, 80));
       return kj::heap<ExternalHttpService>(
-          kj::mv(addr), kj::mv(rewriter), headerTableBuilder.getFutureTable(),
+          name, kj::mv(addr), kj::mv(rewriter), headerTableBuilder.getFutureTable(),
           timer, entropySource, globalContext->byteStreamFactory,
-          globalContext->httpOverCapnpFactory);
+          globalContext->httpOverCapnpFactory, conf.getConnectionPool());
     }
     case config::ExternalServer::HTTPS: {
       auto httpsConf = conf.getHttps();
@@ -736,9 +949,9 @@ kj::Own<Server::Service> Server::makeExternalService(
       auto addr = kj::heap<PromisedNetworkAddress>(
           makeTlsNetworkAddress(httpsConf.getTlsOptions(), addrStr, certificateHost, 443));
       return kj::heap<ExternalHttpService>(
-          kj::mv(addr), kj::mv(rewriter), headerTableBuilder.getFutureTable(),
+          name, kj::mv(addr), kj::mv(rewriter), headerTableBuilder.getFutureTable(),
           timer, entropySource, globalContext->byteStreamFactory,
-          globalContext->httpOverCapnpFactory);
+          globalContext->httpOverCapnpFactory, conf.getConnectionPool());
     }
     case config::ExternalServer::TCP: {
       auto tcpConf = conf.getTcp();
@@ -847,16 +1060,38 @@ class Server::DiskDirectoryService final: public Service, private WorkerInterfac
 public:
   DiskDirectoryService(config::DiskDirectory::Reader conf,
                        kj::Own<const kj::Directory> dir,
-                       kj::HttpHeaderTable::Builder& headerTableBuilder)
+                       kj::HttpHeaderTable::Builder& headerTableBuilder,
+                       kj::EntropySource& entropySource)
       : writable(*dir), readable(kj::mv(dir)), headerTable(headerTableBuilder.getFutureTable()),
+        entropySource(entropySource),
         hLastModified(headerTableBuilder.add("Last-Modified")),
-        allowDotfiles(conf.getAllowDotfiles()) {}
+        hETag(headerTableBuilder.add("ETag")),
+        hIfNoneMatch(headerTableBuilder.add("If-None-Match")),
+        hIfModifiedSince(headerTableBuilder.add("If-Modified-Since")),
+        hIfRange(headerTableBuilder.add("If-Range")),
+        allowDotfiles(conf.getAllowDotfiles()),
+        guessContentType(conf.getGuessContentType()),
+        cacheSize(conf.getCacheSize()) {}
   DiskDirectoryService(config::DiskDirectory::Reader conf,
                        kj::Own<const kj::ReadableDirectory> dir,
-                       kj::HttpHeaderTable::Builder& headerTableBuilder)
+                       kj::HttpHeaderTable::Builder& headerTableBuilder,
+                       kj::EntropySource& entropySource)
       : readable(kj::mv(dir)), headerTable(headerTableBuilder.getFutureTable()),
+        entropySource(entropySource),
         hLastModified(headerTableBuilder.add("Last-Modified")),
-        allowDotfiles(conf.getAllowDotfiles()) {}
+        hETag(headerTableBuilder.add("ETag")),
+        hIfNoneMatch(headerTableBuilder.add("If-None-Match")),
+        hIfModifiedSince(headerTableBuilder.add("If-Modified-Since")),
+        hIfRange(headerTableBuilder.add("If-Range")),
+        allowDotfiles(conf.getAllowDotfiles()),
+        guessContentType(conf.getGuessContentType()),
+        cacheSize(conf.getCacheSize()) {}
+
+  ~DiskDirectoryService() noexcept(false) {
+    while (!fileCacheLru.empty()) {
+      fileCacheLru.remove(fileCacheLru.front());
+    }
+  }
 
   kj::Own<WorkerInterface> startRequest(IoChannelFactory::SubrequestMetadata metadata) override {
     return { this, kj::NullDisposer::instance };
@@ -869,11 +1104,121 @@ public:
   }
 
 private:
+  // A file held memory-mapped in the hot-file cache. Refcounted so that a response which is
+  // still being written keeps its mapping alive even if the entry is evicted meanwhile.
+  struct CachedFile: public kj::Refcounted {
+    kj::String key;
+    kj::FsNode::Metadata meta;
+    kj::Array<const kj::byte> content;
+    kj::ListLink<CachedFile> link;
+
+    CachedFile(kj::String key, kj::FsNode::Metadata meta, kj::Array<const kj::byte> content)
+        : key(kj::mv(key)), meta(meta), content(kj::mv(content)) {}
+  };
+
+  // Where the body of a file response comes from: a cached mapping, or the opened file.
+  using FileBody = kj::OneOf<kj::Own<CachedFile>, kj::Own<const kj::ReadableFile>>;
+
+  // Requests with more ranges than this are answered with the full content instead, so that a
+  // client can't make us emit an arbitrarily large multipart response for a small file.
+  static constexpr size_t MAX_RANGES = 32;
+
   kj::Maybe<const kj::Directory&> writable;
   kj::Own<const kj::ReadableDirectory> readable;
   kj::HttpHeaderTable& headerTable;
+  kj::EntropySource& entropySource;
   kj::HttpHeaderId hLastModified;
+  kj::HttpHeaderId hETag;
+  kj::HttpHeaderId hIfNoneMatch;
+  kj::HttpHeaderId hIfModifiedSince;
+  kj::HttpHeaderId hIfRange;
   bool allowDotfiles;
+  bool guessContentType;
+
+  // Byte budget for the hot-file cache; zero disables it. Entries are keyed by path and ordered
+  // most-recently-used first.
+  uint64_t cacheSize;
+  uint64_t fileCacheBytes = 0;
+  kj::HashMap<kj::String, kj::Own<CachedFile>> fileCache;
+  kj::List<CachedFile, &CachedFile::link> fileCacheLru;
+
+  static bool sameVersion(const kj::FsNode::Metadata& a, const kj::FsNode::Metadata& b) {
+    return a.size == b.size && a.lastModified == b.lastModified && a.hashCode == b.hashCode;
+  }
+
+  // Returns the cached mapping of the file at `key` if it is still current, otherwise maps it and
+  // adds it to the cache, evicting least-recently-used entries to stay within budget. Returns
+  // kj::none if the file should not be cached.
+  kj::Maybe<kj::Own<CachedFile>> getCachedFile(kj::StringPtr key, const kj::FsNode::Metadata& meta,
+      kj::FunctionParam<kj::Own<const kj::ReadableFile>()> openFile) {
+    if (meta.size == 0 || meta.size > cacheSize) return kj::none;
+
+    KJ_IF_SOME(entry, fileCache.find(key)) {
+      if (sameVersion(entry->meta, meta)) {
+        fileCacheLru.remove(*entry);
+        fileCacheLru.addFront(*entry);
+        return kj::addRef(*entry);
+      }
+    }
+    dropCachedFile(key);
+
+    auto entry = kj::refcounted<CachedFile>(kj::str(key), meta, openFile()->mmap(0, meta.size));
+    fileCacheBytes += meta.size;
+    while (fileCacheBytes > cacheSize && !fileCacheLru.empty()) {
+      dropCachedFile(fileCacheLru.back().key);
+    }
+    fileCacheLru.addFront(*entry);
+    auto result = kj::addRef(*entry);
+    fileCache.insert(kj::str(key), kj::mv(entry));
+    return kj::mv(result);
+  }
+
+  void dropCachedFile(kj::StringPtr key) {
+    KJ_IF_SOME(entry, fileCache.findEntry(key)) {
+      fileCacheBytes -= entry.value->meta.size;
+      fileCacheLru.remove(*entry.value);
+      fileCache.erase(entry);
+    }
+  }
+
+  // Weak comparison of an If-None-Match header (a comma-separated list of entity tags, or "*")
+  // against our entity tag.
+  static bool etagMatches(kj::StringPtr header, kj::StringPtr etag) {
+    auto candidates = header.asArray();
+    while (candidates.size() > 0) {
+      size_t end = 0;
+      while (end < candidates.size() && candidates[end] != ',') ++end;
+      auto tag = candidates.slice(0, end);
+      candidates = candidates.slice(kj::min(end + 1, candidates.size()), candidates.size());
+
+      while (tag.size() > 0 && (tag.front() == ' ' || tag.front() == '\t')) {
+        tag = tag.slice(1, tag.size());
+      }
+      while (tag.size() > 0 && (tag.back() == ' ' || tag.back() == '\t')) {
+        tag = tag.slice(0, tag.size() - 1);
+      }
+
+      if (tag == "*"_kj.asArray()) return true;
+      if (tag.size() >= 2 && tag[0] == 'W' && tag[1] == '/') tag = tag.slice(2, tag.size());
+      if (tag == etag.asArray()) return true;
+    }
+    return false;
+  }
+
+  static kj::Promise<void> writeBody(kj::AsyncOutputStream& out, FileBody& body,
+                                     uint64_t offset, uint64_t size) {
+    KJ_SWITCH_ONEOF(body) {
+      KJ_CASE_ONEOF(cached, kj::Own<CachedFile>) {
+        return out.write(cached->content.begin() + offset, size);
+      }
+      KJ_CASE_ONEOF(file, kj::Own<const kj::ReadableFile>) {
+        auto in = kj::heap<kj::FileInputStream>(*file, offset);
+        auto promise = in->pumpTo(out, size).ignoreResult();
+        return promise.attach(kj::mv(in));
+      }
+    }
+    KJ_UNREACHABLE;
+  }
 
   kj::Promise<void> request(
       kj::HttpMethod method, kj::StringPtr urlStr, const kj::HttpHeaders& requestHeaders,
@@ -905,38 +1250,85 @@ private:
         co_return co_await response.sendError(404, "Not Found", headerTable);
       }
 
-      auto file = KJ_UNWRAP_OR(readable->tryOpenFile(path), {
+      auto cacheKey = path.toString();
+
+      // lstat() rather than open: for regular files this is all we need to answer HEAD and
+      // conditional requests, and to validate a cached copy. Symlinks still have to be opened to
+      // find out what they point to.
+      kj::Maybe<kj::Own<const kj::ReadableFile>> openedFile;
+      auto meta = path.size() == 0 ? readable->stat() : KJ_UNWRAP_OR(readable->tryLstat(path), {
+        dropCachedFile(cacheKey);
         co_return co_await response.sendError(404, "Not Found", headerTable);
       });
-
-      auto meta = file->stat();
+      if (meta.type == kj::FsNode::Type::SYMLINK) {
+        auto file = KJ_UNWRAP_OR(readable->tryOpenFile(path), {
+          co_return co_await response.sendError(404, "Not Found", headerTable);
+        });
+        meta = file->stat();
+        openedFile = kj::mv(file);
+      }
 
       switch (meta.type) {
         case kj::FsNode::Type::FILE: {
-          // If this is a GET request with a Range header, return partial content if a single
-          // satisfiable range is specified.
-          // TODO(someday): consider supporting multiple ranges with multipart/byteranges
-          kj::Maybe<kj::HttpByteRange> range;
+          auto lastModified = httpTime(meta.lastModified);
+          auto etag = kj::str('"',
+              kj::hex(static_cast<uint64_t>((meta.lastModified - kj::UNIX_EPOCH) / kj::NANOSECONDS)),
+              '-', kj::hex(meta.size), '"');
+
+          // If-None-Match takes precedence over If-Modified-Since. The latter is satisfied by any
+          // date no earlier than the modification time, at the one second resolution of
+          // Last-Modified. Dates we can't parse are ignored, as RFC 9110 requires.
+          bool notModified = false;
+          KJ_IF_SOME(header, requestHeaders.get(hIfNoneMatch)) {
+            notModified = etagMatches(header, etag);
+          } else KJ_IF_SOME(header, requestHeaders.get(hIfModifiedSince)) {
+            KJ_IF_SOME(since, parseHttpTime(header)) {
+              auto modified = kj::UNIX_EPOCH +
+                  (meta.lastModified - kj::UNIX_EPOCH) / kj::SECONDS * kj::SECONDS;
+              notModified = modified <= since;
+            }
+          }
+
+          kj::HttpHeaders headers(headerTable);
+          headers.set(hLastModified, lastModified);
+          headers.set(hETag, etag);
+
+          if (notModified) {
+            response.send(304, "Not Modified", headers);
+            co_return;
+          }
+
+          // If this is a GET request with a Range header, return partial content if the ranges
+          // are satisfiable. An If-Range that doesn't match the current version means the client
+          // wants the whole (new) file instead.
+          kj::Array<kj::HttpByteRange> ranges;
           if (method == kj::HttpMethod::GET) {
             KJ_IF_SOME(header, requestHeaders.get(kj::HttpHeaderId::RANGE)) {
-              KJ_SWITCH_ONEOF(kj::tryParseHttpRangeHeader(header.asArray(), meta.size)) {
-                KJ_CASE_ONEOF(ranges, kj::Array<kj::HttpByteRange>) {
-                  KJ_ASSERT(ranges.size() > 0);
-                  if (ranges.size() == 1) range = ranges[0];
-                }
-                KJ_CASE_ONEOF(_, kj::HttpEverythingRange) {}
-                KJ_CASE_ONEOF(_, kj::HttpUnsatisfiableRange) {
-                  kj::HttpHeaders headers(headerTable);
-                  headers.set(kj::HttpHeaderId::CONTENT_RANGE, kj::str("bytes */", meta.size));
-                  co_return co_await response.sendError(416, "Range Not Satisfiable", headers);
+              bool ifRangeMatches = true;
+              KJ_IF_SOME(ifRange, requestHeaders.get(hIfRange)) {
+                ifRangeMatches = ifRange == etag || ifRange == lastModified;
+              }
+              if (ifRangeMatches) {
+                KJ_SWITCH_ONEOF(kj::tryParseHttpRangeHeader(header.asArray(), meta.size)) {
+                  KJ_CASE_ONEOF(parsed, kj::Array<kj::HttpByteRange>) {
+                    KJ_ASSERT(parsed.size() > 0);
+                    if (parsed.size() <= MAX_RANGES) ranges = kj::mv(parsed);
+                  }
+                  KJ_CASE_ONEOF(_, kj::HttpEverythingRange) {}
+                  KJ_CASE_ONEOF(_, kj::HttpUnsatisfiableRange) {
+                    kj::HttpHeaders headers(headerTable);
+                    headers.set(kj::HttpHeaderId::CONTENT_RANGE, kj::str("bytes */", meta.size));
+                    co_return co_await response.sendError(416, "Range Not Satisfiable", headers);
+                  }
                 }
               }
             }
           }
 
-          kj::HttpHeaders headers(headerTable);
-          headers.set(kj::HttpHeaderId::CONTENT_TYPE, MimeType::OCTET_STREAM.toString());
-          headers.set(hLastModified, httpTime(meta.lastModified));
+          kj::StringPtr contentType = MimeType::OCTET_STREAM_STRING;
+          if (guessContentType && path.size() > 0) {
+            contentType = MimeType::forFileName(path[path.size() - 1]).orDefault(contentType);
+          }
 
           // We explicitly set the Content-Length header because if we don't, and we were called
           // by a local Worker (without an actual HTTP connection in between), then the Worker
@@ -948,30 +1340,81 @@ private:
           //   to change without a compat flag.
 
           if (method == kj::HttpMethod::HEAD) {
+            headers.set(kj::HttpHeaderId::CONTENT_TYPE, contentType);
             headers.set(kj::HttpHeaderId::CONTENT_LENGTH, kj::str(meta.size));
             response.send(200, "OK", headers, meta.size);
             co_return;
-          } else KJ_IF_SOME(r, range) {
+          }
+
+          auto openFile = [&]() -> kj::Own<const kj::ReadableFile> {
+            KJ_IF_SOME(file, openedFile) {
+              return kj::mv(file);
+            }
+            // The file may have been removed since we lstat()ed it, in which case this throws
+            // and the client sees a 500. That's fine for such an unlikely race.
+            return readable->openFile(path);
+          };
+
+          auto body = [&]() -> FileBody {
+            if (cacheSize > 0) {
+              KJ_IF_SOME(cached, getCachedFile(cacheKey, meta, openFile)) {
+                return kj::mv(cached);
+              }
+            }
+            return openFile();
+          }();
+
+          // TODO(perf): Bodies that aren't cached are still copied through userspace. KJ's HTTP
+          //   server doesn't expose its socket, so there's no way to sendfile()/splice() here.
+          if (ranges.size() == 1) {
+            auto& r = ranges[0];
             KJ_ASSERT(r.start <= r.end);
             auto rangeSize = r.end - r.start + 1;
+            headers.set(kj::HttpHeaderId::CONTENT_TYPE, contentType);
             headers.set(kj::HttpHeaderId::CONTENT_LENGTH, kj::str(rangeSize));
             headers.set(kj::HttpHeaderId::CONTENT_RANGE,
               kj::str("bytes ", r.start, "-", r.end, "/", meta.size));
             auto out = response.send(206, "Partial Content", headers, rangeSize);
+            co_return co_await writeBody(*out, body, r.start, rangeSize);
+          } else if (ranges.size() > 1) {
+            // Multiple ranges are returned as multipart/byteranges (RFC 9110 section 14.6). We
+            // compute every part header up front so that we can send an exact Content-Length.
+            kj::byte boundaryBytes[12];
+            entropySource.generate(boundaryBytes);
+            auto boundary = kj::encodeHex(boundaryBytes);
+
+            auto partHeaders = KJ_MAP(r, ranges) {
+              KJ_ASSERT(r.start <= r.end);
+              return kj::str("\r\n--", boundary, "\r\n"
+                             "Content-Type: ", contentType, "\r\n"
+                             "Content-Range: bytes ", r.start, "-", r.end, "/", meta.size, "\r\n"
+                             "\r\n");
+            };
+            auto trailer = kj::str("\r\n--", boundary, "--\r\n");
+
+            uint64_t totalSize = trailer.size();
+            for (auto i: kj::indices(ranges)) {
+              totalSize += partHeaders[i].size() + (ranges[i].end - ranges[i].start + 1);
+            }
 
-            auto in = kj::heap<kj::FileInputStream>(*file, r.start);
-            co_return co_await in->pumpTo(*out, rangeSize).ignoreResult();
+            headers.set(kj::HttpHeaderId::CONTENT_TYPE,
+                kj::str("multipart/byteranges; boundary=", boundary));
+            headers.set(kj::HttpHeaderId::CONTENT_LENGTH, kj::str(totalSize));
+            auto out = response.send(206, "Partial Content", headers, totalSize);
+            for (auto i: kj::indices(ranges)) {
+              co_await out->write(partHeaders[i].begin(), partHeaders[i].size());
+              co_await writeBody(*out, body, ranges[i].start,
+                                 ranges[i].end - ranges[i].start + 1);
+            }
+            co_return co_await out->write(trailer.begin(), trailer.size());
           } else {
+            headers.set(kj::HttpHeaderId::CONTENT_TYPE, contentType);
             headers.set(kj::HttpHeaderId::CONTENT_LENGTH, kj::str(meta.size));
             auto out = response.send(200, "OK", headers, meta.size);
-
-            auto in = kj::heap<kj::FileInputStream>(*file);
-            co_return co_await in->pumpTo(*out, meta.size).ignoreResult();
+            co_return co_await writeBody(*out, body, 0, meta.size);
           }
         }
         case kj::FsNode::Type::DIRECTORY: {
-          // Whoooops, we opened a directory. Back up and start over.
-
           auto dir = readable->openSubdir(path);
 
           kj::HttpHeaders headers(headerTable);
@@ -1033,6 +1476,7 @@ private:
       co_await requestBody.pumpTo(*stream);
 
       replacer->commit();
+      dropCachedFile(path.toString());
       kj::HttpHeaders headers(headerTable);
       response.send(204, "No Content", headers);
       co_return;
@@ -1046,6 +1490,7 @@ private:
       }
 
       auto found = w.tryRemove(path);
+      dropCachedFile(path.toString());
 
       kj::HttpHeaders headers(headerTable);
       if (found) {
@@ -1108,7 +1553,8 @@ kj::Own<Server::Service> Server::makeDiskDirectoryService(
       return makeInvalidConfigService();
     });
 
-    return kj::heap<DiskDirectoryService>(conf, kj::mv(openDir), headerTableBuilder);
+    return kj::heap<DiskDirectoryService>(conf, kj::mv(openDir), headerTableBuilder,
+                                          entropySource);
   } else {
     auto openDir = KJ_UNWRAP_OR(fs.getRoot().tryOpenSubdir(kj::mv(path)), {
       reportConfigError(kj::str(
@@ -1116,8 +1562,106 @@ kj::Own<Server::Service> Server::makeDiskDirectoryService(
       return makeInvalidConfigService();
     });
 
-    return kj::heap<DiskDirectoryService>(conf, kj::mv(openDir), headerTableBuilder);
+    return kj::heap<DiskDirectoryService>(conf, kj::mv(openDir), headerTableBuilder,
+                                          entropySource);
+  }
+}
+
+// Service used when the service is configured as an in-process cache.
+class Server::CacheService final: public Service, private WorkerInterface {
+public:
+  // Looks up the directory to use as the disk tier, if one was configured.
+  using LinkCallback = kj::Function<kj::Maybe<const kj::Directory&>()>;
+
+  CacheService(LocalCache::Options options, kj::HttpHeaderTable::Builder& headerTableBuilder,
+               kj::Maybe<LinkCallback> linkCallback)
+      : cache(kj::systemPreciseCalendarClock(), headerTableBuilder, options),
+        linkCallback(kj::mv(linkCallback)) {}
+
+  void link() override {
+    KJ_IF_SOME(callback, linkCallback) {
+      KJ_IF_SOME(dir, callback()) {
+        cache.setDiskDirectory(dir);
+      }
+      linkCallback = kj::none;
+    }
+  }
+
+  kj::Own<WorkerInterface> startRequest(IoChannelFactory::SubrequestMetadata metadata) override {
+    return { this, kj::NullDisposer::instance };
+  }
+
+  bool hasHandler(kj::StringPtr handlerName) override {
+    return handlerName == "fetch"_kj;
+  }
+
+private:
+  LocalCache cache;
+  kj::Maybe<LinkCallback> linkCallback;
+
+  kj::Promise<void> request(
+      kj::HttpMethod method, kj::StringPtr url, const kj::HttpHeaders& headers,
+      kj::AsyncInputStream& requestBody, kj::HttpService::Response& response) override {
+    TRACE_EVENT("workerd", "CacheService::request()", "url", url.cStr());
+    return cache.request(method, url, headers, requestBody, response);
+  }
+
+  kj::Promise<void> connect(kj::StringPtr host, const kj::HttpHeaders& headers,
+      kj::AsyncIoStream& connection, kj::HttpService::ConnectResponse& response,
+      kj::HttpConnectSettings settings) override {
+    throwUnsupported();
+  }
+  void prewarm(kj::StringPtr url) override {}
+  kj::Promise<ScheduledResult> runScheduled(kj::Date scheduledTime, kj::StringPtr cron) override {
+    throwUnsupported();
+  }
+  kj::Promise<AlarmResult> runAlarm(kj::Date scheduledTime, uint32_t retryCount) override {
+    throwUnsupported();
+  }
+  kj::Promise<CustomEvent::Result> customEvent(kj::Own<CustomEvent> event) override {
+    throwUnsupported();
+  }
+
+  [[noreturn]] void throwUnsupported() {
+    JSG_FAIL_REQUIRE(Error, "Cache services don't support this event type.");
+  }
+};
+
+kj::Own<Server::Service> Server::makeCacheService(
+    kj::StringPtr name, config::CacheService::Reader conf,
+    kj::HttpHeaderTable::Builder& headerTableBuilder) {
+  TRACE_EVENT("workerd", "Server::makeCacheService()");
+  LocalCache::Options options {
+    .memoryLimit = conf.getMemoryLimit(),
+    .diskLimit = conf.getDiskLimit(),
+  };
+
+  kj::Maybe<CacheService::LinkCallback> linkCallback;
+  if (conf.hasDisk()) {
+    linkCallback = CacheService::LinkCallback(
+        [this, name = kj::str(name), diskName = kj::str(conf.getDisk())]()
+        -> kj::Maybe<const kj::Directory&> {
+      auto& svc = KJ_UNWRAP_OR(services.find(diskName), {
+        reportConfigError(kj::str("Cache service \"", name, "\" refers to the service \"",
+            diskName, "\", but no such service is defined."));
+        return kj::none;
+      });
+      auto diskSvc = dynamic_cast<DiskDirectoryService*>(svc.get());
+      if (diskSvc == nullptr) {
+        reportConfigError(kj::str("Cache service \"", name, "\" refers to the service \"",
+            diskName, "\", but that service is not a local disk service."));
+        return kj::none;
+      }
+      KJ_IF_SOME(dir, diskSvc->getWritable()) {
+        return dir;
+      }
+      reportConfigError(kj::str("Cache service \"", name, "\" refers to the disk service \"",
+          diskName, "\", but that service is not writable."));
+      return kj::none;
+    });
   }
+
+  return kj::heap<CacheService>(options, headerTableBuilder, kj::mv(linkCallback));
 }
 
 // =======================================================================================
@@ -1378,6 +1922,7 @@ public:
     kj::Array<kj::Maybe<ActorNamespace&>> actor;  // null = configuration error
     kj::Maybe<Service&> cache;
     kj::Maybe<kj::Own<SqliteDatabase::Vfs>> actorStorage;
+    kj::Maybe<ActorMemoryStorage::Store&> actorMemoryStorage;
     AlarmScheduler& alarmScheduler;
   };
   using LinkCallback = kj::Function<LinkedIoChannels(WorkerService&)>;
@@ -1769,9 +2314,10 @@ public:
       kj::String id;
     };
 
-    class ActorSqliteHooks final : public ActorSqlite::Hooks {
+    // Implements alarms for both SQLite-backed and in-memory storage, using the AlarmScheduler.
+    class AlarmSchedulerHooks final : public ActorSqlite::Hooks, public ActorMemoryStorage::Hooks {
     public:
-      ActorSqliteHooks(AlarmScheduler& alarmScheduler, ActorKey actor)
+      AlarmSchedulerHooks(AlarmScheduler& alarmScheduler, ActorKey actor)
           : alarmScheduler(alarmScheduler), actor(actor) {}
 
       kj::Promise<kj::Maybe<kj::Date>> getAlarm() override {
@@ -1780,11 +2326,10 @@ public:
 
       kj::Promise<void> setAlarm(kj::Maybe<kj::Date> newAlarmTime) override {
         KJ_IF_SOME(scheduledTime, newAlarmTime) {
-          alarmScheduler.setAlarm(actor, scheduledTime);
+          return alarmScheduler.setAlarm(actor, scheduledTime);
         } else {
-          alarmScheduler.deleteAlarm(actor);
+          return alarmScheduler.deleteAlarm(actor);
         }
-        return kj::READY_NOW;
       }
 
       // No-op -- armAlarmHandler() is normally used to schedule a delete after the alarm runs.
@@ -1843,11 +2388,11 @@ public:
                 .map([&](const Durable& d) -> kj::Own<ActorCacheInterface> {
               KJ_IF_SOME(as, channels.actorStorage) {
                 // The idPtr can end up being freed if the Actor gets hibernated so we need
-                // to create a copy that is ensured to live as long as the ActorSqliteHooks
+                // to create a copy that is ensured to live as long as the AlarmSchedulerHooks
                 // instance we're creating here.
                 // TODO(cleanup): Is there a better way to handle the ActorKey in general here?
                 auto idStr = kj::str(idPtr);
-                auto sqliteHooks = kj::heap<ActorSqliteHooks>(channels.alarmScheduler, ActorKey{
+                auto sqliteHooks = kj::heap<AlarmSchedulerHooks>(channels.alarmScheduler, ActorKey{
                   .uniqueKey = d.uniqueKey, .actorId = idStr
                 }).attach(kj::mv(idStr));
 
@@ -1857,9 +2402,19 @@ public:
                 return kj::heap<ActorSqlite>(kj::mv(db), outputGate,
                     []() -> kj::Promise<void> { return kj::READY_NOW; },
                     *sqliteHooks).attach(kj::mv(sqliteHooks));
+              } else KJ_IF_SOME(store, channels.actorMemoryStorage) {
+                // As above, the hooks need their own copy of the ID.
+                auto idStr = kj::str(idPtr);
+                auto hooks = kj::heap<AlarmSchedulerHooks>(channels.alarmScheduler, ActorKey{
+                  .uniqueKey = d.uniqueKey, .actorId = idStr
+                }).attach(kj::mv(idStr));
+
+                return kj::heap<ActorMemoryStorage>(store, d.uniqueKey, idPtr, *hooks)
+                    .attach(kj::mv(hooks));
               } else {
-                // Create an ActorCache backed by a fake, empty storage. Elsewhere, we configure
-                // ActorCache never to flush, so this effectively creates in-memory storage.
+                // Storage is misconfigured (an error was reported earlier). Create an ActorCache
+                // backed by a fake, empty storage. Elsewhere, we configure ActorCache never to
+                // flush, so this effectively creates in-memory storage.
                 return kj::heap<ActorCache>(
                     kj::heap<EmptyReadOnlyActorStorageImpl>(), sharedLru, outputGate, hooks);
               }
@@ -2610,9 +3165,13 @@ kj::Own<Server::Service> Server::makeWorker(kj::StringPtr name, config::Worker::
         .dirtyListByteLimit = 8 * (1ull << 20), // 8 MiB
         .maxKeysPerRpc = 128,
 
-        // For now, we use `neverFlush` to implement in-memory-only actors.
-        // See WorkerService::getActor().
-        .neverFlush = true
+        // In-memory actors normally use ActorMemoryStorage, but `neverFlush` is still needed for
+        // the fallback in WorkerService::getActor().
+        .neverFlush = true,
+
+        // Each isolate has its own LRU, only ever touched under the isolate lock, so sharding it
+        // wouldn't reduce contention. It would only split the soft limit into smaller budgets.
+        .shardCount = 1,
       };
     }
     kj::Own<void> enterStartupJs(
@@ -2640,13 +3199,17 @@ kj::Own<Server::Service> Server::makeWorker(kj::StringPtr name, config::Worker::
     }
   };
 
-  auto observer = kj::atomicRefcounted<IsolateObserver>();
+  auto observer = kj::atomicRefcounted<CodeCacheCountingObserver>(
+      kj::atomicAddRef(*codeCacheCounters));
   auto limitEnforcer = kj::heap<NullIsolateLimitEnforcer>();
   auto api = kj::heap<WorkerdApi>(globalContext->v8System,
                                   featureFlags.asReader(),
                                   *limitEnforcer,
                                   kj::atomicAddRef(*observer),
-                                  *memoryCacheProvider);
+                                  *memoryCacheProvider,
+                                  codeCache.map([](auto& cache) -> const jsg::CodeCache& {
+                                    return *cache;
+                                  }));
   auto inspectorPolicy = Worker::Isolate::InspectorPolicy::DISALLOW;
   if (inspectorOverride != kj::none) {
     // For workerd, if the inspector is enabled, it is always fully trusted.
@@ -2931,7 +3494,19 @@ kj::Own<Server::Service> Server::makeWorker(kj::StringPtr name, config::Worker::
           reportConfigError(kj::str("service ", name, ": durableObjectStorage config refers "
               "to the service \"", diskName, "\", but that service is not a local disk service."));
         } else KJ_IF_SOME(dir, diskSvc->getWritable()) {
-          result.actorStorage = kj::heap<SqliteDatabase::Vfs>(dir);
+          auto localDiskConf = conf.getDurableObjectLocalDiskStorage();
+          SqliteDatabase::Vfs::Options options {
+            .cacheSize = localDiskConf.getCacheSize(),
+            .mmapSize = localDiskConf.getMmapSize(),
+          };
+          kj::Maybe<kj::Own<SqliteDatabase::PageCacheBudget>> budget;
+          if (localDiskConf.getPageCacheBudget() > 0) {
+            auto& b = budget.emplace(
+                kj::heap<SqliteDatabase::PageCacheBudget>(localDiskConf.getPageCacheBudget()));
+            options.pageCacheBudget = *b;
+          }
+          result.actorStorage = kj::heap<SqliteDatabase::Vfs>(dir, kj::mv(options))
+              .attach(kj::mv(budget));
         } else {
           reportConfigError(kj::str("service ", name, ": durableObjectStorage config refers "
               "to the disk service \"", diskName, "\", but that service is defined read-only."));
@@ -2940,6 +3515,35 @@ kj::Own<Server::Service> Server::makeWorker(kj::StringPtr name, config::Worker::
         reportConfigError(kj::str("service ", name, ": durableObjectStorage config refers "
             "to a service \"", diskName, "\", but no such service is defined."));
       }
+    } else if (actorStorageConf.isInMemory()) {
+      auto inMemoryConf = conf.getDurableObjectInMemoryStorage();
+      kj::Maybe<const kj::Directory&> snapshotDir;
+      if (inMemoryConf.hasSnapshotDisk()) {
+        kj::StringPtr diskName = inMemoryConf.getSnapshotDisk();
+        KJ_IF_SOME(svc, this->services.find(diskName)) {
+          auto diskSvc = dynamic_cast<DiskDirectoryService*>(svc.get());
+          if (diskSvc == nullptr) {
+            reportConfigError(kj::str("service ", name, ": durableObjectInMemoryStorage config "
+                "refers to the service \"", diskName, "\", but that service is not a local disk "
+                "service."));
+          } else KJ_IF_SOME(dir, diskSvc->getWritable()) {
+            snapshotDir = dir;
+          } else {
+            reportConfigError(kj::str("service ", name, ": durableObjectInMemoryStorage config "
+                "refers to the disk service \"", diskName, "\", but that service is defined "
+                "read-only."));
+          }
+        } else {
+          reportConfigError(kj::str("service ", name, ": durableObjectInMemoryStorage config "
+              "refers to a service \"", diskName, "\", but no such service is defined."));
+        }
+      }
+
+      auto store = kj::heap<ActorMemoryStorage::Store>(ActorMemoryStorage::Store::Options {
+        .memoryLimit = inMemoryConf.getMemoryLimit(),
+      }, snapshotDir);
+      result.actorMemoryStorage = *store;
+      actorMemoryStores.add(kj::mv(store));
     }
 
     kj::HashMap<kj::StringPtr, WorkerService::ActorNamespace&> durableNamespacesByUniqueKey;
@@ -2988,6 +3592,9 @@ kj::Own<Server::Service> Server::makeService(
 
     case config::Service::DISK:
       return makeDiskDirectoryService(name, conf.getDisk(), headerTableBuilder);
+
+    case config::Service::CACHE:
+      return makeCacheService(name, conf.getCache(), headerTableBuilder);
   }
 
   reportConfigError(kj::str(
@@ -3333,6 +3940,11 @@ kj::Promise<void> Server::handleDrain(kj::Promise<void> drainWhen) {
     drainPromises.add(httpServer.httpServer.drain());
   }
   co_await kj::joinPromisesFailFast(drainPromises.finish());
+
+  // Save in-memory Durable Object storage configured with a snapshot disk.
+  for (auto& store: actorMemoryStores) {
+    store->writeSnapshot();
+  }
 }
 
 kj::Promise<void> Server::run(jsg::V8System& v8System, config::Config::Reader config,
@@ -3504,6 +4116,22 @@ void Server::startServices(jsg::V8System& v8System, config::Config::Reader confi
     inspectorIsolateRegistrar = kj::mv(registrar);
   }
 
+  // A code cache may have been provided by preloadWorkers() instead.
+  if (codeCache == kj::none && config.hasCodeCacheDirectory()) {
+    auto pathStr = config.getCodeCacheDirectory();
+    auto path = fs.getCurrentPath().evalNative(pathStr);
+    KJ_IF_SOME(dir, fs.getRoot().tryOpenSubdir(kj::mv(path),
+        kj::WriteMode::CREATE | kj::WriteMode::MODIFY | kj::WriteMode::CREATE_PARENT)) {
+      codeCache = kj::Own<jsg::CodeCache>(kj::heap<DiskCodeCache>(kj::mv(dir)));
+    } else {
+      reportConfigError(kj::str("Code cache directory could not be opened: ", pathStr));
+    }
+  }
+  if (config.hasEmbeddedCodeCache()) {
+    codeCache = kj::Own<jsg::CodeCache>(
+        kj::heap<EmbeddedCodeCache>(config.getEmbeddedCodeCache(), kj::mv(codeCache)));
+  }
+
   // Second pass: Build services.
   for (auto serviceConf: config.getServices()) {
     kj::StringPtr name = serviceConf.getName();
@@ -3687,6 +4315,28 @@ kj::Promise<void> Server::listenOnSockets(config::Config::Reader config,
   co_await kj::evalLast([]() {});
 }
 
+// =======================================================================================
+// Server::preloadWorkers()
+
+void Server::preloadWorkers(jsg::V8System& v8System, config::Config::Reader config,
+                            kj::Own<jsg::CodeCache> codeCacheParam) {
+  TRACE_EVENT("workerd", "Server.preloadWorkers");
+  kj::HttpHeaderTable::Builder headerTableBuilder;
+  globalContext = kj::heap<GlobalContext>(*this, v8System, headerTableBuilder);
+  invalidConfigServiceSingleton = kj::heap<InvalidConfigService>();
+
+  auto [ fatalPromise, fatalFulfiller ] = kj::newPromiseAndFulfiller<void>();
+  this->fatalFulfiller = kj::mv(fatalFulfiller);
+
+  auto forkedDrainWhen = kj::Promise<void>(kj::NEVER_DONE).fork();
+
+  // Workers are constructed, running their top-level code, as the services are built.
+  codeCache = kj::mv(codeCacheParam);
+  startServices(v8System, config, headerTableBuilder, forkedDrainWhen);
+
+  preloadHeaderTable = headerTableBuilder.build();
+}
+
 // =======================================================================================
 // Server::test()
 
@@ -9,10 +9,12 @@
 #include <kj/one-of.h>
 #include <kj/async-io.h>
 #include <workerd/io/worker.h>
+#include <workerd/io/actor-memory-storage.h>
 #include <workerd/api/memory-cache.h>
 #include <workerd/server/workerd.capnp.h>
 #include <workerd/util/sqlite.h>
 #include <workerd/server/alarm-scheduler.h>
+#include <workerd/server/code-cache.h>
 #include <kj/compat/http.h>
 
 namespace kj {
@@ -63,6 +65,13 @@ public:
   kj::Promise<void> run(jsg::V8System& v8System, config::Config::Reader conf,
                         kj::Promise<void> drainWhen = kj::NEVER_DONE);
 
+  // Constructs every service in the config -- so every Worker runs its top-level code -- without
+  // listening on any sockets. The V8 code cache data produced for the Workers' modules is stored in
+  // `codeCache`, in place of any cache configured by `codeCacheDirectory`. Used by
+  // `workerd compile --code-cache`.
+  void preloadWorkers(jsg::V8System& v8System, config::Config::Reader conf,
+                      kj::Own<jsg::CodeCache> codeCache);
+
   // Executes one or more tests. By default, all exported test handlers from all entrypoints to
   // all services in the config are executed. Glob patterns can be specified to match specific
   // service and entrypoint names.
@@ -72,6 +81,10 @@ public:
                          kj::StringPtr servicePattern = "*"_kj,
                          kj::StringPtr entrypointPattern = "*"_kj);
 
+  // Returns how often the Workers' modules were compiled using the code cache, and how much was
+  // stored in it, since the server was constructed.
+  CodeCacheStats getCodeCacheStats() const { return codeCacheCounters->get(); }
+
   struct Durable {
     kj::String uniqueKey;
     bool isEvictable;
@@ -97,6 +110,11 @@ private:
 
   kj::Own<api::MemoryCacheProvider> memoryCacheProvider;
 
+  // Set if `codeCacheDirectory` or `embeddedCodeCache` is configured, or by preloadWorkers().
+  // Initialized in startServices().
+  kj::Maybe<kj::Own<jsg::CodeCache>> codeCache;
+  kj::Own<CodeCacheCounters> codeCacheCounters = kj::atomicRefcounted<CodeCacheCounters>();
+
   kj::HashMap<kj::String, kj::OneOf<kj::String, kj::Own<kj::ConnectionReceiver>>> socketOverrides;
   kj::HashMap<kj::String, kj::String> directoryOverrides;
 
@@ -110,6 +128,10 @@ private:
   kj::Maybe<kj::Own<InspectorServiceIsolateRegistrar>> inspectorIsolateRegistrar;
   kj::Maybe<kj::Own<kj::FdOutputStream>> controlOverride;
 
+  // The header table built by preloadWorkers(), which the services it constructs refer to. (run()
+  // and test() keep theirs alive for as long as they are running instead.)
+  kj::Own<kj::HttpHeaderTable> preloadHeaderTable;
+
   struct GlobalContext;
   // General context needed to construct workers. Initilaized early in run().
   kj::Own<GlobalContext> globalContext;
@@ -122,6 +144,10 @@ private:
   // correctly construct dependent services.
   kj::HashMap<kj::String, kj::HashMap<kj::String, ActorConfig>> actorConfigs;
 
+  // Storage for the Durable Objects of each worker using `durableObjectStorage.inMemory`. Declared
+  // before `services` so that it outlives the objects using it. Snapshotted upon drain.
+  kj::Vector<kj::Own<ActorMemoryStorage::Store>> actorMemoryStores;
+
   kj::HashMap<kj::String, kj::Own<Service>> services;
 
   kj::Own<kj::PromiseFulfiller<void>> fatalFulfiller;
@@ -174,6 +200,9 @@ private:
   kj::Own<Service> makeDiskDirectoryService(
       kj::StringPtr name, config::DiskDirectory::Reader conf,
       kj::HttpHeaderTable::Builder& headerTableBuilder);
+  kj::Own<Service> makeCacheService(
+      kj::StringPtr name, config::CacheService::Reader conf,
+      kj::HttpHeaderTable::Builder& headerTableBuilder);
   kj::Own<Service> makeWorker(kj::StringPtr name, config::Worker::Reader conf,
       capnp::List<config::Extension>::Reader extensions);
   kj::Own<Service> makeService(
@@ -195,6 +224,7 @@ private:
   class ExternalTcpService;
   class NetworkService;
   class DiskDirectoryService;
+  class CacheService;
   class WorkerService;
   class WorkerEntrypointService;
   class HttpListener;
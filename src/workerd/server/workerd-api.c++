@@ -109,6 +109,7 @@ struct WorkerdApi::Impl {
   kj::Own<CompatibilityFlags::Reader> features;
   JsgWorkerdIsolate jsgIsolate;
   api::MemoryCacheProvider& memoryCacheProvider;
+  kj::Maybe<const jsg::CodeCache&> codeCache;
 
   class Configuration {
   public:
@@ -129,10 +130,12 @@ struct WorkerdApi::Impl {
        CompatibilityFlags::Reader featuresParam,
        IsolateLimitEnforcer& limitEnforcer,
        kj::Own<jsg::IsolateObserver> observer,
-       api::MemoryCacheProvider& memoryCacheProvider)
+       api::MemoryCacheProvider& memoryCacheProvider,
+       kj::Maybe<const jsg::CodeCache&> codeCache)
       : features(capnp::clone(featuresParam)),
         jsgIsolate(v8System, Configuration(*this), kj::mv(observer), limitEnforcer.getCreateParams()),
-        memoryCacheProvider(memoryCacheProvider) {}
+        memoryCacheProvider(memoryCacheProvider),
+        codeCache(codeCache) {}
 
   static v8::Local<v8::String> compileTextGlobal(JsgWorkerdIsolate::Lock& lock,
       capnp::Text::Reader reader) {
@@ -172,9 +175,10 @@ WorkerdApi::WorkerdApi(jsg::V8System& v8System,
     CompatibilityFlags::Reader features,
     IsolateLimitEnforcer& limitEnforcer,
     kj::Own<jsg::IsolateObserver> observer,
-    api::MemoryCacheProvider& memoryCacheProvider)
+    api::MemoryCacheProvider& memoryCacheProvider,
+    kj::Maybe<const jsg::CodeCache&> codeCache)
     : impl(kj::heap<Impl>(v8System, features, limitEnforcer, kj::mv(observer),
-                          memoryCacheProvider)) {}
+                          memoryCacheProvider, codeCache)) {}
 WorkerdApi::~WorkerdApi() noexcept(false) {}
 
 kj::Own<jsg::Lock> WorkerdApi::lock(jsg::V8StackScope& stackScope) const {
@@ -298,7 +302,8 @@ kj::Maybe<jsg::ModuleRegistry::ModuleInfo> WorkerdApi::tryCompileModule(
     jsg::Lock& js,
     config::Worker::Module::Reader module,
     jsg::CompilationObserver& observer,
-    CompatibilityFlags::Reader featureFlags) {
+    CompatibilityFlags::Reader featureFlags,
+    kj::Maybe<const jsg::CodeCache&> codeCache) {
   TRACE_EVENT("workerd", "WorkerdApi::tryCompileModule()", "name", module.getName());
   auto& lock = kj::downcast<JsgWorkerdIsolate::Lock>(js);
   switch (module.which()) {
@@ -341,7 +346,8 @@ kj::Maybe<jsg::ModuleRegistry::ModuleInfo> WorkerdApi::tryCompileModule(
           module.getName(),
           module.getEsModule(),
           jsg::ModuleInfoCompileOption::BUNDLE,
-          observer);
+          observer,
+          codeCache);
     }
     case config::Worker::Module::COMMON_JS_MODULE: {
       return jsg::ModuleRegistry::ModuleInfo(
@@ -351,7 +357,8 @@ kj::Maybe<jsg::ModuleRegistry::ModuleInfo> WorkerdApi::tryCompileModule(
           jsg::ModuleRegistry::CommonJsModuleInfo(
               lock,
               module.getName(),
-              module.getCommonJsModule()));
+              module.getCommonJsModule(),
+              codeCache));
     }
     case config::Worker::Module::NODE_JS_COMPAT_MODULE: {
       KJ_REQUIRE(featureFlags.getNodeJsCompat(),
@@ -363,7 +370,8 @@ kj::Maybe<jsg::ModuleRegistry::ModuleInfo> WorkerdApi::tryCompileModule(
           jsg::ModuleRegistry::NodeJsModuleInfo(
               lock,
               module.getName(),
-              module.getNodeJsCompatModule()));
+              module.getNodeJsCompatModule(),
+              codeCache));
     }
     case config::Worker::Module::PYTHON_MODULE: {
       // Nothing to do. Handled in compileModules.
@@ -437,7 +445,8 @@ void WorkerdApi::compileModules(
 
     for (auto module: confModules) {
       auto path = kj::Path::parse(module.getName());
-      auto maybeInfo = tryCompileModule(lockParam, module, modules->getObserver(), featureFlags);
+      auto maybeInfo = tryCompileModule(lockParam, module, modules->getObserver(), featureFlags,
+                                        impl->codeCache);
       KJ_IF_SOME(info, maybeInfo) {
         modules->add(path, kj::mv(info));
       }
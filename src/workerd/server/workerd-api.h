@@ -21,7 +21,8 @@ public:
       CompatibilityFlags::Reader features,
       IsolateLimitEnforcer& limitEnforcer,
       kj::Own<jsg::IsolateObserver> observer,
-      api::MemoryCacheProvider& memoryCacheProvider);
+      api::MemoryCacheProvider& memoryCacheProvider,
+      kj::Maybe<const jsg::CodeCache&> codeCache = kj::none);
   ~WorkerdApi() noexcept(false);
 
   static const WorkerdApi& from(const Worker::Api&);
@@ -214,7 +215,8 @@ public:
       jsg::Lock& js,
       config::Worker::Module::Reader conf,
       jsg::CompilationObserver& observer,
-      CompatibilityFlags::Reader featureFlags);
+      CompatibilityFlags::Reader featureFlags,
+      kj::Maybe<const jsg::CodeCache&> codeCache = kj::none);
 
   using ModuleFallbackCallback = Worker::Api::ModuleFallbackCallback;
   void setModuleFallbackCallback(
@@ -7,6 +7,9 @@
 #include <kj/filesystem.h>
 #include <kj/map.h>
 #include <kj/async-queue.h>
+#include <kj/mutex.h>
+#include <kj/one-of.h>
+#include <kj/thread.h>
 #include <capnp/message.h>
 #include <capnp/serialize.h>
 #include <capnp/schema-parser.h>
@@ -17,6 +20,8 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include "server.h"
+#include "code-cache.h"
+#include "listen-sockets.h"
 #include <workerd/jsg/setup.h>
 #include <openssl/rand.h>
 #include <workerd/io/compatibility-date.capnp.h>
@@ -721,7 +726,10 @@ public:
         .addOption({'w', "watch"}, CLI_METHOD(watch),
                    "Watch configuration files (and server binary) and reload if they change. "
                    "Useful for development, but not recommended in production.")
-        .addOption({"experimental"}, [this]() { server.allowExperimental(); return true; },
+        .addOption({"experimental"}, [this]() {
+                     configureServers([](Server& s) { s.allowExperimental(); });
+                     return true;
+                   },
                    "Permit the use of experimental features which may break backwards "
                    "compatibility in a future release.");
   }
@@ -737,6 +745,10 @@ public:
         .addOptionWithArg({"control-fd"}, CLI_METHOD(enableControl), "<fd>",
                           "Enable sending of control messages on descriptor <fd>. Currently this "
                           "only reports the port each socket is listening on when ready.")
+        .addOptionWithArg({'t', "threads"}, CLI_METHOD(setThreads), "<n>",
+                          "Serve requests on <n> event loop threads, overriding the `threads` "
+                          "setting in the config. Each thread runs its own instance of every "
+                          "service and listens on every socket.")
         .callAfterParsing(CLI_METHOD(serve))
         .build();
   }
@@ -802,6 +814,10 @@ public:
           "Only write the encoded binary config to stdout. Do not attach it to an executable. "
           "The encoded config can be used as input to the \"serve\" command, without the need "
           "for any other files to be present.")
+        .addOption({"code-cache"}, [this]() { embedCodeCache = true; return true; },
+          "Load every Worker in the config, running its top-level code, and embed V8's compiled "
+          "code for the Workers' modules in the output, so that they need not be compiled from "
+          "scratch when it is run. The output is then specific to this version of workerd.")
         .callAfterParsing(CLI_METHOD(compile))
         .build();
   }
@@ -823,6 +839,7 @@ public:
 
   void overrideSocketAddr(kj::StringPtr param) {
     auto [ name, value ] = parseOverride(param);
+    socketOverrides.upsert(kj::str(name), kj::str(value));
     server.overrideSocket(kj::mv(name), kj::str(value));
   }
 
@@ -879,18 +896,23 @@ public:
     validateSocketFd(fd, name);
 
     inheritedFds.add(fd);
+    socketOverrides.upsert(kj::str(name), fd);
     server.overrideSocket(kj::mv(name), io.lowLevelProvider->wrapListenSocketFd(
         fd, kj::LowLevelAsyncIoProvider::TAKE_OWNERSHIP));
   }
 
   void overrideDirectory(kj::StringPtr param) {
     auto [ name, value ] = parseOverride(param);
-    server.overrideDirectory(kj::mv(name), kj::str(value));
+    configureServers([name = kj::mv(name), value = kj::str(value)](Server& s) {
+      s.overrideDirectory(kj::str(name), kj::str(value));
+    });
   }
 
   void overrideExternal(kj::StringPtr param) {
     auto [ name, value ] = parseOverride(param);
-    server.overrideExternal(kj::mv(name), kj::str(value));
+    configureServers([name = kj::mv(name), value = kj::str(value)](Server& s) {
+      s.overrideExternal(kj::str(name), kj::str(value));
+    });
   }
 
 #if defined(WORKERD_USE_PERFETTO)
@@ -911,6 +933,23 @@ public:
     server.enableControl(fd);
   }
 
+  void setThreads(kj::StringPtr param) {
+    uint n = KJ_UNWRAP_OR(param.tryParseAs<uint>(),
+        CLI_ERROR("Thread count must be a positive integer."));
+    if (n == 0) {
+      CLI_ERROR("Thread count must be a positive integer.");
+    }
+    threadsOverride = n;
+  }
+
+  // Applies `func` to `server`, and also remembers it so that it can be applied to the additional
+  // servers created when serving on more than one thread.
+  template <typename Func>
+  void configureServers(Func&& func) {
+    func(server);
+    serverConfigurators.add(kj::fwd<Func>(func));
+  }
+
   void watch() {
 #if _WIN32
     auto& w = watcher.emplace(io.win32EventPort);
@@ -1069,6 +1108,31 @@ public:
           "Refusing to write binary to the terminal. Please use `>` to send the output to a file.");
     }
 
+    // With --code-cache, the server (and thus its isolates) must not outlive V8, so we exit
+    // rather than return at the end, as serveImpl() does.
+    kj::Own<v8::Platform> platform;
+    kj::Maybe<WorkerdPlatform> v8Platform;
+    kj::Maybe<jsg::V8System> v8System;
+    capnp::MallocMessageBuilder configWithCodeCache;
+    if (embedCodeCache) {
+      platform = jsg::defaultPlatform(0);
+      auto& system = v8System.emplace(v8Platform.emplace(*platform),
+          KJ_MAP(flag, config.getV8Flags()) -> kj::StringPtr { return flag; });
+
+      auto codeCache = kj::heap<MemoryCodeCache>();
+      auto& codeCacheRef = *codeCache;
+      server.preloadWorkers(system, config, kj::mv(codeCache));
+      if (hadErrors) {
+        // Errors were already reported with context.error().
+        context.exit();
+      }
+
+      configWithCodeCache.setRoot(config);
+      auto root = configWithCodeCache.getRoot<config::Config>();
+      codeCacheRef.copyTo(root.initEmbeddedCodeCache(codeCacheRef.size()));
+      config = root.asReader();
+    }
+
 #if !_WIN32
     // Grab the inode info before we write anything.
     struct stat stats;
@@ -1144,6 +1208,10 @@ public:
       }
 #endif
     }
+
+    if (embedCodeCache) {
+      context.exit();
+    }
   }
 
   template <typename Func>
@@ -1195,9 +1263,16 @@ public:
 
   [[noreturn]] void serve() noexcept {
     serveImpl([&](jsg::V8System& v8System, config::Config::Reader config) {
+      uint threadCount = threadsOverride.orDefault(config.getThreads());
 #if _WIN32
+      if (threadCount > 1) {
+        context.exitError("Serving on multiple threads is not supported on Windows.");
+      }
       return server.run(v8System, config);
 #else
+      if (threadCount > 1) {
+        return serveMultiThreaded(v8System, config, threadCount);
+      }
       return server.run(v8System, config,
           // Gracefully drain when SIGTERM is received.
           io.unixEventPort.onSignal(SIGTERM).ignoreResult());
@@ -1205,6 +1280,175 @@ public:
     });
   }
 
+#if !_WIN32
+  struct ThreadSocket {
+    kj::String name;
+    kj::AutoCloseFd fd;
+  };
+
+  // An additional server running on its own thread, when serving on multiple threads.
+  struct ServerThread {
+    struct DrainState {
+      // Set once the main thread has received SIGTERM.
+      bool requested = false;
+
+      // Fulfilled to tell the thread's server to drain. Published by the thread once its event
+      // loop is running.
+      kj::Maybe<kj::Own<kj::CrossThreadPromiseFulfiller<void>>> fulfiller;
+    };
+    kj::MutexGuarded<DrainState> drain;
+
+    // Declared last so that the thread is joined before `drain` is destroyed.
+    kj::Maybe<kj::Own<kj::Thread>> thread;
+  };
+
+  // Runs `threadCount` servers, each on its own thread with its own event loop. `server` runs on
+  // the main thread; the others are created here and configured identically.
+  kj::Promise<void> serveMultiThreaded(jsg::V8System& v8System, config::Config::Reader config,
+                                       uint threadCount) {
+    for (auto service: config.getServices()) {
+      if (service.isWorker()) {
+        auto worker = service.getWorker();
+        if (worker.getDurableObjectNamespaces().size() > 0 ||
+            !worker.getDurableObjectStorage().isNone()) {
+          context.exitError(kj::str(
+              "Worker service \"", service.getName(), "\" uses Durable Objects, which are not "
+              "yet supported when serving on more than one thread."));
+        }
+      } else if (service.isCache()) {
+        // Each thread would run its own cache over the same directory, each with its own index,
+        // so they'd evict and overwrite each other's files.
+        if (service.getCache().hasDisk()) {
+          context.exitError(kj::str(
+              "Cache service \"", service.getName(), "\" stores responses on disk, which is not "
+              "supported when serving on more than one thread."));
+        }
+      }
+    }
+
+    // Bind every socket once per thread. The main thread's server gets its listeners right away,
+    // the rest are handed to the threads below.
+    auto threadSockets = kj::heapArray<kj::Vector<ThreadSocket>>(threadCount - 1);
+    for (auto sock: config.getSockets()) {
+      kj::StringPtr name = sock.getName();
+      kj::Array<kj::AutoCloseFd> fds;
+
+      KJ_IF_SOME(override, socketOverrides.find(name)) {
+        KJ_SWITCH_ONEOF(override) {
+          KJ_CASE_ONEOF(addr, kj::String) {
+            fds = bindListenSockets(addr, getDefaultPort(sock), threadCount);
+          }
+          KJ_CASE_ONEOF(fd, int) {
+            // We can't rebind an inherited socket, so all threads accept from the same one. The
+            // main thread's server already owns `fd` itself.
+            auto builder = kj::heapArrayBuilder<kj::AutoCloseFd>(threadCount);
+            builder.add(nullptr);
+            for (uint i = 1; i < threadCount; i++) {
+              builder.add(dupFd(fd));
+            }
+            fds = builder.finish();
+          }
+        }
+      } else if (sock.hasAddress()) {
+        fds = bindListenSockets(sock.getAddress(), getDefaultPort(sock), threadCount);
+      } else {
+        // Server::run() will report the missing address.
+        continue;
+      }
+
+      if (fds[0] != nullptr) {
+        server.overrideSocket(kj::str(name),
+            io.lowLevelProvider->wrapListenSocketFd(kj::mv(fds[0])));
+      }
+      for (uint i = 1; i < threadCount; i++) {
+        threadSockets[i - 1].add(ThreadSocket { kj::str(name), kj::mv(fds[i]) });
+      }
+    }
+
+    auto serverPromises = kj::heapArrayBuilder<kj::Promise<void>>(threadCount);
+    for (auto& sockets: threadSockets) {
+      auto [ donePromise, doneFulfiller ] = kj::newPromiseAndCrossThreadFulfiller<void>();
+      serverPromises.add(kj::mv(donePromise));
+
+      auto& serverThread = *serverThreads.add(kj::heap<ServerThread>());
+      serverThread.thread = kj::heap<kj::Thread>(
+          [this, &serverThread, &v8System, config, sockets = kj::mv(sockets),
+           doneFulfiller = kj::mv(doneFulfiller)]() mutable {
+        KJ_IF_SOME(exception, kj::runCatchingExceptions([&]() {
+          runServerThread(serverThread, v8System, config, kj::mv(sockets));
+        })) {
+          doneFulfiller->reject(kj::mv(exception));
+        } else {
+          doneFulfiller->fulfill();
+        }
+      });
+    }
+
+    // SIGTERM is only delivered to the main thread's event loop, so forward it to the others.
+    auto drainWhen = io.unixEventPort.onSignal(SIGTERM).ignoreResult().fork();
+    auto forwardDrain = drainWhen.addBranch().then([this]() {
+      for (auto& serverThread: serverThreads) {
+        auto lock = serverThread->drain.lockExclusive();
+        lock->requested = true;
+        KJ_IF_SOME(fulfiller, lock->fulfiller) {
+          fulfiller->fulfill();
+        }
+      }
+    }).eagerlyEvaluate(nullptr);
+
+    serverPromises.add(server.run(v8System, config, drainWhen.addBranch()));
+    return kj::joinPromisesFailFast(serverPromises.finish()).attach(kj::mv(forwardDrain))
+        .catch_([this](kj::Exception&& exception) -> kj::Promise<void> {
+      // One of the threads failed, most likely on a config error. Its server can't be restarted
+      // on its own, so take the whole process down rather than serve with fewer threads.
+      context.exitError(exception.getDescription());
+    });
+  }
+
+  void runServerThread(ServerThread& serverThread, jsg::V8System& v8System,
+                       config::Config::Reader config, kj::Vector<ThreadSocket> sockets) {
+    auto threadIo = kj::setupAsyncIo();
+
+    Server threadServer(*fs, threadIo.provider->getTimer(), threadIo.provider->getNetwork(),
+        entropySource, Worker::ConsoleMode::STDOUT, [this](kj::String error) {
+      // Every thread loads the same config, so the main thread's server reports the same errors.
+      // Outside of --watch mode they're fatal, so they must be fatal here too, or else this thread
+      // could carry on serving a broken config while the main thread is still loading. Throwing
+      // fails the thread, which the main thread turns into an exit.
+      if (watcher == kj::none) {
+        kj::throwFatalException(KJ_EXCEPTION(FAILED, kj::mv(error)));
+      }
+    });
+    for (auto& configure: serverConfigurators) {
+      configure(threadServer);
+    }
+    for (auto& socket: sockets) {
+      threadServer.overrideSocket(kj::mv(socket.name),
+          threadIo.lowLevelProvider->wrapListenSocketFd(kj::mv(socket.fd)));
+    }
+
+    auto drain = kj::newPromiseAndCrossThreadFulfiller<void>();
+    {
+      auto lock = serverThread.drain.lockExclusive();
+      if (lock->requested) {
+        drain.fulfiller->fulfill();
+      } else {
+        lock->fulfiller = kj::mv(drain.fulfiller);
+      }
+    }
+
+    threadServer.run(v8System, config, kj::mv(drain.promise)).wait(threadIo.waitScope);
+  }
+
+  static uint getDefaultPort(config::Socket::Reader sock) {
+    switch (sock.which()) {
+      case config::Socket::HTTP: return 80;
+      case config::Socket::HTTPS: return 443;
+    }
+    return 0;
+  }
+#endif
+
   [[noreturn]] void test() noexcept {
     // Always turn on info logging when running tests so that uncaught exceptions are displayed.
     // TODO(beta): This can be removed once we improve our error logging story.
@@ -1272,6 +1516,7 @@ private:
 
   bool binaryConfig = false;
   bool configOnly = false;
+  bool embedCodeCache = false;
   kj::Maybe<FileWatcher> watcher;
 
   kj::Own<kj::Filesystem> fs = kj::newDiskFilesystem();
@@ -1289,6 +1534,21 @@ private:
 
   kj::Vector<int> inheritedFds;
 
+  // Socket overrides from the command line, either an address or an inherited file descriptor.
+  // These are also passed to `server` directly, but serving on multiple threads needs to know them
+  // in order to bind each socket once per thread.
+  kj::HashMap<kj::String, kj::OneOf<kj::String, int>> socketOverrides;
+
+  // Command-line settings which apply to every server when serving on multiple threads. See
+  // configureServers().
+  kj::Vector<kj::ConstFunction<void(Server&)>> serverConfigurators;
+
+  kj::Maybe<uint> threadsOverride;
+
+#if !_WIN32
+  kj::Vector<kj::Own<ServerThread>> serverThreads;
+#endif
+
   kj::Maybe<kj::String> testServicePattern;
   kj::Maybe<kj::String> testEntrypointPattern;
 
@@ -0,0 +1,66 @@
+// Copyright (c) 2024 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include <workerd/tests/bench-tools.h>
+#include <workerd/api/node/buffer-string-search.h>
+#include <workerd/util/substring-search.h>
+
+// A benchmark for Buffer.indexOf()'s search engines, scanning 4MiB of text for a needle which
+// isn't in it. The argument is the needle length, which must be at least 3: every pair of
+// characters occurs in the text, so a shorter needle whose first and last characters both occur
+// in it would be found.
+
+namespace workerd {
+namespace {
+
+using api::node::stringsearch::Vector;
+
+struct BufferSearch {
+  BufferSearch(size_t needleLength)
+      : haystack(kj::heapArray<uint8_t>(4 << 20)),
+        needle(kj::heapArray<uint8_t>(needleLength)) {
+    KJ_REQUIRE(needleLength >= 3);
+
+    // Text-like contents. The needle's first and last characters both occur in it, so that
+    // candidate positions regularly get past the filter, but its next-to-last character doesn't,
+    // so it's never found.
+    static constexpr char CHARS[] = "abcdefghijklmnopqrstuvwxyz ,.\r\n-ABCDEFG0123456789";
+    uint32_t state = 1;
+    for (auto& c: haystack) {
+      state = state * 1103515245 + 12345;
+      c = CHARS[(state >> 16) % (sizeof(CHARS) - 1)];
+    }
+    for (auto i: kj::indices(needle)) needle[i] = '-';
+    needle[needle.size() - 2] = '#';
+  }
+
+  kj::Array<uint8_t> haystack;
+  kj::Array<uint8_t> needle;
+};
+
+void boyerMoore(benchmark::State& state) {
+  BufferSearch search(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(api::node::stringsearch::SearchString(
+        Vector<const uint8_t>(search.haystack.begin(), search.haystack.size(), true),
+        Vector<const uint8_t>(search.needle.begin(), search.needle.size(), true), 0));
+  }
+  state.SetBytesProcessed(state.iterations() * search.haystack.size());
+}
+
+void filtered(benchmark::State& state) {
+  BufferSearch search(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(substring::findFirst(search.haystack, search.needle));
+  }
+  state.SetBytesProcessed(state.iterations() * search.haystack.size());
+}
+
+// Buffer.indexOf() uses the filtered search for needles up to kMaxFilteredNeedleLength (128)
+// bytes, so measure both sides of that: the lengths are 3, 4, 16, 64, 256 and 512.
+WD_BENCHMARK(boyerMoore)->RangeMultiplier(4)->Range(3, 512);
+WD_BENCHMARK(filtered)->RangeMultiplier(4)->Range(3, 512);
+
+} // namespace
+} // namespace workerd
@@ -0,0 +1,97 @@
+// Copyright (c) 2024 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include <workerd/tests/bench-tools.h>
+#include <workerd/tests/test-fixture.h>
+#include <workerd/api/encoding.h>
+
+// A benchmark for TextDecoder and TextEncoder, with UTF-8 text of various compositions.
+
+namespace workerd {
+namespace {
+
+// About 64KiB of text built from repetitions of `unit`.
+kj::String makeText(kj::StringPtr unit) {
+  kj::Vector<char> text;
+  while (text.size() < 65536) text.addAll(unit);
+  text.add('\0');
+  return kj::String(text.releaseAsArray());
+}
+
+struct TextEncodingBenchmark: public benchmark::Fixture {
+  virtual ~TextEncodingBenchmark() noexcept(true) {}
+
+  void SetUp(benchmark::State& state) noexcept(true) override {
+    fixture = kj::heap<TestFixture>();
+
+    // JSON is mostly ASCII; the other inputs exercise the Latin-1 and two-byte output paths.
+    ascii = makeText(R"({"id":12345,"name":"example","tags":["a","b","c"],"ok":true},)"_kj);
+    latin1 = makeText(
+        "Cr\xc3\xa8me br\xc3\xbbl\xc3\xa9" "e, caf\xc3\xa9 au lait, na\xc3\xaf" "ve. "_kj);
+    mixed = makeText("Hello, \xe4\xb8\x96\xe7\x95\x8c! \xf0\x9f\x98\xba \xe2\x82\xac" "10. "_kj);
+  }
+
+  void TearDown(benchmark::State& state) noexcept(true) override {
+    fixture = nullptr;
+  }
+
+  void decode(benchmark::State& state, kj::StringPtr text) {
+    fixture->runInIoContext([&](const TestFixture::Environment& env) {
+      auto decoder = api::TextDecoder::constructor(kj::none, kj::none);
+      for (auto _ : state) {
+        env.js.withinHandleScope([&] {
+          benchmark::DoNotOptimize(decoder->decodePtr(env.js, text.asBytes(), true));
+        });
+      }
+      state.SetBytesProcessed(state.iterations() * text.size());
+    });
+  }
+
+  void encode(benchmark::State& state, kj::StringPtr text) {
+    fixture->runInIoContext([&](const TestFixture::Environment& env) {
+      auto encoder = api::TextEncoder::constructor();
+      env.js.withinHandleScope([&] {
+        auto str = env.js.str(text);
+        for (auto _ : state) {
+          env.js.withinHandleScope([&] {
+            benchmark::DoNotOptimize(encoder->encode(env.js, str));
+          });
+        }
+      });
+      state.SetBytesProcessed(state.iterations() * text.size());
+    });
+  }
+
+  kj::Own<TestFixture> fixture;
+  kj::String ascii;
+  kj::String latin1;
+  kj::String mixed;
+};
+
+BENCHMARK_F(TextEncodingBenchmark, DecodeAscii)(benchmark::State& state) {
+  decode(state, ascii);
+}
+
+BENCHMARK_F(TextEncodingBenchmark, DecodeLatin1)(benchmark::State& state) {
+  decode(state, latin1);
+}
+
+BENCHMARK_F(TextEncodingBenchmark, DecodeMixed)(benchmark::State& state) {
+  decode(state, mixed);
+}
+
+BENCHMARK_F(TextEncodingBenchmark, EncodeAscii)(benchmark::State& state) {
+  encode(state, ascii);
+}
+
+BENCHMARK_F(TextEncodingBenchmark, EncodeLatin1)(benchmark::State& state) {
+  encode(state, latin1);
+}
+
+BENCHMARK_F(TextEncodingBenchmark, EncodeMixed)(benchmark::State& state) {
+  encode(state, mixed);
+}
+
+} // namespace
+} // namespace workerd
@@ -0,0 +1,63 @@
+// Copyright (c) 2024 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "base64.h"
+#include <kj/encoding.h>
+#include <kj/string.h>
+#include <kj/test.h>
+
+namespace workerd::base64 {
+namespace {
+
+kj::String encodeToString(kj::ArrayPtr<const kj::byte> input, Alphabet alphabet) {
+  auto out = kj::heapArray<char>(encodedLength(input.size(), alphabet) + 1);
+  encode(input, out.slice(0, out.size() - 1), alphabet);
+  out.back() = '\0';
+  return kj::String(kj::mv(out));
+}
+
+KJ_TEST("base64 encoding matches kj") {
+  // Long enough to cover whole vector blocks as well as every length of tail.
+  auto data = kj::heapArray<kj::byte>(200);
+  for (auto i: kj::indices(data)) data[i] = i * 37 + 11;
+
+  for (size_t size = 0; size <= data.size(); size++) {
+    auto input = data.slice(0, size);
+    KJ_EXPECT(encodeToString(input, Alphabet::STANDARD) == kj::encodeBase64(input), size);
+    KJ_EXPECT(encodeToString(input, Alphabet::URL) == kj::encodeBase64Url(input), size);
+  }
+}
+
+KJ_TEST("base64 decoding") {
+  auto data = kj::heapArray<kj::byte>(192);
+  for (auto i: kj::indices(data)) data[i] = i * 37 + 11;
+  auto encoded = kj::encodeBase64(data);
+  auto out = kj::heapArray<kj::byte>(data.size());
+
+  KJ_EXPECT(decodePrefix(encoded.asBytes(), out) == encoded.size());
+  KJ_EXPECT(out == data);
+
+  // Both alphabets are accepted, even mixed together.
+  KJ_EXPECT(decodePrefix("+/-_"_kj.asBytes(), out) == 4);
+  KJ_EXPECT(out[0] == 0xfb && out[1] == 0xff && out[2] == 0xbf);
+}
+
+KJ_TEST("base64 decoding stops at anything outside the alphabets") {
+  kj::byte out[128];
+
+  // Padding, whitespace and invalid characters all end the prefix at the start of their group.
+  KJ_EXPECT(decodePrefix("aGVsbG8="_kj.asBytes(), out) == 4);
+  KJ_EXPECT(decodePrefix("aGVs bG8"_kj.asBytes(), out) == 4);
+  auto invalid = kj::str("aGVsbG8h\xc3\xa9", kj::repeat('A', 100));
+  KJ_EXPECT(decodePrefix(invalid.asBytes(), out) == 8);
+
+  // So does a partial group at the end.
+  KJ_EXPECT(decodePrefix("aGVsbG8"_kj.asBytes(), out) == 4);
+
+  // And a full output buffer.
+  KJ_EXPECT(decodePrefix("aGVsbG8h"_kj.asBytes(), kj::arrayPtr(out, 5)) == 4);
+}
+
+}  // namespace
+}  // namespace workerd::base64
@@ -0,0 +1,287 @@
+// Copyright (c) 2024 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "base64.h"
+#include <kj/debug.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace workerd::base64 {
+namespace {
+
+constexpr char STANDARD_CHARS[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+constexpr char URL_CHARS[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+inline const char* charsFor(Alphabet alphabet) {
+  return alphabet == Alphabet::STANDARD ? STANDARD_CHARS : URL_CHARS;
+}
+
+// Marks characters which are in neither alphabet. Has the high bit set, which the SIMD code
+// relies on.
+constexpr kj::byte INVALID = 0xff;
+
+// Maps characters from either alphabet to their 6-bit values.
+struct DecodeTable {
+  kj::byte values[256];
+
+  constexpr DecodeTable(): values() {
+    for (auto& value: values) value = INVALID;
+    for (kj::byte i = 0; i < 64; i++) {
+      values[static_cast<kj::byte>(STANDARD_CHARS[i])] = i;
+      values[static_cast<kj::byte>(URL_CHARS[i])] = i;
+    }
+  }
+};
+
+constexpr DecodeTable DECODE_TABLE;
+
+inline uint32_t load24(const kj::byte* p) {
+  return (uint32_t(p[0]) << 16) | (uint32_t(p[1]) << 8) | uint32_t(p[2]);
+}
+
+// ---------------------------------------------------------------------------------------
+// Block primitives
+//
+// encodeBlock() turns ENCODE_BLOCK_INPUT bytes into 4/3 as many characters, and decodeBlock()
+// turns DECODE_BLOCK_INPUT characters into 3/4 as many bytes, returning false (having written
+// nothing) if any of them is not in either alphabet.
+
+#if defined(__SSE2__)
+
+constexpr ptrdiff_t ENCODE_BLOCK_INPUT = 12;
+constexpr ptrdiff_t DECODE_BLOCK_INPUT = 16;
+
+void encodeBlock(const kj::byte* in, char* out, const char* chars) {
+  // Put each group of three bytes in its own 32-bit lane, then spread its four 6-bit values out
+  // over the lane's bytes, first value in the lowest byte.
+  auto groups = _mm_setr_epi32(load24(in), load24(in + 3), load24(in + 6), load24(in + 9));
+  auto mask = _mm_set1_epi32(0x3f);
+  auto values = _mm_or_si128(
+      _mm_or_si128(
+          _mm_srli_epi32(groups, 18),
+          _mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(groups, 12), mask), 8)),
+      _mm_or_si128(
+          _mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(groups, 6), mask), 16),
+          _mm_slli_epi32(_mm_and_si128(groups, mask), 24)));
+
+  // Map each value to its character by adding an offset which depends on the value's range.
+  auto offset = _mm_set1_epi8('A');
+  offset = _mm_add_epi8(offset, _mm_and_si128(
+      _mm_cmpgt_epi8(values, _mm_set1_epi8(25)), _mm_set1_epi8(('a' - 26) - 'A')));
+  offset = _mm_add_epi8(offset, _mm_and_si128(
+      _mm_cmpgt_epi8(values, _mm_set1_epi8(51)), _mm_set1_epi8(('0' - 52) - ('a' - 26))));
+  offset = _mm_add_epi8(offset, _mm_and_si128(
+      _mm_cmpeq_epi8(values, _mm_set1_epi8(62)), _mm_set1_epi8((chars[62] - 62) - ('0' - 52))));
+  offset = _mm_add_epi8(offset, _mm_and_si128(
+      _mm_cmpeq_epi8(values, _mm_set1_epi8(63)), _mm_set1_epi8((chars[63] - 63) - ('0' - 52))));
+
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_add_epi8(values, offset));
+}
+
+inline __m128i inRange(__m128i c, char low, char high) {
+  // Characters outside of ASCII compare as negative, so are never in range.
+  return _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8(low - 1)),
+                       _mm_cmplt_epi8(c, _mm_set1_epi8(high + 1)));
+}
+
+bool decodeBlock(const kj::byte* in, kj::byte* out) {
+  auto c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+
+  auto upper = inRange(c, 'A', 'Z');
+  auto lower = inRange(c, 'a', 'z');
+  auto digit = inRange(c, '0', '9');
+  auto is62 = _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8('+')),
+                           _mm_cmpeq_epi8(c, _mm_set1_epi8('-')));
+  auto is63 = _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8('/')),
+                           _mm_cmpeq_epi8(c, _mm_set1_epi8('_')));
+
+  auto alphanumeric = _mm_or_si128(upper, _mm_or_si128(lower, digit));
+  if (_mm_movemask_epi8(_mm_or_si128(alphanumeric, _mm_or_si128(is62, is63))) != 0xffff) {
+    return false;
+  }
+
+  auto offset = _mm_or_si128(_mm_and_si128(upper, _mm_set1_epi8(-'A')),
+                _mm_or_si128(_mm_and_si128(lower, _mm_set1_epi8(26 - 'a')),
+                             _mm_and_si128(digit, _mm_set1_epi8(52 - '0'))));
+  auto values = _mm_or_si128(_mm_and_si128(alphanumeric, _mm_add_epi8(c, offset)),
+                _mm_or_si128(_mm_and_si128(is62, _mm_set1_epi8(62)),
+                             _mm_and_si128(is63, _mm_set1_epi8(63))));
+
+  // Merge pairs of 6-bit values into 12 bits, then pairs of those into the 24 bits of each group.
+  auto pairs = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(values, _mm_set1_epi16(0x00ff)), 6),
+                            _mm_srli_epi16(values, 8));
+  auto groups = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(pairs, _mm_set1_epi32(0xffff)), 12),
+                             _mm_srli_epi32(pairs, 16));
+
+  alignas(16) uint32_t lanes[4];
+  _mm_store_si128(reinterpret_cast<__m128i*>(lanes), groups);
+  for (auto group: lanes) {
+    *out++ = group >> 16;
+    *out++ = group >> 8;
+    *out++ = group;
+  }
+  return true;
+}
+
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+
+constexpr ptrdiff_t ENCODE_BLOCK_INPUT = 48;
+constexpr ptrdiff_t DECODE_BLOCK_INPUT = 64;
+
+inline uint8x16x4_t loadTable(const kj::byte* table) {
+  return {{ vld1q_u8(table), vld1q_u8(table + 16), vld1q_u8(table + 32), vld1q_u8(table + 48) }};
+}
+
+void encodeBlock(const kj::byte* in, char* out, const char* chars) {
+  auto table = loadTable(reinterpret_cast<const kj::byte*>(chars));
+  auto mask = vdupq_n_u8(0x3f);
+
+  // De-interleave the input so that each vector holds one byte from each group of three.
+  auto bytes = vld3q_u8(in);
+  uint8x16x4_t values;
+  values.val[0] = vshrq_n_u8(bytes.val[0], 2);
+  values.val[1] = vandq_u8(vorrq_u8(vshlq_n_u8(bytes.val[0], 4), vshrq_n_u8(bytes.val[1], 4)),
+                           mask);
+  values.val[2] = vandq_u8(vorrq_u8(vshlq_n_u8(bytes.val[1], 2), vshrq_n_u8(bytes.val[2], 6)),
+                           mask);
+  values.val[3] = vandq_u8(bytes.val[2], mask);
+
+  for (auto& value: values.val) value = vqtbl4q_u8(table, value);
+  vst4q_u8(reinterpret_cast<uint8_t*>(out), values);
+}
+
+bool decodeBlock(const kj::byte* in, kj::byte* out) {
+  auto low = loadTable(DECODE_TABLE.values);
+  auto high = loadTable(DECODE_TABLE.values + 64);
+
+  // De-interleave the input so that each vector holds one character from each group of four.
+  auto chars = vld4q_u8(in);
+  uint8x16_t values[4];
+  uint8x16_t errors = vdupq_n_u8(0);
+  for (int i = 0; i < 4; i++) {
+    auto c = chars.val[i];
+    // Look up characters below 64 in the first half of the table and the rest in the second;
+    // lookups with an out-of-range index leave the result alone.
+    values[i] = vqtbx4q_u8(vqtbl4q_u8(low, c), high, vsubq_u8(c, vdupq_n_u8(64)));
+    // Non-ASCII characters and INVALID values both have the high bit set.
+    errors = vorrq_u8(errors, vorrq_u8(c, values[i]));
+  }
+  if (vmaxvq_u8(errors) >= 0x80) return false;
+
+  uint8x16x3_t bytes;
+  bytes.val[0] = vorrq_u8(vshlq_n_u8(values[0], 2), vshrq_n_u8(values[1], 4));
+  bytes.val[1] = vorrq_u8(vshlq_n_u8(values[1], 4), vshrq_n_u8(values[2], 2));
+  bytes.val[2] = vorrq_u8(vshlq_n_u8(values[2], 6), values[3]);
+  vst3q_u8(out, bytes);
+  return true;
+}
+
+#else
+
+// No vector support; everything goes through the scalar loops.
+constexpr ptrdiff_t ENCODE_BLOCK_INPUT = 0;
+constexpr ptrdiff_t DECODE_BLOCK_INPUT = 0;
+
+void encodeBlock(const kj::byte* in, char* out, const char* chars) { KJ_UNREACHABLE; }
+bool decodeBlock(const kj::byte* in, kj::byte* out) { KJ_UNREACHABLE; }
+
+#endif
+
+constexpr ptrdiff_t ENCODE_BLOCK_OUTPUT = ENCODE_BLOCK_INPUT / 3 * 4;
+constexpr ptrdiff_t DECODE_BLOCK_OUTPUT = DECODE_BLOCK_INPUT / 4 * 3;
+
+}  // namespace
+
+size_t encodedLength(size_t size, Alphabet alphabet) {
+  switch (alphabet) {
+    case Alphabet::STANDARD:
+      return (size + 2) / 3 * 4;
+    case Alphabet::URL:
+      return size / 3 * 4 + (size % 3 == 0 ? 0 : size % 3 + 1);
+  }
+  KJ_UNREACHABLE;
+}
+
+void encode(kj::ArrayPtr<const kj::byte> input, kj::ArrayPtr<char> out, Alphabet alphabet) {
+  KJ_DASSERT(out.size() == encodedLength(input.size(), alphabet));
+  auto chars = charsFor(alphabet);
+  auto in = input.begin();
+  auto end = input.end();
+  auto dest = out.begin();
+
+  if constexpr (ENCODE_BLOCK_INPUT > 0) {
+    for (; end - in >= ENCODE_BLOCK_INPUT; in += ENCODE_BLOCK_INPUT) {
+      encodeBlock(in, dest, chars);
+      dest += ENCODE_BLOCK_OUTPUT;
+    }
+  }
+
+  for (; end - in >= 3; in += 3) {
+    uint32_t group = load24(in);
+    *dest++ = chars[group >> 18];
+    *dest++ = chars[(group >> 12) & 0x3f];
+    *dest++ = chars[(group >> 6) & 0x3f];
+    *dest++ = chars[group & 0x3f];
+  }
+
+  switch (end - in) {
+    case 1:
+      *dest++ = chars[in[0] >> 2];
+      *dest++ = chars[(in[0] & 0x03) << 4];
+      if (alphabet == Alphabet::STANDARD) {
+        *dest++ = '=';
+        *dest++ = '=';
+      }
+      break;
+    case 2:
+      *dest++ = chars[in[0] >> 2];
+      *dest++ = chars[((in[0] & 0x03) << 4) | (in[1] >> 4)];
+      *dest++ = chars[(in[1] & 0x0f) << 2];
+      if (alphabet == Alphabet::STANDARD) {
+        *dest++ = '=';
+      }
+      break;
+  }
+
+  KJ_DASSERT(dest == out.end());
+}
+
+size_t decodePrefix(kj::ArrayPtr<const kj::byte> input, kj::ArrayPtr<kj::byte> out) {
+  auto in = input.begin();
+  auto end = in + input.size() / 4 * 4;
+  auto dest = out.begin();
+  auto destEnd = out.end();
+
+  if constexpr (DECODE_BLOCK_INPUT > 0) {
+    while (end - in >= DECODE_BLOCK_INPUT && destEnd - dest >= DECODE_BLOCK_OUTPUT &&
+           decodeBlock(in, dest)) {
+      in += DECODE_BLOCK_INPUT;
+      dest += DECODE_BLOCK_OUTPUT;
+    }
+  }
+
+  // Finish off one group at a time, which also finds where exactly a failed block went wrong.
+  while (end - in >= 4 && destEnd - dest >= 3) {
+    uint32_t a = DECODE_TABLE.values[in[0]];
+    uint32_t b = DECODE_TABLE.values[in[1]];
+    uint32_t c = DECODE_TABLE.values[in[2]];
+    uint32_t d = DECODE_TABLE.values[in[3]];
+    if ((a | b | c | d) & 0x80) break;
+
+    *dest++ = (a << 2) | (b >> 4);
+    *dest++ = (b << 4) | (c >> 2);
+    *dest++ = (c << 6) | d;
+    in += 4;
+  }
+
+  return in - input.begin();
+}
+
+}  // namespace workerd::base64
@@ -0,0 +1,38 @@
+// Copyright (c) 2024 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#pragma once
+
+#include <kj/array.h>
+
+// Base64 encoding and decoding, for callers that need to write the output into a buffer they
+// already have, or that want to layer their own handling of padding and invalid input on top.
+//
+// Whole blocks of input are processed with SSE2 or NEON (whichever the target has as a baseline),
+// and anything left over one group at a time.
+namespace workerd::base64 {
+
+enum class Alphabet {
+  // RFC 4648 section 4: '+' and '/', padded with '='.
+  STANDARD,
+  // RFC 4648 section 5: '-' and '_', without padding.
+  URL,
+};
+
+// Returns the length of the encoding of `size` bytes.
+size_t encodedLength(size_t size, Alphabet alphabet = Alphabet::STANDARD);
+
+// Encodes `input` into `out`, which must be exactly `encodedLength(input.size(), alphabet)` long.
+void encode(kj::ArrayPtr<const kj::byte> input, kj::ArrayPtr<char> out,
+            Alphabet alphabet = Alphabet::STANDARD);
+
+// Decodes the longest prefix of `input` which consists of complete groups of four characters
+// from either alphabet, stopping early if `out` is full, and returns the number of characters
+// consumed. Three bytes are written to `out` for every four characters consumed.
+//
+// Padding, whitespace and any other characters end the prefix; it is up to the caller to decide
+// what to do with them.
+size_t decodePrefix(kj::ArrayPtr<const kj::byte> input, kj::ArrayPtr<kj::byte> out);
+
+}  // namespace workerd::base64
@@ -0,0 +1,59 @@
+// Copyright (c) 2024 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "hex.h"
+#include <kj/encoding.h>
+#include <kj/string.h>
+#include <kj/test.h>
+
+namespace workerd::hex {
+namespace {
+
+KJ_TEST("hex encoding matches kj") {
+  // Long enough to cover whole vector blocks as well as every length of tail.
+  auto data = kj::heapArray<kj::byte>(100);
+  for (auto i: kj::indices(data)) data[i] = i * 37 + 11;
+
+  for (size_t size = 0; size <= data.size(); size++) {
+    auto input = data.slice(0, size);
+    auto out = kj::heapArray<char>(size * 2 + 1);
+    encode(input, out.slice(0, size * 2));
+    out.back() = '\0';
+    KJ_EXPECT(kj::String(kj::mv(out)) == kj::encodeHex(input), size);
+  }
+}
+
+KJ_TEST("hex decoding") {
+  auto data = kj::heapArray<kj::byte>(100);
+  for (auto i: kj::indices(data)) data[i] = i * 37 + 11;
+  auto out = kj::heapArray<kj::byte>(data.size());
+
+  KJ_EXPECT(decodePrefix(kj::encodeHex(data).asBytes(), out) == data.size());
+  KJ_EXPECT(out == data);
+
+  // Upper-case digits are accepted too.
+  auto upper = kj::encodeHex(data);
+  for (auto& c: upper) {
+    if (c >= 'a') c -= 'a' - 'A';
+  }
+  KJ_EXPECT(decodePrefix(upper.asBytes(), out) == data.size());
+  KJ_EXPECT(out == data);
+}
+
+KJ_TEST("hex decoding stops at the first invalid pair") {
+  kj::byte out[64];
+
+  KJ_EXPECT(decodePrefix("0a1B2g3c"_kj.asBytes(), out) == 2);
+  KJ_EXPECT(out[0] == 0x0a && out[1] == 0x1b);
+
+  auto invalid = kj::str(kj::repeat('f', 40), "\xc3\xa9", kj::repeat('f', 40));
+  KJ_EXPECT(decodePrefix(invalid.asBytes(), out) == 20);
+
+  // An odd character at the end is left alone, as is anything that doesn't fit.
+  KJ_EXPECT(decodePrefix("abcde"_kj.asBytes(), out) == 2);
+  KJ_EXPECT(decodePrefix("abcdef"_kj.asBytes(), kj::arrayPtr(out, 1)) == 1);
+}
+
+}  // namespace
+}  // namespace workerd::hex
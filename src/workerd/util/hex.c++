@@ -0,0 +1,178 @@
+// Copyright (c) 2024 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "hex.h"
+#include <kj/debug.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace workerd::hex {
+namespace {
+
+constexpr char DIGITS[] = "0123456789abcdef";
+
+// Returns the value of a hex digit, or a value with the high bit set for anything else.
+inline kj::byte digitValue(kj::byte c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  c |= 0x20;
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return 0x80;
+}
+
+// ---------------------------------------------------------------------------------------
+// Block primitives
+//
+// encodeBlock() turns BLOCK_SIZE bytes into twice as many characters, and decodeBlock() turns
+// twice BLOCK_SIZE characters into BLOCK_SIZE bytes, returning false (having written nothing) if
+// any of them is not a hex digit.
+
+#if defined(__SSE2__)
+
+constexpr ptrdiff_t BLOCK_SIZE = 16;
+
+inline __m128i nibblesToDigits(__m128i nibbles) {
+  // '0' + n, plus the distance from '9' + 1 to 'a' for nibbles above 9.
+  auto letters = _mm_and_si128(_mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9)),
+                               _mm_set1_epi8('a' - '9' - 1));
+  return _mm_add_epi8(nibbles, _mm_add_epi8(letters, _mm_set1_epi8('0')));
+}
+
+void encodeBlock(const kj::byte* in, char* out) {
+  auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+  auto mask = _mm_set1_epi8(0x0f);
+  auto high = nibblesToDigits(_mm_and_si128(_mm_srli_epi16(bytes, 4), mask));
+  auto low = nibblesToDigits(_mm_and_si128(bytes, mask));
+
+  auto dest = reinterpret_cast<__m128i*>(out);
+  _mm_storeu_si128(dest, _mm_unpacklo_epi8(high, low));
+  _mm_storeu_si128(dest + 1, _mm_unpackhi_epi8(high, low));
+}
+
+inline __m128i inRange(__m128i c, char low, char high) {
+  // Characters outside of ASCII compare as negative, so are never in range.
+  return _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8(low - 1)),
+                       _mm_cmplt_epi8(c, _mm_set1_epi8(high + 1)));
+}
+
+// Converts 16 characters to pairs of nibbles, each pair in a 16-bit lane, high nibble first.
+// Sets `valid` to false if any character is not a hex digit.
+inline __m128i digitsToPairs(const kj::byte* in, bool& valid) {
+  auto c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+  auto digit = inRange(c, '0', '9');
+  auto lowered = _mm_or_si128(c, _mm_set1_epi8(0x20));
+  auto letter = inRange(lowered, 'a', 'f');
+  if (_mm_movemask_epi8(_mm_or_si128(digit, letter)) != 0xffff) valid = false;
+
+  auto nibbles = _mm_or_si128(
+      _mm_and_si128(digit, _mm_sub_epi8(c, _mm_set1_epi8('0'))),
+      _mm_and_si128(letter, _mm_sub_epi8(lowered, _mm_set1_epi8('a' - 10))));
+  return _mm_or_si128(_mm_slli_epi16(_mm_and_si128(nibbles, _mm_set1_epi16(0x00ff)), 4),
+                      _mm_srli_epi16(nibbles, 8));
+}
+
+bool decodeBlock(const kj::byte* in, kj::byte* out) {
+  bool valid = true;
+  auto first = digitsToPairs(in, valid);
+  auto second = digitsToPairs(in + 16, valid);
+  if (!valid) return false;
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(first, second));
+  return true;
+}
+
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+
+constexpr ptrdiff_t BLOCK_SIZE = 16;
+
+void encodeBlock(const kj::byte* in, char* out) {
+  auto table = vld1q_u8(reinterpret_cast<const kj::byte*>(DIGITS));
+  auto bytes = vld1q_u8(in);
+  uint8x16x2_t digits;
+  digits.val[0] = vqtbl1q_u8(table, vshrq_n_u8(bytes, 4));
+  digits.val[1] = vqtbl1q_u8(table, vandq_u8(bytes, vdupq_n_u8(0x0f)));
+  vst2q_u8(reinterpret_cast<uint8_t*>(out), digits);
+}
+
+// Converts characters to their values, setting the high bit of `errors` for any which are not
+// hex digits.
+inline uint8x16_t digitsToNibbles(uint8x16_t c, uint8x16_t& errors) {
+  auto digit = vsubq_u8(c, vdupq_n_u8('0'));
+  auto letter = vsubq_u8(vorrq_u8(c, vdupq_n_u8(0x20)), vdupq_n_u8('a'));
+  auto isDigit = vcltq_u8(digit, vdupq_n_u8(10));
+  auto isLetter = vcltq_u8(letter, vdupq_n_u8(6));
+  errors = vorrq_u8(errors, vmvnq_u8(vorrq_u8(isDigit, isLetter)));
+  return vbslq_u8(isDigit, digit, vaddq_u8(letter, vdupq_n_u8(10)));
+}
+
+bool decodeBlock(const kj::byte* in, kj::byte* out) {
+  // De-interleave the input so that the high and low nibbles are in separate vectors.
+  auto chars = vld2q_u8(in);
+  auto errors = vdupq_n_u8(0);
+  auto high = digitsToNibbles(chars.val[0], errors);
+  auto low = digitsToNibbles(chars.val[1], errors);
+  if (vmaxvq_u8(errors) != 0) return false;
+  vst1q_u8(out, vorrq_u8(vshlq_n_u8(high, 4), low));
+  return true;
+}
+
+#else
+
+// No vector support; everything goes through the scalar loops.
+constexpr ptrdiff_t BLOCK_SIZE = 0;
+
+void encodeBlock(const kj::byte* in, char* out) { KJ_UNREACHABLE; }
+bool decodeBlock(const kj::byte* in, kj::byte* out) { KJ_UNREACHABLE; }
+
+#endif
+
+}  // namespace
+
+void encode(kj::ArrayPtr<const kj::byte> input, kj::ArrayPtr<char> out) {
+  KJ_DASSERT(out.size() == input.size() * 2);
+  auto in = input.begin();
+  auto end = input.end();
+  auto dest = out.begin();
+
+  if constexpr (BLOCK_SIZE > 0) {
+    for (; end - in >= BLOCK_SIZE; in += BLOCK_SIZE) {
+      encodeBlock(in, dest);
+      dest += BLOCK_SIZE * 2;
+    }
+  }
+
+  for (; in < end; ++in) {
+    *dest++ = DIGITS[*in >> 4];
+    *dest++ = DIGITS[*in & 0x0f];
+  }
+}
+
+size_t decodePrefix(kj::ArrayPtr<const kj::byte> input, kj::ArrayPtr<kj::byte> out) {
+  auto in = input.begin();
+  auto end = in + input.size() / 2 * 2;
+  auto dest = out.begin();
+  auto destEnd = out.end();
+
+  if constexpr (BLOCK_SIZE > 0) {
+    while (end - in >= BLOCK_SIZE * 2 && destEnd - dest >= BLOCK_SIZE &&
+           decodeBlock(in, dest)) {
+      in += BLOCK_SIZE * 2;
+      dest += BLOCK_SIZE;
+    }
+  }
+
+  // Finish off one pair at a time, which also finds where exactly a failed block went wrong.
+  for (; in < end && dest < destEnd; in += 2) {
+    kj::byte high = digitValue(in[0]);
+    kj::byte low = digitValue(in[1]);
+    if ((high | low) & 0x80) break;
+    *dest++ = (high << 4) | low;
+  }
+
+  return dest - out.begin();
+}
+
+}  // namespace workerd::hex
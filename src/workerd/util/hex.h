@@ -0,0 +1,22 @@
+// Copyright (c) 2024 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#pragma once
+
+#include <kj/array.h>
+
+// Hex encoding and decoding into caller-provided buffers. Whole blocks of input are processed
+// with SSE2 or NEON (whichever the target has as a baseline), and anything left over one byte at
+// a time.
+namespace workerd::hex {
+
+// Encodes `input` as lower-case hex into `out`, which must be exactly twice as long.
+void encode(kj::ArrayPtr<const kj::byte> input, kj::ArrayPtr<char> out);
+
+// Decodes pairs of hex digits (of either case) from the start of `input` into `out`, until the
+// input runs out, `out` is full, or a pair containing anything other than a hex digit is found.
+// Returns the number of bytes written, i.e. half the number of characters consumed.
+size_t decodePrefix(kj::ArrayPtr<const kj::byte> input, kj::ArrayPtr<kj::byte> out);
+
+}  // namespace workerd::hex
@@ -129,6 +129,21 @@ KJ_TEST("Building MimeType works") {
   KJ_ASSERT(MimeType::PLAINTEXT == type);
 }
 
+KJ_TEST("MimeType for file name works") {
+  KJ_EXPECT(KJ_ASSERT_NONNULL(MimeType::forFileName("index.html")) == "text/html;charset=UTF-8");
+  KJ_EXPECT(KJ_ASSERT_NONNULL(MimeType::forFileName("app.min.js")) ==
+      "text/javascript;charset=UTF-8");
+  KJ_EXPECT(KJ_ASSERT_NONNULL(MimeType::forFileName("LOGO.PNG")) == "image/png");
+  KJ_EXPECT(KJ_ASSERT_NONNULL(MimeType::forFileName(".woff2")) == "font/woff2");
+
+  // Every known type should itself be a valid mime type.
+  KJ_EXPECT(MimeType::tryParse(KJ_ASSERT_NONNULL(MimeType::forFileName("a.css"))) != kj::none);
+
+  KJ_EXPECT(MimeType::forFileName("README") == kj::none);
+  KJ_EXPECT(MimeType::forFileName("archive.unknown") == kj::none);
+  KJ_EXPECT(MimeType::forFileName("trailing.") == kj::none);
+}
+
 KJ_TEST("WHATWG tests") {
   struct Test {
     kj::StringPtr input;
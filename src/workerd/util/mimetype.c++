@@ -323,7 +323,8 @@ const MimeType MimeType::HTML = MimeType("text"_kj, "html"_kj);
 const MimeType MimeType::TEXT_JAVASCRIPT = MimeType("text"_kj, "javascript"_kj);
 const MimeType MimeType::JSON = MimeType("application"_kj, "json"_kj);
 const MimeType MimeType::FORM_URLENCODED = MimeType("application"_kj, "x-www-form-urlencoded"_kj);
-const MimeType MimeType::OCTET_STREAM = MimeType("application"_kj, "octet-stream"_kj);
+const kj::StringPtr MimeType::OCTET_STREAM_STRING = "application/octet-stream"_kj;
+const MimeType MimeType::OCTET_STREAM = MimeType::parse(OCTET_STREAM_STRING);
 const MimeType MimeType::XHTML = MimeType("application"_kj, "xhtml+xml"_kj);
 const MimeType MimeType::JAVASCRIPT = MimeType("application"_kj, "javascript"_kj);
 const MimeType MimeType::XJAVASCRIPT = MimeType("application"_kj, "x-javascript"_kj);
@@ -378,4 +379,62 @@ bool MimeType::isVideo(const MimeType& mimeType) {
 bool MimeType::isAudio(const MimeType& mimeType) {
   return mimeType.type() == "audio";
 }
+
+kj::Maybe<kj::StringPtr> MimeType::forFileName(kj::StringPtr name) {
+  static const kj::HashMap<kj::StringPtr, kj::StringPtr> TYPES = []() {
+    struct Entry {
+      kj::StringPtr extension;
+      kj::StringPtr type;
+    };
+    static const Entry ENTRIES[] = {
+      { "html"_kj, "text/html;charset=UTF-8"_kj },
+      { "htm"_kj, "text/html;charset=UTF-8"_kj },
+      { "css"_kj, "text/css;charset=UTF-8"_kj },
+      { "js"_kj, "text/javascript;charset=UTF-8"_kj },
+      { "mjs"_kj, "text/javascript;charset=UTF-8"_kj },
+      { "json"_kj, "application/json"_kj },
+      { "map"_kj, "application/json"_kj },
+      { "webmanifest"_kj, "application/manifest+json"_kj },
+      { "txt"_kj, "text/plain;charset=UTF-8"_kj },
+      { "md"_kj, "text/markdown;charset=UTF-8"_kj },
+      { "csv"_kj, "text/csv;charset=UTF-8"_kj },
+      { "xml"_kj, "application/xml"_kj },
+      { "vtt"_kj, "text/vtt;charset=UTF-8"_kj },
+      { "wasm"_kj, "application/wasm"_kj },
+      { "pdf"_kj, "application/pdf"_kj },
+      { "zip"_kj, "application/zip"_kj },
+      { "gz"_kj, "application/gzip"_kj },
+      { "png"_kj, "image/png"_kj },
+      { "jpg"_kj, "image/jpeg"_kj },
+      { "jpeg"_kj, "image/jpeg"_kj },
+      { "gif"_kj, "image/gif"_kj },
+      { "webp"_kj, "image/webp"_kj },
+      { "avif"_kj, "image/avif"_kj },
+      { "svg"_kj, "image/svg+xml"_kj },
+      { "ico"_kj, "image/x-icon"_kj },
+      { "woff"_kj, "font/woff"_kj },
+      { "woff2"_kj, "font/woff2"_kj },
+      { "ttf"_kj, "font/ttf"_kj },
+      { "otf"_kj, "font/otf"_kj },
+      { "mp3"_kj, "audio/mpeg"_kj },
+      { "ogg"_kj, "audio/ogg"_kj },
+      { "wav"_kj, "audio/wav"_kj },
+      { "mp4"_kj, "video/mp4"_kj },
+      { "webm"_kj, "video/webm"_kj },
+    };
+    kj::HashMap<kj::StringPtr, kj::StringPtr> result;
+    result.reserve(kj::size(ENTRIES));
+    for (auto& entry: ENTRIES) {
+      result.insert(entry.extension, entry.type);
+    }
+    return result;
+  }();
+
+  auto dot = KJ_UNWRAP_OR(name.findLast('.'), { return kj::none; });
+  auto extension = toLowerCopy(name.slice(dot + 1));
+  KJ_IF_SOME(type, TYPES.find(kj::StringPtr(extension))) {
+    return type;
+  }
+  return kj::none;
+}
 }  // namespace workerd
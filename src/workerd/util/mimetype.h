@@ -78,6 +78,12 @@ public:
   static bool isAudio(const MimeType& mimeType);
   static bool isText(const MimeType& mimeType);
 
+  // Returns the serialized content type conventionally used for files with the given name,
+  // based on its extension (case-insensitive), or kj::none if the extension is not recognized.
+  // Text types include a UTF-8 charset parameter. Only a small table of common web formats is
+  // known; this is not meant to replace a full mime database.
+  static kj::Maybe<kj::StringPtr> forFileName(kj::StringPtr name);
+
   static const MimeType JSON;
   static const MimeType PLAINTEXT;
   static const MimeType FORM_URLENCODED;
@@ -95,6 +101,7 @@ public:
 
   // exposed directly for performance reasons
   static const kj::StringPtr PLAINTEXT_STRING;
+  static const kj::StringPtr OCTET_STREAM_STRING;
 
 private:
   kj::String type_;
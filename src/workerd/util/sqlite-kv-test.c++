@@ -3,6 +3,7 @@
 //     https://opensource.org/licenses/Apache-2.0
 
 #include "sqlite-kv.h"
+#include <kj/map.h>
 #include <kj/test.h>
 
 namespace workerd {
@@ -91,5 +92,55 @@ KJ_TEST("SQLite-KV") {
   KJ_EXPECT(list(nullptr, kj::none, kj::none, F) == "");
 }
 
+KJ_TEST("SQLite-KV multi-key operations") {
+  auto dir = kj::newInMemoryDirectory(kj::nullClock());
+  SqliteDatabase::Vfs vfs(*dir);
+  SqliteDatabase db(vfs, kj::Path({"foo"}), kj::WriteMode::CREATE | kj::WriteMode::MODIFY);
+  SqliteKv kv(db);
+
+  // Use enough keys to need more than one batch, plus a partial batch.
+  constexpr uint N = SqliteKv::BATCH_SIZE * 2 + 5;
+  auto keys = KJ_MAP(i, kj::zeroTo(N)) { return kj::str("key", i); };
+  auto values = KJ_MAP(i, kj::zeroTo(N)) { return kj::str("value", i); };
+  auto keyPtrs = KJ_MAP(key, keys) -> SqliteKv::KeyPtr { return key; };
+  auto valuePtrs = KJ_MAP(value, values) -> SqliteKv::ValuePtr { return value.asBytes(); };
+
+  kv.put(keyPtrs, valuePtrs);
+
+  kj::HashMap<kj::String, kj::String> results;
+  auto callback = [&](kj::StringPtr key, kj::ArrayPtr<const byte> value) {
+    results.insert(kj::str(key), kj::str(value.asChars()));
+  };
+
+  KJ_EXPECT(kv.get(keyPtrs, callback) == N);
+  KJ_EXPECT(results.size() == N);
+  for (auto i: kj::zeroTo(N)) {
+    KJ_EXPECT(KJ_ASSERT_NONNULL(results.find(keys[i])) == values[i]);
+  }
+
+  // Missing keys are skipped.
+  results.clear();
+  const kj::StringPtr someKeys[] = { "key1"_kj, "corge"_kj, "key3"_kj };
+  KJ_EXPECT(kv.get(someKeys, callback) == 2);
+  KJ_EXPECT(KJ_ASSERT_NONNULL(results.find("key1"_kj)) == "value1");
+  KJ_EXPECT(KJ_ASSERT_NONNULL(results.find("key3"_kj)) == "value3");
+
+  // Put can overwrite, and the last of duplicate keys wins.
+  const kj::StringPtr putKeys[] = { "key1"_kj, "key2"_kj, "key1"_kj };
+  const kj::ArrayPtr<const byte> putValues[] = {
+    "abc"_kj.asBytes(), "def"_kj.asBytes(), "ghi"_kj.asBytes() };
+  kv.put(putKeys, putValues);
+  KJ_EXPECT(kv.get("key1", [&](kj::ArrayPtr<const byte> value) {
+    KJ_EXPECT(kj::str(value.asChars()) == "ghi");
+  }));
+
+  KJ_EXPECT(kv.delete_(someKeys) == 2);
+  KJ_EXPECT(kv.delete_(someKeys) == 0);
+  KJ_EXPECT(kv.delete_(keyPtrs) == N - 2);
+
+  results.clear();
+  KJ_EXPECT(kv.get(keyPtrs, callback) == 0);
+}
+
 }  // namespace
 }  // namespace workerd
@@ -36,4 +36,54 @@ uint SqliteKv::deleteAll() {
   return query.changeCount();
 }
 
+void SqliteKv::put(kj::ArrayPtr<const KeyPtr> keys, kj::ArrayPtr<const ValuePtr> values) {
+  KJ_REQUIRE(keys.size() == values.size());
+
+  // Full batches are written with one statement each, the remainder one key at a time.
+  SqliteDatabase::Query::ValuePtr bindings[BATCH_SIZE * 2];
+  while (keys.size() >= BATCH_SIZE) {
+    for (auto i: kj::zeroTo(BATCH_SIZE)) {
+      bindings[i * 2] = keys[i];
+      bindings[i * 2 + 1] = values[i];
+    }
+    stmtPutMulti.run(kj::arrayPtr(bindings, BATCH_SIZE * 2).asConst());
+    keys = keys.slice(BATCH_SIZE, keys.size());
+    values = values.slice(BATCH_SIZE, values.size());
+  }
+
+  for (auto i: kj::indices(keys)) {
+    stmtPut.run(keys[i], values[i]);
+  }
+}
+
+uint SqliteKv::delete_(kj::ArrayPtr<const KeyPtr> keys) {
+  uint count = 0;
+  SqliteDatabase::Query::ValuePtr bindings[BATCH_SIZE];
+  while (keys.size() > 0) {
+    fillBatch(keys, kj::arrayPtr(bindings, BATCH_SIZE));
+    auto query = stmtDeleteMulti.run(kj::arrayPtr(bindings, BATCH_SIZE).asConst());
+    count += query.changeCount();
+  }
+  return count;
+}
+
+kj::String SqliteKv::makeBatchSql(kj::StringPtr prefix, kj::StringPtr item, kj::StringPtr suffix) {
+  auto items = kj::heapArray<kj::StringPtr>(BATCH_SIZE);
+  for (auto& i: items) i = item;
+  return kj::str(prefix, kj::delimited(items, ", "), suffix);
+}
+
+void SqliteKv::fillBatch(kj::ArrayPtr<const KeyPtr>& keys,
+                         kj::ArrayPtr<SqliteDatabase::Query::ValuePtr> bindings) {
+  auto n = kj::min(keys.size(), bindings.size());
+  for (auto i: kj::indices(bindings)) {
+    if (i < n) {
+      bindings[i] = keys[i];
+    } else {
+      bindings[i] = nullptr;
+    }
+  }
+  keys = keys.slice(n, keys.size());
+}
+
 }  // namespace workerd
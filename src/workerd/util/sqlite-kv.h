@@ -48,10 +48,23 @@ public:
 
   uint deleteAll();
 
-  // TODO(perf): Should we provide multi-get, multi-put, and multi-delete? It's a bit tricky to
-  //   implement them as single SQL queries, while still using prepared statements. The c-array
-  //   extension might help here, though it can only support arrays of NUL-terminated strings, not
-  //   byte blobs or strings containing NUL bytes.
+  // Multi-key variants of the above. Keys are processed BATCH_SIZE at a time, with one query per
+  // batch, using prepared statements with BATCH_SIZE placeholders. (The carray extension can't
+  // be used here, since it only supports NUL-terminated strings.)
+  static constexpr uint BATCH_SIZE = 32;
+
+  // Search for matches for all the given keys, calling the callback (with KeyPtr and ValuePtr
+  // parameters) for each one found. Returns the number of matches. Each batch's matches are
+  // reported in key order, so if `keys` is sorted, all matches are reported in key order.
+  template <typename Func>
+  uint get(kj::ArrayPtr<const KeyPtr> keys, Func&& callback);
+
+  // Store each value into the table under the corresponding key. If a key appears more than once,
+  // the last value wins.
+  void put(kj::ArrayPtr<const KeyPtr> keys, kj::ArrayPtr<const ValuePtr> values);
+
+  // Delete the keys and return how many were matched.
+  uint delete_(kj::ArrayPtr<const KeyPtr> keys);
 
 private:
   SqliteDatabase& db;
@@ -114,6 +127,26 @@ private:
     DELETE FROM _cf_KV
   )");
 
+  // Multi-key statements take BATCH_SIZE keys. Unused key slots in stmtGetMulti and
+  // stmtDeleteMulti are bound to NULL, which matches nothing; stmtPutMulti is only used for full
+  // batches.
+  SqliteDatabase::Statement stmtGetMulti = db.prepare(SqliteDatabase::TRUSTED, makeBatchSql(
+      "SELECT key, value FROM _cf_KV WHERE key IN (", "?", ") ORDER BY key"));
+  SqliteDatabase::Statement stmtPutMulti = db.prepare(SqliteDatabase::TRUSTED, makeBatchSql(
+      "INSERT INTO _cf_KV VALUES ", "(?, ?)",
+      " ON CONFLICT DO UPDATE SET value = excluded.value"));
+  SqliteDatabase::Statement stmtDeleteMulti = db.prepare(SqliteDatabase::TRUSTED, makeBatchSql(
+      "DELETE FROM _cf_KV WHERE key IN (", "?", ")"));
+
+  // Returns `prefix`, then BATCH_SIZE comma-separated copies of `item`, then `suffix`. The result
+  // is built only from string literals, so it is as trusted as they are.
+  static kj::String makeBatchSql(kj::StringPtr prefix, kj::StringPtr item, kj::StringPtr suffix);
+
+  // Fills `bindings` with up to BATCH_SIZE keys from the front of `keys`, padding with NULLs, and
+  // removes them from `keys`.
+  static void fillBatch(kj::ArrayPtr<const KeyPtr>& keys,
+                        kj::ArrayPtr<SqliteDatabase::Query::ValuePtr> bindings);
+
   SqliteDatabase& ensureInitialized(SqliteDatabase& db);
   // Make sure the KV table is created, then return the same object.
 
@@ -139,6 +172,22 @@ bool SqliteKv::get(KeyPtr key, Func&& callback) {
   }
 }
 
+template <typename Func>
+uint SqliteKv::get(kj::ArrayPtr<const KeyPtr> keys, Func&& callback) {
+  uint count = 0;
+  SqliteDatabase::Query::ValuePtr bindings[BATCH_SIZE];
+  while (keys.size() > 0) {
+    fillBatch(keys, kj::arrayPtr(bindings, BATCH_SIZE));
+    auto query = stmtGetMulti.run(kj::arrayPtr(bindings, BATCH_SIZE).asConst());
+    while (!query.isDone()) {
+      callback(query.getText(0), query.getBlob(1));
+      query.nextRow();
+      ++count;
+    }
+  }
+  return count;
+}
+
 template <typename Func>
 uint SqliteKv::list(KeyPtr begin, kj::Maybe<KeyPtr> end, kj::Maybe<uint> limit, Order order,
                     Func&& callback) {
@@ -636,5 +636,88 @@ KJ_TEST("DELETE with LIMIT") {
   KJ_EXPECT(q.getInt(0) == 3);
 }
 
+KJ_TEST("SQLite WAL commit callback and manual checkpoints") {
+  auto dir = kj::newInMemoryDirectory(kj::nullClock());
+  SqliteDatabase::Vfs vfs(*dir);
+  SqliteDatabase db(vfs, kj::Path({"foo"}), kj::WriteMode::CREATE | kj::WriteMode::MODIFY);
+
+  uint walPages = 0;
+  uint commitCount = 0;
+  db.onWalCommit([&](uint pages) {
+    walPages = pages;
+    ++commitCount;
+  });
+
+  setupSql(db);
+  KJ_EXPECT(commitCount > 0);
+  KJ_EXPECT(walPages > 0);
+
+  // Automatic checkpoints are disabled, so the log keeps growing.
+  for (auto i: kj::zeroTo(100)) {
+    auto email = kj::str("someone", i, "@example.com");
+    db.run("INSERT INTO people (id, name, email) VALUES (?, ?, ?)",
+        i + 1000, "Someone"_kj, kj::StringPtr(email));
+  }
+  auto grownPages = walPages;
+  KJ_EXPECT(grownPages > 100, grownPages);
+
+  // Syncing doesn't change anything visible.
+  db.syncWal();
+  KJ_EXPECT(db.run("SELECT COUNT(*) FROM people").getInt(0) == 102);
+
+  // After a checkpoint, the next commit starts over at the beginning of the log.
+  db.checkpoint();
+  db.run("INSERT INTO people (id, name, email) VALUES (?, ?, ?)",
+      2000, "Eve"_kj, "eve@example.com"_kj);
+  KJ_EXPECT(walPages < grownPages / 10, walPages);
+  checkSql(db);
+}
+
+KJ_TEST("SQLite page cache options") {
+  auto dir = kj::newInMemoryDirectory(kj::nullClock());
+  SqliteDatabase::Vfs vfs(*dir, { .cacheSize = 4 << 20 });
+  SqliteDatabase db(vfs, kj::Path({"foo"}), kj::WriteMode::CREATE | kj::WriteMode::MODIFY);
+
+  // Negative values are in KiB.
+  KJ_EXPECT(db.run("PRAGMA cache_size").getInt64(0) == -4096);
+}
+
+KJ_TEST("SQLite page cache budget goes to the busiest database") {
+  static constexpr int64_t TOTAL_KIB = 16 << 10;
+  static constexpr int64_t MIN_KIB = SqliteDatabase::PageCacheBudget::MIN_SHARE / 1024;
+  SqliteDatabase::PageCacheBudget budget(TOTAL_KIB * 1024);
+
+  auto dir = kj::newInMemoryDirectory(kj::nullClock());
+  SqliteDatabase::Vfs vfs(*dir, { .pageCacheBudget = budget });
+  SqliteDatabase busy(vfs, kj::Path({"busy"}), kj::WriteMode::CREATE | kj::WriteMode::MODIFY);
+  SqliteDatabase idle(vfs, kj::Path({"idle"}), kj::WriteMode::CREATE | kj::WriteMode::MODIFY);
+
+  auto getCacheKib = [](SqliteDatabase& db) -> int64_t {
+    // A database applies its share before each query, but `PRAGMA cache_size` reports the value
+    // as of when it was prepared, so run some other query first.
+    db.run("SELECT 1");
+    return -db.run("PRAGMA cache_size").getInt64(0);
+  };
+
+  // With no queries yet, the budget is split evenly.
+  KJ_EXPECT(getCacheKib(busy) == TOTAL_KIB / 2);
+  KJ_EXPECT(getCacheKib(idle) == TOTAL_KIB / 2);
+
+  for (auto i KJ_UNUSED: kj::zeroTo(SqliteDatabase::PageCacheBudget::REBALANCE_INTERVAL * 4)) {
+    busy.run("SELECT 1");
+  }
+
+  // `busy` now holds nearly everything, while `idle` is down to (about) the minimum.
+  KJ_EXPECT(getCacheKib(busy) > TOTAL_KIB * 9 / 10, getCacheKib(busy));
+  KJ_EXPECT(getCacheKib(idle) < MIN_KIB * 2, getCacheKib(idle));
+
+  {
+    // A third database gets a share too, taken from the others.
+    SqliteDatabase other(vfs, kj::Path({"other"}),
+        kj::WriteMode::CREATE | kj::WriteMode::MODIFY);
+    KJ_EXPECT(getCacheKib(other) >= MIN_KIB);
+  }
+}
+
 }  // namespace
 }  // namespace workerd
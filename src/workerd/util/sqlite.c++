@@ -314,6 +314,17 @@ static constexpr PragmaInfo ALLOWED_PRAGMAS[] = {
 
 // =======================================================================================
 
+// Annoyingly, SQLite's heap limits are process-wide. We'll set 128MB "soft" limit (to try to
+// control how much page caching SQLite does) and 512MB "hard" limit (to block DoS attacks from
+// taking down the whole system). A PageCacheBudget may raise the soft limit to fit.
+static void initHeapLimits() {
+  static bool doOnce KJ_UNUSED = []() {
+    sqlite3_soft_heap_limit64(128u << 20);
+    sqlite3_hard_heap_limit64(512u << 20);
+    return false;
+  }();
+}
+
 SqliteDatabase::Regulator SqliteDatabase::TRUSTED;
 
 SqliteDatabase::SqliteDatabase(const Vfs& vfs, kj::PathPtr path) {
@@ -330,6 +341,7 @@ SqliteDatabase::SqliteDatabase(const Vfs& vfs, kj::PathPtr path) {
   KJ_ON_SCOPE_FAILURE(sqlite3_close_v2(db));
 
   setupSecurity();
+  initPageCache(vfs);
 }
 
 SqliteDatabase::SqliteDatabase(const Vfs& vfs, kj::PathPtr path, kj::WriteMode mode) {
@@ -358,6 +370,7 @@ SqliteDatabase::SqliteDatabase(const Vfs& vfs, kj::PathPtr path, kj::WriteMode m
   KJ_ON_SCOPE_FAILURE(sqlite3_close_v2(db));
 
   setupSecurity();
+  initPageCache(vfs);
 }
 
 SqliteDatabase::~SqliteDatabase() noexcept(false) {
@@ -372,12 +385,80 @@ SqliteDatabase::~SqliteDatabase() noexcept(false) {
   KJ_REQUIRE(err == SQLITE_OK, sqlite3_errstr(err)) { break; }
 }
 
+void SqliteDatabase::initPageCache(const Vfs& vfs) {
+  auto& options = vfs.options;
+
+  if (options.mmapSize > 0) {
+    run(TRUSTED, kj::str("PRAGMA mmap_size = ", options.mmapSize));
+  }
+
+  KJ_IF_SOME(budget, options.pageCacheBudget) {
+    // The share is applied by updatePageCacheSize() before the first query.
+    pageCacheShare = kj::heap<PageCacheShare>(budget,
+        options.cacheSize > 0 ? options.cacheSize : budget.getTotalBytes());
+  } else if (options.cacheSize > 0) {
+    setCacheSize(options.cacheSize);
+  }
+}
+
+void SqliteDatabase::setCacheSize(uint64_t bytes) {
+  // Update `appliedCacheSize` first, since running the pragma calls back into
+  // updatePageCacheSize().
+  appliedCacheSize = bytes;
+
+  // A negative cache_size is in KiB rather than pages.
+  run(TRUSTED, kj::str("PRAGMA cache_size = -", kj::max(bytes / 1024, uint64_t(1))));
+}
+
+void SqliteDatabase::updatePageCacheSize() {
+  KJ_IF_SOME(share, pageCacheShare) {
+    uint64_t bytes = share->noteQuery();
+    if (bytes != appliedCacheSize) {
+      setCacheSize(bytes);
+    }
+  }
+}
+
 void SqliteDatabase::notifyWrite() {
   KJ_IF_SOME(cb, onWriteCallback) {
     cb();
   }
 }
 
+void SqliteDatabase::onWalCommit(kj::Function<void(uint walPages)> callback) {
+  onWalCommitCallback = kj::mv(callback);
+
+  // Note that this replaces the hook SQLite uses to implement `PRAGMA wal_autocheckpoint`.
+  sqlite3_wal_hook(db, [](void* ctx, sqlite3*, const char*, int walPages) -> int {
+    auto& self = *reinterpret_cast<SqliteDatabase*>(ctx);
+    KJ_IF_SOME(cb, self.onWalCommitCallback) {
+      cb(walPages);
+    }
+    return SQLITE_OK;
+  }, this);
+}
+
+void SqliteDatabase::checkpoint() {
+  Regulator& regulator = TRUSTED;
+  SQLITE_CALL(sqlite3_wal_checkpoint_v2(
+      db, "main", SQLITE_CHECKPOINT_PASSIVE, nullptr, nullptr));
+}
+
+void SqliteDatabase::syncWal() {
+  Regulator& regulator = TRUSTED;
+
+  // In WAL mode, the pager's "journal" is the write-ahead log.
+  sqlite3_file* file = nullptr;
+  SQLITE_CALL(sqlite3_file_control(db, "main", SQLITE_FCNTL_JOURNAL_POINTER, &file));
+  if (file == nullptr || file->pMethods == nullptr) {
+    // No log is open, so there is nothing to sync.
+    return;
+  }
+
+  int err = file->pMethods->xSync(file, SQLITE_SYNC_NORMAL);
+  KJ_REQUIRE(err == SQLITE_OK, "failed to sync SQLite write-ahead log", sqlite3_errstr(err));
+}
+
 kj::StringPtr SqliteDatabase::getCurrentQueryForDebug() {
   KJ_IF_SOME(s, currentStatement) {
     return sqlite3_normalized_sql(&s);
@@ -753,17 +834,8 @@ void SqliteDatabase::setupSecurity() {
   // This happens inside LimitEnforcer.
 
   // 5. Limit heap size.
-  // Annoyingly, this sets a process-wide limit. We'll set 128MB "soft" limit (to try to control
-  // how much page caching SQLite does) and 512MB "hard" limit (to block DoS attacks from taking
-  // down the whole system).
-  // TODO(perf): Revisit as popularity grows. Maybe make configurable? Maybe patch SQLite to allow
-  //   these to be controlled per-database? Is page caching even all that important when the kernel
-  //   does its own page caching?
-  static bool doOnce KJ_UNUSED = []() {
-    sqlite3_soft_heap_limit64(128u << 20);
-    sqlite3_hard_heap_limit64(512u << 20);
-    return false;
-  }();
+  // (handled by initHeapLimits(); per-database page caching is controlled by VfsOptions)
+  initHeapLimits();
 
   // 6. Set SQLITE_MAX_ALLOCATION_SIZE compile flag.
   // (handled in BUILD.sqlite3)
@@ -819,6 +891,8 @@ void SqliteDatabase::Query::checkRequirements(size_t size) {
   SQLITE_REQUIRE(size == sqlite3_bind_parameter_count(statement),
       "Wrong number of parameter bindings for SQL query.");
 
+  db.updatePageCacheSize();
+
   KJ_IF_SOME(cb, db.onWriteCallback) {
     if (!sqlite3_stmt_readonly(statement)) {
       cb();
@@ -1890,4 +1964,68 @@ kj::Maybe<kj::Path> SqliteDatabase::Vfs::tryAppend(kj::PathPtr suffix) const {
 
 // =======================================================================================
 
+SqliteDatabase::PageCacheBudget::PageCacheBudget(uint64_t totalBytes)
+    : totalBytes(totalBytes) {
+  initHeapLimits();
+
+  // Passing a negative value queries the current limit.
+  int64_t wanted = static_cast<int64_t>(totalBytes);
+  int64_t hardLimit = sqlite3_hard_heap_limit64(-1);
+  if (hardLimit > 0) wanted = kj::min(wanted, hardLimit);
+  if (wanted > sqlite3_soft_heap_limit64(-1)) {
+    sqlite3_soft_heap_limit64(wanted);
+  }
+}
+
+void SqliteDatabase::PageCacheBudget::rebalance(
+    kj::List<PageCacheShare, &PageCacheShare::link>& list) const {
+  size_t count = list.size();
+  if (count == 0) return;
+
+  uint64_t totalHeat = 0;
+  for (auto& share: list) {
+    // Halving at each rebalance means a database which goes idle loses most of its share within
+    // a few rebalances.
+    share.heat = share.heat / 2 + share.queries.exchange(0, std::memory_order_relaxed);
+    totalHeat += share.heat;
+  }
+
+  // Everyone gets the minimum, and the rest is split in proportion to heat (or evenly, if
+  // nothing has run any queries yet).
+  uint64_t floor = kj::min(MIN_SHARE, totalBytes / count);
+  uint64_t spare = totalBytes - floor * count;
+  for (auto& share: list) {
+    double fraction = totalHeat == 0 ? 1.0 / count : static_cast<double>(share.heat) / totalHeat;
+    uint64_t bytes = floor + static_cast<uint64_t>(spare * fraction);
+    share.bytes.store(kj::min(bytes, share.maxBytes), std::memory_order_relaxed);
+  }
+}
+
+SqliteDatabase::PageCacheShare::PageCacheShare(const PageCacheBudget& budget, uint64_t maxBytes)
+    : budget(budget), maxBytes(maxBytes) {
+  auto lock = budget.shares.lockExclusive();
+  lock->add(*this);
+  budget.rebalance(*lock);
+}
+
+SqliteDatabase::PageCacheShare::~PageCacheShare() noexcept(false) {
+  auto lock = budget.shares.lockExclusive();
+  lock->remove(*this);
+  budget.rebalance(*lock);
+}
+
+uint64_t SqliteDatabase::PageCacheShare::noteQuery() {
+  queries.fetch_add(1, std::memory_order_relaxed);
+
+  if (budget.queriesSinceRebalance.fetch_add(1, std::memory_order_relaxed) + 1 >=
+      PageCacheBudget::REBALANCE_INTERVAL) {
+    // Concurrent callers may both get here, which just means an extra rebalance.
+    budget.queriesSinceRebalance.store(0, std::memory_order_relaxed);
+    auto lock = budget.shares.lockExclusive();
+    budget.rebalance(*lock);
+  }
+
+  return bytes.load(std::memory_order_relaxed);
+}
+
 }  // namespace workerd
@@ -5,7 +5,10 @@
 #pragma once
 
 #include <kj/filesystem.h>
+#include <kj/list.h>
+#include <kj/mutex.h>
 #include <kj/one-of.h>
+#include <atomic>
 #include <utility>
 
 struct sqlite3;
@@ -34,6 +37,7 @@ public:
   class Lock;
   class LockManager;
   class Regulator;
+  class PageCacheBudget;
   struct VfsOptions;
 
   SqliteDatabase(const Vfs& vfs, kj::PathPtr path);
@@ -85,6 +89,26 @@ public:
   // start before the SAVEPOINT.
   void notifyWrite();
 
+  // Invokes the given callback whenever a transaction is committed in WAL mode, with the number of
+  // pages now in the write-ahead log. The callback is called from within the commit and must not
+  // throw or run queries.
+  //
+  // Registering a callback disables SQLite's automatic checkpointing, which would otherwise run
+  // inline as part of whichever commit crosses the threshold. The caller is expected to call
+  // `checkpoint()` itself, e.g. once the log grows large and the database is otherwise idle.
+  void onWalCommit(kj::Function<void(uint walPages)> callback);
+
+  // Runs a passive checkpoint, copying as much of the write-ahead log as possible back into the
+  // database file without waiting on other connections. Must not be called while a transaction
+  // is open. Does nothing if the database is not in WAL mode.
+  void checkpoint();
+
+  // Syncs the write-ahead log to disk. Does nothing if the database is not in WAL mode.
+  //
+  // With `PRAGMA synchronous = NORMAL`, commits in WAL mode do not sync the log themselves. Calling
+  // this after several commits makes them all durable at once, at the cost of a single sync.
+  void syncWal();
+
   // Get the currently-executing SQL query for debug purposes. The query is normalized to hide
   // any literal values that might contain sensitive information. This is intended to be safe for
   // debug logs.
@@ -100,9 +124,26 @@ private:
   kj::Maybe<sqlite3_stmt&> currentStatement;
 
   kj::Maybe<kj::Function<void()>> onWriteCallback;
+  kj::Maybe<kj::Function<void(uint)>> onWalCommitCallback;
+
+  // Set if the Vfs has a page cache budget.
+  class PageCacheShare;
+  kj::Maybe<kj::Own<PageCacheShare>> pageCacheShare;
+
+  // Page cache size last set with `PRAGMA cache_size`, in bytes, or zero if never set.
+  uint64_t appliedCacheSize = 0;
 
   void close();
 
+  // Applies the page cache and mmap settings from `vfs`'s options. Called after opening.
+  void initPageCache(const Vfs& vfs);
+
+  void setCacheSize(uint64_t bytes);
+
+  // Called before each query. If the database shares a page cache budget, records the query and
+  // applies any change to its share.
+  void updatePageCacheSize();
+
   enum Multi { SINGLE, MULTI };
 
   // Helper to call sqlite3_prepare_v3().
@@ -348,6 +389,83 @@ struct SqliteDatabase::VfsOptions {
   // will fall back to the native VFS implementation. In that case, the options you set here will
   // be ORed with the ones set by the underlying VFS.
   int deviceCharacteristics = 0x00001000;  // = SQLITE_FCNTL_POWERSAFE_OVERWRITE
+
+  // Maximum size of each database's page cache, in bytes, applied with `PRAGMA cache_size`. Zero
+  // leaves SQLite's default (about 2 MiB). When `pageCacheBudget` is set, this instead caps the
+  // share of the budget given to any one database.
+  uint64_t cacheSize = 0;
+
+  // If non-zero, databases are read through a memory mapping of up to this many bytes
+  // (`PRAGMA mmap_size`), letting the kernel's page cache serve reads without copying pages into
+  // SQLite's. This only takes effect for real disk directories, which use SQLite's native VFS.
+  uint64_t mmapSize = 0;
+
+  // If set, the page caches of all databases opened through this Vfs share this budget. It must
+  // outlive the databases.
+  kj::Maybe<const PageCacheBudget&> pageCacheBudget;
+};
+
+// A database's share of a PageCacheBudget, registered with the budget while it exists.
+class SqliteDatabase::PageCacheShare {
+public:
+  // `maxBytes` caps the share.
+  PageCacheShare(const PageCacheBudget& budget, uint64_t maxBytes);
+  ~PageCacheShare() noexcept(false);
+  KJ_DISALLOW_COPY_AND_MOVE(PageCacheShare);
+
+  // Records a query, rebalancing the budget if it's time. Returns the current share, in bytes.
+  uint64_t noteQuery();
+
+private:
+  const PageCacheBudget& budget;
+  uint64_t maxBytes;
+
+  // Queries since the last rebalance.
+  std::atomic<uint64_t> queries = 0;
+
+  std::atomic<uint64_t> bytes = 0;
+
+  // Exponentially-decaying count of queries at past rebalances. Guarded by `budget.shares`.
+  uint64_t heat = 0;
+  kj::ListLink<PageCacheShare> link;
+
+  friend class SqliteDatabase::PageCacheBudget;
+};
+
+// A page cache budget, in bytes, shared by a set of databases (see VfsOptions::pageCacheBudget).
+//
+// Each database's page cache is resized from time to time so that the databases which have run
+// the most queries recently get the largest shares, while idle ones shrink to a small minimum.
+// Shares are recomputed every REBALANCE_INTERVAL queries (across all databases) and whenever a
+// database is opened or closed; each database applies its new share before its next query.
+//
+// SQLite only allocates cache pages as it needs them, so shares are limits, not reservations.
+//
+// Creating a budget raises SQLite's process-wide soft heap limit to fit it, if needed (but never
+// beyond the hard heap limit).
+//
+// A PageCacheBudget can be shared by databases used from different threads.
+class SqliteDatabase::PageCacheBudget {
+public:
+  explicit PageCacheBudget(uint64_t totalBytes);
+  KJ_DISALLOW_COPY_AND_MOVE(PageCacheBudget);
+
+  uint64_t getTotalBytes() const { return totalBytes; }
+
+  // Each database's share is at least this, unless the budget is too small to give every
+  // database this much, in which case it is split evenly.
+  static constexpr uint64_t MIN_SHARE = 256 * 1024;
+
+  static constexpr uint REBALANCE_INTERVAL = 1024;
+
+private:
+  uint64_t totalBytes;
+  mutable std::atomic<uint> queriesSinceRebalance = 0;
+  kj::MutexGuarded<kj::List<PageCacheShare, &PageCacheShare::link>> shares;
+
+  void rebalance(kj::List<PageCacheShare, &PageCacheShare::link>& list) const;
+
+  friend class SqliteDatabase::PageCacheShare;
 };
 
 // Implements a SQLite VFS based on a KJ directory.
@@ -0,0 +1,56 @@
+// Copyright (c) 2024 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "substring-search.h"
+#include <kj/string.h>
+#include <kj/test.h>
+
+namespace workerd::substring {
+namespace {
+
+kj::ArrayPtr<const uint8_t> bytes(kj::StringPtr str) {
+  return str.asBytes();
+}
+
+kj::Array<uint16_t> wide(kj::StringPtr str) {
+  // Put something in the high byte too, so that only whole characters can match.
+  return KJ_MAP(c, str) -> uint16_t { return 0x100 | c; };
+}
+
+KJ_TEST("substring search") {
+  // Long enough for matches to be found both in whole vector blocks and in the tail.
+  auto haystack = "----------boundary--------------------------------------boundary---"_kj;
+
+  KJ_EXPECT(findFirst(bytes(haystack), bytes("boundary")) == 10);
+  KJ_EXPECT(findLast(bytes(haystack), bytes("boundary")) == 56);
+  KJ_EXPECT(findFirst(bytes(haystack), bytes("-b")) == 9);
+  KJ_EXPECT(findLast(bytes(haystack), bytes("y-")) == 63);
+  KJ_EXPECT(findFirst(bytes(haystack), bytes("b")) == 10);
+  KJ_EXPECT(findLast(bytes(haystack), bytes("b")) == 56);
+
+  KJ_EXPECT(findFirst(wide(haystack), wide("boundary")) == 10);
+  KJ_EXPECT(findLast(wide(haystack), wide("boundary")) == 56);
+  KJ_EXPECT(findFirst(wide(haystack), wide("y")) == 17);
+  KJ_EXPECT(findLast(wide(haystack), wide("y")) == 63);
+}
+
+KJ_TEST("substring search without a match") {
+  auto haystack = "----------boundary--------------------------------------boundary---"_kj;
+
+  // The first and last characters match in places, but the middle never does.
+  KJ_EXPECT(findFirst(bytes(haystack), bytes("b-y")) == haystack.size());
+  KJ_EXPECT(findLast(bytes(haystack), bytes("b-y")) == haystack.size());
+  KJ_EXPECT(findFirst(bytes(haystack), bytes("boundary!")) == haystack.size());
+  KJ_EXPECT(findLast(wide(haystack), wide("--b--")) == haystack.size());
+
+  // Same characters in the low byte, different ones in the high byte.
+  KJ_EXPECT(findFirst(wide(haystack), kj::heapArray<uint16_t>({ 'b', 'o' })) == haystack.size());
+
+  // Needles longer than the haystack.
+  KJ_EXPECT(findFirst(bytes("abc"), bytes("abcd")) == 3);
+  KJ_EXPECT(findLast(bytes("abc"), bytes("abcd")) == 3);
+}
+
+}  // namespace
+}  // namespace workerd::substring
@@ -0,0 +1,180 @@
+// Copyright (c) 2024 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "substring-search.h"
+#include <kj/debug.h>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace workerd::substring {
+namespace {
+
+// ---------------------------------------------------------------------------------------
+// Block primitives
+//
+// Filter<Char>::candidates(first, last, a, b) returns a mask with one bit set for each of the
+// LANES positions i where first[i] == a and last[i] == b. The bit for position i is bit
+// (i << LANE_SHIFT).
+
+template <typename Char>
+struct Filter {
+  static constexpr ptrdiff_t LANES = 0;
+  static constexpr uint LANE_SHIFT = 0;
+  static uint64_t candidates(const Char* first, const Char* last, Char a, Char b) {
+    KJ_UNREACHABLE;
+  }
+};
+
+#if defined(__SSE2__)
+
+inline __m128i load(const void* p) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+
+template <>
+struct Filter<uint8_t> {
+  static constexpr ptrdiff_t LANES = 16;
+  static constexpr uint LANE_SHIFT = 0;
+  static uint64_t candidates(const uint8_t* first, const uint8_t* last, uint8_t a, uint8_t b) {
+    auto matches = _mm_and_si128(_mm_cmpeq_epi8(load(first), _mm_set1_epi8(a)),
+                                 _mm_cmpeq_epi8(load(last), _mm_set1_epi8(b)));
+    return _mm_movemask_epi8(matches);
+  }
+};
+
+template <>
+struct Filter<uint16_t> {
+  static constexpr ptrdiff_t LANES = 8;
+  static constexpr uint LANE_SHIFT = 1;
+  static uint64_t candidates(const uint16_t* first, const uint16_t* last, uint16_t a, uint16_t b) {
+    auto matches = _mm_and_si128(_mm_cmpeq_epi16(load(first), _mm_set1_epi16(a)),
+                                 _mm_cmpeq_epi16(load(last), _mm_set1_epi16(b)));
+    // Each matching lane sets both of its bits; keep just the low one.
+    return _mm_movemask_epi8(matches) & 0x5555;
+  }
+};
+
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+
+template <>
+struct Filter<uint8_t> {
+  static constexpr ptrdiff_t LANES = 16;
+  static constexpr uint LANE_SHIFT = 2;
+  static uint64_t candidates(const uint8_t* first, const uint8_t* last, uint8_t a, uint8_t b) {
+    auto matches = vandq_u8(vceqq_u8(vld1q_u8(first), vdupq_n_u8(a)),
+                            vceqq_u8(vld1q_u8(last), vdupq_n_u8(b)));
+    // NEON has no movemask; narrowing with a shift packs each lane into a nibble instead.
+    auto nibbles = vshrn_n_u16(vreinterpretq_u16_u8(matches), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(nibbles), 0) & 0x1111111111111111;
+  }
+};
+
+template <>
+struct Filter<uint16_t> {
+  static constexpr ptrdiff_t LANES = 8;
+  static constexpr uint LANE_SHIFT = 3;
+  static uint64_t candidates(const uint16_t* first, const uint16_t* last, uint16_t a, uint16_t b) {
+    auto matches = vandq_u16(vceqq_u16(vld1q_u16(first), vdupq_n_u16(a)),
+                             vceqq_u16(vld1q_u16(last), vdupq_n_u16(b)));
+    auto bytes = vmovn_u16(matches);
+    return vget_lane_u64(vreinterpret_u64_u8(bytes), 0) & 0x0101010101010101;
+  }
+};
+
+#endif
+
+// Checks whether the needle occurs at `p`, given that its first and last characters do.
+template <typename Char>
+inline bool matchesAt(const Char* p, kj::ArrayPtr<const Char> needle) {
+  return needle.size() <= 2 ||
+      memcmp(p + 1, needle.begin() + 1, (needle.size() - 2) * sizeof(Char)) == 0;
+}
+
+template <typename Char>
+size_t findFirstImpl(kj::ArrayPtr<const Char> haystack, kj::ArrayPtr<const Char> needle) {
+  KJ_DASSERT(needle.size() > 0);
+  if (needle.size() > haystack.size()) return haystack.size();
+
+  using F = Filter<Char>;
+  auto h = haystack.begin();
+  auto a = needle.front();
+  auto b = needle.back();
+  auto offset = needle.size() - 1;
+  // One past the last position the needle could start at.
+  ptrdiff_t end = haystack.size() - offset;
+  ptrdiff_t pos = 0;
+
+  if constexpr (F::LANES > 0) {
+    for (; end - pos >= F::LANES; pos += F::LANES) {
+      auto mask = F::candidates(h + pos, h + pos + offset, a, b);
+      while (mask != 0) {
+        auto candidate = pos + (__builtin_ctzll(mask) >> F::LANE_SHIFT);
+        if (matchesAt(h + candidate, needle)) return candidate;
+        mask &= mask - 1;
+      }
+    }
+  }
+
+  for (; pos < end; pos++) {
+    if (h[pos] == a && h[pos + offset] == b && matchesAt(h + pos, needle)) return pos;
+  }
+  return haystack.size();
+}
+
+template <typename Char>
+size_t findLastImpl(kj::ArrayPtr<const Char> haystack, kj::ArrayPtr<const Char> needle) {
+  KJ_DASSERT(needle.size() > 0);
+  if (needle.size() > haystack.size()) return haystack.size();
+
+  using F = Filter<Char>;
+  auto h = haystack.begin();
+  auto a = needle.front();
+  auto b = needle.back();
+  auto offset = needle.size() - 1;
+  // One past the last position the needle could start at; blocks are taken from here downwards.
+  ptrdiff_t pos = haystack.size() - offset;
+
+  if constexpr (F::LANES > 0) {
+    for (; pos >= F::LANES; pos -= F::LANES) {
+      auto block = pos - F::LANES;
+      auto mask = F::candidates(h + block, h + block + offset, a, b);
+      while (mask != 0) {
+        auto bit = 63 - __builtin_clzll(mask);
+        auto candidate = block + (bit >> F::LANE_SHIFT);
+        if (matchesAt(h + candidate, needle)) return candidate;
+        mask &= ~(uint64_t(1) << bit);
+      }
+    }
+  }
+
+  while (pos-- > 0) {
+    if (h[pos] == a && h[pos + offset] == b && matchesAt(h + pos, needle)) return pos;
+  }
+  return haystack.size();
+}
+
+}  // namespace
+
+size_t findFirst(kj::ArrayPtr<const uint8_t> haystack, kj::ArrayPtr<const uint8_t> needle) {
+  return findFirstImpl(haystack, needle);
+}
+
+size_t findFirst(kj::ArrayPtr<const uint16_t> haystack, kj::ArrayPtr<const uint16_t> needle) {
+  return findFirstImpl(haystack, needle);
+}
+
+size_t findLast(kj::ArrayPtr<const uint8_t> haystack, kj::ArrayPtr<const uint8_t> needle) {
+  return findLastImpl(haystack, needle);
+}
+
+size_t findLast(kj::ArrayPtr<const uint16_t> haystack, kj::ArrayPtr<const uint16_t> needle) {
+  return findLastImpl(haystack, needle);
+}
+
+}  // namespace workerd::substring
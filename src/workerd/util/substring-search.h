@@ -0,0 +1,28 @@
+// Copyright (c) 2024 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#pragma once
+
+#include <kj/array.h>
+
+// Substring search over one-byte and two-byte strings.
+//
+// Candidate positions are found a vector at a time (SSE2 or NEON, whichever the target has as a
+// baseline) by comparing the first and last characters of the needle against the haystack at
+// once, and only then checked in full with memcmp(). This does very little work per haystack
+// character regardless of its contents, which makes it a good fit for short needles. Long needles
+// are better served by Boyer-Moore style skipping, which gets faster as the needle grows.
+namespace workerd::substring {
+
+// Returns the position of the first occurrence of `needle`, which must not be empty, in
+// `haystack`, or `haystack.size()` if there is none.
+size_t findFirst(kj::ArrayPtr<const uint8_t> haystack, kj::ArrayPtr<const uint8_t> needle);
+size_t findFirst(kj::ArrayPtr<const uint16_t> haystack, kj::ArrayPtr<const uint16_t> needle);
+
+// Returns the position of the last occurrence of `needle`, which must not be empty, in
+// `haystack`, or `haystack.size()` if there is none.
+size_t findLast(kj::ArrayPtr<const uint8_t> haystack, kj::ArrayPtr<const uint8_t> needle);
+size_t findLast(kj::ArrayPtr<const uint16_t> haystack, kj::ArrayPtr<const uint16_t> needle);
+
+}  // namespace workerd::substring
@@ -0,0 +1,143 @@
+// Copyright (c) 2024 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "utf8.h"
+#include <kj/test.h>
+#include <kj/string.h>
+
+namespace workerd::utf8 {
+namespace {
+
+kj::Array<char16_t> decode(kj::StringPtr input, DecodeInfo& info) {
+  auto bytes = input.asBytes();
+  info = scan(bytes);
+  auto result = kj::heapArray<char16_t>(info.utf16Length);
+  decodeToUtf16(bytes, result);
+
+  if (info.isLatin1) {
+    auto latin1 = kj::heapArray<kj::byte>(info.utf16Length);
+    decodeToLatin1(bytes, latin1);
+    for (auto i: kj::indices(latin1)) {
+      KJ_EXPECT(latin1[i] == result[i]);
+    }
+  }
+
+  return result;
+}
+
+template <typename T>
+bool equal(kj::ArrayPtr<const T> a, kj::ArrayPtr<const T> b) {
+  return a.size() == b.size() && memcmp(a.begin(), b.begin(), a.size() * sizeof(T)) == 0;
+}
+
+bool decodesTo(kj::StringPtr input, kj::ArrayPtr<const char16_t> expected) {
+  DecodeInfo info;
+  return equal<char16_t>(decode(input, info), expected);
+}
+
+kj::ArrayPtr<const char16_t> u(const char16_t* str) {
+  size_t length = 0;
+  while (str[length] != 0) ++length;
+  return kj::arrayPtr(str, length);
+}
+
+KJ_TEST("UTF-8 ASCII prefix") {
+  KJ_EXPECT(asciiPrefixLength(""_kj.asBytes()) == 0);
+  KJ_EXPECT(isAscii("a string which is longer than a single block"_kj.asBytes()));
+  KJ_EXPECT(asciiPrefixLength("a string which is longer than \xc3\xa9 single block"_kj.asBytes())
+      == 30);
+  KJ_EXPECT(asciiPrefixLength("\xc3\xa9"_kj.asBytes()) == 0);
+}
+
+KJ_TEST("UTF-8 decoding") {
+  DecodeInfo info;
+
+  auto ascii = "a string which is longer than a single block"_kj;
+  KJ_EXPECT(decode(ascii, info).size() == ascii.size());
+  KJ_EXPECT(info.isValid);
+  KJ_EXPECT(info.isLatin1);
+
+  KJ_EXPECT(equal<char16_t>(
+      decode("caf\xc3\xa9, with enough text to fill a block, caf\xc3\xa9", info),
+      u(u"café, with enough text to fill a block, café")));
+  KJ_EXPECT(info.isValid);
+  KJ_EXPECT(info.isLatin1);
+
+  KJ_EXPECT(equal<char16_t>(decode("\xe2\x82\xac and \xf0\x9f\x98\x80", info), u(u"€ and 😀")));
+  KJ_EXPECT(info.isValid);
+  KJ_EXPECT(!info.isLatin1);
+  KJ_EXPECT(info.utf16Length == 8);
+}
+
+KJ_TEST("UTF-8 decoding replaces maximal subparts of ill-formed sequences") {
+  DecodeInfo info;
+  KJ_EXPECT(equal<char16_t>(decode("a\xff" "b", info), u(u"a�b")));
+  KJ_EXPECT(!info.isValid);
+  KJ_EXPECT(!info.isLatin1);
+
+  // Overlong encodings, surrogates and out-of-range code points.
+  KJ_EXPECT(decodesTo("\xc0\x80", u(u"��")));
+  KJ_EXPECT(decodesTo("\xe0\x80\x80", u(u"���")));
+  KJ_EXPECT(decodesTo("\xed\xa0\x80", u(u"���")));
+  KJ_EXPECT(decodesTo("\xf4\x90\x80\x80", u(u"����")));
+
+  // A truncated sequence is replaced as a whole, and the byte which interrupted it is kept.
+  KJ_EXPECT(decodesTo("\xf0\x9f\x98" "a", u(u"�" "a")));
+  KJ_EXPECT(decodesTo("\xf0\x9f\x98", u(u"�")));
+}
+
+KJ_TEST("UTF-8 incomplete suffix") {
+  KJ_EXPECT(incompleteSuffixLength(""_kj.asBytes()) == 0);
+  KJ_EXPECT(incompleteSuffixLength("abc"_kj.asBytes()) == 0);
+  KJ_EXPECT(incompleteSuffixLength("a\xe2"_kj.asBytes()) == 1);
+  KJ_EXPECT(incompleteSuffixLength("a\xe2\x82"_kj.asBytes()) == 2);
+  KJ_EXPECT(incompleteSuffixLength("\xf0\x9f\x98"_kj.asBytes()) == 3);
+  KJ_EXPECT(incompleteSuffixLength("\xf0\x9f\x98\x80"_kj.asBytes()) == 0);
+
+  // Sequences which are already invalid can't be completed.
+  KJ_EXPECT(incompleteSuffixLength("\xe0\x80"_kj.asBytes()) == 0);
+  KJ_EXPECT(incompleteSuffixLength("\x80\x80\x80"_kj.asBytes()) == 0);
+}
+
+KJ_TEST("UTF-8 encoding") {
+  auto check = [](kj::ArrayPtr<const char16_t> input, kj::StringPtr expected) {
+    KJ_EXPECT(encodedLength(input) == expected.size());
+    auto out = kj::heapArray<kj::byte>(expected.size());
+    auto result = encode(input, out);
+    KJ_EXPECT(result.read == input.size());
+    KJ_EXPECT(result.written == expected.size());
+    KJ_EXPECT(equal<kj::byte>(out, expected.asBytes()));
+  };
+
+  check(u(u"a string which is longer than a single block"),
+        "a string which is longer than a single block");
+  check(u(u"café, € and 😀, with enough text to fill a block"),
+        "caf\xc3\xa9, \xe2\x82\xac and \xf0\x9f\x98\x80, with enough text to fill a block");
+
+  // Unpaired surrogates.
+  const char16_t lone[] = { 'a', 0xd800, 'b', 0xdc00 };
+  check(kj::arrayPtr(lone, 4), "a\xef\xbf\xbd" "b\xef\xbf\xbd");
+
+  const kj::byte latin1[] = { 'c', 'a', 'f', 0xe9 };
+  KJ_EXPECT(encodedLength(kj::arrayPtr(latin1, 4)) == 5);
+  kj::byte out[5];
+  auto result = encode(kj::arrayPtr(latin1, 4), kj::arrayPtr(out, 5));
+  KJ_EXPECT(result.read == 4);
+  KJ_EXPECT(result.written == 5);
+  KJ_EXPECT(equal<kj::byte>(kj::arrayPtr(out, 5), "caf\xc3\xa9"_kj.asBytes()));
+}
+
+KJ_TEST("UTF-8 encoding into a short buffer does not split characters") {
+  kj::byte out[6];
+  auto result = encode(u(u"ab€€"), kj::arrayPtr(out, 6));
+  KJ_EXPECT(result.read == 3);
+  KJ_EXPECT(result.written == 5);
+
+  result = encode(u(u"a😀"), kj::arrayPtr(out, 4));
+  KJ_EXPECT(result.read == 1);
+  KJ_EXPECT(result.written == 1);
+}
+
+}  // namespace
+}  // namespace workerd::utf8
@@ -0,0 +1,424 @@
+// Copyright (c) 2024 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "utf8.h"
+#include <kj/debug.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace workerd::utf8 {
+namespace {
+
+// ---------------------------------------------------------------------------------------
+// Block primitives
+//
+// Each of these operates on 16 characters at a time. SSE2 and NEON are part of the baseline
+// x86-64 and AArch64 instruction sets respectively, so no runtime dispatch is needed; other
+// targets get a portable version.
+
+constexpr ptrdiff_t BLOCK_SIZE = 16;
+
+// Returns true if the 16 bytes at `p` are all ASCII.
+inline bool isAsciiBlock(const kj::byte* p) {
+#if defined(__SSE2__)
+  return _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))) == 0;
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  return vmaxvq_u8(vld1q_u8(p)) < 0x80;
+#else
+  uint64_t a, b;
+  memcpy(&a, p, sizeof(a));
+  memcpy(&b, p + sizeof(a), sizeof(b));
+  return ((a | b) & 0x8080808080808080ull) == 0;
+#endif
+}
+
+// Returns true if the 16 UTF-16 code units at `p` are all ASCII.
+inline bool isAsciiBlock(const char16_t* p) {
+#if defined(__SSE2__)
+  auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+  auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 8));
+  auto high = _mm_and_si128(_mm_or_si128(a, b), _mm_set1_epi16(static_cast<short>(0xff80)));
+  return _mm_movemask_epi8(_mm_cmpeq_epi16(high, _mm_setzero_si128())) == 0xffff;
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  auto units = reinterpret_cast<const uint16_t*>(p);
+  return vmaxvq_u16(vorrq_u16(vld1q_u16(units), vld1q_u16(units + 8))) < 0x80;
+#else
+  char16_t bits = 0;
+  for (ptrdiff_t i = 0; i < BLOCK_SIZE; i++) bits |= p[i];
+  return bits < 0x80;
+#endif
+}
+
+// Returns the number of non-ASCII bytes among the 16 at `p`.
+inline uint countNonAscii(const kj::byte* p) {
+#if defined(__SSE2__)
+  auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+  return __builtin_popcount(_mm_movemask_epi8(bytes));
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  return vaddvq_u8(vshrq_n_u8(vld1q_u8(p), 7));
+#else
+  uint count = 0;
+  for (ptrdiff_t i = 0; i < BLOCK_SIZE; i++) count += p[i] >> 7;
+  return count;
+#endif
+}
+
+// Zero-extends the 16 bytes at `in` to 16 UTF-16 code units at `out`.
+inline void widenBlock(const kj::byte* in, char16_t* out) {
+#if defined(__SSE2__)
+  auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+  auto zero = _mm_setzero_si128();
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_unpacklo_epi8(bytes, zero));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 8), _mm_unpackhi_epi8(bytes, zero));
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  auto bytes = vld1q_u8(in);
+  vst1q_u16(reinterpret_cast<uint16_t*>(out), vmovl_u8(vget_low_u8(bytes)));
+  vst1q_u16(reinterpret_cast<uint16_t*>(out + 8), vmovl_high_u8(bytes));
+#else
+  for (ptrdiff_t i = 0; i < BLOCK_SIZE; i++) out[i] = in[i];
+#endif
+}
+
+// Narrows the 16 UTF-16 code units at `in`, which must all be ASCII, to 16 bytes at `out`.
+inline void narrowBlock(const char16_t* in, kj::byte* out) {
+#if defined(__SSE2__)
+  auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+  auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 8));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(a, b));
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  auto units = reinterpret_cast<const uint16_t*>(in);
+  vst1q_u8(out, vcombine_u8(vmovn_u16(vld1q_u16(units)), vmovn_u16(vld1q_u16(units + 8))));
+#else
+  for (ptrdiff_t i = 0; i < BLOCK_SIZE; i++) out[i] = in[i];
+#endif
+}
+
+// ---------------------------------------------------------------------------------------
+// Scalar helpers
+
+constexpr char32_t REPLACEMENT_CHARACTER = 0xfffd;
+
+// Returned by decodeOne() for an ill-formed sequence. Not a valid code point.
+constexpr char32_t INVALID = 0x110000;
+
+// Decodes the non-ASCII sequence starting at `pos`, which must be before `end`, and advances `pos`
+// past it. An ill-formed sequence consumes only its maximal subpart and decodes to INVALID, as
+// specified in https://encoding.spec.whatwg.org/#utf-8-decoder. If the input ends in the middle
+// of a sequence which is valid so far, `truncated` is set as well.
+char32_t decodeOne(const kj::byte*& pos, const kj::byte* end, bool& truncated) {
+  kj::byte lead = *pos++;
+  uint needed;
+  kj::byte lower = 0x80;
+  kj::byte upper = 0xbf;
+  char32_t codePoint;
+
+  if (lead >= 0xc2 && lead <= 0xdf) {
+    needed = 1;
+    codePoint = lead & 0x1f;
+  } else if (lead >= 0xe0 && lead <= 0xef) {
+    // Exclude overlong encodings and surrogates.
+    if (lead == 0xe0) lower = 0xa0;
+    if (lead == 0xed) upper = 0x9f;
+    needed = 2;
+    codePoint = lead & 0x0f;
+  } else if (lead >= 0xf0 && lead <= 0xf4) {
+    // Exclude overlong encodings and code points above U+10FFFF.
+    if (lead == 0xf0) lower = 0x90;
+    if (lead == 0xf4) upper = 0x8f;
+    needed = 3;
+    codePoint = lead & 0x07;
+  } else {
+    return INVALID;
+  }
+
+  for (uint i = 0; i < needed; i++) {
+    if (pos == end) {
+      truncated = true;
+      return INVALID;
+    }
+    kj::byte b = *pos;
+    if (b < lower || b > upper) {
+      // Leave `b` to be decoded as the start of the next sequence.
+      return INVALID;
+    }
+    lower = 0x80;
+    upper = 0xbf;
+    codePoint = (codePoint << 6) | (b & 0x3f);
+    ++pos;
+  }
+
+  return codePoint;
+}
+
+inline bool isLeadSurrogate(char16_t c) { return (c & 0xfc00) == 0xd800; }
+inline bool isTrailSurrogate(char16_t c) { return (c & 0xfc00) == 0xdc00; }
+
+}  // namespace
+
+size_t asciiPrefixLength(kj::ArrayPtr<const kj::byte> bytes) {
+  auto pos = bytes.begin();
+  auto end = bytes.end();
+  while (end - pos >= BLOCK_SIZE && isAsciiBlock(pos)) pos += BLOCK_SIZE;
+  while (pos < end && *pos < 0x80) ++pos;
+  return pos - bytes.begin();
+}
+
+size_t incompleteSuffixLength(kj::ArrayPtr<const kj::byte> bytes) {
+  // Find the start of the last sequence. An incomplete one is at most three bytes long.
+  for (size_t length = 1; length <= 3 && length <= bytes.size(); length++) {
+    auto start = bytes.end() - length;
+    if ((*start & 0xc0) == 0x80) continue;  // Continuation byte.
+    if (*start < 0x80) return 0;
+
+    bool truncated = false;
+    decodeOne(start, bytes.end(), truncated);
+    return truncated ? length : 0;
+  }
+  return 0;
+}
+
+DecodeInfo scan(kj::ArrayPtr<const kj::byte> bytes) {
+  DecodeInfo info { .utf16Length = 0, .isLatin1 = true, .isValid = true };
+
+  auto pos = bytes.begin();
+  auto end = bytes.end();
+  while (pos < end) {
+    if (end - pos >= BLOCK_SIZE && isAsciiBlock(pos)) {
+      pos += BLOCK_SIZE;
+      info.utf16Length += BLOCK_SIZE;
+      continue;
+    }
+
+    // Go through the next block's worth of input one character at a time before trying to skip
+    // ahead again.
+    auto stop = pos + kj::min(BLOCK_SIZE, end - pos);
+    while (pos < stop) {
+      if (*pos < 0x80) {
+        ++pos;
+        ++info.utf16Length;
+        continue;
+      }
+
+      bool truncated = false;
+      char32_t c = decodeOne(pos, end, truncated);
+      if (c == INVALID) {
+        info.isValid = false;
+        info.isLatin1 = false;
+        ++info.utf16Length;
+      } else {
+        if (c > 0xff) info.isLatin1 = false;
+        info.utf16Length += c >= 0x10000 ? 2 : 1;
+      }
+    }
+  }
+
+  return info;
+}
+
+void decodeToLatin1(kj::ArrayPtr<const kj::byte> bytes, kj::ArrayPtr<kj::byte> out) {
+  auto pos = bytes.begin();
+  auto end = bytes.end();
+  auto dest = out.begin();
+  while (pos < end) {
+    if (end - pos >= BLOCK_SIZE && isAsciiBlock(pos)) {
+      memcpy(dest, pos, BLOCK_SIZE);
+      pos += BLOCK_SIZE;
+      dest += BLOCK_SIZE;
+      continue;
+    }
+
+    auto stop = pos + kj::min(BLOCK_SIZE, end - pos);
+    while (pos < stop) {
+      if (*pos < 0x80) {
+        *dest++ = *pos++;
+        continue;
+      }
+
+      bool truncated = false;
+      char32_t c = decodeOne(pos, end, truncated);
+      KJ_DASSERT(c <= 0xff, "input is not Latin-1");
+      *dest++ = c;
+    }
+  }
+  KJ_DASSERT(dest == out.end());
+}
+
+void decodeToUtf16(kj::ArrayPtr<const kj::byte> bytes, kj::ArrayPtr<char16_t> out) {
+  auto pos = bytes.begin();
+  auto end = bytes.end();
+  auto dest = out.begin();
+  while (pos < end) {
+    if (end - pos >= BLOCK_SIZE && isAsciiBlock(pos)) {
+      widenBlock(pos, dest);
+      pos += BLOCK_SIZE;
+      dest += BLOCK_SIZE;
+      continue;
+    }
+
+    auto stop = pos + kj::min(BLOCK_SIZE, end - pos);
+    while (pos < stop) {
+      if (*pos < 0x80) {
+        *dest++ = *pos++;
+        continue;
+      }
+
+      bool truncated = false;
+      char32_t c = decodeOne(pos, end, truncated);
+      if (c == INVALID) {
+        *dest++ = REPLACEMENT_CHARACTER;
+      } else if (c >= 0x10000) {
+        c -= 0x10000;
+        *dest++ = 0xd800 | (c >> 10);
+        *dest++ = 0xdc00 | (c & 0x3ff);
+      } else {
+        *dest++ = c;
+      }
+    }
+  }
+  KJ_DASSERT(dest == out.end());
+}
+
+size_t encodedLength(kj::ArrayPtr<const kj::byte> latin1) {
+  auto pos = latin1.begin();
+  auto end = latin1.end();
+  size_t length = 0;
+  for (; end - pos >= BLOCK_SIZE; pos += BLOCK_SIZE) {
+    length += BLOCK_SIZE + countNonAscii(pos);
+  }
+  for (; pos < end; ++pos) {
+    length += *pos < 0x80 ? 1 : 2;
+  }
+  return length;
+}
+
+size_t encodedLength(kj::ArrayPtr<const char16_t> utf16) {
+  auto pos = utf16.begin();
+  auto end = utf16.end();
+  size_t length = 0;
+  while (pos < end) {
+    if (end - pos >= BLOCK_SIZE && isAsciiBlock(pos)) {
+      pos += BLOCK_SIZE;
+      length += BLOCK_SIZE;
+      continue;
+    }
+
+    auto stop = pos + kj::min(BLOCK_SIZE, end - pos);
+    while (pos < stop) {
+      char16_t c = *pos++;
+      if (c < 0x80) {
+        length += 1;
+      } else if (c < 0x800) {
+        length += 2;
+      } else if (isLeadSurrogate(c) && pos < end && isTrailSurrogate(*pos)) {
+        ++pos;
+        length += 4;
+      } else {
+        // Includes unpaired surrogates, which are encoded as U+FFFD.
+        length += 3;
+      }
+    }
+  }
+  return length;
+}
+
+EncodeResult encode(kj::ArrayPtr<const kj::byte> latin1, kj::ArrayPtr<kj::byte> out) {
+  auto pos = latin1.begin();
+  auto end = latin1.end();
+  auto dest = out.begin();
+  auto destEnd = out.end();
+  auto result = [&]() {
+    return EncodeResult {
+      .read = static_cast<size_t>(pos - latin1.begin()),
+      .written = static_cast<size_t>(dest - out.begin()),
+    };
+  };
+
+  while (pos < end) {
+    if (end - pos >= BLOCK_SIZE && destEnd - dest >= BLOCK_SIZE && isAsciiBlock(pos)) {
+      memcpy(dest, pos, BLOCK_SIZE);
+      pos += BLOCK_SIZE;
+      dest += BLOCK_SIZE;
+      continue;
+    }
+
+    auto stop = pos + kj::min(BLOCK_SIZE, end - pos);
+    for (; pos < stop; ++pos) {
+      kj::byte c = *pos;
+      if (c < 0x80) {
+        if (dest == destEnd) return result();
+        *dest++ = c;
+      } else {
+        if (destEnd - dest < 2) return result();
+        *dest++ = 0xc0 | (c >> 6);
+        *dest++ = 0x80 | (c & 0x3f);
+      }
+    }
+  }
+
+  return result();
+}
+
+EncodeResult encode(kj::ArrayPtr<const char16_t> utf16, kj::ArrayPtr<kj::byte> out) {
+  auto pos = utf16.begin();
+  auto end = utf16.end();
+  auto dest = out.begin();
+  auto destEnd = out.end();
+  auto result = [&]() {
+    return EncodeResult {
+      .read = static_cast<size_t>(pos - utf16.begin()),
+      .written = static_cast<size_t>(dest - out.begin()),
+    };
+  };
+
+  while (pos < end) {
+    if (end - pos >= BLOCK_SIZE && destEnd - dest >= BLOCK_SIZE && isAsciiBlock(pos)) {
+      narrowBlock(pos, dest);
+      pos += BLOCK_SIZE;
+      dest += BLOCK_SIZE;
+      continue;
+    }
+
+    auto stop = pos + kj::min(BLOCK_SIZE, end - pos);
+    while (pos < stop) {
+      char32_t c = *pos;
+      size_t consumed = 1;
+      if (isLeadSurrogate(c) && pos + 1 < end && isTrailSurrogate(pos[1])) {
+        c = 0x10000 + ((c - 0xd800) << 10) + (pos[1] - 0xdc00);
+        consumed = 2;
+      } else if ((c & 0xf800) == 0xd800) {
+        c = REPLACEMENT_CHARACTER;
+      }
+
+      if (c < 0x80) {
+        if (dest == destEnd) return result();
+        *dest++ = c;
+      } else if (c < 0x800) {
+        if (destEnd - dest < 2) return result();
+        *dest++ = 0xc0 | (c >> 6);
+        *dest++ = 0x80 | (c & 0x3f);
+      } else if (c < 0x10000) {
+        if (destEnd - dest < 3) return result();
+        *dest++ = 0xe0 | (c >> 12);
+        *dest++ = 0x80 | ((c >> 6) & 0x3f);
+        *dest++ = 0x80 | (c & 0x3f);
+      } else {
+        if (destEnd - dest < 4) return result();
+        *dest++ = 0xf0 | (c >> 18);
+        *dest++ = 0x80 | ((c >> 12) & 0x3f);
+        *dest++ = 0x80 | ((c >> 6) & 0x3f);
+        *dest++ = 0x80 | (c & 0x3f);
+      }
+      pos += consumed;
+    }
+  }
+
+  return result();
+}
+
+}  // namespace workerd::utf8
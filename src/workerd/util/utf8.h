@@ -0,0 +1,67 @@
+// Copyright (c) 2024 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#pragma once
+
+#include <kj/array.h>
+
+// UTF-8 validation and transcoding to and from the two string representations V8 uses: Latin-1
+// (one byte per character) and UTF-16.
+//
+// Text in the wild is overwhelmingly ASCII, so each routine processes runs of ASCII 16 bytes at a
+// time using SSE2 or NEON (whichever the target has as a baseline), and falls back to scalar code
+// for everything else.
+//
+// Decoding follows the WHATWG Encoding Standard: each maximal subpart of an ill-formed sequence
+// is replaced with a single U+FFFD. Encoding replaces unpaired surrogates with U+FFFD.
+namespace workerd::utf8 {
+
+// Returns the length of the longest prefix of `bytes` containing only ASCII characters.
+size_t asciiPrefixLength(kj::ArrayPtr<const kj::byte> bytes);
+
+inline bool isAscii(kj::ArrayPtr<const kj::byte> bytes) {
+  return asciiPrefixLength(bytes) == bytes.size();
+}
+
+// Returns the number of bytes at the end of `bytes` which are the start of a sequence that is
+// valid so far, but incomplete. A streaming decoder must hold these back until more input arrives.
+size_t incompleteSuffixLength(kj::ArrayPtr<const kj::byte> bytes);
+
+struct DecodeInfo {
+  // Number of UTF-16 code units the input decodes to.
+  size_t utf16Length;
+
+  // True if every decoded character is in the range U+0000 to U+00FF, i.e. the output can be
+  // represented as Latin-1, in which case it is `utf16Length` bytes long.
+  bool isLatin1;
+
+  // False if the input contained any ill-formed sequences.
+  bool isValid;
+};
+
+// Validates `bytes` and computes the size of its decoded form.
+DecodeInfo scan(kj::ArrayPtr<const kj::byte> bytes);
+
+// Decodes `bytes` into `out`, which must be exactly `scan(bytes).utf16Length` long. The Latin-1
+// version requires that `scan(bytes).isLatin1` is true.
+void decodeToLatin1(kj::ArrayPtr<const kj::byte> bytes, kj::ArrayPtr<kj::byte> out);
+void decodeToUtf16(kj::ArrayPtr<const kj::byte> bytes, kj::ArrayPtr<char16_t> out);
+
+// Returns the length of the UTF-8 encoding of the given Latin-1 or UTF-16 text.
+size_t encodedLength(kj::ArrayPtr<const kj::byte> latin1);
+size_t encodedLength(kj::ArrayPtr<const char16_t> utf16);
+
+struct EncodeResult {
+  // Number of input characters (bytes for Latin-1, code units for UTF-16) consumed.
+  size_t read;
+
+  // Number of bytes written to the output.
+  size_t written;
+};
+
+// Encodes as much of the given text into `out` as fits, without splitting a character.
+EncodeResult encode(kj::ArrayPtr<const kj::byte> latin1, kj::ArrayPtr<kj::byte> out);
+EncodeResult encode(kj::ArrayPtr<const char16_t> utf16, kj::ArrayPtr<kj::byte> out);
+
+}  // namespace workerd::utf8